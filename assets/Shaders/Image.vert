@@ -3,9 +3,12 @@
 layout (location = 0) in vec4 vertex; // vec2 pos, vec2 tex
 out vec2 tex;
 
-uniform mat4 transform;
+layout(std140) uniform Transforms {
+    mat4 projection;
+    mat4 model;
+};
 
 void main() {
-    gl_Position = transform * vec4(vertex.xy, 0.0, 1.0);
+    gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
     tex = vertex.zw;
 }
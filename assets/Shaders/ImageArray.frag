@@ -0,0 +1,11 @@
+#version 330 core
+
+in vec2 tex;
+flat in float layer;
+out vec4 colour;
+
+uniform sampler2DArray sampler;
+
+void main() {
+    colour = texture(sampler, vec3(tex, layer));
+}
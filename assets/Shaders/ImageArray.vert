@@ -0,0 +1,17 @@
+#version 330 core
+
+layout (location = 0) in vec4 vertex; // vec2 pos, vec2 tex
+layout (location = 2) in float in_layer;
+out vec2 tex;
+flat out float layer;
+
+layout(std140) uniform Transforms {
+    mat4 projection;
+    mat4 model;
+};
+
+void main() {
+    gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
+    tex = vertex.zw;
+    layer = in_layer;
+}
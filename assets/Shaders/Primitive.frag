@@ -1,9 +1,8 @@
 #version 330 core
 
+in vec4 vertex_colour;
 out vec4 colour;
 
-uniform vec4 in_colour;
-
 void main() {
-    colour = in_colour;
+    colour = vertex_colour;
 }
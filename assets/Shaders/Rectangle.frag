@@ -2,11 +2,9 @@
 
 out vec4 colour;
 in vec2 position;
-
-uniform vec4 in_colour;
-uniform vec2 size;
-uniform mat4 transform;
-uniform float radius; // In pixels.
+flat in vec4 rect_colour;
+flat in vec2 size;
+flat in float radius; // In pixels.
 
 // How soft the edges should be (in pixels). Higher values could be used to simulate a drop shadow.
 const float edge_softness = .5f;
@@ -27,6 +25,6 @@ void main() {
     float a =  1.0f - smoothstep(0.0f, edge_softness * 2.0f, distance);
 
     // Return the resultant shape.
-    colour = vec4(in_colour.rgb, min(a, in_colour.a));
+    colour = vec4(rect_colour.rgb, min(a, rect_colour.a));
 }
 
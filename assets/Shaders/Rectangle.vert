@@ -1,14 +1,27 @@
 #version 330 core
 
-layout(location = 0) in vec2 vertex;
+layout(location = 0) in vec2 corner;    // Corner of the unit square.
+layout(location = 1) in vec4 placement; // Origin (xy), scale (z), and border radius (w).
+layout(location = 2) in vec4 region;    // Part of the rectangle to draw (min xy, max xy).
+layout(location = 3) in vec4 in_colour;
+layout(location = 4) in vec2 in_size;
+
 out vec2 position;
+flat out vec4 rect_colour;
+flat out vec2 size;
+flat out float radius;
 
-uniform mat4 transform;
+layout(std140) uniform Transforms {
+    mat4 projection;
+    mat4 model;
+};
 
 void main() {
-    gl_Position = transform * vec4(vertex.xy, 0.0, 1.0);
-
     // The box SDF needs to be evaluated before transforms are applied, so
-    // pass along the original position to the vertex shader.
-    position = vertex;
+    // pass along the untransformed position to the fragment shader.
+    position = mix(region.xy, region.zw, corner);
+    gl_Position = projection * vec4(placement.xy + position * placement.z, 0.0, 1.0);
+    rect_colour = in_colour;
+    size = in_size;
+    radius = placement.w;
 }
@@ -7,6 +7,11 @@ uniform sampler2D sampler;
 uniform vec4 text_colour;
 
 void main() {
-    colour = text_colour * vec4(1.0, 1.0, 1.0, texture(sampler, tex).r);
+    // The atlas contains signed distances to the outline of each glyph,
+    // where .5 is on the outline; smooth the edge over about a pixel,
+    // whatever size the text is drawn at.
+    float distance = texture(sampler, tex).r - 0.5;
+    float width = fwidth(distance);
+    float alpha = smoothstep(-width, width, distance);
+    colour = vec4(text_colour.rgb, text_colour.a * alpha);
 }
-
@@ -3,13 +3,12 @@
 layout (location = 0) in vec4 vertex; // vec2 pos, vec2 tex
 out vec2 tex;
 
-uniform mat4 transform;
-uniform float atlas_height;
+layout(std140) uniform Transforms {
+    mat4 projection;
+    mat4 model;
+};
 
 void main() {
-    gl_Position = transform * vec4(vertex.xy, 0.0, 1.0);
-
-    // Atlas width is constant, but the height might change,
-    // so recompute the V coordinate based on the height.
-    tex = vec2(vertex.z, vertex.w / atlas_height);
+    gl_Position = projection * model * vec4(vertex.xy, 0.0, 1.0);
+    tex = vertex.zw;
 }
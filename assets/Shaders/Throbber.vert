@@ -3,7 +3,10 @@
 layout (location = 0) in vec4 vertex; // vec2 pos
 
 uniform float r;
-uniform mat4 transform;
+layout(std140) uniform Transforms {
+    mat4 projection;
+    mat4 model;
+};
 uniform mat4 rotation;
 uniform vec2 position;
 
@@ -16,5 +19,5 @@ void main() {
         1.0
     );
 
-    gl_Position = transform * pos;
+    gl_Position = projection * model * pos;
 }
@@ -0,0 +1,95 @@
+#ifndef PRESCRIPTIVISM_BENCH_BENCH_HH
+#define PRESCRIPTIVISM_BENCH_BENCH_HH
+
+#include <Shared/Utils.hh>
+
+#include <base/Base.hh>
+
+#include <chrono>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pr::bench {
+class Suite;
+struct Result;
+struct RunOptions;
+
+/// Prevent the compiler from optimising away a value.
+template <typename T>
+void DoNotOptimise(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/// Render benchmark results as JSON.
+auto ToJSON(std::span<const Result> results, const RunOptions& opts) -> std::string;
+
+/// Register the benchmarks for the shared library.
+void RegisterSharedBenchmarks(Suite& s);
+
+/// Register the text shaping benchmarks; this opens a window since we
+/// need an OpenGL context to shape text.
+void RegisterTextBenchmarks(Suite& s);
+} // namespace pr::bench
+
+/// How to run benchmarks.
+struct pr::bench::RunOptions {
+    /// Only run benchmarks whose name contains this.
+    std::string filter;
+
+    /// Minimum time that a single repetition should take.
+    chr::milliseconds min_time{200};
+
+    /// How many times to run each benchmark.
+    usz repetitions = 5;
+};
+
+/// The timings of a benchmark.
+///
+/// All times are per item, where an item is whatever the benchmark
+/// processes in a loop, e.g. a packet or a pair of cards.
+struct pr::bench::Result {
+    std::string name;
+
+    /// Number of iterations per repetition.
+    u64 iterations;
+
+    /// Number of items processed per iteration.
+    u64 items;
+
+    /// Per-item times of all repetitions, in nanoseconds, sorted.
+    std::vector<f64> ns_per_item;
+
+    [[nodiscard]] auto min() const -> f64 { return ns_per_item.front(); }
+    [[nodiscard]] auto max() const -> f64 { return ns_per_item.back(); }
+    [[nodiscard]] auto median() const -> f64;
+    [[nodiscard]] auto mean() const -> f64;
+};
+
+/// A collection of benchmarks.
+class pr::bench::Suite {
+public:
+    /// Run a benchmark 'iterations' times.
+    using Body = std::function<void(u64 iterations)>;
+
+private:
+    struct Benchmark {
+        std::string name;
+        u64 items;
+        Body body;
+    };
+
+    std::vector<Benchmark> benchmarks;
+
+public:
+    /// Add a benchmark; 'items' is the number of items that a single
+    /// iteration of the benchmark processes.
+    void add(std::string name, Body body, u64 items = 1);
+
+    /// Run all benchmarks that match the filter.
+    auto run(const RunOptions& opts) -> std::vector<Result>;
+};
+
+#endif // PRESCRIPTIVISM_BENCH_BENCH_HH
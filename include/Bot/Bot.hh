@@ -0,0 +1,158 @@
+#ifndef PRESCRIPTIVISM_BOT_BOT_HH
+#define PRESCRIPTIVISM_BOT_BOT_HH
+
+#include <Shared/Cards.hh>
+#include <Shared/Constants.hh>
+#include <Shared/Metrics.hh>
+#include <Shared/Packets.hh>
+#include <Shared/TCP.hh>
+#include <Shared/Utils.hh>
+
+#include <base/Base.hh>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace pr::bot {
+class Bot;
+class BotThread;
+struct Options;
+struct Stats;
+} // namespace pr::bot
+
+/// Settings shared by all bots.
+struct pr::bot::Options {
+    std::string address;
+    u16 port;
+    std::string password;
+
+    /// Log in again with the same name once a game is over.
+    bool rejoin = true;
+};
+
+/// Statistics collected by all bots.
+///
+/// These use the same primitives as the server’s metrics, so they
+/// can be updated from any thread without locking.
+struct pr::bot::Stats {
+    /// Time between connecting and the server accepting our login.
+    metrics::Histogram login_latency{"bot_login_latency_seconds", "Time until a login is accepted", "", 1e-9};
+
+    /// Time between sending a move and the server ending our turn.
+    metrics::Histogram move_latency{"bot_move_latency_seconds", "Time until a move is acknowledged", "", 1e-9};
+
+    metrics::Counter moves{"bot_moves_total", "Moves made by all bots"};
+    metrics::Counter passes{"bot_passes_total", "Moves that were passes"};
+    metrics::Counter games{"bot_games_total", "Games that have ended"};
+    metrics::Counter errors{"bot_errors_total", "Connexions that failed or were kicked"};
+};
+
+/// A simulated player.
+///
+/// Bots play the first legal move they can find, and pass if there
+/// is none. They only know what the server tells them, just like a
+/// real client, so every move they make must be accepted by the server;
+/// if one isn’t, that is a bug on one side or the other.
+class pr::bot::Bot {
+    LIBBASE_IMMOVABLE(Bot);
+
+    struct Stack {
+        CardId top;
+        usz height = 1;
+        bool locked = false;
+    };
+
+    struct Player {
+        std::array<Stack, constants::StartingWordSize> word;
+    };
+
+    struct Validator;
+
+    const Options& opts;
+    Stats& stats;
+
+    /// The name we log in with.
+    Readonly(std::string, name);
+
+    /// Our connexion, if we have one.
+    net::TCPConnexion conn;
+
+    /// What we know about the game.
+    std::vector<Player> players;
+    std::vector<CardId> hand;
+    PlayerId us = 0;
+
+    /// When we connected, or sent our last move, if we’re waiting for
+    /// a response.
+    std::optional<chr::steady_clock::time_point> login_sent;
+    std::optional<chr::steady_clock::time_point> move_sent;
+
+    /// Set once we’re done with the current connexion.
+    bool done = false;
+
+    /// How many times in a row we have failed to connect.
+    u32 failed_connects = 0;
+
+public:
+    Bot(const Options& opts, Stats& stats, std::string name);
+
+    /// Get our connexion.
+    [[nodiscard]] auto connexion() -> net::TCPConnexion& { return conn; }
+
+    /// Connect to the server and log in; the connexion does not belong
+    /// to any event loop until the caller adopts it.
+    [[nodiscard]] auto connect() -> Result<>;
+
+    /// How long to wait before trying again after connect() failed;
+    /// this doubles with every failure, up to a limit.
+    [[nodiscard]] auto retry_delay() const -> chr::milliseconds;
+
+    /// Whether we should reconnect.
+    [[nodiscard]] bool wants_reconnect() const { return done and opts.rejoin; }
+
+    /// Process data sent by the server.
+    void receive(net::ReceiveBuffer& buf);
+
+#define X(name) void handle(packets::sc::name);
+    COMMON_PACKETS(X)
+    SC_PACKETS(X)
+#undef X
+
+private:
+    void Fail(std::string_view why);
+    void MakeMove();
+    auto ValidatorFor(PlayerId p) const -> Validator;
+};
+
+/// A thread that runs the event loop for a number of bots.
+class pr::bot::BotThread : net::TCPServerCallbacks {
+    LIBBASE_IMMOVABLE(BotThread);
+
+    net::TCPServer loop;
+    std::vector<std::unique_ptr<Bot>> bots;
+    net::ConnexionMap<Bot*> bot_map;
+
+    // The thread MUST be the last member of this class so it is joined
+    // before anything it touches is destroyed.
+    std::jthread thread;
+
+public:
+    /// Create 'count' bots and start running them.
+    BotThread(const Options& opts, Stats& stats, usz first_id, usz count);
+    ~BotThread();
+
+private:
+    void Connect(Bot& b);
+    void Run(std::stop_token stop);
+
+    bool accept(net::TCPConnexion& connexion) override;
+    void receive(net::TCPConnexion& client, net::ReceiveBuffer& buffer) override;
+};
+
+#endif // PRESCRIPTIVISM_BOT_BOT_HH
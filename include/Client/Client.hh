@@ -8,15 +8,19 @@
 #include <Shared/Cards.hh>
 #include <Shared/Constants.hh>
 #include <Shared/Packets.hh>
+#include <Shared/Queue.hh>
 #include <Shared/TCP.hh>
 #include <Shared/Utils.hh>
 
 #include <base/Base.hh>
 
+#include <atomic>
 #include <functional>
 #include <generator>
 #include <memory>
+#include <mutex>
 #include <ranges>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -29,6 +33,7 @@ class WaitingScreen;
 class WordChoiceScreen;
 class GameScreen;
 class Player;
+class ServerConnexion;
 } // namespace pr::client
 
 // =============================================================================
@@ -187,14 +192,20 @@ class pr::client::GameScreen : public Screen {
     /// The current game state.
     State state = State::NotOurTurn;
 
+    /// How much of the game we’ve seen, in case we need to rejoin.
+    packets::ResumePoint last_seen;
+
 public:
     explicit GameScreen(Client& c);
     void add_card(PlayerId id, u32 stack_idx, CardId card);
     void add_card_to_hand(CardId id);
     void enter(packets::sc::StartGame sg);
+    void enter(packets::sc::Snapshot s);
     void end_turn();
     void lock_changed(PlayerId player, u32 stack_index, bool locked);
     void on_refresh(Renderer& r) override;
+    void resume(packets::sc::Resume r);
+    auto resume_point() const -> packets::ResumePoint { return last_seen; }
     void start_turn();
     void tick(InputSystem& input) override;
 
@@ -217,6 +228,109 @@ private:
     auto ValidatorFor(Player& p) -> Validator;
 };
 
+// =============================================================================
+//  Networking
+// =============================================================================
+/// Our connexion to the game server.
+///
+/// The connexion is run by a thread of its own, so a slow frame doesn’t
+/// hold up the network, and a flood of packets doesn’t hold up rendering.
+/// The network thread answers heartbeats itself and hands every other
+/// packet to the UI thread through a queue, which handles them in
+/// receive(); packets that the UI thread sends go the other way through
+/// another one.
+///
+/// Apart from the network thread, this is only used by the UI thread.
+class pr::client::ServerConnexion : net::TCPServerCallbacks {
+    LIBBASE_IMMOVABLE(ServerConnexion);
+
+    /// A frame and the encoding it was sent in.
+    struct Packet {
+        std::vector<std::byte> data;
+        ser::Encoding encoding;
+    };
+
+    static constexpr usz QueueSize = 1'024;
+
+    net::TCPServer loop;
+    net::TCPConnexion conn;
+
+    /// Packets travelling between the two threads.
+    SPSCQueue<Packet, QueueSize> incoming;
+    SPSCQueue<std::vector<std::byte>, QueueSize> outgoing;
+
+    /// Frames that haven’t been handed to the network thread yet.
+    std::vector<std::vector<std::byte>> unsent;
+
+    /// Frames that were still in 'unsent' when the UI thread closed the
+    /// connexion; the network thread sends these before it closes it.
+    std::mutex overflow_lock;
+    std::vector<std::vector<std::byte>> overflow;
+
+    /// The buffer that still holds frames which didn’t fit into
+    /// 'incoming'; only used by the network thread.
+    net::ReceiveBuffer* stalled = nullptr;
+
+    /// Set while the network thread waits for room in 'incoming'.
+    std::atomic_bool backlogged = false;
+
+    /// Set once the network thread has pushed its last packet.
+    std::atomic_bool closed = false;
+
+    /// Set once the UI thread no longer wants the connexion.
+    std::atomic_bool close_requested = false;
+
+    /// The encoding we send packets in.
+    std::atomic<ser::Encoding> encoding = ser::Encoding::Fixed;
+
+    /// Why the network thread closed the connexion; this may only be
+    /// read once 'closed' is set.
+    std::string error;
+
+    /// Whether the UI thread is done with this connexion.
+    Readonly(bool, disconnected, true);
+
+    // The thread MUST be the last member of this class so it is joined
+    // before anything it touches is destroyed.
+    std::jthread thread;
+
+public:
+    ServerConnexion();
+    ~ServerConnexion();
+
+    /// Start talking to the server, closing the previous connexion.
+    void connect(net::TCPConnexion connexion);
+
+    /// Close the connexion once everything that was sent before this
+    /// has been handed to the network thread.
+    void disconnect();
+
+    /// Hand everything sent since the last call to the network thread.
+    void flush();
+
+    /// Handle every packet the network thread has received.
+    ///
+    /// If this returns an error, the connexion has been closed.
+    auto receive(Client& c) -> Result<>;
+
+    /// Queue a packet; it is sent once flush() is called.
+    template <typename T>
+    void send(const T& packet) {
+        if (disconnected) return;
+        unsent.push_back(net::SerialiseFrame(packet, encoding.load(std::memory_order::relaxed)));
+    }
+
+private:
+    void Forward(net::ReceiveBuffer& buf);
+    auto ForwardFrame(net::ReceiveBuffer& buf) -> Result<bool>;
+    void Run(std::stop_token stop);
+    void SendQueued();
+    void Stop();
+
+    bool accept(net::TCPConnexion& connexion) override;
+    void receive(net::TCPConnexion& connexion, net::ReceiveBuffer& buffer) override;
+};
+
 // =============================================================================
 //  Client
 // =============================================================================
@@ -244,7 +358,7 @@ public:
     GameScreen game_screen{*this};
 
     /// Connexion to the game server.
-    net::TCPConnexion server_connexion;
+    ServerConnexion server_connexion;
 
 private:
     Screen* current_screen = nullptr;
@@ -277,6 +391,7 @@ private:
     static auto Startup() -> Renderer;
 
     void RunGame();
+    auto ScreenName(const Screen& s) const -> std::string_view;
     void Tick();
     void TickNetworking();
 };
@@ -10,18 +10,35 @@
 #include <base/FS.hh>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <chrono>
+#include <initializer_list>
+#include <span>
+#include <stop_token>
 #include <utility>
+#include <vector>
 
 namespace pr::client {
 using namespace gl;
 
+struct GLStats;
 struct Size;
 
+class ArrayImage;
 class DrawableTexture;
+class Framebuffer;
+class ImageData;
 class ShaderProgram;
+class StreamBuffer;
 class Texture;
+class TextureArray;
+class TimerQuery;
+class UniformBuffer;
 class VertexArrays;
 class VertexBuffer;
+struct VertexAttribute;
+
+template <typename T>
+class Uniform;
 
 using glm::ivec2;
 using glm::mat3;
@@ -70,6 +87,7 @@ struct pr::ser::Serialiser<glm::vec<n, T>> {
 enum class pr::client::VertexLayout : base::u8 {
     Position2D,        /// vec2f position
     PositionTexture4D, /// vec4f position(xy)+texture(zw)
+    Custom,            /// Described by VertexArrays::add_stream()
 };
 
 enum class pr::client::Axis : base::u8 {
@@ -109,6 +127,31 @@ private:
     }
 };
 
+/// Counts the work that we hand to OpenGL.
+///
+/// This is only ever touched by the thread that owns the context; the
+/// profiler resets it at the start of every frame.
+struct pr::client::GLStats {
+    u32 draw_calls = 0;
+    u32 buffer_uploads = 0;
+    u32 texture_uploads = 0;
+    usz buffer_bytes = 0;
+
+    /// Get the counters.
+    static auto Get() -> GLStats&;
+
+    /// Record a draw call.
+    static void Draw() { Get().draw_calls++; }
+
+    /// Record data being copied into a buffer or texture.
+    static void UploadBuffer(usz bytes) {
+        Get().buffer_uploads++;
+        Get().buffer_bytes += bytes;
+    }
+
+    static void UploadTexture() { Get().texture_uploads++; }
+};
+
 /// Helper to keep track of and delete OpenGL objects.
 template <auto deleter>
 struct Descriptor {
@@ -168,6 +211,28 @@ private:
     void CopyImpl(std::span<const T> data, GLenum usage);
 };
 
+/// A float attribute of the vertices in a buffer.
+struct pr::client::VertexAttribute {
+    GLuint location;
+    GLint components;
+    usz offset;
+};
+
+/// A vertex buffer whose contents are replaced every time they
+/// are drawn, e.g. once per batch.
+class pr::client::StreamBuffer : Descriptor<glDeleteBuffers> {
+    usz capacity = 0;
+
+public:
+    StreamBuffer();
+
+    /// Bind the buffer.
+    void bind() const;
+
+    /// Replace the contents of the buffer.
+    void upload(std::span<const std::byte> data);
+};
+
 class pr::client::VertexArrays : Descriptor<glDeleteVertexArrays> {
     VertexLayout layout;
     std::vector<VertexBuffer> buffers;
@@ -181,12 +246,26 @@ public:
     auto add_buffer(Vertices<4> data, GLenum draw_mode = GL_TRIANGLES) -> VertexBuffer&;
     auto add_buffer(GLenum draw_mode = GL_TRIANGLES) -> VertexBuffer&;
 
+    /// Attaches a stream buffer whose vertices have the given attributes.
+    ///
+    /// If 'per_instance' is true, the attributes advance once per instance
+    /// rather than once per vertex. Streams are not drawn by draw_vertices().
+    void add_stream(
+        const StreamBuffer& buffer,
+        usz stride,
+        std::initializer_list<VertexAttribute> attributes,
+        bool per_instance = false
+    );
+
     /// Binds the vertex array.
     void bind() const;
 
     /// Draw the vertex array.
     void draw_vertices() const;
 
+    /// Draw part of a vertex array that contains a single buffer.
+    void draw_vertices(usz first, usz count) const;
+
     /// Check if this contains no buffers.
     auto empty() const -> bool { return buffers.empty(); }
 
@@ -199,6 +278,34 @@ private:
     void ApplyLayout();
 };
 
+/// The location of a uniform of type 'T' in a shader program.
+///
+/// Setting a uniform that doesn’t exist, e.g. because the shader compiler
+/// optimised it away, does nothing.
+template <typename T>
+class pr::client::Uniform {
+    friend ShaderProgram;
+    GLint location = -1;
+    explicit Uniform(GLint location) : location(location) {}
+
+public:
+    Uniform() = default;
+};
+
+/// A uniform buffer object, which can be shared between shader programs.
+class pr::client::UniformBuffer : Descriptor<glDeleteBuffers> {
+public:
+    UniformBuffer() = default;
+
+    /// Allocate a buffer and attach it to a binding point; shader
+    /// programs can use it by calling ShaderProgram::bind_block().
+    UniformBuffer(usz size, GLuint binding);
+
+    /// Write data into the buffer at a given offset.
+    void write(usz offset, std::span<const std::byte> data);
+    void write(usz offset, const mat4& m) { write(offset, std::as_bytes(std::span{value_ptr(m), 16})); }
+};
+
 class pr::client::ShaderProgram : Descriptor<glDeleteProgram> {
 public:
     ShaderProgram() = default;
@@ -207,26 +314,33 @@ public:
         std::span<const char> fragment_shader_source
     );
 
-    /// Set a uniform.
-    void uniform(ZTermString name, vec2 v);
-    void uniform(ZTermString name, vec4 v);
-    void uniform(ZTermString name, mat3 m);
-    void uniform(ZTermString name, mat4 m);
-    void uniform(ZTermString name, f32 f);
+    /// Make a uniform block of this program use a binding point.
+    void bind_block(ZTermString name, GLuint binding);
+
+    /// Look up the location of a uniform.
+    template <typename T>
+    auto locate(ZTermString name) const -> Uniform<T> {
+        return Uniform<T>{glGetUniformLocation(descriptor, name.c_str())};
+    }
+
+    /// Set a uniform; the program must be active.
+    void set(Uniform<vec2> u, vec2 v);
+    void set(Uniform<vec4> u, vec4 v);
+    void set(Uniform<mat3> u, mat3 m);
+    void set(Uniform<mat4> u, mat4 m);
+    void set(Uniform<f32> u, f32 f);
 
     /// Set this as the active shader.
     ///
     /// Prefer to call Renderer::use() instead.
     void use_shader_program_dont_call_this_directly() const { glUseProgram(descriptor); }
-
-private:
-    template <typename... T>
-    void SetUniform(ZTermString name, auto callable, T... args);
 };
 
 /// This is an internal handle to texture data. You probably
 /// wand DrawableTexture instead.
 class pr::client::Texture : Descriptor<glDeleteTextures> {
+    friend Framebuffer;
+
     GLenum target{};
     GLenum unit{};
     GLenum format{};
@@ -272,8 +386,6 @@ public:
 };
 
 class pr::client::DrawableTexture : public Texture {
-    VertexArrays vao{VertexLayout::PositionTexture4D};
-
 public:
     DrawableTexture(
         const void* data,
@@ -308,13 +420,127 @@ public:
     /// texture.
     static auto LoadFromFile(fs::PathRef path) -> DrawableTexture;
 
-    /// Draw the texture.
+private:
+    friend ArrayImage;
+    static auto MakeVerts(f32 wd, f32 ht, f32 u, f32 v) -> std::array<vec4, 4>;
+};
+
+/// A framebuffer that renders into a texture.
+class pr::client::Framebuffer : Descriptor<glDeleteFramebuffers> {
+    Texture colour;
+    ComputedReadonly(Size, size, colour.size);
+
+public:
+    Framebuffer() = default;
+
+    /// Create a framebuffer with an RGBA texture of the given size.
+    explicit Framebuffer(Size size);
+
+    /// Draw into this framebuffer.
     ///
-    /// Prefer to call Renderer::draw_texture() instead.
-    void draw_vertices() const;
+    /// Prefer to call Renderer::draw_to() instead.
+    void bind() const;
+
+    /// Get the texture that this renders into.
+    [[nodiscard]] auto texture() const -> const Texture& { return colour; }
+};
+
+/// Measures how long the GPU spends on the commands issued between
+/// begin() and end(); only one of these can be running at a time.
+///
+/// Results arrive some time after end() since the GPU lags behind us,
+/// so callers should keep several of these and only read the ones that
+/// are available() to avoid waiting for the GPU.
+class pr::client::TimerQuery : Descriptor<glDeleteQueries> {
+public:
+    TimerQuery();
+
+    /// Start and stop measuring.
+    void begin() const;
+    void end() const;
+
+    /// Whether the result of the last measurement is available.
+    [[nodiscard]] bool available() const;
+
+    /// Get the result of the last measurement; this waits for the GPU
+    /// if the result is not available yet.
+    [[nodiscard]] auto elapsed() const -> chr::nanoseconds;
+};
+
+/// RGBA images that have been decoded, but not uploaded yet.
+///
+/// Decoding doesn’t need an OpenGL context, so this can be done on
+/// any thread; use TextureArray to upload the images afterwards.
+class pr::client::ImageData {
+    friend TextureArray;
+
+    struct Image {
+        std::vector<u8> pixels;
+        u32 width;
+        u32 height;
+    };
+
+    std::vector<Image> images;
+
+public:
+    ImageData() = default;
+
+    /// Decode a number of images on several threads; images are in the
+    /// same order as the paths. If an image cannot be loaded, it is
+    /// replaced with the builtin default texture.
+    static auto Decode(std::span<const fs::Path> paths, std::stop_token stop = {}) -> ImageData;
+
+    /// Get the number of images.
+    [[nodiscard]] auto size() const -> usz { return images.size(); }
+};
+
+/// A 2D texture array that holds a number of images; this lets us
+/// draw any of them without binding another texture.
+///
+/// Every layer is as large as the largest image; smaller images only
+/// use the part of their layer that starts at texture coordinate 0.
+class pr::client::TextureArray : Descriptor<glDeleteTextures> {
+    Readonly(u32, width);
+    Readonly(u32, height);
+    Readonly(u32, layers);
+
+public:
+    TextureArray() = default;
+
+    /// Upload images; must be called on the render thread.
+    explicit TextureArray(const ImageData& data);
+
+    /// Bind this texture to texture unit 0.
+    void bind() const;
+
+    /// Get an image in this texture.
+    [[nodiscard]] auto image(u32 layer) const -> ArrayImage;
 
 private:
-    static auto MakeVerts(f32 wd, f32 ht, f32 u, f32 v) -> std::array<vec4, 4>;
+    std::vector<Size> sizes;
+};
+
+/// An image in a texture array.
+class pr::client::ArrayImage {
+    friend TextureArray;
+
+    Readonly(const TextureArray*, array, nullptr);
+    Readonly(u32, layer, 0);
+    Readonly(Size, size);
+
+    ArrayImage(const TextureArray& array, u32 layer, Size size) : _array{&array}, _layer{layer}, _size{size} {}
+
+public:
+    ArrayImage() = default;
+
+    /// Create triangle strip texture vertices for a given size.
+    ///
+    /// If the image is larger than the requested size, only part of it
+    /// is drawn; if it is smaller, it is stretched to fill the space.
+    auto create_vertices(Size size) const -> std::array<vec4, 4>;
+
+    /// Create triangle strip texture vertices for a given size.
+    auto create_vertices_scaled(f32 scale) const -> std::array<vec4, 4>;
 };
 
 #endif // PRESCRIPTIVISM_CLIENT_RENDER_GL_HH
@@ -0,0 +1,145 @@
+#ifndef PRESCRIPTIVISM_CLIENT_RENDER_PROFILER_HH
+#define PRESCRIPTIVISM_CLIENT_RENDER_PROFILER_HH
+
+#include <Client/Render/GL.hh>
+
+#include <Shared/Utils.hh>
+
+#include <base/Base.hh>
+#include <base/FS.hh>
+
+#include <array>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pr::client {
+class Profiler;
+class Renderer;
+} // namespace pr::client
+
+/// Measures how long frames take and what they spend their time on.
+///
+/// This is off until it is toggled (F3), at which point it records
+/// the CPU time of each part of a frame, the GPU time of the whole
+/// frame, and how much work we handed to OpenGL; the overlay shows
+/// the last few seconds of this, and dump_trace() (F4) writes them
+/// to a file that can be opened in Perfetto or chrome://tracing.
+class pr::client::Profiler {
+    LIBBASE_MOVE_ONLY(Profiler);
+
+public:
+    using Clock = chr::steady_clock;
+
+    /// The parts of a frame that we measure.
+    enum struct Section : u8 {
+        Networking, ///< Handling packets from the server.
+        Refresh,    ///< Screen::refresh().
+        Tick,       ///< Screen::tick().
+        Draw,       ///< Screen::draw().
+        Present,    ///< Submitting the last batch and swapping buffers.
+    };
+
+    static constexpr usz Sections = +Section::Present + 1;
+
+    /// The number of frames we keep.
+    static constexpr usz HistorySize = 256;
+
+    /// Where F4 writes the trace.
+    static constexpr std::string_view TraceFile = "frame-trace.json";
+
+private:
+    /// What we know about a single frame.
+    struct Sample {
+        Clock::time_point start;
+        Clock::duration total{};
+
+        /// When each section started, relative to the start of the
+        /// frame, and how long it took; sections that run several
+        /// times start when they first ran.
+        std::array<Clock::duration, Sections> offset{};
+        std::array<Clock::duration, Sections> cpu{};
+
+        /// GPU time, once the GPU has gotten around to telling us.
+        std::optional<chr::nanoseconds> gpu;
+
+        GLStats gl;
+        u32 refreshes = 0;
+        std::string_view screen;
+    };
+
+    /// A timer query, and the frame it is measuring, if any.
+    struct Query {
+        TimerQuery query;
+        std::optional<u64> frame;
+    };
+
+    /// The GPU lags a few frames behind, so keep enough queries around
+    /// that we don’t have to wait for it to finish one.
+    static constexpr usz QueryCount = 4;
+
+    std::vector<Sample> history = std::vector<Sample>(HistorySize);
+    Sample current;
+
+    /// The number of frames we have recorded.
+    u64 frames = 0;
+
+    /// These can only be created once we have an OpenGL context.
+    std::vector<Query> queries;
+    usz next_query = 0;
+    Query* running_query = nullptr;
+
+    /// The screen that frames are drawn for.
+    std::string_view screen;
+
+    /// The text of the overlay; this is only updated a few times a
+    /// second so it can actually be read.
+    std::vector<std::string> lines;
+    Clock::time_point last_update;
+
+    /// Whether we’re recording frames.
+    Readonly(bool, enabled, false);
+
+public:
+    Profiler() = default;
+
+    /// Start and end a frame; Renderer::frame() calls these.
+    void begin_frame();
+    void end_frame();
+
+    /// Draw the overlay; this does nothing if we’re disabled.
+    void draw(Renderer& r);
+
+    /// Write the frames we have to a file, in the Chrome trace format.
+    auto dump_trace(fs::PathRef path) const -> Result<>;
+
+    /// Measure how long a part of the current frame takes.
+    template <typename Callable>
+    void measure(Section s, Callable&& c) {
+        if (not enabled) return c();
+        auto start = Clock::now();
+        c();
+        Record(s, start, Clock::now());
+    }
+
+    /// Count widgets that were refreshed.
+    void refreshed(usz count = 1) {
+        if (enabled) current.refreshes += u32(count);
+    }
+
+    /// Set the name of the screen that is being drawn.
+    void set_screen(std::string_view name) { screen = name; }
+
+    /// Start or stop recording.
+    void toggle();
+
+private:
+    void CollectQueries();
+    void Record(Section s, Clock::time_point start, Clock::time_point end);
+    auto Samples() const -> std::vector<const Sample*>;
+    void UpdateOverlay();
+};
+
+#endif // PRESCRIPTIVISM_CLIENT_RENDER_PROFILER_HH
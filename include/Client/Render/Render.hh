@@ -2,6 +2,7 @@
 #define PRESCRIPTIVISM_CLIENT_RENDER_RENDER_HH
 
 #include <Client/Render/GL.hh>
+#include <Client/Render/Profiler.hh>
 
 #include <Shared/Serialisation.hh>
 #include <Shared/Utils.hh>
@@ -14,7 +15,9 @@
 #include <SDL3/SDL_video.h>
 
 #include <hb.h>
+#include <list>
 #include <memory>
+#include <optional>
 #include <stop_token>
 #include <unordered_map>
 #include <vector>
@@ -28,6 +31,9 @@ struct xy;
 class AssetLoader;
 class Renderer;
 class Font;
+class GlyphAtlas;
+class ShapedTextCache;
+struct ShapedText;
 class Text;
 
 enum struct FontSize : u32;
@@ -283,22 +289,113 @@ struct std::formatter<pr::client::AABB> : std::formatter<std::string> {
 // =============================================================================
 //  Text
 // =============================================================================
-/// A fixed-sized font, combined with a HarfBuzz shaper and texture atlas.
-class pr::client::Font {
-public:
+/// A signed distance field atlas of the glyphs of a font face.
+///
+/// Glyphs are rendered once, at a fixed size, and every Font that uses
+/// the face scales them to its own size; the text shader turns the
+/// distances back into sharp edges at whatever size the text is drawn.
+class pr::client::GlyphAtlas {
+    LIBBASE_IMMOVABLE(GlyphAtlas);
     friend AssetLoader;
 
-private:
-    using HarfBuzzFontHandle = Handle<hb_font_t*, hb_font_destroy>;
-    using HarfBuzzBufferHandle = Handle<hb_buffer_t*, hb_buffer_destroy>;
+public:
+    /// The size in pixels at which glyphs are rendered.
+    static constexpr u32 GlyphSize = 64;
+
+    /// How far the distance field extends past the outline of a glyph,
+    /// in pixels; this is also the padding around every glyph.
+    static constexpr u32 Spread = 8;
+
+    /// The width and height of every page; this is the smallest maximum
+    /// texture size that OpenGL 3.3 guarantees. We can’t ask the driver
+    /// since glyphs may be rendered before we have an OpenGL context.
+    static constexpr u32 PageSize = 1'024;
+
+    /// The metrics of a glyph at GlyphSize, excluding the padding.
     struct Metrics {
-        PR_SERIALISE(atlas_index, size, bearing);
+        PR_SERIALISE(page, x, y, size, bearing);
 
-        u32 atlas_index;
+        u32 page;
+        u32 x, y; ///< Position of the padded glyph in its page, in pixels.
         vec2 size;
         vec2 bearing;
     };
 
+private:
+    /// A row of glyphs in a page.
+    struct Shelf {
+        PR_SERIALISE(y, height, width);
+
+        u32 y;
+        u32 height;
+        u32 width; ///< How much of the row is in use.
+    };
+
+    /// A page of the atlas.
+    ///
+    /// Glyphs are packed into shelves and never move once they’ve been
+    /// added, so text that has already been shaped stays valid; when a
+    /// page is full, we start a new one.
+    struct Page {
+        Texture texture;
+        std::vector<Shelf> shelves;
+
+        /// How much of the page is taken up by shelves.
+        u32 height{};
+
+        /// Glyphs rendered before we had an OpenGL context; these are
+        /// uploaded by AssetLoader::finalise().
+        std::vector<std::byte> pixels;
+    };
+
+    FT_Face face;
+    std::unordered_map<FT_UInt, Metrics> glyphs;
+    std::vector<Page> pages;
+
+    /// Whether we can create textures; until then, glyphs are only
+    /// rendered into memory.
+    bool has_context = false;
+
+public:
+    explicit GlyphAtlas(FT_Face face) : face(face) {}
+
+    /// Get the metrics of a glyph, adding it to the atlas if need be.
+    auto glyph(FT_UInt glyph) -> const Metrics&;
+
+    /// Get the number of pages.
+    [[nodiscard]] auto page_count() const -> usz { return pages.size(); }
+
+    /// Add the glyphs for some characters ahead of time.
+    void prerender(std::u32string_view chars);
+
+    /// Activate a page for rendering.
+    void use(u32 page) const;
+
+private:
+    void AddGlyph(FT_UInt glyph);
+    void AddPage();
+    auto FindShelf(u32 wd, u32 ht) -> std::pair<u32, Shelf*>;
+    void Upload(Page& page);
+
+    /// Read the atlas from a cache file, or write it to one; this only
+    /// works before we have an OpenGL context, since the pixels of the
+    /// pages are not kept in memory after that. 'key' identifies the
+    /// font the cache was made from.
+    auto LoadCache(fs::PathRef path, u32 key) -> Result<>;
+    auto SaveCache(fs::PathRef path, u32 key) const -> Result<>;
+};
+
+/// A fixed-sized font, combined with a HarfBuzz shaper; its glyphs
+/// come from the atlas of its face.
+class pr::client::Font {
+public:
+    friend AssetLoader;
+    friend Renderer;
+
+private:
+    using HarfBuzzFontHandle = Handle<hb_font_t*, hb_font_destroy>;
+    using HarfBuzzBufferHandle = Handle<hb_buffer_t*, hb_buffer_destroy>;
+
     /// The renderer that owns this font.
     Readonly(Renderer&, renderer, nullptr);
 
@@ -312,33 +409,8 @@ private:
     std::vector<HarfBuzzBufferHandle> hb_bufs;
     usz hb_buffers_in_use = 0;
 
-    /// Metrics for all glyphs in the font.
-    std::unordered_map<FT_UInt, Metrics> glyphs{};
-
-    /// List of glyphs, in order, that have been added to the atlas; this
-    /// has the same contents as the map, except it’s ordered.
-    std::vector<FT_UInt> glyphs_ordered{};
-
-    /// Memory buffer for texture atlas allocation.
-    std::vector<std::byte> atlas_buffer;
-
-    /// Whether the atlas needs to be rebuilt.
-    bool dirty = false;
-
-    /// The width and height of a cell in the texture atlas.
-    u32 atlas_entry_width{};
-    u32 atlas_entry_height{};
-
-    /// The width of the atlas; to prevent glyphs that are already in the
-    /// atlas from moving, we always set the atlas width to the maximum row
-    /// size.
-    u32 atlas_width{};
-
-    /// The number of rows in the texture atlas.
-    u32 atlas_rows{};
-
-    /// The number of entries in the atlas.
-    u32 atlas_entries{};
+    /// The atlas of the font face.
+    GlyphAtlas* atlas{};
 
     /// The font size.
     Readonly(FontSize, size);
@@ -355,29 +427,23 @@ private:
     /// Maximum ascender and descender.
     f32 strut_asc{}, strut_desc{};
 
-    /// The atlas texture.
-    Texture atlas;
-
 public:
     i32 x_height{};
 
 private:
-    Font(FT_Face ft_face, FontSize size, TextStyle style);
+    Font(FT_Face ft_face, FontSize size, TextStyle style, GlyphAtlas& atlas);
 
 public:
     Font() = default;
 
-    /// Get the size of the font texture.
-    auto atlas_height() const -> i32;
-
     /// Get the bold variant of this font.
     auto bold() -> Font&;
 
     /// Get the italic variant of this font.
     auto italic() -> Font&;
 
-    /// Activate the font for rendering.
-    void use() const;
+    /// Activate a page of the font’s atlas for rendering.
+    void use(u32 page) const;
 
     /// Shape text using this font.
     ///
@@ -407,10 +473,26 @@ struct pr::client::TextCluster {
     bool operator==(const TextCluster& rhs) const { return index == rhs.index; }
 };
 
+/// The output of shaping a text.
+struct pr::client::ShapedText {
+    /// Vertices that use the same atlas page, which are adjacent.
+    struct PageRange {
+        u32 page;
+        u32 first;
+        u32 count;
+    };
+
+    VertexArrays vertices{VertexLayout::PositionTexture4D};
+    std::vector<PageRange> page_ranges;
+    f32 width{}, height{}, depth{};
+    bool multiline{};
+};
+
 /// A text object that caches the shaping output and vertices needed
 /// to render the text.
 class pr::client::Text {
     friend Font;
+    friend ShapedTextCache;
 
     /// The alignment of the text.
     Property(TextAlign, align);
@@ -427,7 +509,7 @@ class pr::client::Text {
     Readonly(Font&, font);
 
     /// Whether this text spans multiple lines.
-    ComputedReadonly(bool, multiline, _multiline);
+    ComputedReadonly(bool, multiline, shaped and shaped->multiline);
 
     /// The style of the text (regular, bold, italic).
     ComputedProperty(TextStyle, style, font.style);
@@ -439,22 +521,21 @@ class pr::client::Text {
     ComputedReadonly(bool, empty, content.empty());
 
     /// The horizontal width of the text.
-    ComputedReadonly(f32, width, reshape()._width);
+    ComputedReadonly(f32, width, reshape().shaped->width);
 
     /// The vertical height of the text above the baseline.
-    ComputedReadonly(f32, height, reshape()._height);
+    ComputedReadonly(f32, height, reshape().shaped->height);
 
     /// The vertical depth of the text below the baseline. This
     /// value is positive.
-    ComputedReadonly(f32, depth, reshape()._depth);
+    ComputedReadonly(f32, depth, reshape().shaped->depth);
 
     /// The total size of the text, including depth.
     ComputedReadonly(Size, text_size, Size(i32(width), i32(height + depth)));
 
-    /// Internal state cache.
-    mutable std::optional<VertexArrays> vertices;
-    mutable f32 _width{}, _height{}, _depth{};
-    mutable bool _multiline{};
+    /// Internal state cache; this may be shared with other texts
+    /// that have the same contents.
+    mutable std::shared_ptr<const ShapedText> shaped;
 
 public:
     /// Use Renderer::text() instead if you want the text to be shaped
@@ -477,6 +558,41 @@ private:
     auto reshape() const -> const Text&;
 };
 
+/// Shaped texts, shared by all texts with the same contents, font,
+/// width, and alignment; the least recently used entries are evicted
+/// once the cache is full.
+class pr::client::ShapedTextCache {
+    struct Key {
+        const Font* font;
+        std::u32string_view content;
+        i32 desired_width;
+        TextAlign align;
+
+        bool operator==(const Key&) const = default;
+    };
+
+    struct KeyHash {
+        auto operator()(const Key& k) const -> usz;
+    };
+
+    struct Entry {
+        std::u32string content;
+        std::shared_ptr<const ShapedText> shaped;
+        Key key; ///< Refers to 'content'.
+    };
+
+    /// Entries, most recently used first.
+    std::list<Entry> entries;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+    usz capacity;
+
+public:
+    explicit ShapedTextCache(usz capacity = 2'048) : capacity(capacity) {}
+
+    /// Get the shaped form of a text, shaping it if need be.
+    auto get(const Text& text) -> std::shared_ptr<const ShapedText>;
+};
+
 // =============================================================================
 //  Renderer
 // =============================================================================
@@ -500,6 +616,7 @@ namespace pr::client {
 struct FontData {
     std::array<FTLibraryHandle, 4> ft{};
     std::array<FTFaceHandle, 4> ft_face{};
+    std::array<std::unique_ptr<GlyphAtlas>, 4> atlases{};
     std::unordered_map<FontEntry, Font> fonts{};
 };
 } // namespace pr::client
@@ -528,6 +645,7 @@ class pr::client::Renderer {
     LIBBASE_MOVE_ONLY(Renderer);
 
     friend AssetLoader;
+    friend Text;
 
 public:
     class [[nodiscard]] MatrixRAII {
@@ -540,6 +658,16 @@ public:
         ~MatrixRAII() { r.matrix_stack.pop_back(); }
     };
 
+    class [[nodiscard]] TargetRAII {
+        LIBBASE_IMMOVABLE(TargetRAII);
+        friend Renderer;
+        Renderer& r;
+        explicit TargetRAII(Renderer& r) : r(r) {}
+
+    public:
+        ~TargetRAII() { r.EndTarget(); }
+    };
+
 private:
     SDLWindowHandle window;
     SDLGLContextStateHandle context;
@@ -548,16 +676,97 @@ public:
     ShaderProgram primitive_shader;
     ShaderProgram text_shader;
     ShaderProgram image_shader;
+    ShaderProgram image_array_shader;
     ShaderProgram throbber_shader;
     ShaderProgram rect_shader;
 
+    /// Measures frames; see Profiler.
+    Profiler profiler;
+
+    /// Uniforms of the throbber shader.
+    struct {
+        Uniform<vec2> position;
+        Uniform<mat4> rotation;
+        Uniform<f32> r;
+    } throbber_uniforms;
+
 private:
+    /// Matrices that every shader has access to; this must match the
+    /// 'Transforms' block in the shaders (std140 layout).
+    struct Transforms {
+        mat4 projection; ///< Screen to clip coordinates.
+        mat4 model;      ///< Transform of what is drawn after use().
+    };
+
+    static constexpr GLuint TransformsBinding = 0;
+    UniformBuffer transforms;
+
+    /// Uniforms of the text shader.
+    struct {
+        Uniform<vec4> colour;
+    } text_uniforms;
+
+    /// Texts that have been shaped recently.
+    ShapedTextCache text_cache;
+
     FontData font_data;
     std::unordered_map<Cursor, SDL_Cursor*> cursor_cache;
     Cursor active_cursor = Cursor::Default;
     Cursor requested_cursor = Cursor::Default;
     std::vector<mat4> matrix_stack;
 
+    /// Draws that have been collected but not submitted yet.
+    ///
+    /// Consecutive rectangles, lines, or quads of the same texture are
+    /// drawn with a single draw call; the batch is flushed whenever we
+    /// switch to a different kind of draw, and at the end of the frame.
+    /// Everything in it is already in screen coordinates.
+    struct Batch {
+        enum struct Kind : u8 {
+            None,
+            Lines,
+            Rects,
+            Textured,
+            TexturedArray,
+            Composite, ///< Textured, with premultiplied alpha.
+        };
+
+        /// A vertex of a line or textured quad.
+        struct Vertex {
+            vec4 vertex; ///< Position (xy) and texture coordinates (zw).
+            vec4 colour;
+            f32 layer;   ///< Layer in the texture array, if any.
+        };
+
+        /// A rectangle, which is drawn as an instance of a unit square.
+        struct Rect {
+            vec4 placement; ///< Origin (xy), scale (z), and border radius (w).
+            vec4 region;    ///< Part of the rectangle to draw (min xy, max xy).
+            vec4 colour;
+            vec2 size;
+        };
+
+        VertexArrays vertex_vao{VertexLayout::Custom};
+        VertexArrays rect_vao{VertexLayout::Custom};
+        StreamBuffer vertex_buffer;
+        StreamBuffer rect_buffer;
+        StreamBuffer unit_square;
+        std::vector<Vertex> vertices;
+        std::vector<Rect> rects;
+        Kind kind = Kind::None;
+
+        /// The Texture or TextureArray of a batch of textured quads.
+        const void* texture = nullptr;
+
+        Batch();
+    };
+
+    /// This can only be created once we have an OpenGL context.
+    std::optional<Batch> batch;
+
+    /// The framebuffer we’re drawing to, if not the window.
+    const Framebuffer* target = nullptr;
+
 public:
     class Frame {
         LIBBASE_IMMOVABLE(Frame);
@@ -585,6 +794,14 @@ public:
     /// Clear the screen.
     void clear(Colour c = Colour::White);
 
+    /// Get the scale of the current transform.
+    [[nodiscard]] auto current_scale() const -> f32 { return matrix_stack.back()[0][0]; }
+
+    /// Draw the contents of a framebuffer that was drawn with draw_to();
+    /// 'scale' is the scale that was used there, so the contents end up
+    /// as large as they were when they were drawn.
+    void draw_framebuffer(const Framebuffer& fb, xy pos, f32 scale = 1);
+
     /// Draw a line between two points.
     void draw_line(xy start, xy end, Colour c = Colour::White);
 
@@ -630,6 +847,7 @@ public:
     ///
     /// \see draw_texture_scaled(), draw_texture_sized()
     void draw_texture(const DrawableTexture& tex, xy pos);
+    void draw_texture(const ArrayImage& img, xy pos);
 
     /// Draw a texture at a position in world coordinates.
     ///
@@ -639,6 +857,7 @@ public:
     ///
     /// \see draw_texture(), draw_texture_sized()
     void draw_texture_scaled(const DrawableTexture& tex, xy pos, f32 scale);
+    void draw_texture_scaled(const ArrayImage& img, xy pos, f32 scale);
 
     /// Draw a texture at a position in world coordinates.
     ///
@@ -651,6 +870,22 @@ public:
     /// \see draw_texture(), draw_texture_scaled()
     void draw_texture_sized(const DrawableTexture& tex, AABB box);
 
+    /// Draw an image from a texture array at a position in world coordinates.
+    ///
+    /// This works like the overload for textures, except that images
+    /// that are smaller than the requested size are stretched.
+    void draw_texture_sized(const ArrayImage& img, AABB box);
+
+    /// Draw into a framebuffer instead of the window.
+    ///
+    /// The framebuffer is cleared, and everything drawn until the
+    /// returned object goes out of scope ends up in it, starting at
+    /// its bottom left corner and scaled by 'scale'. Colours in the
+    /// framebuffer are premultiplied by their alpha.
+    ///
+    /// \see draw_framebuffer()
+    auto draw_to(Framebuffer& fb, f32 scale = 1) -> TargetRAII;
+
     /// Get a font of a given size.
     auto font(FontSize size, TextStyle style = TextStyle::Regular) -> Font&;
 
@@ -724,6 +959,9 @@ public:
     ) -> Text;
 
     /// Set the active shader.
+    ///
+    /// This flushes any batched draws since whatever the caller draws
+    /// next is drawn immediately.
     void use(ShaderProgram& shader, xy position);
 
 private:
@@ -731,6 +969,21 @@ private:
     void frame_end();
     void frame_start();
 
+    /// Add to the batch, flushing it first if it is of a different kind.
+    void AddRect(xy pos, Size size, vec4 region, Colour c, i32 border_radius);
+    void AddTexturedQuad(Batch::Kind kind, const void* texture, xy pos, const std::array<vec4, 4>& quad, f32 layer = 0);
+    void BeginBatch(Batch::Kind kind, const void* texture = nullptr);
+
+    /// Go back to drawing to the window; see draw_to().
+    void EndTarget();
+
+    /// Submit everything in the batch.
+    void Flush();
+
+    /// Look up uniforms and attach uniform blocks; this must be done
+    /// whenever the shaders are (re)loaded.
+    void LocateUniforms();
+
     /// Set the current cursor.
     void SetCursorImpl();
 };
@@ -58,7 +58,12 @@ enum class Anchor : u8;
 enum class Selectable : u8;
 using Hoverable = Selectable;
 
-void InitialiseUI(Renderer& r);
+/// Decode the card art; this runs on a separate thread while
+/// the assets are loading and does not use OpenGL.
+auto DecodeCardArt(std::stop_token stop) -> ImageData;
+
+/// Upload the card art and set up anything else the UI needs.
+void InitialiseUI(Renderer& r, const ImageData& card_art);
 } // namespace pr::client
 
 namespace pr::client {
@@ -320,7 +325,39 @@ public:
     /// Unselect the element.
     void unselect();
 
+    /// Discard what DrawCached() has drawn for this widget and for the
+    /// widgets that contain it; this happens automatically whenever a
+    /// widget requests a refresh.
+    void invalidate();
+
+protected:
+    /// Draw a widget through a texture, which is only redrawn if the
+    /// widget has been invalidated or 'key' has changed since the last
+    /// time; this is meant for widgets that rarely change, but are
+    /// expensive to draw.
+    ///
+    /// 'draw' must draw relative to the current transform, stay within
+    /// 'size', and not depend on anything that is drawn before it.
+    template <typename Callable>
+    void DrawCached(Renderer& r, Size size, u64 key, Callable draw) {
+        if (PrepareCache(r, size, key)) {
+            auto _ = r.draw_to(*draw_cache, cache_scale);
+            draw();
+        }
+
+        r.draw_framebuffer(*draw_cache, {0, 0}, cache_scale);
+    }
+
 private:
+    /// What DrawCached() drew last time, and what it drew it with.
+    std::unique_ptr<Framebuffer> draw_cache;
+    f32 cache_scale = 0;
+    u64 cache_key = 0;
+    bool cache_valid = false;
+
+    /// Check whether the cache needs to be redrawn.
+    bool PrepareCache(Renderer& r, Size size, u64 key);
+
     void unselect_impl(Screen& parent);
 };
 
@@ -562,7 +599,7 @@ public:
 };
 
 class pr::client::Image : public Widget {
-    Property(DrawableTexture*, texture, nullptr);
+    Property(const ArrayImage*, texture, nullptr);
 
     /// The size of the image. If x or y is 0, they are set from the texture.
     Property(Size, fixed_size, {});
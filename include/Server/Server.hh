@@ -3,69 +3,45 @@
 
 #include <Shared/Cards.hh>
 #include <Shared/Constants.hh>
+#include <Shared/GameState.hh>
+#include <Shared/Journal.hh>
+#include <Shared/Metrics.hh>
 #include <Shared/Packets.hh>
 #include <Shared/TCP.hh>
+#include <Shared/Timers.hh>
 #include <Shared/Utils.hh>
 
 #include <base/Base.hh>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
-#include <map>
+#include <deque>
 #include <memory>
-#include <random>
+#include <mutex>
+#include <optional>
 #include <ranges>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <variant>
 #include <vector>
 
 namespace pr::server {
-class Card;
+class Game;
 class Player;
 class Server;
-class Stack;
-class Word;
+class Worker;
 
 using DisconnectReason = packets::sc::Disconnect::Reason;
-} // namespace pr::server
-
-class pr::server::Card {
-    LIBBASE_MOVE_ONLY(Card);
-    ComputedReadonly(const CardData&, data, CardDatabase[+id]);
-
-public:
-    CardId id;
-    explicit Card(CardId t) : id(t) {}
-};
-
-class pr::server::Stack {
-    ComputedReadonly(CardId, top, cards.back().id);
-    ComputedReadonly(bool, full, cards.size() == constants::MaxSoundStackSize);
-
-public:
-    std::vector<Card> cards;
-
-    /// Stack is locked by a spelling reform.
-    bool locked = false;
 
-    /// Get the nth card id in the stack.
-    auto operator[](usz n) -> CardId {
-        Assert(n < cards.size());
-        return cards[n].id;
-    }
-
-    /// Add a card to the stack.
-    void push(Card card) { cards.push_back(std::move(card)); }
-};
-
-class pr::server::Word {
-public:
-    std::vector<Stack> stacks;
+/// Get the histogram that records how long we take to handle a packet.
+auto HandlerTime(packets::cs::ID id) -> metrics::Histogram&;
 
-    /// Add a stack to the word.
-    void add_stack(Card c) { stacks.emplace_back().push(std::move(c)); }
-
-    /// Get the card ids of the topmost card in each stack.
-    auto ids() const { return stacks | vws::transform(&Stack::get_top); }
-};
+/// Send a client a disconnect packet and disconnect them.
+void Kick(net::TCPConnexion& client, DisconnectReason reason);
+} // namespace pr::server
 
 class pr::server::Player {
     LIBBASE_IMMOVABLE(Player);
@@ -82,39 +58,84 @@ public:
     /// The player's name.
     std::string name;
 
-    /// The player’s hand
-    std::vector<Card> hand;
+    /// The id of this player; this is also the index of their
+    /// state in the game state.
+    u8 id{};
 
-    /// The player’s word
-    Word word;
+    /// The last heartbeat that this player answered.
+    u32 heartbeat_ack = 0;
 
-    /// The player submitted their word
-    bool submitted_word = false;
+    /// The protocol version that we agreed on with the player’s client.
+    u32 protocol_version = packets::LegacyProtocolVersion;
 
-    /// The id of this player.
-    u8 id{};
+    /// Whether the updates the client has counted match ours, i.e.
+    /// whether we can trust its ResumePoint; see Game::SendGameState().
+    bool resumable = true;
+
+private:
+    /// Frames that have been sent to this player since the last call
+    /// to flush(), after the header of the sc::Batch that holds them.
+    ///
+    /// Large shared frames aren’t copied into the batch; instead, we
+    /// remember where in it they go, and how many bytes they add.
+    std::vector<std::byte> batch;
+    std::vector<std::pair<usz, net::SharedFrame>> shared_frames;
+    usz shared_bytes = 0;
+    usz batched_frames = 0;
 
+public:
     /// Create a new player.
     Player(net::TCPConnexion client_connexion, std::string name)
         : client_connexion(std::move(client_connexion)),
           name(std::move(name)) {}
 
+    /// Send everything that was sent to this player since the last
+    /// call to this, as a single frame if possible.
+    void flush();
+
+    /// Disconnect the player; this sends whatever is still batched
+    /// first so that the disconnect packet arrives last.
+    void kick(DisconnectReason reason);
+
     /// Send a packet to the player.
+    ///
+    /// Packets are batched until flush() is called, unless the client
+    /// is too old to understand batches or the packet is too large to
+    /// fit in one.
     template <typename T>
-    void send(const T& t) { client_connexion.send(t); }
-};
+    void send(const T& t) {
+        if (disconnected) return;
+        auto encoding = client_connexion.encoding;
+        auto batched = Reserve(sizeof(net::FrameLength) + ser::SerialisedSize(t, encoding));
+        if (not batched) return SendFailed(batched.error());
+        if (not batched.value()) return client_connexion.send(t);
+        if (auto res = net::AppendFrame(batch, t, encoding); not res) return SendFailed(res.error());
+        batched_frames++;
+    }
 
-/// Prescriptivism server instance.
-class pr::server::Server : net::TCPServerCallbacks {
-    LIBBASE_IMMOVABLE(Server);
+    /// Send a packet that was serialised for several players.
+    void send(const net::SharedFrame& frame);
 
-    struct Validator;
-    friend Validator;
+private:
+    /// Whether the player’s client understands sc::Batch.
+    [[nodiscard]] bool Batches() const { return protocol_version >= packets::BatchProtocolVersion; }
 
-    struct PendingConnexion {
-        net::TCPConnexion conn;
-        chr::steady_clock::time_point established;
-    };
+    /// Make sure the current batch has room for another frame.
+    ///
+    /// \return False if the frame has to be sent on its own instead; in
+    /// that case, everything batched before it has already been sent.
+    [[nodiscard]] auto Reserve(usz frame_size) -> Result<bool>;
+
+    /// Disconnect the player after we failed to send them a packet.
+    void SendFailed(const std::string& error);
+};
+
+/// A single game that is hosted by the server.
+///
+/// A game is owned by a worker, and all of its functions are only
+/// ever called from that worker’s thread.
+class pr::server::Game {
+    LIBBASE_IMMOVABLE(Game);
 
     enum struct State {
         // We are waiting for enough players to join for the first time.
@@ -125,45 +146,117 @@ class pr::server::Server : net::TCPServerCallbacks {
 
         // The game is running.
         Running,
-    };
 
-    /// TCP server that manages client connexions.
-    net::TCPServer server;
+        // The game is over and can be deleted.
+        Ended,
+    };
 
     /// The list of players. Once a player has been added, they are
     /// typically never removed.
     std::vector<std::unique_ptr<Player>> players;
 
     /// A map from connexions to players, to figure out which player sent that packet.
-    std::map<net::TCPConnexion, Player*> player_map;
+    net::ConnexionMap<Player*> player_map;
 
-    /// The current player
-    PlayerId current_player = 0;
+    /// The cards, words, and whose turn it is.
+    GameState board;
 
-    /// The random number generator.
-    std::mt19937 rng{std::random_device{}()};
+    /// The random number generator; the seed is logged so a game can
+    /// be reproduced.
+    const u64 seed;
+    Rng rng{seed};
 
-    /// List of connexions that have not yet been assigned a player.
-    std::vector<PendingConnexion> pending_connexions;
+    State state = State::WaitingForPlayerRegistration;
 
-    /// The password of the server.
-    std::string password;
+    using Update = std::variant<packets::sc::AddSoundToStack, packets::sc::StackLockChanged>;
 
-    /// Deck and discard pile.
-    std::vector<Card> deck;
-    std::vector<Card> discard{};
+    /// The most recent changes to the players’ words, in order, for
+    /// players who rejoin the game; 'seq_no' is the number of changes
+    /// since the game started, the last of which is at the back.
+    ///
+    /// \see packets::ResumePoint
+    std::deque<Update> history;
+    u32 seq_no = 0;
 
-    State state = State::WaitingForPlayerRegistration;
+    /// Where we write the journal of this game, if anywhere.
+    journal::Sink* sink;
+    std::optional<journal::Writer> journal_writer;
+
+    /// The timers of the worker that runs this game.
+    TimerWheel& timers;
+
+    /// Every player is sent a heartbeat periodically; players who
+    /// haven’t answered the last one by the time the next one is due
+    /// are disconnected. This is the number of heartbeats sent so far.
+    TimerId heartbeat_timer;
+    u32 heartbeat_seq = 0;
+
+    /// When a heartbeat first found no player connected, if the last
+    /// one did; see AbandonTimeout.
+    std::optional<TimerWheel::Clock::time_point> abandoned_since;
+
+    /// Where the worker that runs this game wants us to add ourselves
+    /// once we need to be ticked; 'tick_pending' is set while we’re in
+    /// that list.
+    std::vector<Game*>* tick_list = nullptr;
+    bool tick_pending = false;
 
 public:
-    /// Create and start the server.
-    Server(u16 port, std::string password);
+    /// The id that the lobby uses to refer to this game.
+    const u64 id;
+
+    /// Random id that clients use to check that they are resuming the
+    /// same game; this is never 0.
+    const u64 session;
+
+    /// Create a new game; its journal is written to 'sink', if any.
+    ///
+    /// \param timers The timers of the worker that is going to run
+    /// this game; they are only used once the game is ticked.
+    Game(u64 id, TimerWheel& timers, journal::Sink* sink = nullptr);
+    ~Game();
+
+    /// Recreate a game from its journal and continue writing to it.
+    ///
+    /// \return The game, or nullptr if the game had already ended.
+    static auto Restore(
+        u64 id,
+        TimerWheel& timers,
+        journal::Sink& sink,
+        fs::PathRef path
+    ) -> Result<std::unique_ptr<Game>>;
+
+    /// Add a player that has logged in to this game, or reconnect
+    /// a player that has logged in again.
+    void add_player(
+        net::TCPConnexion client,
+        std::string name,
+        packets::ResumePoint resume,
+        u32 protocol_version
+    );
 
-    /// Disconnect a client.
-    void Kick(net::TCPConnexion& client, DisconnectReason reason);
+    /// Have the worker that runs this game tick it whenever it has done
+    /// anything since the last tick; this also schedules the first tick.
+    void attach(std::vector<Game*>& ticks);
 
-    /// Run the server for ever.
-    [[noreturn]] void Run();
+    /// Check whether the game is over.
+    [[nodiscard]] bool finished() const { return state == State::Ended; }
+
+    /// Get the names of the players that have joined so far.
+    [[nodiscard]] auto player_names() const {
+        return players | vws::transform([](const auto& p) -> const std::string& { return p->name; });
+    }
+
+    /// Process data sent by one of the players.
+    void receive(net::TCPConnexion& client, net::ReceiveBuffer& buffer);
+
+    /// Update the game after all incoming data has been processed.
+    void tick();
+
+    /// Called by HandleServerSidePacket() for every packet.
+    auto time_handler(packets::cs::ID id) -> metrics::ScopedTimer {
+        return metrics::ScopedTimer{HandlerTime(id)};
+    }
 
 #define X(name) void handle(net::TCPConnexion& client, packets::cs::name);
     COMMON_PACKETS(X)
@@ -171,46 +264,277 @@ public:
 #undef X
 
 private:
+    Game(u64 id, TimerWheel& timers, journal::Sink* sink, u64 session, u64 seed);
+
     bool AllPlayersConnected() {
         return rgs::all_of(players, [](const auto& p) { return p->connected; });
     }
 
     bool AllWordsSubmitted() {
-        return rgs::all_of(players, [](auto& x) { return x->submitted_word; });
+        return rgs::all_of(board.players, &PlayerState::submitted_word);
     }
 
+    /// Send a packet to every player. This only serialises it once
+    /// per encoding that is in use.
     template <typename T>
     void Broadcast(const T& packet) {
-        for (auto& p : players) p->send(packet);
+        std::array<std::optional<net::SharedFrame>, ser::EncodingCount> frames;
+        for (auto& p : players) {
+            auto encoding = p->client_connexion.encoding;
+            auto& frame = frames[+encoding];
+            if (not frame) frame.emplace(packet, encoding);
+            p->send(*frame);
+        }
     }
 
-    void Draw(Player& p, usz count = 1);
+    /// End the game, kick everyone, and finish the journal; the worker
+    /// deletes the game after its next tick.
+    void Finish();
 
-    void HandlePlaySoundCard(
-        net::TCPConnexion& client,
-        Card& card,
-        Player& target_player,
-        u32 target_index
-    );
+    /// Check that everyone answered the last heartbeat and send the next
+    /// one; this also ends games that everyone has left.
+    void Heartbeat();
 
+    /// End the current player’s turn.
     void NextPlayer();
 
-    /// Remove a card a player’s hand.
-    void RemoveCard(Player& p, Card& c) {
-        auto it = rgs::find(p.hand, c.id, &Card::id);
-        Assert(it != p.hand.end(), "Card not in hand");
-        discard.emplace_back(c.id);
-        p.hand.erase(it);
+    /// Get the player that owns a connexion; receive() has already
+    /// checked that there is one.
+    auto PlayerFor(const net::TCPConnexion& client) -> Player* {
+        auto p = player_map.find(client.id);
+        Assert(p, "Packet from unknown connexion");
+        return *p;
     }
 
-    void SendGameState(Player& p);
+    /// Apply a change that everyone can see: send it to every player
+    /// and record it for players who rejoin later.
+    template <typename T>
+    void Publish(const T& update) {
+        Remember(update);
+        Broadcast(update);
+    }
+
+    /// Add a record to the journal of this game.
+    void Record(const journal::Record& r) {
+        if (journal_writer) journal_writer->append(r);
+    }
+
+    /// Add a change to the history.
+    void Remember(Update update);
+
+    /// Make sure we’re ticked after whatever we’re doing right now.
+    void RequestTick();
+
+    /// Bring a player up to date, starting from what they’ve seen.
+    void SendGameState(Player& p, packets::ResumePoint resume);
     void SetUpGame();
+
+    auto player() -> Player& { return *players[board.current_player]; }
+
+    /// Get the game state of a player; their id must have been assigned.
+    auto StateOf(const Player& p) -> PlayerState& { return board.players[p.id]; }
+};
+
+/// A thread that runs an event loop for the connexions of a number
+/// of games.
+class pr::server::Worker : net::TCPServerCallbacks {
+    LIBBASE_IMMOVABLE(Worker);
+
+    struct Handoff {
+        u64 game;
+        bool new_game;
+        net::TCPConnexion conn;
+        std::string name;
+        packets::ResumePoint resume;
+        u32 protocol_version;
+    };
+
+    /// The lobby that owns this worker.
+    Server& lobby;
+
+    /// Event loop for the connexions of our games.
+    net::TCPServer loop;
+
+    /// Games that are run on this worker.
+    std::unordered_map<u64, std::unique_ptr<Game>> games;
+
+    /// A map from connexions to games, to figure out which game a packet is for.
+    net::ConnexionMap<Game*> game_map;
+
+    /// Games that have done anything since the last tick; the games
+    /// add themselves here.
+    std::vector<Game*> pending_ticks;
+
+    /// Connexions that the lobby has handed to us, but that we
+    /// haven’t taken ownership of yet.
+    std::mutex handoff_lock;
+    std::vector<Handoff> handoffs;
+    std::vector<std::pair<u64, std::unique_ptr<Game>>> adopted;
+
+    /// Where new games write their journals, if anywhere.
+    journal::Sink* sink;
+
+    /// Tracks how long our ticks take.
+    metrics::TickMonitor tick_monitor;
+
+public:
+    /// The number of games running on this worker. This is maintained
+    /// by the lobby and only used for load balancing.
+    std::atomic<usz> load = 0;
+
+private:
+    // The thread MUST be the last member of this class so it is joined
+    // before anything it touches is destroyed.
+    std::jthread thread;
+
+public:
+    /// Create a worker and start its thread.
+    Worker(Server& lobby, usz index, journal::Sink* sink);
+    ~Worker();
+
+    /// Take over a game that was restored from its journal.
+    ///
+    /// This is called by the lobby and is thread-safe.
+    void adopt_game(u64 id, std::unique_ptr<Game> game);
+
+    /// Get the timers of this worker’s event loop. Only the worker’s
+    /// thread may use them; others may only pass them to games that
+    /// are then handed to this worker.
+    auto timers() -> TimerWheel& { return loop.timers(); }
+
+    /// Transfer a logged-in connexion to this worker.
+    ///
+    /// This is called by the lobby and is thread-safe.
+    ///
+    /// \param game The game that the player should join.
+    /// \param new_game Whether the game has to be created first.
+    /// \param conn The connexion, which must not be managed by any server.
+    /// \param name The name that the player logged in with.
+    /// \param protocol_version The protocol version we agreed on.
+    void hand_off(
+        u64 game,
+        bool new_game,
+        net::TCPConnexion conn,
+        std::string name,
+        packets::ResumePoint resume,
+        u32 protocol_version
+    );
+
+private:
+    void Run(std::stop_token stop);
+    void TakeHandoffs();
     void Tick();
-    auto ValidatorFor(Player& p) -> Validator;
 
-    auto player() -> Player& { return *players[current_player]; }
+    bool accept(net::TCPConnexion& connexion) override;
+    void receive(net::TCPConnexion& client, net::ReceiveBuffer& buffer) override;
+};
+
+/// Prescriptivism server instance.
+///
+/// This is the lobby: it accepts connexions, checks their login
+/// credentials, and then hands them off to a game running on one
+/// of the workers.
+class pr::server::Server : net::TCPServerCallbacks {
+    LIBBASE_IMMOVABLE(Server);
+
+    struct PendingConnexion {
+        net::TCPConnexion conn;
+        TimerId timeout;
+    };
+
+    struct LoggedInConnexion {
+        net::TCPConnexion conn;
+        std::string name;
+        packets::ResumePoint resume;
+        u32 protocol_version;
+    };
+
+    struct Table {
+        Worker* worker;
+        std::vector<std::string> players;
+    };
+
+    /// TCP server that manages client connexions.
+    net::TCPServer server;
+
+    /// List of connexions that have not yet sent a login packet.
+    net::ConnexionMap<PendingConnexion> pending_connexions;
+
+    /// Connexions that have logged in and which need to be handed
+    /// off to a worker once we’re done polling.
+    std::vector<LoggedInConnexion> logged_in;
+
+    /// The password of the server.
+    std::string password;
+
+    /// All games that have not ended yet, and which players they
+    /// belong to. Games are never removed from here by the lobby;
+    /// workers tell us when a game is over or has been abandoned.
+    std::mutex tables_lock;
+    std::unordered_map<u64, Table> tables;
+    std::unordered_map<std::string, u64> player_tables;
+
+    /// The game that new players are added to until it is full.
+    std::optional<u64> open_table;
+
+    /// The id of the next game we create.
+    u64 next_table_id = 0;
+
+    /// Tracks how long our ticks take.
+    metrics::TickMonitor tick_monitor;
+
+    /// Serves metrics for scraping, if enabled.
+    std::unique_ptr<metrics::Exporter> exporter;
+
+    /// Writes the journals of all games, if enabled.
+    std::unique_ptr<journal::Sink> sink;
+
+    // Workers MUST be destroyed before anything they might access.
+    std::vector<std::unique_ptr<Worker>> workers;
+
+public:
+    /// Create and start the server.
+    ///
+    /// \param metrics_port Port to serve metrics on, or 0 to disable this.
+    /// \param journal_dir Directory to keep game journals in, or empty to
+    /// disable journalling. Unfinished games in it are resumed.
+    Server(
+        u16 port,
+        std::string password,
+        usz worker_count,
+        u16 metrics_port = 0,
+        fs::Path journal_dir = {}
+    );
+
+    /// Called by a worker when a game has ended.
+    ///
+    /// This is thread-safe.
+    void game_finished(u64 game);
+
+    /// Run the server for ever.
+    [[noreturn]] void Run();
+
+    /// Any packet other than a login packet is invalid here.
+    template <typename Packet>
+    void handle(net::TCPConnexion& client, Packet) { Kick(client, DisconnectReason::UnexpectedPacket); }
+    void handle(net::TCPConnexion& client, packets::cs::Disconnect);
+    void handle(net::TCPConnexion& client, packets::cs::Login login);
+
+    /// Called by HandleServerSidePacket() for every packet.
+    auto time_handler(packets::cs::ID id) -> metrics::ScopedTimer {
+        return metrics::ScopedTimer{HandlerTime(id)};
+    }
+
+private:
+    void HandOffLogins();
+
+    /// Resume the games whose journals weren’t finished.
+    void RestoreGames();
+
+    void Tick();
 
     bool accept(net::TCPConnexion& connexion) override;
+    void closed(net::ConnexionId id) override;
     void receive(net::TCPConnexion& client, net::ReceiveBuffer& buffer) override;
 };
 
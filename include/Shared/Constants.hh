@@ -7,10 +7,15 @@
 
 #include <array>
 
+namespace pr {
+using PlayerId = u8;
+}
+
 namespace pr::constants {
 constexpr usz StartingWordSize = 6;
 constexpr usz PlayersPerGame = 2;
 constexpr usz MaxSoundStackSize = 7;
+constexpr usz MaxPlayerNameSize = 64;
 using Word = std::array<CardId, StartingWordSize>;
 }
 
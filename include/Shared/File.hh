@@ -0,0 +1,37 @@
+#ifndef PRESCRIPTIVISM_SHARED_FILE_HH
+#define PRESCRIPTIVISM_SHARED_FILE_HH
+
+#include <Shared/Serialisation.hh>
+
+#include <base/Base.hh>
+#include <base/FS.hh>
+
+#include <memory>
+
+namespace pr {
+class MappedFile;
+
+/// Compute the CRC-32 (IEEE) of some data.
+auto Checksum(ser::InputSpan data) -> u32;
+} // namespace pr
+
+/// A file that is mapped into memory for reading.
+class pr::MappedFile {
+    LIBBASE_IMMOVABLE(MappedFile);
+
+    const std::byte* ptr = nullptr;
+    usz size = 0;
+
+    MappedFile() = default;
+
+public:
+    ~MappedFile();
+
+    /// Map a file.
+    static auto Open(fs::PathRef path) -> Result<std::unique_ptr<MappedFile>>;
+
+    /// Get the contents of the file.
+    [[nodiscard]] auto bytes() const -> ser::InputSpan { return {ptr, size}; }
+};
+
+#endif // PRESCRIPTIVISM_SHARED_FILE_HH
@@ -0,0 +1,251 @@
+#ifndef PRESCRIPTIVISM_SHARED_GAMESTATE_HH
+#define PRESCRIPTIVISM_SHARED_GAMESTATE_HH
+
+#include <Shared/Cards.hh>
+#include <Shared/Constants.hh>
+#include <Shared/Random.hh>
+#include <Shared/StaticVector.hh>
+#include <Shared/Utils.hh>
+#include <Shared/Validation.hh>
+
+#include <base/Base.hh>
+
+#include <array>
+#include <span>
+#include <type_traits>
+
+namespace pr {
+class Stack;
+class Word;
+struct GameState;
+struct PlayerState;
+
+/// The number of cards a player draws up to at the end of their turn.
+constexpr usz HandSize = 7;
+
+/// The maximum number of cards in a hand; players currently start
+/// with an extra Spelling Reform.
+constexpr usz MaxHandSize = HandSize + 1;
+
+/// The maximum number of stacks in a word; no card adds stacks yet.
+constexpr usz MaxWordSize = constants::StartingWordSize;
+
+/// How many copies of each card go into the deck.
+using DeckCounts = std::array<u8, +CardIdValue::$$Count>;
+
+/// The deck counts from the card database.
+constexpr DeckCounts DefaultDeckCounts = [] {
+    DeckCounts counts{};
+    for (auto& c : CardDatabase) counts[+c.id] = u8(c.count_in_deck);
+    return counts;
+}();
+
+/// The number of cards in the deck at the start of a normal game.
+constexpr usz DeckSize = [] {
+    usz n = 0;
+    for (auto c : DefaultDeckCounts) n += c;
+    return n;
+}();
+
+/// The largest deck a game can be set up with; this leaves room for
+/// simulations that try out bigger decks.
+constexpr usz MaxDeckSize = 2 * DeckSize;
+
+/// The number of cards that can end up in a single pile: the deck,
+/// plus the extra cards that players start with.
+constexpr usz MaxPileSize = MaxDeckSize + constants::PlayersPerGame * (MaxHandSize - HandSize);
+
+using Hand = StaticVector<CardId, MaxHandSize>;
+using Pile = StaticVector<CardId, MaxPileSize>;
+} // namespace pr
+
+class pr::Stack {
+    ComputedReadonly(CardId, top, cards.back());
+    ComputedReadonly(bool, full, cards.full());
+
+public:
+    StaticVector<CardId, constants::MaxSoundStackSize> cards;
+
+    /// Stack is locked by a spelling reform.
+    bool locked = false;
+
+    /// Get the nth card id in the stack.
+    auto operator[](usz n) const -> CardId {
+        Assert(n < cards.size());
+        return cards[n];
+    }
+
+    /// Add a card to the stack.
+    void push(CardId card) { cards.push_back(card); }
+};
+
+class pr::Word {
+public:
+    StaticVector<Stack, MaxWordSize> stacks;
+
+    /// Add a stack to the word.
+    void add_stack(CardId c) { stacks.emplace_back().push(c); }
+
+    /// Get the card ids of the topmost card in each stack.
+    auto ids() const { return stacks | vws::transform(&Stack::get_top); }
+};
+
+/// The part of a player that is game state.
+struct pr::PlayerState {
+    /// The player’s hand
+    Hand hand;
+
+    /// The player’s word
+    Word word;
+
+    /// The player submitted their word
+    bool submitted_word = false;
+};
+
+/// Everything that describes a game in progress.
+///
+/// This is stored inline and contains no pointers, so a game can be
+/// snapshotted or rolled back by copying it.
+struct pr::GameState {
+    /// The state of each player, indexed by player id.
+    std::array<PlayerState, constants::PlayersPerGame> players{};
+
+    /// Deck and discard pile; the top of each is at the end.
+    Pile deck;
+    Pile discard;
+
+    /// The current player
+    PlayerId current_player = 0;
+
+    /// The number of turns that have ended.
+    u32 turns = 0;
+
+    /// Get the state of the current player.
+    auto current() -> PlayerState& { return players[current_player]; }
+    auto current() const -> const PlayerState& { return players[current_player]; }
+};
+
+static_assert(std::is_trivially_copyable_v<pr::GameState>);
+
+// =============================================================================
+//  Rules
+// =============================================================================
+//
+// These are the rules of the game as they apply to a GameState; the
+// server applies them to the real game, and the simulator to games
+// that only exist in memory. Everything here is deterministic given
+// the random number generator.
+namespace pr::rules {
+class WordView;
+struct Action;
+
+/// Something that wants to know what happens at the end of a turn.
+template <typename T>
+concept TurnObserver = requires (T& t, PlayerId p, std::span<const CardId> cards) {
+    t.draw(p, cards);
+    t.end_turn(p);
+    t.start_turn(p);
+};
+
+/// A TurnObserver that ignores everything.
+struct IgnoreTurns {
+    void draw(PlayerId, std::span<const CardId>) {}
+    void end_turn(PlayerId) {}
+    void start_turn(PlayerId) {}
+};
+
+/// Check whether every player’s hand is empty, in which case the game
+/// is over.
+bool AllHandsEmpty(const GameState& g);
+
+/// Apply an action of the current player; it must be legal.
+void Apply(GameState& g, Action a);
+
+/// Discard a card from the current player’s hand.
+void Discard(GameState& g, usz card);
+
+/// Draw up to 'count' cards into a player’s hand and return how many
+/// were drawn; these are the last cards of the hand.
+auto Draw(GameState& g, PlayerId p, usz count) -> usz;
+
+/// Check whether the current player may play a card on a stack; this
+/// also checks that every index is in range.
+bool IsLegal(const GameState& g, validation::Move m);
+
+/// Get every card the current player can play, and where.
+auto LegalMoves(const GameState& g) -> validation::MoveSet;
+
+/// Play a card from the current player’s hand; the move must be legal.
+void Play(GameState& g, validation::Move m);
+
+/// Build and shuffle the deck, and deal each player a word and a hand.
+///
+/// Words alternate between consonants and vowels so every player
+/// starts with a valid word.
+void SetUp(GameState& g, Rng& rng, const DeckCounts& counts = DefaultDeckCounts);
+
+/// Get a view of a player’s word for use with the validation functions.
+auto ViewOf(const GameState& g, PlayerId owner) -> WordView;
+
+/// End the current player’s turn: refill their hand, and move on to the
+/// next player who still has cards to play.
+///
+/// \return False if the game is over because no one has any cards left.
+template <TurnObserver Observer>
+bool EndTurn(GameState& g, Observer& o) {
+    for (;;) {
+        auto& hand = g.current().hand;
+        if (hand.size() < HandSize) {
+            auto n = Draw(g, g.current_player, HandSize - hand.size());
+            if (n) o.draw(g.current_player, std::span{hand}.last(n));
+        }
+
+        o.end_turn(g.current_player);
+        g.current_player = PlayerId((g.current_player + 1) % g.players.size());
+        g.turns++;
+        o.start_turn(g.current_player);
+
+        // If this player’s hand is empty, move on to the next player. Do
+        // this *after* drawing so this only happens if the deck is empty.
+        if (not g.current().hand.empty()) return true;
+
+        // If *all* players’ hands are empty, the game is over. This
+        // *shouldn’t* happen, but you never know...
+        if (AllHandsEmpty(g)) return false;
+    }
+}
+} // namespace pr::rules
+
+/// What a player does on their turn.
+struct pr::rules::Action {
+    enum struct Kind : u8 {
+        Play,
+        Discard,
+    };
+
+    Kind kind;
+
+    /// The card and target; only 'move.card' is used for discards.
+    validation::Move move;
+
+    [[nodiscard]] static auto Discard(usz card) -> Action { return {Kind::Discard, {card, 0, 0}}; }
+    [[nodiscard]] static auto Play(validation::Move m) -> Action { return {Kind::Play, m}; }
+};
+
+class pr::rules::WordView {
+    const PlayerState& p;
+    PlayerId owner;
+    PlayerId acting_player;
+
+public:
+    WordView(const PlayerState& p, PlayerId owner, PlayerId acting_player)
+        : p(p), owner(owner), acting_player(acting_player) {}
+
+    auto operator[](usz i) const -> CardId { return p.word.stacks[i].top; }
+    bool is_own_word() const { return acting_player == owner; }
+    auto size() const -> usz { return p.word.stacks.size(); }
+    bool stack_is_locked(usz i) const { return p.word.stacks[i].locked; }
+    bool stack_is_full(usz i) const { return p.word.stacks[i].full; }
+};
+
+#endif // PRESCRIPTIVISM_SHARED_GAMESTATE_HH
@@ -0,0 +1,276 @@
+#ifndef PRESCRIPTIVISM_SHARED_JOURNAL_HH
+#define PRESCRIPTIVISM_SHARED_JOURNAL_HH
+
+#include <Shared/Cards.hh>
+#include <Shared/Constants.hh>
+#include <Shared/File.hh>
+#include <Shared/GameState.hh>
+#include <Shared/Serialisation.hh>
+#include <Shared/Utils.hh>
+
+#include <base/Base.hh>
+
+#include <array>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#define JOURNAL_RECORDS(X) \
+    X(Start)               \
+    X(WordChoice)          \
+    X(Play)                \
+    X(Pass)                \
+    X(End)
+
+/// Game journals.
+///
+/// Every game writes a journal that contains the game as it was dealt,
+/// followed by every action that the server accepted, in order. Since
+/// the rules are deterministic, this is enough to recreate the game at
+/// any point, e.g. to resume it after a crash or to check that a change
+/// to the rules doesn’t break recorded games.
+///
+/// A journal starts with a header (a magic number and a version), which
+/// is followed by frames. Every frame is the length of its payload and a
+/// CRC-32 of it, followed by the payload: the type of a record and the
+/// record itself, in the compact encoding. A journal that was being
+/// written when the server crashed may end with a partial frame; readers
+/// stop at the first frame that is incomplete or fails its checksum.
+namespace pr::journal {
+class Reader;
+class Sink;
+class Writer;
+struct Replayer;
+
+/// "PRJL", in little endian.
+constexpr u32 Magic = 0x4c4a'5250;
+constexpr u32 Version = 1;
+
+/// The size of the header at the start of every journal.
+constexpr usz HeaderSize = 2 * sizeof(u32);
+
+/// The size of the length and checksum that precede every record.
+constexpr usz FrameHeaderSize = 2 * sizeof(u32);
+
+/// The largest record that a reader accepts.
+constexpr usz MaxRecordSize = 64 * 1'024;
+
+/// Extension of journals of games that are still running, and of games
+/// that have ended.
+constexpr std::string_view ActiveExtension = ".active";
+constexpr std::string_view FinishedExtension = ".journal";
+
+/// Extension of journals that we failed to write to; these are kept
+/// for inspection, but never resumed, since they may be missing records.
+constexpr std::string_view FailedExtension = ".failed";
+
+/// A player, as they were dealt.
+struct PlayerInfo {
+    std::string name;
+    constants::Word word;
+    std::vector<CardId> hand;
+
+    PR_SERIALISE(name, word, hand);
+};
+
+/// The game as it was dealt; players are in turn order.
+struct Start {
+    u64 session;
+    u64 seed;
+    std::array<PlayerInfo, constants::PlayersPerGame> players;
+    std::vector<CardId> deck;
+
+    PR_SERIALISE(session, seed, players, deck);
+};
+
+/// A player gave back their word.
+struct WordChoice {
+    PlayerId player;
+    constants::Word word;
+
+    PR_SERIALISE(player, word);
+};
+
+/// A player played a card; 'card' is what was at that index in
+/// their hand, which lets readers check that they are in sync.
+struct Play {
+    PlayerId player;
+    u32 card_index;
+    CardId card;
+    PlayerId target;
+    u32 stack;
+
+    PR_SERIALISE(player, card_index, card, target, stack);
+};
+
+/// A player discarded a card.
+struct Pass {
+    PlayerId player;
+    u32 card_index;
+    CardId card;
+
+    PR_SERIALISE(player, card_index, card);
+};
+
+/// The game is over.
+struct End {
+    u32 turns;
+
+    PR_SERIALISE(turns);
+};
+
+/// The type of a record, which precedes it in the journal; this is also
+/// its index in Record.
+enum struct RecordType : u8 {
+#define X(name) name,
+    JOURNAL_RECORDS(X)
+#undef X
+};
+
+using Record = std::variant<Start, WordChoice, Play, Pass, End>;
+
+#define X(name) static_assert(std::is_same_v<std::variant_alternative_t<+RecordType::name, Record>, name>);
+JOURNAL_RECORDS(X)
+#undef X
+
+/// Append a record, including its frame, to a buffer.
+void AppendRecord(std::vector<std::byte>& buffer, const Record& r);
+} // namespace pr::journal
+
+/// Reads the records of a journal.
+class pr::journal::Reader {
+    ser::InputSpan data;
+    usz offset = HeaderSize;
+    std::string err;
+
+    explicit Reader(ser::InputSpan data) : data(data) {}
+
+public:
+    /// Check the header of a journal and start reading after it.
+    static auto Open(ser::InputSpan data) -> Result<Reader>;
+
+    /// Get why reading stopped before the end of the journal, if it did.
+    [[nodiscard]] auto error() const -> std::string_view { return err; }
+
+    /// Get the next record, or nothing if there are no more records or
+    /// the rest of the journal is damaged.
+    [[nodiscard]] auto next() -> std::optional<Record>;
+
+    /// Get the offset just past the last record that was read; anything
+    /// after this is either not read yet or damaged.
+    [[nodiscard]] auto valid_size() const -> usz { return offset; }
+};
+
+/// Rebuilds a game from its records.
+///
+/// This performs the same checks as the server did when it accepted
+/// each action, so a journal that no longer replays indicates that the
+/// rules have changed in a way that breaks existing games.
+struct pr::journal::Replayer {
+    /// The start of the game, once we have seen it.
+    std::optional<Start> start;
+
+    /// The game as of the last record.
+    GameState state;
+
+    /// Whether the game is over, and whether we have seen its end
+    /// record; nothing may follow the latter.
+    bool over = false;
+    bool complete = false;
+
+    /// The number of actions that were applied.
+    usz actions = 0;
+
+    /// Apply the next record.
+    auto apply(const Record& r) -> Result<>;
+
+private:
+    auto Apply(const Start& s) -> Result<>;
+    auto Apply(const WordChoice& w) -> Result<>;
+    auto Apply(const Play& p) -> Result<>;
+    auto Apply(const Pass& p) -> Result<>;
+    auto Apply(const End& e) -> Result<>;
+    auto CheckTurn(PlayerId player, u32 card_index, CardId card) -> Result<>;
+    void EndTurn();
+};
+
+/// Writes journals to disk on a background thread so games don’t have
+/// to wait for the file system.
+class pr::journal::Sink {
+    LIBBASE_IMMOVABLE(Sink);
+
+    struct File;
+    struct Job {
+        std::shared_ptr<File> file;
+        std::vector<std::byte> data;
+        bool finish;
+    };
+
+    fs::Path dir;
+    std::mutex mutex;
+    std::condition_variable_any cv;
+    std::vector<Job> jobs;
+
+    // The thread MUST be the last member of this class so it is joined
+    // before anything it touches is destroyed.
+    std::jthread thread;
+
+    friend Writer;
+
+public:
+    /// Write journals into a directory, which is created if needed.
+    static auto Create(fs::Path dir) -> Result<std::unique_ptr<Sink>>;
+    ~Sink();
+
+    /// Start the journal of a new game.
+    auto create(u64 session) -> Result<Writer>;
+
+    /// Get the directory we write to.
+    [[nodiscard]] auto directory() const -> fs::PathRef { return dir; }
+
+    /// Continue writing a journal, discarding anything past 'valid_size'.
+    auto resume(fs::PathRef path, usz valid_size) -> Result<Writer>;
+
+private:
+    explicit Sink(fs::Path dir);
+    void Run(std::stop_token stop);
+    void Submit(Job job);
+};
+
+/// The journal of a single game.
+///
+/// Records are buffered until flush() is called; this is not thread-safe
+/// and meant to be used by the thread that runs the game.
+class pr::journal::Writer {
+    LIBBASE_MOVE_ONLY(Writer);
+
+    Sink* sink;
+    std::shared_ptr<Sink::File> file;
+    std::vector<std::byte> buffer;
+
+    friend Sink;
+    Writer(Sink& sink, std::shared_ptr<Sink::File> file) : sink(&sink), file(std::move(file)) {}
+
+public:
+    /// Add a record.
+    void append(const Record& r) { AppendRecord(buffer, r); }
+
+    /// Whether writing to the journal failed; if it did, the journal
+    /// won’t be resumed, and nothing is written to it anymore.
+    [[nodiscard]] bool failed() const;
+
+    /// Hand everything that was appended to the sink.
+    void flush();
+
+    /// Flush, make sure the journal reaches the disk, and mark it as
+    /// finished; nothing can be appended after this.
+    void finish();
+};
+
+#endif // PRESCRIPTIVISM_SHARED_JOURNAL_HH
@@ -0,0 +1,195 @@
+#ifndef PRESCRIPTIVISM_SHARED_LOG_HH
+#define PRESCRIPTIVISM_SHARED_LOG_HH
+
+#include <base/Base.hh>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <new>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+/// Messages below this level are compiled out entirely.
+#ifndef PRESCRIPTIVISM_MIN_LOG_LEVEL
+#    define PRESCRIPTIVISM_MIN_LOG_LEVEL 0
+#endif
+
+namespace pr {
+using namespace base;
+
+enum class LogLevel : u8 {
+    Debug,
+    Info,
+    Warning,
+    Error,
+};
+
+/// What to do if a message is logged while the log buffer is full.
+enum class LogOverflowPolicy : u8 {
+    /// Discard the message; the logging thread reports how many
+    /// messages were dropped once it catches up.
+    Drop,
+
+    /// Wait until the logging thread has made room.
+    Block,
+};
+
+struct SilenceLog;
+
+/// Minimum level of messages that are compiled in at all.
+constexpr LogLevel MinLogLevel = LogLevel(PRESCRIPTIVISM_MIN_LOG_LEVEL);
+
+/// Log a message.
+///
+/// This never allocates or takes a lock: the arguments are copied into
+/// a fixed-size record, which is formatted and printed on the logging
+/// thread. Arguments that can’t be copied safely are formatted eagerly
+/// instead; messages that don’t fit into a record are truncated.
+template <LogLevel level = LogLevel::Info, typename... Args>
+void Log(std::format_string<Args...> fmt, Args&&... args);
+
+/// Only print messages of this level or higher.
+void SetLogLevel(LogLevel level);
+
+/// Set what happens if the log buffer is full.
+void SetLogOverflowPolicy(LogOverflowPolicy policy);
+} // namespace pr
+
+namespace pr::detail {
+struct LogRecord;
+struct LoggedString;
+
+extern std::atomic<LogLevel> CurrentLogLevel;
+extern std::atomic_bool LogEnabled;
+
+/// Get a free log record, or nullptr if the message should be dropped.
+auto AcquireLogRecord() -> LogRecord*;
+
+/// Hand a record to the logging thread.
+void CommitLogRecord(LogRecord* r);
+
+/// Types whose values we can copy into a record and format later.
+template <typename T>
+concept LoggableString = std::is_convertible_v<const T&, std::string_view>;
+
+template <typename T>
+concept LazyLoggable = LoggableString<T> or std::is_arithmetic_v<T> or std::is_enum_v<T>;
+
+template <typename T>
+using LoggedType = std::conditional_t<LoggableString<T>, LoggedString, T>;
+
+template <typename... Stored>
+void FormatLogRecord(const LogRecord& r, std::string& out);
+
+template <LogLevel level, typename... Args>
+void LogLazy(std::string_view fmt, const Args&... args);
+} // namespace pr::detail
+
+/// A string stored in the payload of a log record.
+struct pr::detail::LoggedString {
+    u16 offset;
+    u16 size;
+};
+
+/// A single log message. Records live in a ring buffer that is
+/// shared between all threads.
+struct alignas(64) pr::detail::LogRecord {
+    static constexpr usz PayloadSize = 448;
+
+    /// Used by the ring buffer to hand records between threads.
+    std::atomic<u64> sequence;
+
+    chr::system_clock::time_point time;
+    void (*format)(const LogRecord&, std::string&);
+    std::string_view fmt;
+    LogLevel level;
+
+    /// The arguments, followed by the contents of any strings.
+    alignas(std::max_align_t) std::byte payload[PayloadSize];
+
+    auto chars() const -> const char* { return reinterpret_cast<const char*>(payload); }
+};
+
+struct pr::SilenceLog {
+    LIBBASE_IMMOVABLE(SilenceLog);
+    SilenceLog();
+    ~SilenceLog();
+};
+
+template <typename... Stored>
+void pr::detail::FormatLogRecord(const LogRecord& r, std::string& out) {
+    auto& args = *std::launder(reinterpret_cast<const std::tuple<Stored...>*>(r.payload));
+    auto Load = [&]<typename T>(const T& v) {
+        if constexpr (std::is_same_v<T, LoggedString>) return std::string_view{r.chars() + v.offset, v.size};
+        else return v;
+    };
+
+    auto Format = [&](const auto&... values) {
+        std::vformat_to(std::back_inserter(out), r.fmt, std::make_format_args(values...));
+    };
+
+    std::apply([&](const auto&... v) { Format(Load(v)...); }, args);
+}
+
+template <pr::LogLevel level, typename... Args>
+void pr::detail::LogLazy(std::string_view fmt, const Args&... args) {
+    using Tuple = std::tuple<LoggedType<Args>...>;
+    static_assert(sizeof(Tuple) <= LogRecord::PayloadSize, "Too many arguments");
+
+    auto r = AcquireLogRecord();
+    if (not r) return;
+
+    // Strings are copied to the end of the payload, after the arguments.
+    usz offset = sizeof(Tuple);
+    auto Store = [&]<typename T>(const T& arg) -> LoggedType<T> {
+        if constexpr (LoggableString<T>) {
+            std::string_view s = arg;
+            auto n = std::min(s.size(), LogRecord::PayloadSize - offset);
+            std::memcpy(r->payload + offset, s.data(), n);
+            LoggedString stored{u16(offset), u16(n)};
+            offset += n;
+            return stored;
+        } else {
+            return arg;
+        }
+    };
+
+    r->time = chr::system_clock::now();
+    r->format = FormatLogRecord<LoggedType<Args>...>;
+    r->fmt = fmt;
+    r->level = level;
+    new (r->payload) Tuple{Store(args)...};
+    CommitLogRecord(r);
+}
+
+template <pr::LogLevel level, typename... Args>
+void pr::Log(std::format_string<Args...> fmt, Args&&... args) {
+    if constexpr (level < MinLogLevel) {
+        return;
+    } else {
+        if (level < detail::CurrentLogLevel.load(std::memory_order::relaxed)) return;
+        if (not detail::LogEnabled.load(std::memory_order::relaxed)) return;
+
+        // Copy the arguments if we can do so safely.
+        if constexpr ((detail::LazyLoggable<std::remove_cvref_t<Args>> and ...)) {
+            detail::LogLazy<level, std::remove_cvref_t<Args>...>(fmt.get(), args...);
+        } else {
+            // Otherwise, format the message here; arguments might e.g. be
+            // pointers to something that is gone by the time the logging
+            // thread gets to this message.
+            char buffer[detail::LogRecord::PayloadSize - sizeof(detail::LoggedString)];
+            auto res = std::format_to_n(buffer, sizeof buffer, fmt, std::forward<Args>(args)...);
+            auto size = std::min(usz(res.size), sizeof buffer);
+            if (usz(res.size) > sizeof buffer) std::memcpy(buffer + size - 3, "...", 3);
+            detail::LogLazy<level, std::string_view>("{}", std::string_view{buffer, size});
+        }
+    }
+}
+
+#endif // PRESCRIPTIVISM_SHARED_LOG_HH
@@ -0,0 +1,216 @@
+#ifndef PRESCRIPTIVISM_SHARED_METRICS_HH
+#define PRESCRIPTIVISM_SHARED_METRICS_HH
+
+#include <base/Base.hh>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace pr::metrics {
+using namespace base;
+
+class Counter;
+class Exporter;
+class Gauge;
+class Histogram;
+class Metric;
+class ScopedTimer;
+class TickMonitor;
+
+/// Render every metric in the Prometheus text exposition format.
+auto Render() -> std::string;
+} // namespace pr::metrics
+
+/// Base class of all metrics.
+///
+/// Metrics register themselves on construction and are exported until
+/// they are destroyed. Metrics with the same name form a family and
+/// must all have the same type; they should differ in their labels.
+class pr::metrics::Metric {
+    LIBBASE_IMMOVABLE(Metric);
+    friend auto Render() -> std::string;
+
+    Readonly(std::string, name);
+    Readonly(std::string, help);
+    Readonly(std::string, labels);
+
+protected:
+    /// 'labels' is a comma-separated list of Prometheus labels, e.g.
+    /// 'packet="Login",loop="lobby"'.
+    Metric(std::string name, std::string help, std::string labels);
+
+public:
+    virtual ~Metric();
+
+private:
+    /// Append the samples of this metric to 'out'.
+    virtual void RenderSamples(std::string& out) const = 0;
+    virtual auto TypeName() const -> std::string_view = 0;
+};
+
+/// A value that only ever goes up.
+class pr::metrics::Counter : public Metric {
+    std::atomic<u64> value = 0;
+
+public:
+    Counter(std::string name, std::string help, std::string labels = "")
+        : Metric(std::move(name), std::move(help), std::move(labels)) {}
+
+    void add(u64 n = 1) { value.fetch_add(n, std::memory_order::relaxed); }
+    [[nodiscard]] auto get() const -> u64 { return value.load(std::memory_order::relaxed); }
+
+private:
+    void RenderSamples(std::string& out) const override;
+    auto TypeName() const -> std::string_view override { return "counter"; }
+};
+
+/// A value that can go up and down.
+class pr::metrics::Gauge : public Metric {
+    std::atomic<i64> value = 0;
+
+public:
+    Gauge(std::string name, std::string help, std::string labels = "")
+        : Metric(std::move(name), std::move(help), std::move(labels)) {}
+
+    void add(i64 n) { value.fetch_add(n, std::memory_order::relaxed); }
+    void set(i64 n) { value.store(n, std::memory_order::relaxed); }
+    [[nodiscard]] auto get() const -> i64 { return value.load(std::memory_order::relaxed); }
+
+private:
+    void RenderSamples(std::string& out) const override;
+    auto TypeName() const -> std::string_view override { return "gauge"; }
+};
+
+/// A log-linear histogram of integer values, in the style of an HDR
+/// histogram: every power of two is split into a fixed number of
+/// buckets, so the relative error is the same for all values.
+///
+/// Recording a value is a few bit operations and a relaxed increment.
+class pr::metrics::Histogram : public Metric {
+public:
+    /// Number of buckets per power of two.
+    static constexpr usz SubBucketBits = 3;
+    static constexpr usz SubBuckets = 1 << SubBucketBits;
+    static constexpr usz BucketCount = (64 - SubBucketBits + 1) * SubBuckets;
+
+private:
+    std::array<std::atomic<u64>, BucketCount> buckets{};
+    std::atomic<u64> total = 0;
+    std::atomic<u64> sum = 0;
+
+    /// Factor to convert recorded values to the exported unit, e.g.
+    /// 1e-9 to record nanoseconds and export seconds.
+    const f64 scale;
+
+public:
+    Histogram(std::string name, std::string help, std::string labels = "", f64 scale = 1)
+        : Metric(std::move(name), std::move(help), std::move(labels)),
+          scale(scale) {}
+
+    /// Get the number of recorded values.
+    [[nodiscard]] auto count() const -> u64 { return total.load(std::memory_order::relaxed); }
+
+    /// Estimate a quantile, e.g. 0.99, in recorded units.
+    [[nodiscard]] auto quantile(f64 q) const -> u64;
+
+    /// Record a value.
+    void record(u64 value) {
+        buckets[BucketFor(value)].fetch_add(1, std::memory_order::relaxed);
+        total.fetch_add(1, std::memory_order::relaxed);
+        sum.fetch_add(value, std::memory_order::relaxed);
+    }
+
+    /// Record a duration in nanoseconds.
+    void record(chr::nanoseconds duration) { record(u64(std::max<i64>(duration.count(), 0))); }
+
+    /// Get the smallest value that falls into a bucket.
+    static constexpr auto LowerBound(usz bucket) -> u64 {
+        if (bucket < SubBuckets) return bucket;
+        auto exp = bucket / SubBuckets - 1;
+        return (SubBuckets + bucket % SubBuckets) << exp;
+    }
+
+    /// Get the largest value that falls into a bucket.
+    static constexpr auto UpperBound(usz bucket) -> u64 {
+        if (bucket + 1 == BucketCount) return ~u64(0);
+        return LowerBound(bucket + 1) - 1;
+    }
+
+    /// Get the bucket a value falls into.
+    static constexpr auto BucketFor(u64 value) -> usz {
+        if (value < SubBuckets) return usz(value);
+        auto exp = usz(std::bit_width(value)) - 1 - SubBucketBits;
+        return (exp + 1) * SubBuckets + usz(value >> exp) % SubBuckets;
+    }
+
+private:
+    void RenderSamples(std::string& out) const override;
+    auto TypeName() const -> std::string_view override { return "histogram"; }
+};
+
+/// Records the time between its construction and destruction in
+/// a histogram.
+class pr::metrics::ScopedTimer {
+    LIBBASE_IMMOVABLE(ScopedTimer);
+    Histogram& hist;
+    chr::steady_clock::time_point start = chr::steady_clock::now();
+
+public:
+    explicit ScopedTimer(Histogram& hist) : hist(hist) {}
+    ~ScopedTimer() { hist.record(chr::steady_clock::now() - start); }
+};
+
+/// Measures the ticks of an event loop and complains about slow ones.
+///
+/// A watchdog thread checks every monitor periodically, so a tick
+/// that is stuck is reported while it is still running, rather than
+/// only once (or if) it finishes.
+class pr::metrics::TickMonitor {
+    LIBBASE_IMMOVABLE(TickMonitor);
+
+    Readonly(std::string, loop);
+    Histogram duration;
+    Counter slow_ticks;
+    const chr::nanoseconds threshold;
+
+    /// When the current tick started, in steady clock nanoseconds,
+    /// or 0 if we’re not in a tick.
+    std::atomic<i64> started = 0;
+
+    /// Set by the watchdog once it has reported the current tick.
+    std::atomic_bool reported = false;
+
+public:
+    TickMonitor(std::string loop, chr::nanoseconds threshold);
+    ~TickMonitor();
+
+    /// Mark the start and end of a tick.
+    void begin();
+    void end();
+
+    /// Called by the watchdog.
+    void check(chr::steady_clock::time_point now);
+};
+
+/// Serves the output of Render() over HTTP so it can be scraped.
+class pr::metrics::Exporter {
+    LIBBASE_IMMOVABLE(Exporter);
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+
+    explicit Exporter(std::unique_ptr<Impl> impl);
+
+public:
+    ~Exporter();
+
+    /// Start serving metrics on a port.
+    static auto Create(u16 port) -> Result<std::unique_ptr<Exporter>>;
+};
+
+#endif // PRESCRIPTIVISM_SHARED_METRICS_HH
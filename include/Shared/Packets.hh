@@ -23,7 +23,11 @@
     X(Draw)             \
     X(StartGame)        \
     X(AddSoundToStack)  \
-    X(StackLockChanged)
+    X(StackLockChanged) \
+    X(LoginAccepted)    \
+    X(Batch)            \
+    X(Resume)           \
+    X(Snapshot)
 
 #define CS_PACKETS(X)    \
     X(HeartbeatResponse) \
@@ -31,16 +35,57 @@
     X(PlaySingleTarget)  \
     X(Pass)
 
-namespace pr {
-using PlayerId = u8;
+namespace pr::packets {
+/// Protocol version of clients that don’t send one in cs::Login.
+constexpr u32 LegacyProtocolVersion = 0;
+
+/// Protocol version implemented by this build.
+///
+/// Version 1 switches both peers to the compact encoding once the
+/// server has sent sc::LoginAccepted. Version 2 adds ResumePoint to
+/// cs::Login. Version 3 adds sc::Snapshot, sc::Resume, and sc::Batch,
+/// adds the session to sc::StartGame, and lets sc::Draw carry several
+/// cards.
+constexpr u32 ProtocolVersion = 3;
+
+/// The first protocol version that supports sc::Snapshot.
+constexpr u32 SnapshotProtocolVersion = 3;
+
+/// The first protocol version that supports sc::Resume and the session
+/// in sc::StartGame.
+constexpr u32 ResumeProtocolVersion = 3;
+
+/// The first protocol version that supports sc::Batch and sc::Draw
+/// with more than one card; older clients are sent sc::LegacyDraw.
+constexpr u32 BatchProtocolVersion = 3;
+
+/// Get the encoding used by a protocol version.
+constexpr auto EncodingFor(u32 protocol_version) -> ser::Encoding {
+    return protocol_version >= 1 ? ser::Encoding::Compact : ser::Encoding::Fixed;
 }
 
+/// How much of a game’s state a client has seen.
+///
+/// The state of a game is what sc::StartGame contains, followed by every
+/// sc::AddSoundToStack and sc::StackLockChanged sent since; the sequence
+/// number is the number of these updates that the client has applied.
+/// The updates don’t carry it themselves since both sides can just
+/// count them; an sc::Snapshot says how many it already includes.
+struct ResumePoint {
+    PR_SERIALISE(session, seq_no);
+
+    /// The game these updates belong to; 0 if there is none.
+    u64 session = 0;
+
+    /// The number of updates applied since sc::StartGame.
+    u32 seq_no = 0;
+};
+} // namespace pr::packets
+
 // =============================================================================
 //  Common Packet API
 // =============================================================================
 namespace pr::net::detail {
-using IDType = u8;
-
 template <IDType Id>
 struct PacketBase {
     /// Id of the packet.
@@ -51,11 +96,12 @@ struct PacketBase {
 } // namespace pr::net::detail
 
 #define DefinePacket(name) struct name : ::pr::net::detail::PacketBase<+ID::name>
-#define Ctor(name)             \
-private:                       \
-    friend net::ReceiveBuffer; \
-    name() = default;          \
-public:                        \
+#define Ctor(name)                                                                    \
+private:                                                                              \
+    template <typename T>                                                             \
+    friend auto net::DeserialiseFrame(const net::Frame&, ser::Encoding) -> Result<T>; \
+    name() = default;                                                                 \
+public:                                                                               \
     name
 
 #define Serialisable(...) PR_SERIALISE(id __VA_OPT__(, ) __VA_ARGS__)
@@ -114,6 +160,7 @@ DefinePacket(Disconnect) {
         UsernameInUse,    ///< Username is already in use.
         WrongPassword,    ///< The password was incorrect.
         UnexpectedPacket, ///< That packet wasn’t supposed to be sent at that point.
+        UsernameTooLong,  ///< Username is longer than constants::MaxPlayerNameSize.
     };
 
     Ctor(Disconnect)(Reason reason) : reason(reason) {}
@@ -142,7 +189,7 @@ namespace pr::packets::sc {
 /// turn.
 DefinePacket(HeartbeatRequest) {
     Ctor(HeartbeatRequest)(u32 seq_no) : seq_no(seq_no) {}
-    Serialisable(seq_no);
+    Serialisable(ser::VarInt{seq_no});
 
     /// Sequence number of the heartbeat packet; used to see if the
     /// client is actually responding to the right packet.
@@ -158,7 +205,17 @@ DefinePacket(EndTurn) {
 };
 
 DefinePacket(Draw) {
-    Ctor(Draw)(CardId card) : card(card) {}
+    Ctor(Draw)(std::vector<CardId> cards) : cards(std::move(cards)) {}
+    Serialisable(cards);
+
+    /// The cards that were drawn, in order.
+    std::vector<CardId> cards;
+};
+
+/// sc::Draw as clients before BatchProtocolVersion know it, with a
+/// single card; it uses the same id, so clients never see it as such.
+struct LegacyDraw : ::pr::net::detail::PacketBase<+ID::Draw> {
+    Ctor(LegacyDraw)(CardId card) : card(card) {}
     Serialisable(card);
 
     CardId card;
@@ -174,21 +231,39 @@ DefinePacket(StartGame) {
     Ctor(StartGame)(
         std::array<PlayerInfo, constants::PlayersPerGame> words,
         std::vector<CardId> hand,
-        PlayerId player
+        PlayerId player,
+        u64 session
     ) : player_data(words),
         hand(hand),
-        player_id(player) {}
+        player_id(player),
+        session(session) {}
+
+    // Clients before ResumeProtocolVersion don’t expect a session, so
+    // it is only sent if there is one.
+    void serialise(ser::Writer& w) const {
+        w(id, player_data, hand, player_id);
+        if (session) w << session;
+    }
 
-    Serialisable(player_data, hand, player_id);
+    void deserialise(ser::Reader& r) {
+        r(id, player_data, hand, player_id);
+        session = r.size() != 0 ? r.read<u64>() : 0;
+    }
 
-    /// Player data, in order of player ID.
+    /// Player data, in order of player ID. The words are the ones
+    /// that the game started with; any changes since are sent after
+    /// this packet.
     std::array<PlayerInfo, constants::PlayersPerGame> player_data;
 
-    /// This player’s starting hand.
+    /// This player’s current hand.
     std::vector<CardId> hand;
 
     /// ID of the player that this is sent to.
     PlayerId player_id;
+
+    /// Identifies this game when reconnecting; see ResumePoint. This
+    /// is 0 if the game can’t be resumed.
+    u64 session;
 };
 
 DefinePacket(AddSoundToStack) {
@@ -197,7 +272,7 @@ DefinePacket(AddSoundToStack) {
           stack_index(stack_index),
           card(card) {}
 
-    Serialisable(player, stack_index, card);
+    Serialisable(player, ser::VarInt{stack_index}, card);
 
     /// The player whose word we’re adding the sound to.
     PlayerId player;
@@ -215,7 +290,7 @@ DefinePacket(StackLockChanged) {
           stack_index(stack_index),
           locked(locked) {}
 
-    Serialisable(player, stack_index, locked);
+    Serialisable(player, ser::VarInt{stack_index}, locked);
 
     /// The player whose stack we’re locking.
     PlayerId player;
@@ -226,6 +301,98 @@ DefinePacket(StackLockChanged) {
     /// Whether the stack is locked or unlocked.
     bool locked;
 };
+
+/// Sent in response to a cs::Login that includes a protocol version;
+/// both sides switch to the encoding of the agreed-upon version right
+/// after this packet.
+DefinePacket(LoginAccepted) {
+    Ctor(LoginAccepted)(u32 protocol_version) : protocol_version(protocol_version) {}
+    Serialisable(protocol_version);
+
+    /// The protocol version that the server picked.
+    u32 protocol_version;
+};
+
+/// Several packets that are sent together; this is how the server sends
+/// everything it has for a client at the end of a tick, if the client
+/// supports BatchProtocolVersion.
+///
+/// The contents are complete frames, each with their own length prefix;
+/// they use the same encoding as the batch itself. Batches are unpacked
+/// by HandleClientSidePacket(), so they never reach a handler.
+DefinePacket(Batch) {
+    void serialise(ser::Writer& w) const {
+        w << id;
+        w.write(ser::InputSpan{frames});
+    }
+
+    void deserialise(ser::Reader& r) {
+        r >> id;
+        frames.resize(r.size());
+        r >> std::span{frames};
+    }
+
+    std::vector<std::byte> frames;
+};
+
+/// Sent instead of sc::StartGame to a player who rejoins the game
+/// with a ResumePoint that is still valid; the updates they missed
+/// follow this packet.
+DefinePacket(Resume) {
+    Ctor(Resume)(std::vector<CardId> hand) : hand(std::move(hand)) {}
+    Serialisable(hand);
+
+    /// This player’s current hand, which may have changed since.
+    std::vector<CardId> hand;
+};
+
+/// Sent instead of sc::StartGame to a player who rejoins a game that
+/// is under way and can’t resume where they left off; unlike that, it
+/// contains the current state of the game, so nothing follows it.
+DefinePacket(Snapshot) {
+    struct StackInfo {
+        PR_SERIALISE(cards, locked);
+
+        /// The cards in the stack, from the bottom up.
+        std::vector<CardId> cards;
+        bool locked;
+    };
+
+    struct PlayerInfo {
+        PR_SERIALISE(stacks, name);
+        std::array<StackInfo, constants::StartingWordSize> stacks;
+        std::string name;
+    };
+
+    Ctor(Snapshot)(
+        std::array<PlayerInfo, constants::PlayersPerGame> player_data,
+        std::vector<CardId> hand,
+        PlayerId player,
+        u64 session,
+        u32 seq_no
+    ) : player_data(std::move(player_data)),
+        hand(std::move(hand)),
+        player_id(player),
+        session(session),
+        seq_no(seq_no) {}
+
+    Serialisable(player_data, hand, player_id, session, ser::VarInt{seq_no});
+
+    /// Player data, in order of player ID.
+    std::array<PlayerInfo, constants::PlayersPerGame> player_data;
+
+    /// This player’s current hand.
+    std::vector<CardId> hand;
+
+    /// ID of the player that this is sent to.
+    PlayerId player_id;
+
+    /// Identifies this game when reconnecting; see ResumePoint.
+    u64 session;
+
+    /// The number of updates that this state already includes.
+    u32 seq_no;
+};
 } // namespace pr::packets::sc
 
 // =============================================================================
@@ -234,21 +401,42 @@ DefinePacket(StackLockChanged) {
 namespace pr::packets::cs {
 DefinePacket(HeartbeatResponse) {
     Ctor(HeartbeatResponse)(u32 seq_no) : seq_no(seq_no) {}
-    Serialisable(seq_no);
+    Serialisable(ser::VarInt{seq_no});
 
     /// The sequence number of the corresponding server packet.
     u32 seq_no;
 };
 
 DefinePacket(Login) {
-    Ctor(Login)(std::string name, std::string password)
-        : name(std::move(name)),
-          password(std::move(password)) {}
-
-    Serialisable(name, password);
+    Ctor(Login)(
+        std::string name,
+        std::string password,
+        ResumePoint resume = {},
+        u32 protocol_version = ProtocolVersion
+    ) : name(std::move(name)),
+        password(std::move(password)),
+        protocol_version(protocol_version),
+        resume(resume) {}
+
+    void serialise(ser::Writer& w) const { w(id, name, password, protocol_version, resume); }
+    void deserialise(ser::Reader& r) {
+        r(id, name, password);
+
+        // Older clients end the packet after the password or after
+        // the protocol version.
+        protocol_version = r.size() != 0 ? r.read<u32>() : LegacyProtocolVersion;
+        if (protocol_version >= 2) r >> resume;
+    }
 
     std::string name;
     std::string password;
+
+    /// The highest protocol version the client supports. This is
+    /// always sent using the fixed encoding.
+    u32 protocol_version;
+
+    /// Where the client left off if it was disconnected from a game.
+    ResumePoint resume;
 };
 
 DefinePacket(PlaySingleTarget) {
@@ -257,7 +445,7 @@ DefinePacket(PlaySingleTarget) {
           player(player),
           target_stack_index(target_card_index) {}
 
-    Serialisable(card_index, player, target_stack_index);
+    Serialisable(ser::VarInt{card_index}, player, ser::VarInt{target_stack_index});
 
     /// The index of the card in hand to play.
     u32 card_index;
@@ -272,7 +460,7 @@ DefinePacket(PlaySingleTarget) {
 
 DefinePacket(Pass) {
     Ctor(Pass)(u32 card_index) : card_index(card_index) {}
-    Serialisable(card_index);
+    Serialisable(ser::VarInt{card_index});
 
     /// The index of the card in hand that is discarded.
     u32 card_index;
@@ -284,13 +472,43 @@ DefinePacket(Pass) {
 // =============================================================================
 namespace pr::packets {
 static_assert(std::is_same_v<net::detail::IDType, u8>, "TODO: Handle larger packet IDs");
+static_assert(ser::FixedSize<sc::AddSoundToStack>(ser::Encoding::Fixed) == 8);
+static_assert(ser::FixedSize<sc::StartTurn>(ser::Encoding::Compact) == 1);
+static_assert(ser::FixedSize<sc::StartGame>(ser::Encoding::Fixed) == ser::VariableSize);
+
+template <typename Handler>
+auto HandleClientSideFrame(Handler& h, const net::Frame& frame, ser::Encoding encoding) -> Result<>;
 
 template <typename Packet, typename Handler, typename... Args>
-auto Dispatch(Handler& h, net::ReceiveBuffer& buf, Args&&... args) -> Result<bool> {
-    auto pack = buf.read<Packet>();
-    if (not pack.has_value()) return false;
-    h.handle(std::forward<Args>(args)..., std::move(pack.value()));
-    return true;
+auto Dispatch(Handler& h, const net::Frame& frame, ser::Encoding encoding, Args&&... args) -> Result<> {
+    auto pack = Try(net::DeserialiseFrame<Packet>(frame, encoding));
+
+    // Handle the contents of a batch as though they had been sent separately.
+    if constexpr (std::is_same_v<Packet, sc::Batch>) {
+        ser::InputSpan data{pack.frames};
+        while (not data.empty()) {
+            auto inner = Try(net::ParseFrame(data));
+            if (sc::ID(inner.id) == sc::ID::Batch) return Error("Server sent nested batch");
+            Try(HandleClientSideFrame(h, inner, encoding));
+        }
+    } else {
+        h.handle(std::forward<Args>(args)..., std::move(pack));
+    }
+
+    return {};
+}
+
+/// Deserialise and handle a single frame received from the server.
+template <typename Handler>
+auto HandleClientSideFrame(Handler& h, const net::Frame& frame, ser::Encoding encoding) -> Result<> {
+    switch (auto ty = sc::ID(frame.id)) {
+        default: return Error("Server sent unrecognised packet: {}", +ty);
+#define X(name) \
+    case pr::packets::sc::ID::name: return Dispatch<pr::packets::sc::name>(h, frame, encoding);
+            COMMON_PACKETS(X)
+            SC_PACKETS(X)
+#undef X
+    }
 }
 
 /// Deserialise and handle a packet received from the server.
@@ -301,15 +519,19 @@ auto Dispatch(Handler& h, net::ReceiveBuffer& buf, Args&&... args) -> Result<boo
 /// more data).
 template <typename Handler>
 auto HandleClientSidePacket(Handler& h, net::ReceiveBuffer& buf) -> Result<bool> {
-    Assert(not buf.empty(), "No packet to handle?");
-    switch (auto ty = buf.peek<sc::ID>().value()) {
-        default: return Error("Server sent unrecognised packet: {}", +ty);
-#define X(name) \
-    case pr::packets::sc::ID::name: return Dispatch<pr::packets::sc::name>(h, buf);
-            COMMON_PACKETS(X)
-            SC_PACKETS(X)
-#undef X
-    }
+    auto frame = Try(buf.peek_frame());
+    if (not frame) return false;
+    defer { buf.drop_frame(); };
+    Try(HandleClientSideFrame(h, *frame, buf.encoding));
+    return true;
+}
+
+/// Let the handler measure how long it takes to process a packet; the
+/// returned object is kept alive while the packet is being handled.
+template <typename Handler>
+auto StartHandlerTimer(Handler& h, cs::ID id) {
+    if constexpr (requires { h.time_handler(id); }) return h.time_handler(id);
+    else return 0;
 }
 
 /// Deserialise and handle a packet received from a client.
@@ -320,11 +542,17 @@ auto HandleClientSidePacket(Handler& h, net::ReceiveBuffer& buf) -> Result<bool>
 /// more data).
 template <typename Handler>
 auto HandleServerSidePacket(Handler& h, net::TCPConnexion& client, net::ReceiveBuffer& buf) -> Result<bool> {
-    Assert(not buf.empty(), "No packet to handle?");
-    switch (auto ty = buf.peek<cs::ID>().value()) {
+    auto frame = Try(buf.peek_frame());
+    if (not frame) return false;
+    defer { buf.drop_frame(); };
+    switch (auto ty = cs::ID(frame->id)) {
         default: return Error("Client sent unrecognised packet: {}", +ty);
-#define X(name) \
-    case pr::packets::cs::ID::name: return Dispatch<pr::packets::cs::name>(h, buf, client);
+#define X(name)                                                                \
+    case pr::packets::cs::ID::name: {                                          \
+        auto _ = StartHandlerTimer(h, ty);                                     \
+        Try(Dispatch<pr::packets::cs::name>(h, *frame, buf.encoding, client)); \
+        return true;                                                           \
+    }
             COMMON_PACKETS(X)
             CS_PACKETS(X)
 #undef X
@@ -0,0 +1,81 @@
+#ifndef PRESCRIPTIVISM_SHARED_QUEUE_HH
+#define PRESCRIPTIVISM_SHARED_QUEUE_HH
+
+#include <base/Base.hh>
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <optional>
+#include <utility>
+
+namespace pr {
+template <typename T, usz Capacity>
+class SPSCQueue;
+} // namespace pr
+
+/// A bounded queue with a single producer and a single consumer.
+///
+/// One thread may push elements while another pops them, without any
+/// locking. Both positions only ever increase, and an element’s slot is
+/// its position modulo the capacity. Each side also remembers where it
+/// last saw the other, so it only has to look at the other’s cache line
+/// once it appears to have run out of space or elements.
+///
+/// Which thread is the producer or consumer may change, but only if the
+/// threads synchronise in some other way, e.g. by joining one of them.
+template <typename T, usz Capacity>
+class pr::SPSCQueue {
+    LIBBASE_IMMOVABLE(SPSCQueue);
+    static_assert(std::has_single_bit(Capacity), "Capacity must be a power of two");
+
+    static constexpr usz Mask = Capacity - 1;
+
+    /// std::hardware_destructive_interference_size isn’t available
+    /// everywhere, and this is what it is on every platform we support.
+    static constexpr usz CacheLine = 64;
+
+    std::array<T, Capacity> slots{};
+
+    /// The next element to pop; written by the consumer.
+    alignas(CacheLine) std::atomic<usz> head = 0;
+    usz cached_tail = 0;
+
+    /// The next slot to push into; written by the producer.
+    alignas(CacheLine) std::atomic<usz> tail = 0;
+    usz cached_head = 0;
+
+public:
+    SPSCQueue() = default;
+
+    /// Remove the oldest element; this may only be called by the consumer.
+    [[nodiscard]] auto try_pop() -> std::optional<T> {
+        auto h = head.load(std::memory_order::relaxed);
+        if (h == cached_tail) {
+            cached_tail = tail.load(std::memory_order::acquire);
+            if (h == cached_tail) return std::nullopt;
+        }
+
+        std::optional<T> value{std::exchange(slots[h & Mask], T{})};
+        head.store(h + 1, std::memory_order::release);
+        return value;
+    }
+
+    /// Add an element; this may only be called by the producer.
+    ///
+    /// \return False if the queue is full, in which case 'value' is
+    /// left untouched.
+    [[nodiscard]] bool try_push(T&& value) {
+        auto t = tail.load(std::memory_order::relaxed);
+        if (t - cached_head == Capacity) {
+            cached_head = head.load(std::memory_order::acquire);
+            if (t - cached_head == Capacity) return false;
+        }
+
+        slots[t & Mask] = std::move(value);
+        tail.store(t + 1, std::memory_order::release);
+        return true;
+    }
+};
+
+#endif // PRESCRIPTIVISM_SHARED_QUEUE_HH
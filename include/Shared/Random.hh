@@ -0,0 +1,74 @@
+#ifndef PRESCRIPTIVISM_SHARED_RANDOM_HH
+#define PRESCRIPTIVISM_SHARED_RANDOM_HH
+
+#include <Shared/Utils.hh>
+
+#include <base/Base.hh>
+
+#include <array>
+#include <bit>
+#include <limits>
+#include <random>
+
+namespace pr {
+class Rng;
+
+/// Get a seed from the operating system.
+inline auto RandomSeed() -> u64 {
+    std::random_device rd;
+    return u64(rd()) << 32 | rd();
+}
+
+/// Mix two values into a seed; this is used to derive independent
+/// streams from a single seed, e.g. one per simulated game.
+constexpr auto MixSeed(u64 seed, u64 stream) -> u64 {
+    // SplitMix64 finaliser.
+    u64 z = seed + (stream + 1) * 0x9e37'79b9'7f4a'7c15;
+    z = (z ^ (z >> 30)) * 0xbf58'476d'1ce4'e5b9;
+    z = (z ^ (z >> 27)) * 0x94d0'49bb'1331'11eb;
+    return z ^ (z >> 31);
+}
+} // namespace pr
+
+/// A small, fast random number generator (xoshiro256**).
+///
+/// Unlike std::mt19937, this is cheap to seed and copy, and the same
+/// seed always yields the same sequence on every platform, so games
+/// can be reproduced from their seed. This is NOT suitable for anything
+/// that needs to be unpredictable, such as session ids.
+class pr::Rng {
+    std::array<u64, 4> s{};
+
+public:
+    using result_type = u64;
+
+    constexpr explicit Rng(u64 seed) {
+        for (auto [i, x] : s | vws::enumerate) x = MixSeed(seed, u64(i));
+    }
+
+    [[nodiscard]] static constexpr auto min() -> u64 { return 0; }
+    [[nodiscard]] static constexpr auto max() -> u64 { return std::numeric_limits<u64>::max(); }
+
+    /// Get the next number.
+    constexpr auto operator()() -> u64 {
+        auto res = std::rotl(s[1] * 5, 7) * 9;
+        auto t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = std::rotl(s[3], 45);
+        return res;
+    }
+
+    /// Get a number in [0, n).
+    ///
+    /// This uses a multiply-shift and is very slightly biased for large
+    /// n, which doesn’t matter for picking cards and moves.
+    constexpr auto below(u64 n) -> u64 {
+        return u64((unsigned __int128)(operator()()) * n >> 64);
+    }
+};
+
+#endif // PRESCRIPTIVISM_SHARED_RANDOM_HH
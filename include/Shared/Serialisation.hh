@@ -5,17 +5,23 @@
 
 #include <base/Base.hh>
 
+#include <array>
+#include <concepts>
 #include <cstring>
 #include <expected>
+#include <limits>
 #include <memory>
 #include <span>
 #include <string>
 #include <utility>
 #include <vector>
 
-#define PR_SERIALISE(...)                                              \
-    void serialise(::pr::ser::Writer& buf) const { buf(__VA_ARGS__); } \
-    void deserialise(::pr::ser::Reader& buf) { buf(__VA_ARGS__); }
+#define PR_SERIALISE(...)                                                   \
+    void serialise(::pr::ser::Writer& buf) const { buf(__VA_ARGS__); }      \
+    void deserialise(::pr::ser::Reader& buf) { buf(__VA_ARGS__); }          \
+    static constexpr auto wire_size(::pr::ser::Encoding e) -> ::base::usz { \
+        return decltype(::pr::ser::detail::Fields(__VA_ARGS__))::Size(e);   \
+    }
 
 /// Serialisation module.
 ///
@@ -37,6 +43,11 @@
 ///     static void serialise(Writer& w, const Foo& f) { ... }
 ///     static void deserialise(Reader& r, const Foo& f) { ... }
 /// };
+///
+/// PR_SERIALISE() also computes at compile time whether a type always
+/// takes up the same number of bytes on the wire, and how many; see
+/// FixedSize(). Types that implement serialise() by hand can opt into
+/// this by providing a static constexpr wire_size(Encoding) function.
 namespace pr::ser {
 class Reader;
 class Writer;
@@ -44,12 +55,28 @@ class Writer;
 template <usz n>
 class Magic;
 
+template <std::unsigned_integral T>
+class VarInt;
+
 template <typename T>
 class Blob;
 
 template <typename T>
 struct Serialiser;
 
+/// Wire encodings.
+///
+/// The fixed encoding writes every integer with its full width. The
+/// compact encoding uses LEB128 varints for lengths and for anything
+/// wrapped in a VarInt, and lets types pick a denser representation
+/// (e.g. card ids are a single byte).
+enum class Encoding : u8 {
+    Fixed,
+    Compact,
+};
+
+constexpr usz EncodingCount = 2;
+
 struct InputSpan : std::span<const std::byte> {
     using std::span<const std::byte>::span;
 
@@ -68,21 +95,60 @@ struct InputSpan : std::span<const std::byte> {
         : std::span<const std::byte>(reinterpret_cast<const std::byte*>(str), n) {}
 };
 
+/// Returned by FixedSize() for types whose size depends on their value.
+constexpr usz VariableSize = std::numeric_limits<usz>::max();
+
 template <typename T>
 auto Deserialise(InputSpan data) -> Result<T>;
 
 template <typename T>
 auto Serialise(const T& t) -> std::vector<std::byte>;
+
+/// Get the number of bytes that any value of a type takes up on the
+/// wire in an encoding, or VariableSize if this depends on the value.
+template <typename T>
+constexpr auto FixedSize(Encoding e) -> usz;
+
+/// Get the exact number of bytes that a value takes up on the wire.
+///
+/// For fixed-size types, this is a constant; otherwise, this walks
+/// the value without writing anything.
+template <typename T>
+auto SerialisedSize(const T& t, Encoding e) -> usz;
+
+namespace detail {
+template <typename... Ts>
+struct FieldList {
+    static constexpr auto Size(Encoding e) -> usz {
+        usz total = 0;
+        for (auto sz : std::array<usz, sizeof...(Ts)>{FixedSize<Ts>(e)...}) {
+            if (sz == VariableSize) return VariableSize;
+            total += sz;
+        }
+        return total;
+    }
+};
+
+/// Only used to get at the types of the fields in PR_SERIALISE().
+template <typename... Ts>
+auto Fields(const Ts&...) -> FieldList<Ts...>;
+} // namespace detail
 } // namespace pr::ser
 
 /// Helper class to (partially) deserialise objects.
 class pr::ser::Reader {
     InputSpan data;
 
+    /// Set while reading a fixed-size value whose size we have
+    /// already checked.
+    bool checked = false;
+
 public:
     Result<> result;
+    Encoding encoding;
 
-    explicit Reader(InputSpan data) : data(data) {}
+    explicit Reader(InputSpan data, Encoding encoding = Encoding::Fixed)
+        : data(data), encoding(encoding) {}
 
     /// Read several fields from this packet.
     template <typename... Fields>
@@ -130,6 +196,21 @@ public:
     template <typename T>
     requires requires (T&& t, Reader& r) { std::forward<T>(t).deserialise(r); }
     auto operator>>(T&& t) -> Reader& {
+        // If we know how large this is, check that we have enough data
+        // once; the fields can then be copied out without checking.
+        auto sz = FixedSize<std::remove_cvref_t<T>>(encoding);
+        if (sz != VariableSize and not checked) {
+            if (data.size() < sz or not result) {
+                result = Error("Not enough data to read {} bytes ({} bytes left)", sz, data.size());
+                return *this;
+            }
+
+            checked = true;
+            std::forward<T>(t).deserialise(*this);
+            checked = false;
+            return *this;
+        }
+
         std::forward<T>(t).deserialise(*this);
         return *this;
     }
@@ -143,10 +224,13 @@ public:
 
     /// Read a string from this packet.
     auto operator>>(std::string& s) -> Reader& {
-        s.resize_and_overwrite(
-            read<usz>(),
-            [&](char* ptr, usz count) { return Copy(ptr, count); }
-        );
+        auto sz = read_length();
+        if (sz > data.size()) {
+            result = Error("String size {} exceeds remaining input size {}", sz, data.size());
+            return *this;
+        }
+
+        s.resize_and_overwrite(sz, [&](char* ptr, usz count) { return Copy(ptr, count); });
         return *this;
     }
 
@@ -158,9 +242,11 @@ public:
 
     template <typename T>
     auto operator>>(std::vector<T>& s) -> Reader& {
-        auto sz = read<usz>();
-        if (sz > s.max_size()) {
-            result = Error("Input size {} exceeds maximum size {} of std::vector<>", sz, s.max_size());
+        // Every element takes up at least one byte, so anything larger
+        // than what we have left is bogus.
+        auto sz = read_length();
+        if (sz > data.size()) {
+            result = Error("Input size {} exceeds remaining input size {}", sz, data.size());
             return *this;
         }
 
@@ -177,12 +263,32 @@ public:
         if (result) result = Error("{}", err);
     }
 
+    /// Read the length of a string or vector.
+    auto read_length() -> usz {
+        if (encoding == Encoding::Compact) return usz(read_varint());
+        return read<usz>();
+    }
+
+    /// Read an LEB128-encoded unsigned integer.
+    auto read_varint() -> u64 {
+        u64 value = 0;
+        for (u32 shift = 0; shift < 64; shift += 7) {
+            u8 byte = read<u8>();
+            if (not result) return 0;
+            value |= u64(byte & 0x7F) << shift;
+            if (not (byte & 0x80)) return value;
+        }
+
+        fail("Varint is too long");
+        return 0;
+    }
+
     /// Check how many bytes are left in the buffer.
     [[nodiscard]] auto size() const -> usz { return data.size(); }
 
 private:
     usz Copy(void* ptr, usz count) {
-        if (data.size() < count or not result) {
+        if (not checked and (data.size() < count or not result)) {
             result = Error("Not enough data to read {} bytes ({} bytes left)", count, data.size());
             return 0;
         }
@@ -195,10 +301,26 @@ private:
 
 /// Helper for serialising data into a buffer.
 class pr::ser::Writer {
+    LIBBASE_IMMOVABLE(Writer);
+    std::vector<std::byte> owned;
+
+    /// If set, we only count how many bytes we would write.
+    bool measuring = false;
+    usz measured = 0;
+
 public:
-    std::vector<std::byte> data;
+    /// The buffer we’re writing to.
+    std::vector<std::byte>& data;
+
+    /// How to encode values.
+    Encoding encoding;
+
+    /// Serialise into a new buffer.
+    explicit Writer(Encoding encoding = Encoding::Fixed) : data(owned), encoding(encoding) {}
 
-    Writer() = default;
+    /// Append to an existing buffer.
+    explicit Writer(std::vector<std::byte>& into, Encoding encoding = Encoding::Fixed)
+        : data(into), encoding(encoding) {}
 
     /// Write several fields to this packet.
     template <typename... Fields>
@@ -247,13 +369,13 @@ public:
     }
 
     void write(const std::string& s) {
-        write(s.size());
+        write_length(s.size());
         Append(s.data(), s.size());
     }
 
     template <typename T>
     void write(const std::vector<T>& v) {
-        write(v.size());
+        write_length(v.size());
         for (const auto& elem : v) write(elem);
     }
 
@@ -262,8 +384,43 @@ public:
         for (const auto& elem : a) write(elem);
     }
 
+    /// Write the length of a string or vector.
+    void write_length(usz sz) {
+        if (encoding == Encoding::Compact) write_varint(sz);
+        else write(sz);
+    }
+
+    /// Write an LEB128-encoded unsigned integer.
+    void write_varint(u64 value) {
+        u8 bytes[10];
+        usz n = 0;
+        do {
+            u8 byte = value & 0x7F;
+            value >>= 7;
+            if (value) byte |= 0x80;
+            bytes[n++] = byte;
+        } while (value);
+        Append(bytes, n);
+    }
+
+    /// Compute how many bytes serialising a value would write.
+    ///
+    /// Prefer SerialisedSize(), which skips this for fixed-size types.
+    template <typename T>
+    static auto Measure(const T& t, Encoding encoding) -> usz {
+        Writer w{encoding};
+        w.measuring = true;
+        w << t;
+        return w.measured;
+    }
+
 private:
     void Append(const void* ptr, usz count) {
+        if (measuring) {
+            measured += count;
+            return;
+        }
+
         auto* p = static_cast<const std::byte*>(ptr);
         data.insert(data.end(), p, p + count);
     }
@@ -298,6 +455,8 @@ public:
     void serialise(Writer& w) const {
         w.write(InputSpan{magic});
     }
+
+    static constexpr auto wire_size(Encoding) -> usz { return n; }
 };
 
 /// A blob of data with the size supplied externally.
@@ -334,7 +493,41 @@ public:
     }
 };
 
+/// An unsigned integer that is written as a varint in the compact
+/// encoding; in the fixed encoding, it is written as-is.
+template <std::unsigned_integral T>
+class pr::ser::VarInt {
+    T& value;
+
+public:
+    // See Blob for why the const_cast is fine.
+    VarInt(const T& value) : value(const_cast<T&>(value)) {}
+
+    void deserialise(Reader& r) {
+        if (r.encoding != Encoding::Compact) {
+            r >> value;
+            return;
+        }
+
+        auto v = r.read_varint();
+        if (v > std::numeric_limits<T>::max()) r.fail("Varint out of range");
+        value = T(v);
+    }
+
+    void serialise(Writer& w) const {
+        if (w.encoding == Encoding::Compact) w.write_varint(value);
+        else w << value;
+    }
+
+    static constexpr auto wire_size(Encoding e) -> usz {
+        return e == Encoding::Compact ? VariableSize : sizeof(T);
+    }
+};
+
 namespace pr::ser {
+template <typename T>
+VarInt(const T&) -> VarInt<T>;
+
 template <usz n>
 Magic(const char (&)[n]) -> Magic<n - 1>;
 
@@ -348,6 +541,45 @@ template <typename T>
 Blob(const std::unique_ptr<T[]>&, usz) -> Blob<T>;
 }
 
+namespace pr::ser::detail {
+template <typename T>
+struct IsArray : std::false_type {};
+
+template <typename T, usz n>
+struct IsArray<std::array<T, n>> : std::true_type {
+    using Element = T;
+    static constexpr usz Count = n;
+};
+
+template <typename T>
+constexpr auto ComputeFixedSize(Encoding e) -> usz {
+    if constexpr (std::integral<T> or std::floating_point<T>) return sizeof(T);
+    else if constexpr (std::is_enum_v<T>) return sizeof(std::underlying_type_t<T>);
+    else if constexpr (requires { { T::wire_size(Encoding{}) } -> std::same_as<usz>; }) return T::wire_size(e);
+    else if constexpr (IsArray<T>::value) {
+        auto sz = FixedSize<typename IsArray<T>::Element>(e);
+        return sz == VariableSize ? VariableSize : sz * IsArray<T>::Count;
+    } else return VariableSize;
+}
+
+template <typename T>
+constexpr std::array<usz, EncodingCount> FixedSizes{
+    ComputeFixedSize<T>(Encoding::Fixed),
+    ComputeFixedSize<T>(Encoding::Compact),
+};
+} // namespace pr::ser::detail
+
+template <typename T>
+constexpr auto pr::ser::FixedSize(Encoding e) -> usz {
+    return detail::FixedSizes<T>[usz(e)];
+}
+
+template <typename T>
+auto pr::ser::SerialisedSize(const T& t, Encoding e) -> usz {
+    if (auto sz = FixedSize<T>(e); sz != VariableSize) return sz;
+    return Writer::Measure(t, e);
+}
+
 template <typename T>
 auto pr::ser::Deserialise(InputSpan data) -> pr::Result<T> {
     Result<T> t{T{}};
@@ -360,6 +592,7 @@ auto pr::ser::Deserialise(InputSpan data) -> pr::Result<T> {
 template <typename T>
 auto pr::ser::Serialise(const T& t) -> std::vector<std::byte> {
     Writer w;
+    w.data.reserve(SerialisedSize(t, Encoding::Fixed));
     w << t;
     return std::move(w.data);
 }
@@ -0,0 +1,101 @@
+#ifndef PRESCRIPTIVISM_SHARED_STATICVECTOR_HH
+#define PRESCRIPTIVISM_SHARED_STATICVECTOR_HH
+
+#include <Shared/Utils.hh>
+
+#include <base/Base.hh>
+
+#include <algorithm>
+#include <array>
+#include <initializer_list>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+namespace pr {
+template <typename T, usz N>
+class StaticVector;
+} // namespace pr
+
+/// A vector with a fixed capacity whose elements are stored inline.
+///
+/// Unlike std::vector, this can be used in constant expressions, and
+/// it is trivially copyable if T is, so it can be part of tables that
+/// are computed at compile time.
+template <typename T, base::usz N>
+class pr::StaticVector {
+    static_assert(std::is_default_constructible_v<T>, "StaticVector requires default-constructible elements");
+    using SizeType = std::conditional_t<N <= std::numeric_limits<u8>::max(), u8, u32>;
+
+    std::array<T, N> elems{};
+    SizeType count = 0;
+
+public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    constexpr StaticVector() = default;
+    constexpr StaticVector(std::initializer_list<T> init) {
+        Assert(init.size() <= N, "Too many elements for StaticVector of size {}", N);
+        for (auto& e : init) elems[count++] = e;
+    }
+
+    /// Get the maximum number of elements.
+    [[nodiscard]] static constexpr auto capacity() -> usz { return N; }
+
+    /// Check if this is empty or full.
+    [[nodiscard]] constexpr bool empty() const { return count == 0; }
+    [[nodiscard]] constexpr bool full() const { return count == N; }
+
+    /// Get the number of elements.
+    [[nodiscard]] constexpr auto size() const -> usz { return count; }
+
+    [[nodiscard]] constexpr auto begin() -> T* { return elems.data(); }
+    [[nodiscard]] constexpr auto begin() const -> const T* { return elems.data(); }
+    [[nodiscard]] constexpr auto end() -> T* { return elems.data() + count; }
+    [[nodiscard]] constexpr auto end() const -> const T* { return elems.data() + count; }
+    [[nodiscard]] constexpr auto data() -> T* { return elems.data(); }
+    [[nodiscard]] constexpr auto data() const -> const T* { return elems.data(); }
+
+    [[nodiscard]] constexpr auto front() -> T& { return elems[0]; }
+    [[nodiscard]] constexpr auto front() const -> const T& { return elems[0]; }
+    [[nodiscard]] constexpr auto back() -> T& { return elems[count - 1]; }
+    [[nodiscard]] constexpr auto back() const -> const T& { return elems[count - 1]; }
+
+    [[nodiscard]] constexpr auto operator[](usz i) -> T& { return elems[i]; }
+    [[nodiscard]] constexpr auto operator[](usz i) const -> const T& { return elems[i]; }
+
+    /// Remove all elements.
+    constexpr void clear() { count = 0; }
+
+    /// Construct an element at the end.
+    template <typename... Args>
+    constexpr auto emplace_back(Args&&... args) -> T& {
+        Assert(not full(), "StaticVector is full");
+        return elems[count++] = T(std::forward<Args>(args)...);
+    }
+
+    /// Remove an element, keeping the order of the remaining elements.
+    constexpr auto erase(const T* pos) -> T* {
+        auto it = begin() + (pos - begin());
+        std::move(it + 1, end(), it);
+        count--;
+        return it;
+    }
+
+    /// Remove the last element.
+    constexpr void pop_back() {
+        Assert(not empty(), "StaticVector is empty");
+        count--;
+    }
+
+    /// Append an element.
+    constexpr void push_back(T t) { emplace_back(std::move(t)); }
+
+    [[nodiscard]] friend constexpr bool operator==(const StaticVector& a, const StaticVector& b) {
+        return std::ranges::equal(a, b);
+    }
+};
+
+#endif // PRESCRIPTIVISM_SHARED_STATICVECTOR_HH
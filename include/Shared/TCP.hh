@@ -2,15 +2,19 @@
 #define PRESCRIPTIVISM_SHARED_TCP_HH
 
 #include <Shared/Serialisation.hh>
+#include <Shared/Timers.hh>
 #include <Shared/Utils.hh>
 
 #include <base/Base.hh>
 
+#include <array>
 #include <bit>
 #include <cstring>
 #include <functional>
+#include <limits>
 #include <memory>
 #include <optional>
+#include <ranges>
 #include <span>
 #include <type_traits>
 #include <vector>
@@ -20,75 +24,203 @@ class TCPServerCallbacks;
 class TCPServer;
 class TCPConnexion;
 class ReceiveBuffer;
-class SendBuffer;
+class SharedFrame;
+struct ConnexionId;
+struct ConnexionStats;
+struct Frame;
+
+template <typename T>
+class ConnexionMap;
+
+namespace detail {
+using IDType = u8;
+
+/// Fill in the length of a frame that starts at 'start' and
+/// extends to the end of 'buffer'.
+[[nodiscard]] auto PatchFrameLength(std::vector<std::byte>& buffer, usz start) -> Result<>;
+
+/// Fill in the length of a frame that starts at 'start' and whose
+/// data, excluding the length prefix, is 'size' bytes long; this is
+/// for frames that don’t end with the buffer.
+[[nodiscard]] auto PatchFrameLength(std::vector<std::byte>& buffer, usz start, usz size) -> Result<>;
+} // namespace detail
 
 constexpr u16 DefaultPort = 33'014;
+
+/// Type of the length prefix of a frame.
+using FrameLength = u32;
+
+/// Size of the frame header: the length, followed by the packet id.
+constexpr usz FrameHeaderSize = sizeof(FrameLength) + sizeof(detail::IDType);
+
+/// Capacity of a connexion’s receive buffer.
+constexpr usz ReceiveBufferSize = 16'384;
+
+/// Maximum size of a frame, excluding its length prefix.
+constexpr usz MaxFrameSize = ReceiveBufferSize - sizeof(FrameLength);
+
+/// Serialise a value as a frame and append it to a buffer.
+///
+/// If the frame is too large, the buffer is left as it was.
+template <typename T>
+[[nodiscard]] auto AppendFrame(std::vector<std::byte>& buffer, const T& t, ser::Encoding encoding) -> Result<>;
+
+/// Deserialise a frame as a value of a specific type.
+template <typename T>
+auto DeserialiseFrame(const Frame& frame, ser::Encoding encoding) -> Result<T>;
+
+/// Split the first frame off a buffer that only contains complete frames.
+auto ParseFrame(ser::InputSpan& data) -> Result<Frame>;
+
+/// Serialise a value and prepend a frame length.
+template <typename T>
+auto SerialiseFrame(const T& t, ser::Encoding encoding = ser::Encoding::Fixed) -> std::vector<std::byte>;
 } // namespace pr::net
 
-/// Buffer for receiving data from a TCP connexion.
+/// Identifies a connexion within the TCPServer that manages it.
+///
+/// Ids are small integers that are reused once a connexion has been
+/// deleted; the generation tells apart different connexions that had
+/// the same index.
+struct pr::net::ConnexionId {
+    static constexpr u32 InvalidIndex = std::numeric_limits<u32>::max();
+
+    u32 index = InvalidIndex;
+    u32 generation = 0;
+
+    /// Check if this refers to a connexion at all.
+    [[nodiscard]] bool valid() const { return index != InvalidIndex; }
+
+    friend bool operator==(ConnexionId, ConnexionId) = default;
+};
+
+/// Traffic statistics of a single connexion.
+struct pr::net::ConnexionStats {
+    u64 bytes_received = 0;
+    u64 bytes_sent = 0;
+    u64 frames_received = 0;
+
+    /// Frames queued by send<T>(), as a SharedFrame, or as raw data whose
+    /// caller told send() how many frames it contains; frames nested in
+    /// an sc::Batch count individually.
+    u64 frames_sent = 0;
+
+    /// Bytes that the kernel didn’t accept during the last flush.
+    usz send_backlog = 0;
+};
+
+/// Frame received from a TCP connexion.
+///
+/// The 'data' includes the packet id, so packets can be deserialised
+/// from it directly.
+struct pr::net::Frame {
+    detail::IDType id;
+    ser::InputSpan data;
+};
+
+/// Fixed-capacity ring buffer for receiving data from a TCP connexion.
+///
+/// Data on the wire is split into frames, each of which starts with a
+/// FrameLength that counts the bytes after it, followed by the packet
+/// id; see FrameHeaderSize. Nothing is ever deserialised until a frame
+/// is complete.
 class pr::net::ReceiveBuffer {
     LIBBASE_IMMOVABLE(ReceiveBuffer);
+    friend TCPConnexion;
+    friend TCPServer;
 
-    std::span<std::byte> data;
+    static constexpr usz Mask = ReceiveBufferSize - 1;
+    static_assert(std::has_single_bit(ReceiveBufferSize), "Buffer size must be a power of two");
 
-public:
-    ReceiveBuffer(std::vector<std::byte>& buffer) : data(buffer) {}
+    /// The actual buffer.
+    std::unique_ptr<std::byte[]> storage;
 
-    /// Check if the buffer is empty.
-    [[nodiscard]] auto empty() const -> bool { return data.empty(); }
+    /// Copy of the current frame if it wraps around the end of the
+    /// buffer. This is only allocated once we actually need it.
+    std::unique_ptr<std::byte[]> wrapped_frame;
 
-    /// \see read().
-    [[nodiscard]] auto peek(usz n) -> std::span<std::byte> {
-        if (n > data.size()) return {};
-        return data.subspan(0, n);
-    }
+    /// Total number of bytes read and written; the difference is
+    /// the number of bytes in the buffer.
+    u64 read_pos = 0;
+    u64 write_pos = 0;
 
-    /// \see read().
-    template <typename T>
-    requires std::is_trivially_copyable_v<T> and std::is_default_constructible_v<T>
-    auto peek() -> std::optional<T> {
-        if (data.size() < sizeof(T)) return std::nullopt;
-        auto n = peek(sizeof(T));
-        T result;
-        std::memcpy(&result, n.data(), sizeof(T));
-        return result;
-    }
+    /// The current frame, if we’ve already found it to be complete.
+    std::optional<Frame> current;
 
-    /// Read data from the buffer and discard it.
-    ///
-    /// If there are fewer bytes in the buffer than requested,
-    /// nothing is read and the remains unchanged. Otherwise,
-    /// \p n bytes are removed from the start of the buffer and
-    /// returned.
+    /// Number of frames that have been dropped so far.
+    u64 frames_read = 0;
+
+    /// The encoding the peer uses; this is shared by both directions
+    /// of the connexion.
+    Readonly(ser::Encoding, encoding);
+
+public:
+    ReceiveBuffer();
+
+    /// Copy data into the buffer as though it had been received, e.g.
+    /// to replay recorded traffic.
     ///
-    /// \param n The number of bytes to read.
-    [[nodiscard]] auto read(usz n) -> std::span<std::byte> {
-        if (n > data.size()) return {};
-        auto result = data.subspan(0, n);
-        data = data.subspan(n);
-        return result;
-    }
+    /// \return The number of bytes that fit into the buffer.
+    auto append(ser::InputSpan data) -> usz;
+
+    /// Drop the frame returned by peek_frame().
+    void drop_frame();
 
-    /// As read(), but attempts to read a value of a specific type
-    /// instead, returning an empty optional if there are not enough
-    /// bytes in the buffer.
+    /// Check if the buffer is empty.
+    [[nodiscard]] auto empty() const -> bool { return size() == 0; }
+
+    /// Get the next frame, if it has been received completely.
+    ///
+    /// This returns an error if the frame header is invalid, in which
+    /// case the connexion should be closed since we have no way of
+    /// finding the start of the next frame.
+    [[nodiscard]] auto peek_frame() -> Result<std::optional<Frame>>;
+
+    /// Deserialise the next frame as a value of a specific type and
+    /// drop it. This must only be called after peek_frame() returned
+    /// a frame.
     template <typename T>
-    [[nodiscard]] auto read() -> std::optional<T> {
-        static_assert(
-            requires (T t, ser::Reader& r) { r >> t; },
-            "Type must be serialisable"
-        );
-
-        T res;
-        ser::Reader reader{data};
-        reader >> res;
-        if (not reader) return std::nullopt;
-        data = data.subspan(data.size() - reader.size());
-        return res;
+    [[nodiscard]] auto read() -> Result<T> {
+        Assert(current.has_value(), "No frame to read");
+        defer { drop_frame(); };
+        return DeserialiseFrame<T>(*current, encoding);
     }
 
     /// How many bytes are in the buffer.
-    [[nodiscard]] auto size() const -> usz { return data.size(); }
+    [[nodiscard]] auto size() const -> usz { return usz(write_pos - read_pos); }
+
+private:
+    /// Mark 'n' bytes after the write position as written.
+    void Commit(usz n) { write_pos += n; }
+
+    /// Copy data at a position out of the buffer.
+    void CopyOut(void* into, u64 pos, usz n) const;
+
+    /// Get the parts of the buffer that we can write to; the
+    /// second span is empty if we do not wrap around.
+    auto WritableRegions() -> std::array<std::span<std::byte>, 2>;
+};
+
+/// An immutable, serialised frame that can be queued on any number
+/// of connexions; it is serialised only once and shared by all of
+/// their send queues.
+///
+/// A frame can only be sent to connexions that use the encoding it
+/// was serialised with.
+class pr::net::SharedFrame {
+    friend TCPConnexion;
+    std::shared_ptr<const std::vector<std::byte>> data;
+    ser::Encoding encoding;
+
+public:
+    /// Serialise a packet into a frame.
+    template <typename T>
+    explicit SharedFrame(const T& packet, ser::Encoding encoding = ser::Encoding::Fixed)
+        : data(std::make_shared<const std::vector<std::byte>>(SerialiseFrame(packet, encoding))),
+          encoding(encoding) {}
+
+    /// Get the serialised frame, including its length prefix.
+    [[nodiscard]] auto bytes() const -> std::span<const std::byte> { return *data; }
 };
 
 /// Class that implements common functionality for TCP server
@@ -107,13 +239,18 @@ public:
     /// to send data to the client before returning.
     virtual bool accept(TCPConnexion& connexion) = 0;
 
-    /// Called from TCPServer::receive().
+    /// Called from TCPServer::poll() when data arrives on a connexion.
     ///
     /// \param connexion The connexion that sent the data.
     /// \param data A buffer that contains any unprocessed data since
     /// the last call to receive(). The buffer should be updated to
     /// remove any data that has been processed.
     virtual void receive(TCPConnexion& connexion, ReceiveBuffer& data) = 0;
+
+    /// Called from TCPServer::update_connexions() for every connexion
+    /// that has been closed, right before its id is freed; this is not
+    /// called for connexions that were released.
+    virtual void closed(ConnexionId) {}
 };
 
 /// A reference type that holds a TCP connexion that can be
@@ -134,6 +271,16 @@ class pr::net::TCPConnexion {
     /// The address of the remote peer.
     ComputedReadonly(std::string_view, address);
 
+    /// The encoding used for packets in both directions.
+    ComputedReadonly(ser::Encoding, encoding);
+
+    /// The id of this connexion in the server that manages it; this
+    /// is invalid if there is none.
+    ComputedReadonly(ConnexionId, id);
+
+    /// How much data has gone through this connexion.
+    ComputedReadonly(ConnexionStats, stats);
+
 public:
     TCPConnexion();
     ~TCPConnexion();
@@ -147,15 +294,28 @@ public:
     /// Close the connexion.
     void disconnect();
 
+    /// Send any queued data to the remote peer.
+    ///
+    /// Connexions that belong to a TCPServer are flushed by the next
+    /// call to TCPServer::poll() after they queue data, so this only
+    /// needs to be called manually for connexions used on their own.
+    void flush();
+
     /// Receive data from the remote peer.
     void receive(std::function<void(ReceiveBuffer&)> callback);
 
-    /// Send data to the remote peer.
+    /// Queue data to be sent to the remote peer.
+    ///
+    /// Nothing is sent until the connexion is flushed.
     template <typename T>
     void send(const T& t) {
-        // Type requires serialisation.
+        // Type requires serialisation. Serialise it straight into
+        // the send queue.
         if constexpr (requires (T t, ser::Writer& s) { s << t; }) {
-            send(std::span<const std::byte>{ser::Serialise(t)});
+            if (disconnected) return;
+            auto& buffer = QueueBuffer(sizeof(FrameLength) + ser::SerialisedSize(t, encoding));
+            if (auto res = AppendFrame(buffer, t, encoding); not res)
+                Log<LogLevel::Warning>("Not sending packet to {}: {}", address, res.error());
         }
 
         // Type can be sent as-is.
@@ -169,10 +329,29 @@ public:
         }
     }
 
-    /// Send data to the remote peer.
-    void send(std::span<const std::byte> data);
+    /// Queue raw data to be sent to the remote peer.
+    ///
+    /// The data is sent as-is, so it must already be framed if the
+    /// peer expects frames; 'frames' is how many of them it contains,
+    /// and is only used for the statistics.
+    void send(std::span<const std::byte> data, usz frames = 0);
+
+    /// Queue a frame that may also be sent to other peers.
+    void send(const SharedFrame& frame);
+
+    /// Switch to a different encoding once both peers have agreed on it.
+    ///
+    /// This affects every packet sent after this call, as well as every
+    /// frame that has not been read yet.
+    void set_encoding(ser::Encoding encoding);
 
     friend auto operator<=>(const TCPConnexion&, const TCPConnexion&) = default;
+
+private:
+    /// Get the buffer at the end of the send queue that new data
+    /// should be appended to; it has room for at least 'size' more
+    /// bytes without reallocating.
+    auto QueueBuffer(usz size) -> std::vector<std::byte>&;
 };
 
 /// A reference type that holds a TCP server that can accept
@@ -184,27 +363,187 @@ public:
     /// Create a server socket that listens on the given port.
     static auto Create(u16 port, u32 max_connexions) -> Result<TCPServer>;
 
+    /// Create a server that does not listen on any port. Connexions
+    /// are instead handed to it via adopt(). This is useful to run
+    /// an event loop for connexions accepted by another server.
+    static auto CreateDetached() -> Result<TCPServer>;
+
+    /// Take over a connexion that was released by another server.
+    ///
+    /// This assigns the connexion a new id. If the connexion has any
+    /// unprocessed data, the next call to poll() passes it to
+    /// TCPServerCallbacks::receive().
+    void adopt(TCPConnexion conn);
+
     /// Get the connexions that we have accepted.
     auto connexions() -> std::span<TCPConnexion>;
 
-    /// Receive data from existing connexions. Calls
-    /// TCPEventHandler::Receive() with the data.
-    void receive();
+    /// Wait until a new connexion can be accepted or data arrives on
+    /// an existing connexion, or until the timeout expires or the next
+    /// timer is due, whichever happens first; then accepts all pending
+    /// connexions, calls TCPServerCallbacks::receive() for every
+    /// connexion that has data, and runs every timer that is due.
+    ///
+    /// Before waiting, this flushes every connexion that has queued
+    /// data, so everything sent since the last call goes out together.
+    ///
+    /// A timeout of chr::milliseconds::max() means wait indefinitely.
+    void poll(chr::milliseconds timeout = chr::milliseconds::max());
 
     /// Get the server port.
     auto port() const -> u16;
 
+    /// Stop managing a connexion without closing it, e.g. to
+    /// hand it to another server via adopt().
+    ///
+    /// This must not be called from within receive() for the
+    /// same connexion.
+    void release(const TCPConnexion& conn);
+
     /// Set the server callback handler.
     void set_callbacks(TCPServerCallbacks& callbacks);
 
-    /// Accept incoming connexions and throw away any that have
-    /// gone stale. If there is an error with a connexion, it
-    /// is logged and the connexion is thrown away.
+    /// Get the timers that are run by poll().
     ///
-    /// Any references to connexions that have been closed must
-    /// be cleaned up before this is called, as this deletes any
-    /// closed connexions.
+    /// Timers go off after any network activity that was already
+    /// waiting has been processed; they must only be used by the
+    /// thread that calls poll().
+    auto timers() -> TimerWheel&;
+
+    /// Throw away any connexions that have gone stale.
+    ///
+    /// This frees the ids of connexions that have been closed since
+    /// the last call, so they may be reused for new connexions; see
+    /// ConnexionMap.
     void update_connexions();
+
+    /// Interrupt a call to poll() that is currently in progress, or
+    /// make the next call return immediately if there isn’t one.
+    ///
+    /// Unlike every other function here, it is safe to call this
+    /// from any thread.
+    void wake();
+};
+
+/// A map from the connexions of a single TCPServer to values.
+///
+/// Lookups are a single array access, and entries for connexions that
+/// have been deleted are never found again, even if their index has
+/// been reused, so there is no need to remove them explicitly.
+template <typename T>
+class pr::net::ConnexionMap {
+    struct Entry {
+        u32 generation = 0;
+        std::optional<T> value;
+    };
+
+    std::vector<Entry> entries;
+    usz count = 0;
+
+public:
+    /// Remove the value for a connexion, if there is one.
+    void erase(ConnexionId id) {
+        if (not find(id)) return;
+        entries[id.index].value.reset();
+        count--;
+    }
+
+    /// Remove all values that match a predicate.
+    void erase_if(auto pred) {
+        for (auto& e : entries) {
+            if (e.value and pred(*e.value)) {
+                e.value.reset();
+                count--;
+            }
+        }
+    }
+
+    /// Get the value for a connexion, or nullptr if there is none.
+    [[nodiscard]] auto find(ConnexionId id) -> T* {
+        if (id.index >= entries.size()) return nullptr;
+        auto& e = entries[id.index];
+        if (e.generation != id.generation or not e.value) return nullptr;
+        return &*e.value;
+    }
+
+    /// Set the value for a connexion.
+    void insert(ConnexionId id, T value) {
+        Assert(id.valid(), "Connexion is not managed by a server");
+        if (id.index >= entries.size()) entries.resize(id.index + 1);
+        auto& e = entries[id.index];
+        if (not e.value) count++;
+        e.generation = id.generation;
+        e.value = std::move(value);
+    }
+
+    /// Get the number of values in the map.
+    ///
+    /// Note that this includes entries for deleted connexions that
+    /// have not been overwritten yet.
+    [[nodiscard]] auto size() const -> usz { return count; }
+
+    /// Iterate over all values in the map.
+    auto values(this auto&& self) {
+        return self.entries
+             | vws::filter([](auto& e) { return e.value.has_value(); })
+             | vws::transform([](auto& e) -> auto& { return *e.value; });
+    }
 };
 
+inline auto pr::net::detail::PatchFrameLength(std::vector<std::byte>& buffer, usz start) -> Result<> {
+    return PatchFrameLength(buffer, start, buffer.size() - start - sizeof(FrameLength));
+}
+
+inline auto pr::net::detail::PatchFrameLength(std::vector<std::byte>& buffer, usz start, usz size) -> Result<> {
+    if (size > MaxFrameSize) return Error("Frame too large: {}", size);
+    auto len = FrameLength(size);
+    if constexpr (std::endian::native != std::endian::little) len = std::byteswap(len);
+    std::memcpy(buffer.data() + start, &len, sizeof(FrameLength));
+    return {};
+}
+
+template <typename T>
+auto pr::net::AppendFrame(std::vector<std::byte>& buffer, const T& t, ser::Encoding encoding) -> Result<> {
+    auto start = buffer.size();
+    ser::Writer w{buffer, encoding};
+    w << FrameLength(0) << t;
+    if (auto res = detail::PatchFrameLength(buffer, start); not res) {
+        buffer.resize(start);
+        return res;
+    }
+
+    return {};
+}
+
+template <typename T>
+auto pr::net::DeserialiseFrame(const Frame& frame, ser::Encoding encoding) -> Result<T> {
+    static_assert(
+        requires (T t, ser::Reader& r) { r >> t; },
+        "Type must be serialisable"
+    );
+
+    T res;
+    ser::Reader reader{frame.data, encoding};
+    reader >> res;
+    Try(reader.result);
+    if (reader.size() != 0) return Error(
+        "Frame has {} trailing bytes after packet {}",
+        reader.size(),
+        frame.id
+    );
+
+    return res;
+}
+
+template <typename T>
+auto pr::net::SerialiseFrame(const T& t, ser::Encoding encoding) -> std::vector<std::byte> {
+    std::vector<std::byte> buffer;
+    buffer.reserve(sizeof(FrameLength) + ser::SerialisedSize(t, encoding));
+
+    // Nothing we serialise on our own should ever be this large.
+    auto res = AppendFrame(buffer, t, encoding);
+    Assert(res.has_value(), "{}", res.error());
+    return buffer;
+}
+
 #endif // PRESCRIPTIVISM_SHARED_TCP_HH
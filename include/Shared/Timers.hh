@@ -0,0 +1,117 @@
+#ifndef PRESCRIPTIVISM_SHARED_TIMERS_HH
+#define PRESCRIPTIVISM_SHARED_TIMERS_HH
+
+#include <Shared/Utils.hh>
+
+#include <base/Base.hh>
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+namespace pr {
+class TimerWheel;
+struct TimerId;
+} // namespace pr
+
+/// Refers to a timer; this stays valid (but does nothing) after the
+/// timer has fired or been cancelled.
+struct pr::TimerId {
+    u32 index = 0;
+    u32 generation = 0;
+
+    /// Whether this refers to a timer at all.
+    [[nodiscard]] explicit operator bool() const { return generation != 0; }
+};
+
+/// A hierarchical timer wheel.
+///
+/// Every level has 64 slots, and the slots of each level are 64 times
+/// as long as those of the level below it; the first level has one slot
+/// per millisecond. Timers are put into the lowest level that covers
+/// their deadline and move down a level every time the wheel reaches
+/// the slot they are in, so scheduling and cancelling a timer are O(1),
+/// and advancing the wheel only touches slots that contain timers.
+///
+/// Timers go off no earlier than their deadline, and usually within a
+/// millisecond of it. This is not thread-safe; a wheel belongs to the
+/// thread that runs its event loop.
+class pr::TimerWheel {
+    LIBBASE_IMMOVABLE(TimerWheel);
+
+public:
+    using Clock = chr::steady_clock;
+    using Callback = std::function<void()>;
+
+private:
+    static constexpr usz SlotBits = 6;
+    static constexpr usz Slots = 1 << SlotBits;
+    static constexpr usz Levels = 6;
+
+    /// Used as a list index for slots and the list that is being run.
+    static constexpr u32 Firing = u32(Levels * Slots);
+    static constexpr u32 None = ~0u;
+
+    struct Timer {
+        Callback callback;
+        u64 deadline = 0;
+        u32 prev = None;
+        u32 next = None;
+        u32 list = None;
+        u32 generation = 1;
+    };
+
+    /// All timers, including unused ones, which form a free list.
+    std::vector<Timer> timers;
+    u32 free_list = None;
+    usz active = 0;
+
+    /// The first timer in every slot, and in the list that is being run.
+    std::array<u32, Levels * Slots + 1> heads;
+
+    /// Which slots of each level contain timers.
+    std::array<u64, Levels> occupied{};
+
+    /// The wheel counts milliseconds since this.
+    const Clock::time_point epoch;
+
+    /// The millisecond we have advanced to.
+    u64 now = 0;
+
+public:
+    explicit TimerWheel(Clock::time_point start = Clock::now());
+
+    /// Run every timer whose deadline has passed.
+    void advance(Clock::time_point t = Clock::now());
+
+    /// Cancel a timer, if it hasn’t gone off yet.
+    ///
+    /// \return Whether the timer was still pending.
+    bool cancel(TimerId id);
+
+    /// Get how long we can wait until advance() has something to do,
+    /// or chr::milliseconds::max() if there are no timers.
+    [[nodiscard]] auto next_timeout(Clock::time_point t = Clock::now()) const -> chr::milliseconds;
+
+    /// Call a function once some time has passed.
+    auto schedule(Clock::duration delay, Callback cb) -> TimerId {
+        return schedule_at(Clock::now() + delay, std::move(cb));
+    }
+
+    /// Call a function at some point in time.
+    auto schedule_at(Clock::time_point deadline, Callback cb) -> TimerId;
+
+    /// Get the number of pending timers.
+    [[nodiscard]] auto size() const -> usz { return active; }
+
+private:
+    void Cascade(usz level);
+    void Free(u32 index);
+    void Insert(u32 index);
+    void Link(u32 index, u32 list);
+    auto NextEvent(bool include_current) const -> u64;
+    void Unlink(u32 index);
+};
+
+#endif // PRESCRIPTIVISM_SHARED_TIMERS_HH
@@ -1,6 +1,8 @@
 #ifndef PRESCRIPTIVISM_SHARED_UTILS_HH
 #define PRESCRIPTIVISM_SHARED_UTILS_HH
 
+#include <Shared/Log.hh>
+
 #include <base/Base.hh>
 
 #include <chrono>
@@ -45,20 +47,8 @@ bool Empty(Range&& range) {
     }
 }
 
-struct SilenceLog {
-    LIBBASE_IMMOVABLE(SilenceLog);
-    SilenceLog();
-    ~SilenceLog();
-};
-
-template <typename... Args>
-void Log(std::format_string<Args...> fmt, Args&&... args);
 } // namespace pr
 
-namespace pr {
-void LogImpl(std::string);
-}
-
 template <typename T>
 struct pr::Debug {
     T* value;
@@ -228,11 +218,6 @@ public:
     auto c_str() const -> const char* { return data.data(); }
 };
 
-template <typename... Args>
-void pr::Log(std::format_string<Args...> fmt, Args&&... args) {
-    pr::LogImpl(std::format(fmt, std::forward<Args>(args)...));
-}
-
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wformat-nonliteral"
 template <typename T>
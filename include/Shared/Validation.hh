@@ -5,8 +5,17 @@
 #include <Shared/Constants.hh>
 #include <Shared/Utils.hh>
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cmath>
+#include <concepts>
+#include <cstdlib>
+#include <limits>
+#include <optional>
+#include <ranges>
 #include <span>
+#include <vector>
 
 namespace pr::validation {
 enum struct InitialWordValidationResult {
@@ -16,7 +25,7 @@ enum struct InitialWordValidationResult {
     BadInitialClusterManner,
     BadInitialClusterCoordinates,
 };
-enum struct PlaySoundCardValidationResult {
+enum struct PlaySoundCardValidationResult : u8 {
     Valid,
     NeedsOtherCard,
     Invalid,
@@ -35,6 +44,50 @@ concept WordValidator = requires (const T& t, usz idx) {
 
 auto ValidateInitialWord(constants::Word word, constants::Word original) -> InitialWordValidationResult;
 
+namespace detail {
+using SoundChangeTableType = std::array<std::array<PlaySoundCardValidationResult, +CardIdValue::$$Count>, +CardIdValue::$$Count>;
+
+/// Compute whether a card can be played on another, ignoring the
+/// rest of the word.
+consteval auto ComputeSoundChangeTable() -> SoundChangeTableType {
+    using enum PlaySoundCardValidationResult;
+    SoundChangeTableType table{};
+    for (auto& on : CardDatabase) {
+        for (auto& played : CardDatabase) {
+            auto& entry = table[+on.id][+played.id];
+            entry = Invalid;
+
+            // Is this a special sound change? If so yes
+            auto change = rgs::find_if(on.converts_to, [&](auto& c) { return c[0] == played.id; });
+            if (change != on.converts_to.end()) {
+                entry = change->size() > 1 ? NeedsOtherCard : Valid;
+                continue;
+            }
+
+            // Is this an adjacent phoneme or a different phoneme with the same coordinates?
+            auto d1 = std::abs(played.place_or_frontness - on.place_or_frontness);
+            auto d2 = std::abs(played.manner_or_height - on.manner_or_height);
+            if (
+                played.id.is_consonant() == on.id.is_consonant() and
+                d1 + d2 < 2 and
+                played.id != on.id
+            ) entry = Valid;
+        }
+    }
+    return table;
+}
+
+/// Whether a card can be played on another, indexed by the card that
+/// is played on and then the card that is played.
+inline constexpr SoundChangeTableType SoundChangeTable = ComputeSoundChangeTable();
+
+static_assert(SoundChangeTable[+CardIdValue::C_p][+CardIdValue::C_m] == PlaySoundCardValidationResult::Valid);
+static_assert(SoundChangeTable[+CardIdValue::C_w][+CardIdValue::V_u] == PlaySoundCardValidationResult::NeedsOtherCard);
+static_assert(SoundChangeTable[+CardIdValue::C_p][+CardIdValue::C_b] == PlaySoundCardValidationResult::Valid);
+static_assert(SoundChangeTable[+CardIdValue::C_p][+CardIdValue::C_p] == PlaySoundCardValidationResult::Invalid);
+static_assert(SoundChangeTable[+CardIdValue::C_p][+CardIdValue::V_i] == PlaySoundCardValidationResult::Invalid);
+} // namespace detail
+
 template <WordValidator T>
 auto ValidatePlaySoundCard(CardId played, const T& on, usz at) -> PlaySoundCardValidationResult {
     using enum PlaySoundCardValidationResult;
@@ -49,21 +102,8 @@ auto ValidatePlaySoundCard(CardId played, const T& on, usz at) -> PlaySoundCardV
         ((at > 0 and on[at - 1] == played) or (at < on.size() - 1 and on[at + 1] == played))
     ) return Valid;
 
-    // Is this a special sound change? If so yes
-    for (auto& c : CardDatabase[+on[at]].converts_to)
-        if (played == c[0]) return c.size() > 1 ? NeedsOtherCard : Valid;
-
-    // Is this an adjacent phoneme or a different phoneme with the same coordinates?
-    auto d1 = std::abs(CardDatabase[+played].place_or_frontness - CardDatabase[+on[at]].place_or_frontness);
-    auto d2 = std::abs(CardDatabase[+played].manner_or_height - CardDatabase[+on[at]].manner_or_height);
-    if (
-        played.is_consonant() == on[at].is_consonant() and
-        d1 + d2 < 2 and
-        played != on[at]
-    ) return Valid;
-
-    // Otherwise, no.
-    return Invalid;
+    // Everything else only depends on the two cards.
+    return detail::SoundChangeTable[+on[at]][+played];
 }
 
 /// Returns whether the spelling reform is valid.
@@ -73,6 +113,129 @@ bool ValidateP_SpellingReform(const T& on, usz at) {
     // on a stack that is not already locked.
     return on.is_own_word() and not on.stack_is_locked(at);
 }
+
+// =============================================================================
+//  Move Enumeration
+// =============================================================================
+/// A set of stacks in a word; bit 'i' stands for stack 'i'.
+using StackMask = u64;
+
+/// The largest word that EnumerateMoves() can handle.
+constexpr usz MaxStacks = std::numeric_limits<StackMask>::digits;
+
+/// A move, as found by EnumerateMoves().
+struct Move {
+    usz card;   ///< Index of the card in the hand.
+    usz word;   ///< Index of the word that the card is played on.
+    usz stack;  ///< Index of the stack in that word.
+};
+
+/// Every legal move for a hand.
+class MoveSet {
+    /// One mask per card and word, indexed by 'card * words + word'.
+    std::vector<StackMask> masks;
+    usz words;
+
+public:
+    MoveSet(usz cards, usz words) : masks(cards * words), words(words) {}
+
+    /// Check if there are no legal moves.
+    [[nodiscard]] bool empty() const { return rgs::all_of(masks, [](StackMask m) { return m == 0; }); }
+
+    /// Get the first move, in order of cards, then words, then stacks.
+    [[nodiscard]] auto first() const -> std::optional<Move> {
+        for (auto [i, m] : masks | vws::enumerate)
+            if (m) return Move{usz(i) / words, usz(i) % words, usz(std::countr_zero(m))};
+        return std::nullopt;
+    }
+
+    /// Call a function for every legal move.
+    template <typename Callback>
+    void for_each(Callback cb) const {
+        for (auto [i, m] : masks | vws::enumerate)
+            for (auto bits = m; bits; bits &= bits - 1)
+                cb(Move{usz(i) / words, usz(i) % words, usz(std::countr_zero(bits))});
+    }
+
+    /// Get the nth move, in the same order as for_each().
+    [[nodiscard]] auto nth(usz n) const -> Move {
+        for (auto [i, m] : masks | vws::enumerate) {
+            if (auto count = usz(std::popcount(m)); n >= count) {
+                n -= count;
+                continue;
+            }
+
+            auto bits = m;
+            for (; n; n--) bits &= bits - 1;
+            return Move{usz(i) / words, usz(i) % words, usz(std::countr_zero(bits))};
+        }
+
+        Unreachable("Move index out of bounds");
+    }
+
+    /// Set the stacks that a card can be played on.
+    void set(usz card, usz word, StackMask stacks) { masks[card * words + word] = stacks; }
+
+    /// Get the number of legal moves.
+    [[nodiscard]] auto size() const -> usz {
+        usz n = 0;
+        for (auto m : masks) n += usz(std::popcount(m));
+        return n;
+    }
+
+    /// Get the stacks of a word that a card can be played on.
+    [[nodiscard]] auto targets(usz card, usz word) const -> StackMask { return masks[card * words + word]; }
+};
+
+/// Find every legal move for a hand at once.
+///
+/// This is equivalent to calling ValidatePlaySoundCard() (and looking
+/// only for Valid results) or ValidateP_SpellingReform() for every card,
+/// word, and stack, but each word is only read once, and every check is
+/// done for all stacks of a word at the same time.
+template <WordValidator T>
+auto EnumerateMoves(std::span<const CardId> hand, std::span<const T> words) -> MoveSet {
+    using enum PlaySoundCardValidationResult;
+    MoveSet moves{hand.size(), words.size()};
+    for (auto [w, word] : words | vws::enumerate) {
+        auto n = word.size();
+        Assert(n <= MaxStacks, "Word too long: {}", n);
+
+        // Read the word once.
+        std::array<CardId, MaxStacks> tops;
+        StackMask open = 0, unlocked = 0, special = 0;
+        for (usz s = 0; s < n; s++) {
+            tops[s] = word[s];
+            bool locked = word.stack_is_locked(s);
+            open |= StackMask(not locked and not word.stack_is_full(s)) << s;
+            unlocked |= StackMask(not locked) << s;
+            special |= StackMask(tops[s] == CardId::C_h or tops[s] == CardId::V_ə) << s;
+        }
+
+        const StackMask in_word = n == MaxStacks ? ~StackMask(0) : (StackMask(1) << n) - 1;
+        const bool own = word.is_own_word();
+        for (auto [c, card] : hand | vws::enumerate) {
+            StackMask targets = 0;
+            if (card.is_sound()) {
+                // Special sounds also accept their neighbours.
+                StackMask same = 0, valid = 0;
+                for (usz s = 0; s < n; s++) {
+                    same |= StackMask(tops[s] == card) << s;
+                    valid |= StackMask(detail::SoundChangeTable[+tops[s]][+card] == Valid) << s;
+                }
+
+                auto neighbours = ((same << 1) | (same >> 1)) & in_word;
+                targets = (valid | (special & neighbours)) & open;
+            } else if (card == CardId::P_SpellingReform and own) {
+                targets = unlocked;
+            }
+
+            moves.set(usz(c), usz(w), targets);
+        }
+    }
+
+    return moves;
+}
 } // namespace pr::validation
 
 #endif // PRESCRIPTIVISM_SHARED_VALIDATION_HH
@@ -0,0 +1,158 @@
+#ifndef PRESCRIPTIVISM_SIM_SIM_HH
+#define PRESCRIPTIVISM_SIM_SIM_HH
+
+#include <Shared/Constants.hh>
+#include <Shared/GameState.hh>
+#include <Shared/Random.hh>
+#include <Shared/Utils.hh>
+
+#include <base/Base.hh>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace pr::sim {
+class Pool;
+struct BatchResult;
+struct GameOptions;
+struct GameResult;
+struct SearchOptions;
+
+/// How a seat picks its moves.
+enum struct Policy : u8 {
+    /// Play a random legal card, or discard a random card if there is none.
+    Random,
+
+    /// Pick the move that wins most random playouts.
+    MonteCarlo,
+};
+
+/// Pick the move with the best outcome over random playouts from the
+/// current state; the same seed always yields the same move.
+auto ChooseAction(const GameState& g, const SearchOptions& opts, Pool& pool, u64 seed) -> rules::Action;
+
+/// Replace everything the current player can’t see, i.e. the deck and
+/// the other players’ hands, with a random arrangement of the same cards.
+auto Determinise(const GameState& g, PlayerId viewer, Rng& rng) -> GameState;
+
+/// Score a finished game.
+auto Finish(const GameState& g) -> GameResult;
+
+/// Set up and play a whole game.
+auto PlayGame(const GameOptions& opts, u64 seed, Pool& pool) -> GameResult;
+
+/// Play random moves until the game is over.
+auto Playout(GameState g, Rng& rng) -> GameResult;
+
+/// Pick a random action for the current player.
+auto RandomAction(const GameState& g, Rng& rng) -> rules::Action;
+
+/// Play a number of games in parallel and collect statistics. Game 'i'
+/// is seeded with MixSeed(seed, i), so the results don’t depend on the
+/// number of threads.
+auto RunBatch(const GameOptions& opts, usz games, u64 seed, Pool& pool) -> BatchResult;
+
+/// Get a player’s score.
+///
+/// The rules don’t say who wins yet; until they do, a player scores a
+/// point for every stack of their word that still only holds the sound
+/// it started with, and the player with the most points wins.
+auto Score(const GameState& g, PlayerId p) -> u32;
+} // namespace pr::sim
+
+/// Settings for ChooseAction().
+struct pr::sim::SearchOptions {
+    /// Playouts per candidate move.
+    usz playouts = 64;
+
+    /// Let the search see the deck and the other players’ hands.
+    bool cheat = false;
+};
+
+/// Settings for a simulated game.
+struct pr::sim::GameOptions {
+    /// How each seat plays; seat 0 moves first.
+    std::array<Policy, constants::PlayersPerGame> seats{};
+
+    /// Settings for seats that search.
+    SearchOptions search;
+
+    /// The number of copies of each card in the deck.
+    DeckCounts counts = DefaultDeckCounts;
+};
+
+/// The outcome of a game.
+struct pr::sim::GameResult {
+    std::array<u32, constants::PlayersPerGame> scores{};
+
+    /// The number of turns the game lasted.
+    u32 turns = 0;
+
+    /// The winner, if there is one.
+    std::optional<PlayerId> winner;
+};
+
+/// Statistics about a number of games.
+struct pr::sim::BatchResult {
+    std::array<usz, constants::PlayersPerGame> wins{};
+    usz draws = 0;
+
+    /// The length of every game, in turns, sorted.
+    std::vector<u32> turns;
+};
+
+/// A thread pool for CPU-bound work.
+///
+/// Every worker has its own queue, to which it adds the tasks it
+/// creates and from which it takes the most recent one first, so
+/// nested work stays on the same core. Workers that run out of work
+/// steal the oldest tasks from other queues.
+class pr::sim::Pool {
+    LIBBASE_IMMOVABLE(Pool);
+
+    using Task = std::function<void()>;
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    /// One queue per worker, and one for other threads.
+    std::vector<std::unique_ptr<Queue>> queues;
+
+    /// Tasks that are in a queue; this is only incremented while
+    /// holding the mutex below so waiting threads can’t miss any.
+    std::atomic<usz> queued = 0;
+    std::mutex mutex;
+    std::condition_variable_any changed;
+
+    // The workers MUST be the last member of this class so they are
+    // joined before anything they touch is destroyed.
+    std::vector<std::jthread> workers;
+
+public:
+    /// Start a pool; 0 means one thread per core.
+    explicit Pool(usz threads = 0);
+
+    /// Get the number of worker threads.
+    [[nodiscard]] auto threads() const -> usz { return workers.size(); }
+
+    /// Call a function for every index in [0, n) and wait for all calls
+    /// to finish. The calling thread helps out while waiting, so this
+    /// may be nested.
+    void parallel_for(usz n, const std::function<void(usz)>& body);
+
+private:
+    auto Pop() -> std::optional<Task>;
+    void Push(Task t);
+    void Run(std::stop_token stop, usz index);
+};
+
+#endif // PRESCRIPTIVISM_SIM_SIM_HH
@@ -0,0 +1,125 @@
+#include <Bench/Bench.hh>
+
+#include <algorithm>
+#include <format>
+#include <numeric>
+#include <print>
+#include <thread>
+
+using namespace pr;
+using namespace pr::bench;
+
+// =============================================================================
+//  Results
+// =============================================================================
+auto Result::median() const -> f64 {
+    auto n = ns_per_item.size();
+    return n % 2 ? ns_per_item[n / 2] : (ns_per_item[n / 2 - 1] + ns_per_item[n / 2]) / 2;
+}
+
+auto Result::mean() const -> f64 {
+    return std::reduce(ns_per_item.begin(), ns_per_item.end()) / f64(ns_per_item.size());
+}
+
+namespace {
+void AppendJSONString(std::string& out, std::string_view s) {
+    out += '"';
+    for (char c : s) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            default:
+                if (u8(c) < 0x20) std::format_to(std::back_inserter(out), "\\u{:04x}", u8(c));
+                else out += c;
+        }
+    }
+    out += '"';
+}
+} // namespace
+
+auto bench::ToJSON(std::span<const Result> results, const RunOptions& opts) -> std::string {
+    std::string out;
+    auto now = chr::floor<chr::seconds>(chr::system_clock::now());
+    std::format_to(
+        std::back_inserter(out),
+        "{{\n"
+        "  \"context\": {{\n"
+        "    \"date\": \"{:%FT%TZ}\",\n"
+        "    \"threads\": {},\n"
+        "    \"min_time_ms\": {},\n"
+        "    \"repetitions\": {}\n"
+        "  }},\n"
+        "  \"benchmarks\": [",
+        now,
+        std::thread::hardware_concurrency(),
+        opts.min_time.count(),
+        opts.repetitions
+    );
+
+    for (auto [i, r] : results | vws::enumerate) {
+        out += i == 0 ? "\n    {\"name\": " : ",\n    {\"name\": ";
+        AppendJSONString(out, r.name);
+        std::format_to(
+            std::back_inserter(out),
+            ", \"iterations\": {}, \"items_per_iteration\": {}, "
+            "\"ns_per_item\": {{\"min\": {:.3f}, \"median\": {:.3f}, \"mean\": {:.3f}, \"max\": {:.3f}}}, "
+            "\"items_per_second\": {:.1f}}}",
+            r.iterations,
+            r.items,
+            r.min(),
+            r.median(),
+            r.mean(),
+            r.max(),
+            1e9 / r.median()
+        );
+    }
+
+    out += "\n  ]\n}\n";
+    return out;
+}
+
+// =============================================================================
+//  Suite
+// =============================================================================
+void Suite::add(std::string name, Body body, u64 items) {
+    Assert(items != 0, "Benchmark must process at least one item");
+    benchmarks.emplace_back(std::move(name), items, std::move(body));
+}
+
+auto Suite::run(const RunOptions& opts) -> std::vector<Result> {
+    auto Time = [](const Body& body, u64 iterations) {
+        auto start = chr::steady_clock::now();
+        body(iterations);
+        return chr::duration<f64, std::nano>(chr::steady_clock::now() - start);
+    };
+
+    std::vector<Result> results;
+    for (auto& b : benchmarks) {
+        if (not b.name.contains(opts.filter)) continue;
+
+        // Find an iteration count that takes about as long as we want a
+        // repetition to take; never grow by more than 10x per step so a
+        // single slow outlier doesn’t throw us off too much.
+        const chr::duration<f64, std::nano> target = opts.min_time;
+        u64 iterations = 1;
+        for (;;) {
+            auto elapsed = Time(b.body, iterations);
+            if (elapsed >= target) break;
+            auto factor = elapsed.count() == 0 ? 10 : std::clamp(1.2 * target / elapsed, 2., 10.);
+            iterations = u64(f64(iterations) * factor);
+        }
+
+        Result r{b.name, iterations, b.items, {}};
+        for (usz i = 0; i < std::max<usz>(opts.repetitions, 1); i++) {
+            auto elapsed = Time(b.body, iterations);
+            r.ns_per_item.push_back(elapsed.count() / f64(iterations * b.items));
+        }
+
+        rgs::sort(r.ns_per_item);
+        std::println(stderr, "{:<50} {:>12.2f} ns/item  ({} × {})", r.name, r.median(), iterations, b.items);
+        results.push_back(std::move(r));
+    }
+
+    return results;
+}
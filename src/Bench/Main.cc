@@ -0,0 +1,44 @@
+#include <Bench/Bench.hh>
+
+#include <clopts.hh>
+#include <fstream>
+#include <print>
+
+using namespace pr;
+using namespace command_line_options;
+
+using options = clopts< // clang-format off
+    option<"--filter", "Only run benchmarks whose name contains this string">,
+    option<"--output", "Write the results as JSON to this file instead of stdout">,
+    option<"--min-time", "Minimum duration of a single repetition, in milliseconds (default: 200)", i64>,
+    option<"--repetitions", "How many times to run each benchmark (default: 5)", i64>,
+    flag<"--no-text", "Skip the text shaping benchmarks, which need a window">,
+    help<>
+>; // clang-format on
+
+int main(int argc, char* argv[]) {
+    auto opts = options::parse(argc, argv);
+
+    bench::RunOptions run_opts{
+        .filter = opts.get_or<"--filter">(""),
+        .min_time = chr::milliseconds(opts.get_or<"--min-time">(200)),
+        .repetitions = usz(std::max<i64>(opts.get_or<"--repetitions">(5), 1)),
+    };
+
+    bench::Suite suite;
+    bench::RegisterSharedBenchmarks(suite);
+    if (not opts.get<"--no-text">()) bench::RegisterTextBenchmarks(suite);
+
+    auto results = suite.run(run_opts);
+    auto json = bench::ToJSON(results, run_opts);
+    if (auto path = opts.get<"--output">()) {
+        std::ofstream out{*path};
+        out << json;
+        if (not out) {
+            std::println(stderr, "ERROR: failed to write results to '{}'", *path);
+            return 1;
+        }
+    } else {
+        std::print("{}", json);
+    }
+}
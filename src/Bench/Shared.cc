@@ -0,0 +1,351 @@
+#include <Bench/Bench.hh>
+
+#include <Shared/Cards.hh>
+#include <Shared/Constants.hh>
+#include <Shared/Packets.hh>
+#include <Shared/TCP.hh>
+#include <Shared/Validation.hh>
+
+#include <base/Base.hh>
+
+#include <format>
+#include <string_view>
+#include <vector>
+
+using namespace pr;
+using namespace pr::bench;
+namespace common = packets::common;
+namespace sc = packets::sc;
+namespace cs = packets::cs;
+
+// =============================================================================
+//  Sample Packets
+// =============================================================================
+namespace {
+using enum CardIdValue;
+
+constexpr constants::Word SampleWord{C_s, V_a, C_p, V_ə, C_r, V_i};
+const std::vector<CardId> SampleHand{C_t, V_o, C_m, P_SpellingReform, V_ɛ, C_k, V_u};
+
+/// Get a typical value of a packet.
+///
+/// Every packet must have one of these so the round-trip benchmarks
+/// can’t silently miss any.
+template <typename T>
+auto Sample() -> T = delete;
+
+template <>
+auto Sample<common::Disconnect>() -> common::Disconnect {
+    return common::Disconnect{common::Disconnect::Reason::WrongPassword};
+}
+
+template <>
+auto Sample<common::WordChoice>() -> common::WordChoice {
+    return common::WordChoice{SampleWord};
+}
+
+template <>
+auto Sample<sc::HeartbeatRequest>() -> sc::HeartbeatRequest {
+    return sc::HeartbeatRequest{1'234};
+}
+
+template <>
+auto Sample<sc::StartTurn>() -> sc::StartTurn { return {}; }
+
+template <>
+auto Sample<sc::EndTurn>() -> sc::EndTurn { return {}; }
+
+template <>
+auto Sample<sc::Draw>() -> sc::Draw {
+    return sc::Draw{{C_ʃ, V_æ}};
+}
+
+template <>
+auto Sample<sc::StartGame>() -> sc::StartGame {
+    return sc::StartGame{
+        {
+            sc::StartGame::PlayerInfo{SampleWord, "Alice"},
+            sc::StartGame::PlayerInfo{SampleWord, "Bob"},
+        },
+        SampleHand,
+        1,
+        0x1234'5678'9abc'def0,
+    };
+}
+
+template <>
+auto Sample<sc::AddSoundToStack>() -> sc::AddSoundToStack {
+    return sc::AddSoundToStack{1, 3, C_b};
+}
+
+template <>
+auto Sample<sc::StackLockChanged>() -> sc::StackLockChanged {
+    return sc::StackLockChanged{0, 2, true};
+}
+
+template <>
+auto Sample<sc::LoginAccepted>() -> sc::LoginAccepted {
+    return sc::LoginAccepted{packets::ProtocolVersion};
+}
+
+template <>
+auto Sample<sc::Batch>() -> sc::Batch {
+    // What the server typically sends at the end of a turn.
+    sc::Batch b;
+    net::AppendFrame(b.frames, Sample<sc::AddSoundToStack>(), ser::Encoding::Fixed).value();
+    net::AppendFrame(b.frames, Sample<sc::Draw>(), ser::Encoding::Fixed).value();
+    net::AppendFrame(b.frames, Sample<sc::EndTurn>(), ser::Encoding::Fixed).value();
+    return b;
+}
+
+template <>
+auto Sample<sc::Resume>() -> sc::Resume {
+    return sc::Resume{SampleHand};
+}
+
+template <>
+auto Sample<sc::Snapshot>() -> sc::Snapshot {
+    // Halfway through a game: a few sounds on each word, and a lock.
+    std::array<sc::Snapshot::PlayerInfo, constants::PlayersPerGame> players;
+    for (auto [p, name] : vws::zip(players, std::array{"Alice", "Bob"})) {
+        p.name = name;
+        for (auto [s, c] : vws::zip(p.stacks, SampleWord)) s.cards = {c, C_b};
+    }
+
+    players[0].stacks[2].locked = true;
+    return sc::Snapshot{std::move(players), SampleHand, 1, 0x1234'5678'9abc'def0, 24};
+}
+
+template <>
+auto Sample<cs::HeartbeatResponse>() -> cs::HeartbeatResponse {
+    return cs::HeartbeatResponse{1'234};
+}
+
+template <>
+auto Sample<cs::Login>() -> cs::Login {
+    return cs::Login{"Alice", "password", packets::ResumePoint{0x1234'5678'9abc'def0, 17}};
+}
+
+template <>
+auto Sample<cs::PlaySingleTarget>() -> cs::PlaySingleTarget {
+    return cs::PlaySingleTarget{3, 1, 4};
+}
+
+template <>
+auto Sample<cs::Pass>() -> cs::Pass {
+    return cs::Pass{5};
+}
+} // namespace
+
+// =============================================================================
+//  Serialisation
+// =============================================================================
+namespace {
+template <typename T>
+void AddRoundTrip(Suite& s, std::string_view dir, std::string_view name) {
+    for (auto e : {ser::Encoding::Fixed, ser::Encoding::Compact}) {
+        auto bench_name = std::format(
+            "ser/{}/{}/{}",
+            dir,
+            name,
+            e == ser::Encoding::Fixed ? "fixed" : "compact"
+        );
+
+        s.add(std::move(bench_name), [e, packet = Sample<T>()](u64 iterations) {
+            std::vector<std::byte> buffer;
+            for (u64 i = 0; i < iterations; i++) {
+                buffer.clear();
+                net::AppendFrame(buffer, packet, e).value();
+                ser::InputSpan data{buffer};
+                auto frame = net::ParseFrame(data).value();
+                auto res = net::DeserialiseFrame<T>(frame, e);
+                Assert(res.has_value(), "Round trip failed: {}", res.error());
+                DoNotOptimise(res);
+            }
+        });
+    }
+}
+
+void AddSerialisationBenchmarks(Suite& s) {
+#define X(name) AddRoundTrip<common::name>(s, "common", #name);
+    COMMON_PACKETS(X)
+#undef X
+
+#define X(name) AddRoundTrip<sc::name>(s, "sc", #name);
+    SC_PACKETS(X)
+#undef X
+
+#define X(name) AddRoundTrip<cs::name>(s, "cs", #name);
+    CS_PACKETS(X)
+#undef X
+}
+} // namespace
+
+// =============================================================================
+//  Dispatch
+// =============================================================================
+namespace {
+/// Handler that does nothing with the packets it receives.
+struct NullHandler {
+    u64 handled = 0;
+
+#define X(name)                                        \
+    void handle(net::TCPConnexion&, cs::name packet) { \
+        DoNotOptimise(packet);                         \
+        handled++;                                     \
+    }
+    COMMON_PACKETS(X)
+    CS_PACKETS(X)
+#undef X
+};
+
+template <typename T>
+void AppendSample(std::vector<std::byte>& stream) {
+    net::AppendFrame(stream, Sample<T>(), ser::Encoding::Fixed).value();
+}
+
+void AddDispatchBenchmarks(Suite& s) {
+    // A stream that looks roughly like what a game sends: mostly moves
+    // and heartbeats, with the occasional login or word choice.
+    constexpr usz StreamPackets = 1'024;
+    std::vector<std::byte> stream;
+    for (usz i = 0; i < StreamPackets; i++) {
+        switch (i % 16) {
+            case 0: AppendSample<cs::Login>(stream); break;
+            case 1: AppendSample<cs::WordChoice>(stream); break;
+            case 2:
+            case 6:
+            case 10:
+            case 14: AppendSample<cs::HeartbeatResponse>(stream); break;
+            case 3:
+            case 7:
+            case 11: AppendSample<cs::Pass>(stream); break;
+            case 15: AppendSample<cs::Disconnect>(stream); break;
+            default: AppendSample<cs::PlaySingleTarget>(stream); break;
+        }
+    }
+
+    s.add(
+        "dispatch/server/mixed",
+        [stream = std::move(stream)](u64 iterations) {
+            net::ReceiveBuffer buf;
+            net::TCPConnexion client;
+            NullHandler h;
+            for (u64 i = 0; i < iterations; i++) {
+                // Feed the stream in pieces that fit into the buffer,
+                // like the network would.
+                for (ser::InputSpan data{stream}; not data.empty();) {
+                    data = data.subspan(buf.append(data));
+                    for (;;) {
+                        auto res = packets::HandleServerSidePacket(h, client, buf);
+                        Assert(res.has_value(), "Dispatch failed: {}", res.error());
+                        if (not res.value()) break;
+                    }
+                }
+            }
+
+            Assert(h.handled == iterations * StreamPackets);
+        },
+        StreamPackets
+    );
+}
+} // namespace
+
+// =============================================================================
+//  Validation
+// =============================================================================
+namespace {
+/// A word that a card is played on; everything but the target stack
+/// uses the same card.
+struct BenchWord {
+    std::array<CardId, 3> cards;
+
+    auto operator[](usz i) const -> CardId { return cards[i]; }
+    bool is_own_word() const { return true; }
+    auto size() const -> usz { return cards.size(); }
+    bool stack_is_locked(usz) const { return false; }
+    bool stack_is_full(usz) const { return false; }
+};
+
+auto SoundCards() -> std::vector<CardId> {
+    std::vector<CardId> cards;
+    for (auto& c : CardDatabase)
+        if (c.id.is_sound()) cards.push_back(c.id);
+    return cards;
+}
+
+void AddValidationBenchmarks(Suite& s) {
+    auto sounds = SoundCards();
+
+    // Play every card on every sound, with every sound as a neighbour;
+    // the neighbour matters for /h/ and /ə/.
+    std::vector<std::pair<CardId, BenchWord>> moves;
+    for (auto& played : CardDatabase)
+        for (auto on : sounds)
+            for (auto neighbour : sounds)
+                moves.emplace_back(played.id, BenchWord{{neighbour, on, neighbour}});
+
+    s.add(
+        "validation/ValidatePlaySoundCard/all-pairs",
+        [moves](u64 iterations) {
+            for (u64 i = 0; i < iterations; i++) {
+                for (auto& [played, word] : moves) {
+                    auto res = validation::ValidatePlaySoundCard(played, word, 1);
+                    DoNotOptimise(res);
+                }
+            }
+        },
+        moves.size()
+    );
+
+    // Try every pair of sounds at the start of an otherwise fixed word;
+    // this exercises the cluster checks, which is where that function
+    // spends most of its time.
+    std::vector<constants::Word> words;
+    for (auto a : sounds) {
+        for (auto b : sounds) {
+            auto w = SampleWord;
+            w[0] = a;
+            w[1] = b;
+            words.push_back(w);
+        }
+    }
+
+    // Enumerate every move for a full hand; this is what a bot does on
+    // every turn.
+    std::vector<BenchWord> boards;
+    for (auto on : sounds) boards.push_back(BenchWord{{sounds[0], on, sounds.back()}});
+    s.add(
+        "validation/EnumerateMoves/full-hand",
+        [boards](u64 iterations) {
+            for (u64 i = 0; i < iterations; i++) {
+                auto moves = validation::EnumerateMoves(std::span{SampleHand}, std::span{boards});
+                DoNotOptimise(moves);
+            }
+        },
+        SampleHand.size() * boards.size()
+    );
+
+    s.add(
+        "validation/ValidateInitialWord/all-pairs",
+        [words](u64 iterations) {
+            for (u64 i = 0; i < iterations; i++) {
+                for (auto& w : words) {
+                    auto res = validation::ValidateInitialWord(w, w);
+                    DoNotOptimise(res);
+                }
+            }
+        },
+        words.size()
+    );
+}
+} // namespace
+
+// =============================================================================
+//  API
+// =============================================================================
+void bench::RegisterSharedBenchmarks(Suite& s) {
+    AddSerialisationBenchmarks(s);
+    AddDispatchBenchmarks(s);
+    AddValidationBenchmarks(s);
+}
@@ -0,0 +1,77 @@
+#include <Bench/Bench.hh>
+
+#include <Client/Render/Render.hh>
+
+#include <Shared/Cards.hh>
+
+#include <base/Base.hh>
+#include <base/Text.hh>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace pr;
+using namespace pr::bench;
+using namespace pr::client;
+
+namespace {
+/// Create a renderer and load the fonts; this only happens once since
+/// the renderer must outlive every benchmark that uses it.
+auto SetUpRenderer() -> Renderer& {
+    static Renderer r{800, 600};
+    Thread asset_loader{AssetLoader::Create()};
+    while (asset_loader.running()) std::this_thread::sleep_for(chr::milliseconds(10));
+    asset_loader.value().value().finalise(r);
+    return r;
+}
+
+void AddShapeBenchmark(
+    Suite& s,
+    std::string name,
+    Font& font,
+    std::vector<std::u32string> contents,
+    TextAlign align,
+    i32 desired_width = 0
+) {
+    auto count = contents.size();
+    s.add(
+        std::move(name),
+        [&font, contents = std::move(contents), align, desired_width](u64 iterations) {
+            // Creating a text object doesn’t shape it, so this doesn’t
+            // affect the timings much.
+            std::vector<Text> texts;
+            for (auto& c : contents) {
+                auto& t = texts.emplace_back(font, c, align);
+                if (desired_width) t.desired_width = desired_width;
+            }
+
+            for (u64 i = 0; i < iterations; i++)
+                for (auto& t : texts) font.shape(t, nullptr);
+        },
+        count
+    );
+}
+} // namespace
+
+void bench::RegisterTextBenchmarks(Suite& s) {
+    auto& r = SetUpRenderer();
+
+    // Card names, as they are drawn on cards; these often span several
+    // lines.
+    std::vector<std::u32string> names, centres;
+    for (auto& c : CardDatabase) {
+        names.push_back(text::ToUTF32(c.name));
+        if (c.id.is_sound()) centres.push_back(text::ToUTF32(c.center));
+    }
+
+    AddShapeBenchmark(s, "text/shape/card-names", r.font(FontSize::Medium), names, TextAlign::Center);
+    AddShapeBenchmark(s, "text/shape/card-centres", r.font(FontSize::Huge), centres, TextAlign::SingleLine);
+
+    // Rules text on power cards, which is reflowed to fit the card.
+    std::vector<std::u32string> rules{
+        U"Lock one of your sounds, or combine with a sound card to break a lock on an adjacent sound",
+    };
+
+    AddShapeBenchmark(s, "text/shape/rules-reflowed", r.font(FontSize::Normal), rules, TextAlign::Left, 150);
+}
@@ -0,0 +1,273 @@
+#include <Bot/Bot.hh>
+
+#include <Shared/Validation.hh>
+
+#include <base/Base.hh>
+
+#include <algorithm>
+#include <format>
+#include <ranges>
+
+using namespace pr;
+using namespace pr::bot;
+namespace sc = packets::sc;
+namespace cs = packets::cs;
+
+namespace {
+/// How long bots wait before they try to connect again.
+constexpr chr::milliseconds MinRetryDelay = 100ms;
+constexpr chr::milliseconds MaxRetryDelay = 5s;
+} // namespace
+
+// =============================================================================
+//  Validation
+// =============================================================================
+struct Bot::Validator {
+    const Player& p;
+    bool own;
+
+    auto operator[](usz i) const -> CardId { return p.word[i].top; }
+    bool is_own_word() const { return own; }
+    auto size() const -> usz { return p.word.size(); }
+    bool stack_is_locked(usz i) const { return p.word[i].locked; }
+    bool stack_is_full(usz i) const { return p.word[i].height == constants::MaxSoundStackSize; }
+};
+
+auto Bot::ValidatorFor(PlayerId p) const -> Validator {
+    return Validator{players[p], p == us};
+}
+
+// =============================================================================
+//  Networking
+// =============================================================================
+Bot::Bot(const Options& opts, Stats& stats, std::string name)
+    : opts(opts),
+      stats(stats),
+      _name(std::move(name)) {}
+
+auto Bot::connect() -> Result<> {
+    done = false;
+    players.clear();
+    hand.clear();
+    move_sent.reset();
+    login_sent = chr::steady_clock::now();
+    auto c = net::TCPConnexion::Connect(opts.address, opts.port);
+    if (not c) {
+        stats.errors.add();
+        failed_connects++;
+        return Error("{}", c.error());
+    }
+
+    failed_connects = 0;
+    conn = std::move(c.value());
+    conn.send(cs::Login(name, opts.password));
+    return {};
+}
+
+auto Bot::retry_delay() const -> chr::milliseconds {
+    auto doublings = std::min<u32>(failed_connects ? failed_connects - 1 : 0, 6);
+    return std::min(MinRetryDelay * (1 << doublings), MaxRetryDelay);
+}
+
+void Bot::Fail(std::string_view why) {
+    Log<LogLevel::Warning>("Bot {}: {}", name, why);
+    stats.errors.add();
+    conn.disconnect();
+    done = true;
+}
+
+void Bot::receive(net::ReceiveBuffer& buf) {
+    while (not conn.disconnected and not buf.empty()) {
+        auto res = packets::HandleClientSidePacket(*this, buf);
+        if (not res) return Fail(res.error());
+        if (not res.value()) break;
+    }
+}
+
+// =============================================================================
+//  Packet Handlers
+// =============================================================================
+void Bot::handle(sc::Disconnect packet) {
+    // The server kicks everyone once a game is over; anything else
+    // means we did something wrong.
+    if (packet.reason == sc::Disconnect::Reason::Unspecified and not players.empty()) {
+        stats.games.add();
+        conn.disconnect();
+        done = true;
+        return;
+    }
+
+    Fail(std::format("Disconnected by server (reason {})", +packet.reason));
+}
+
+void Bot::handle(sc::WordChoice wc) {
+    // Keep the word we were given if it’s valid; otherwise, take the
+    // first permutation of it that is.
+    using enum validation::InitialWordValidationResult;
+    auto word = wc.word;
+    if (validation::ValidateInitialWord(word, wc.word) != Valid) {
+        rgs::sort(word);
+        do {
+            if (validation::ValidateInitialWord(word, wc.word) == Valid) break;
+        } while (rgs::next_permutation(word).found);
+    }
+
+    conn.send(packets::common::WordChoice{word});
+}
+
+void Bot::handle(sc::HeartbeatRequest req) {
+    conn.send(cs::HeartbeatResponse{req.seq_no});
+}
+
+void Bot::handle(sc::StartTurn) {
+    MakeMove();
+}
+
+void Bot::handle(sc::EndTurn) {
+    if (not move_sent) return;
+    stats.move_latency.record(chr::steady_clock::now() - *move_sent);
+    move_sent.reset();
+}
+
+void Bot::handle(sc::Draw dr) {
+    hand.insert(hand.end(), dr.cards.begin(), dr.cards.end());
+}
+
+void Bot::handle(sc::StartGame sg) {
+    us = sg.player_id;
+    hand = std::move(sg.hand);
+    players.clear();
+    for (auto& info : sg.player_data) {
+        auto& p = players.emplace_back();
+        for (auto [s, c] : vws::zip(p.word, info.word)) s.top = c;
+    }
+}
+
+void Bot::handle(sc::Resume r) {
+    // We never send a resume point, so this shouldn’t happen, but
+    // there is nothing wrong with it either.
+    hand = std::move(r.hand);
+}
+
+void Bot::handle(sc::Snapshot s) {
+    us = s.player_id;
+    hand = std::move(s.hand);
+    players.clear();
+    for (auto& info : s.player_data) {
+        auto& p = players.emplace_back();
+        for (auto [st, si] : vws::zip(p.word, info.stacks)) {
+            if (si.cards.empty()) return Fail("Invalid Snapshot packet");
+            st.top = si.cards.back();
+            st.height = si.cards.size();
+            st.locked = si.locked;
+        }
+    }
+}
+
+void Bot::handle(sc::AddSoundToStack add) {
+    if (add.player >= players.size() or add.stack_index >= constants::StartingWordSize)
+        return Fail("Invalid AddSoundToStack packet");
+
+    auto& s = players[add.player].word[add.stack_index];
+    s.top = add.card;
+    s.height++;
+}
+
+void Bot::handle(sc::StackLockChanged lock) {
+    if (lock.player >= players.size() or lock.stack_index >= constants::StartingWordSize)
+        return Fail("Invalid StackLockChanged packet");
+
+    players[lock.player].word[lock.stack_index].locked = lock.locked;
+}
+
+void Bot::handle(sc::Batch) {
+    Unreachable("Batches are unpacked by HandleClientSidePacket()");
+}
+
+void Bot::handle(sc::LoginAccepted accepted) {
+    if (login_sent) stats.login_latency.record(chr::steady_clock::now() - *login_sent);
+    login_sent.reset();
+    conn.set_encoding(packets::EncodingFor(accepted.protocol_version));
+}
+
+// =============================================================================
+//  Playing
+// =============================================================================
+void Bot::MakeMove() {
+    if (hand.empty() or players.empty()) return;
+    move_sent = chr::steady_clock::now();
+    stats.moves.add();
+
+    // Play the first card that fits anywhere.
+    std::vector<Validator> words;
+    for (usz p = 0; p < players.size(); p++) words.push_back(ValidatorFor(PlayerId(p)));
+    auto moves = validation::EnumerateMoves(std::span<const CardId>{hand}, std::span<const Validator>{words});
+    if (auto m = moves.first()) {
+        conn.send(cs::PlaySingleTarget{u32(m->card), PlayerId(m->word), u32(m->stack)});
+        hand.erase(hand.begin() + isz(m->card));
+        return;
+    }
+
+    // Nothing to play; discard the first card.
+    stats.passes.add();
+    conn.send(cs::Pass{0});
+    hand.erase(hand.begin());
+}
+
+// =============================================================================
+//  Event Loop
+// =============================================================================
+BotThread::BotThread(const Options& opts, Stats& stats, usz first_id, usz count)
+    : loop(net::TCPServer::CreateDetached().value()) {
+    loop.set_callbacks(*this);
+    for (usz i = 0; i < count; i++)
+        bots.push_back(std::make_unique<Bot>(opts, stats, std::format("bot{}", first_id + i)));
+
+    // Only start the thread once everything else is set up.
+    thread = std::jthread{[this](std::stop_token stop) { Run(std::move(stop)); }};
+}
+
+BotThread::~BotThread() {
+    thread.request_stop();
+    loop.wake();
+}
+
+void BotThread::Connect(Bot& b) {
+    if (auto res = b.connect(); not res) {
+        // Try again later; if the server is down, hammering it won’t help.
+        auto delay = b.retry_delay();
+        Log<LogLevel::Warning>("Bot {} failed to connect, retrying in {}: {}", b.name, delay, res.error());
+        loop.timers().schedule(delay, [this, &b] { Connect(b); });
+        return;
+    }
+
+    loop.adopt(b.connexion());
+    bot_map.insert(b.connexion().id, &b);
+}
+
+void BotThread::Run(std::stop_token stop) {
+    for (auto& b : bots) Connect(*b);
+    while (not stop.stop_requested()) {
+        loop.poll(100ms);
+
+        // Forget about closed connexions before their ids are reused.
+        bot_map.erase_if([](Bot* b) { return b->connexion().disconnected; });
+        loop.update_connexions();
+
+        // Start another game for bots whose game is over.
+        for (auto& b : bots)
+            if (b->wants_reconnect() and b->connexion().disconnected) Connect(*b);
+    }
+
+    for (auto& b : bots) b->connexion().disconnect();
+}
+
+bool BotThread::accept(net::TCPConnexion&) {
+    Unreachable("Bots don’t listen for connexions");
+}
+
+void BotThread::receive(net::TCPConnexion& client, net::ReceiveBuffer& buffer) {
+    auto b = bot_map.find(client.id);
+    if (not b) return client.disconnect();
+    (*b)->receive(buffer);
+}
@@ -0,0 +1,91 @@
+#include <Bot/Bot.hh>
+
+#include <clopts.hh>
+#include <memory>
+#include <print>
+#include <thread>
+#include <vector>
+
+using namespace pr;
+using namespace command_line_options;
+
+using options = clopts< // clang-format off
+    option<"--connect", "The server IP to connect to (default: localhost)">,
+    option<"--port", "The port to connect to", i64>,
+    option<"--password", "The password to use for login">,
+    option<"--bots", "Number of bots to run (default: 100)", i64>,
+    option<"--threads", "Number of threads to run the bots on (default: 4)", i64>,
+    option<"--duration", "How long to run for, in seconds (default: 30)", i64>,
+    flag<"--no-rejoin", "Don’t start another game once a bot’s game is over">,
+    help<>
+>; // clang-format on
+
+static void PrintLatency(std::string_view what, const metrics::Histogram& h) {
+    auto ms = [&](f64 q) { return f64(h.quantile(q)) / 1e6; };
+    std::println(
+        "{:<6} n={:<8} p50={:.3f}ms p90={:.3f}ms p99={:.3f}ms p99.9={:.3f}ms",
+        what,
+        h.count(),
+        ms(.5),
+        ms(.9),
+        ms(.99),
+        ms(.999)
+    );
+}
+
+int main(int argc, char* argv[]) {
+    auto opts = options::parse(argc, argv);
+
+    i64 port = opts.get_or<"--port">(net::DefaultPort);
+    if (port <= 0 or port > std::numeric_limits<u16>::max()) {
+        std::println(stderr, "ERROR: invalid port {}", port);
+        return 1;
+    }
+
+    i64 bots = opts.get_or<"--bots">(100);
+    i64 threads = opts.get_or<"--threads">(4);
+    i64 duration = opts.get_or<"--duration">(30);
+    if (bots <= 0 or threads <= 0 or duration <= 0) {
+        std::println(stderr, "ERROR: --bots, --threads, and --duration must be positive");
+        return 1;
+    }
+
+    bot::Options bot_opts{
+        .address = opts.get_or<"--connect">("127.0.0.1"),
+        .port = u16(port),
+        .password = opts.get_or<"--password">(""),
+        .rejoin = not opts.get<"--no-rejoin">(),
+    };
+
+    // Spread the bots evenly across the threads.
+    bot::Stats stats;
+    std::vector<std::unique_ptr<bot::BotThread>> workers;
+    threads = std::min(threads, bots);
+    for (i64 i = 0, first = 0; i < threads; i++) {
+        auto count = bots / threads + (i < bots % threads);
+        workers.push_back(std::make_unique<bot::BotThread>(bot_opts, stats, usz(first), usz(count)));
+        first += count;
+    }
+
+    // Report progress every second.
+    auto start = chr::steady_clock::now();
+    for (i64 s = 1; s <= duration; s++) {
+        std::this_thread::sleep_until(start + chr::seconds(s));
+        std::println(
+            "[{:>4}s] moves={} games={} errors={}",
+            s,
+            stats.moves.get(),
+            stats.games.get(),
+            stats.errors.get()
+        );
+    }
+
+    workers.clear();
+    auto elapsed = chr::duration<f64>(chr::steady_clock::now() - start).count();
+
+    std::println("\nRan {} bots on {} threads for {:.1f}s", bots, threads, elapsed);
+    std::println("Moves: {} ({} passes), {:.1f}/s", stats.moves.get(), stats.passes.get(), f64(stats.moves.get()) / elapsed);
+    std::println("Games: {}, errors: {}", stats.games.get(), stats.errors.get());
+    PrintLatency("Login", stats.login_latency);
+    PrintLatency("Move", stats.move_latency);
+}
@@ -136,8 +136,12 @@ void ConnexionScreen::tick(InputSystem& input) {
             }
 
             // We do! Tell the server who we are and switch to game screen.
-            client.server_connexion = std::move(conn.value());
-            client.server_connexion.send(packets::cs::Login(std::move(username), std::move(password)));
+            client.server_connexion.connect(std::move(conn.value()));
+            client.server_connexion.send(packets::cs::Login(
+                std::move(username),
+                std::move(password),
+                client.game_screen.resume_point()
+            ));
             client.enter_screen(client.waiting_screen);
             return;
         }
@@ -267,14 +271,15 @@ void Client::handle(sc::Disconnect packet) {
             case Reason::UsernameInUse: return "Disconnected: User name already in use";
             case Reason::WrongPassword: return "Disconnected: Invalid Password";
             case Reason::UnexpectedPacket: return "Disconnected: Unexpected Packet";
+            case Reason::UsernameTooLong: return "Disconnected: User name too long";
             default: return "Disconnected: <<<Invalid>>>";
         }
     }();
     show_error(std::string{reason}, menu_screen);
 }
 
-void Client::handle(sc::HeartbeatRequest req) {
-    server_connexion.send(cs::HeartbeatResponse{req.seq_no});
+void Client::handle(sc::HeartbeatRequest) {
+    Unreachable("Heartbeats are answered by the network thread");
 }
 
 void Client::handle(sc::WordChoice wc) {
@@ -282,7 +287,7 @@ void Client::handle(sc::WordChoice wc) {
 }
 
 void Client::handle(sc::Draw dr) {
-    game_screen.add_card_to_hand(dr.card);
+    for (auto card : dr.cards) game_screen.add_card_to_hand(card);
 }
 
 void Client::handle(sc::StartTurn) {
@@ -299,6 +304,25 @@ void Client::handle(sc::StartGame sg) {
     game_screen.enter(std::move(sg));
 }
 
+void Client::handle(sc::Resume r) {
+    game_screen.resume(std::move(r));
+}
+
+void Client::handle(sc::Snapshot s) {
+    auto Valid = [](const sc::Snapshot::StackInfo& st) {
+        return not st.cards.empty() and st.cards.size() <= constants::MaxSoundStackSize;
+    };
+
+    for (auto& p : s.player_data) {
+        if (not rgs::all_of(p.stacks, Valid)) {
+            server_connexion.disconnect();
+            return show_error("Disconnected: Server sent invalid game state", menu_screen);
+        }
+    }
+
+    game_screen.enter(std::move(s));
+}
+
 void Client::handle(sc::AddSoundToStack add) {
     game_screen.add_card(add.player, add.stack_index, add.card);
 }
@@ -307,22 +331,18 @@ void Client::handle(sc::StackLockChanged lock) {
     game_screen.lock_changed(lock.player, lock.stack_index, lock.locked);
 }
 
-void Client::TickNetworking() {
-    if (server_connexion.disconnected) return;
-    server_connexion.receive([&](net::ReceiveBuffer& buf) {
-        while (not server_connexion.disconnected and not buf.empty()) {
-            auto res = packets::HandleClientSidePacket(*this, buf);
-
-            // If there was an error, close the connexion.
-            if (not res) {
-                server_connexion.disconnect();
-                show_error(res.error(), menu_screen);
-            }
+void Client::handle(sc::Batch) {
+    Unreachable("Batches are unpacked by HandleClientSidePacket()");
+}
 
-            // And stop if the packet was incomplete.
-            if (not res.value()) break;
-        }
-    });
+void Client::handle(sc::LoginAccepted) {
+    // The network thread has already switched to the new encoding.
+}
+
+void Client::TickNetworking() {
+    // If there was an error, the connexion has been closed.
+    if (auto res = server_connexion.receive(*this); not res)
+        show_error(res.error(), menu_screen);
 }
 
 // =============================================================================
@@ -359,25 +379,42 @@ void Client::RunAndConnect(std::string address, std::string username, std::strin
 
 void Client::enter_screen(Screen& s) {
     current_screen = &s;
+    renderer.profiler.set_screen(ScreenName(s));
     s.refresh(renderer);
     s.on_entered();
 }
 
+auto Client::ScreenName(const Screen& s) const -> std::string_view {
+    if (&s == &menu_screen) return "Menu";
+    if (&s == &connexion_screen) return "Connexion";
+    if (&s == &error_screen) return "Error";
+    if (&s == &waiting_screen) return "Waiting";
+    if (&s == &word_choice_screen) return "WordChoice";
+    if (&s == &game_screen) return "Game";
+    return "Screen";
+}
+
 void Client::Tick() {
-    // Handle networking.
-    TickNetworking();
+    using Section = Profiler::Section;
+    auto& p = renderer.profiler;
 
     // Start a new frame.
     Renderer::Frame _ = renderer.frame();
 
+    // Handle networking.
+    p.measure(Section::Networking, [&] { TickNetworking(); });
+
     // Refresh screen info.
-    current_screen->refresh(renderer);
+    p.measure(Section::Refresh, [&] { current_screen->refresh(renderer); });
 
     // Tick the screen.
-    current_screen->tick(input_system);
+    p.measure(Section::Tick, [&] { current_screen->tick(input_system); });
 
     // Draw it.
-    current_screen->draw(renderer);
+    p.measure(Section::Draw, [&] { current_screen->draw(renderer); });
+
+    // Send any packets we queued during this frame.
+    server_connexion.flush();
 }
 
 void Client::RunGame() {
@@ -397,6 +434,7 @@ auto Client::Startup() -> Renderer {
     Screen screen;
     Renderer r{1'800, 1'000};
     Thread asset_loader{AssetLoader::Create()};
+    Thread<ImageData> card_art{&DecodeCardArt};
     InputSystem startup{r};
     screen.Create<Throbber>(Position::Center());
 
@@ -410,7 +448,7 @@ auto Client::Startup() -> Renderer {
     startup.game_loop([&] {
         Renderer::Frame _ = r.frame();
         screen.draw(r);
-        if (not asset_loader.running()) {
+        if (not asset_loader.running() and not card_art.running()) {
             done = true;
             startup.quit = true;
         }
@@ -421,12 +459,13 @@ auto Client::Startup() -> Renderer {
     // to stop since we don’t need the assets anymore.
     if (not done) {
         asset_loader.stop_and_release();
+        card_art.stop_and_release();
         std::exit(0);
     }
 
     // Finish asset loading.
     asset_loader.value().value().finalise(r);
-    InitialiseUI(r);
+    InitialiseUI(r, card_art.value().value());
     return r;
 }
 
@@ -4,8 +4,11 @@
 
 #include <base/Base.hh>
 
+#include <bit>
 #include <generator>
 #include <ranges>
+#include <span>
+#include <vector>
 
 using namespace pr;
 using namespace pr::client;
@@ -71,27 +74,15 @@ void GameScreen::ResetWords(
 }
 
 auto GameScreen::Targets(Card& c) -> std::generator<Target> {
-    if (c.id.is_sound()) {
-        for (auto p : all_players) {
-            for (auto [i, s] : p->word->stacks() | vws::enumerate) {
-                // TODO: Handle evolutions that require an extra card.
-                auto res = validation::ValidatePlaySoundCard(c.id, ValidatorFor(*p), i);
-                bool valid = res == validation::PlaySoundCardValidationResult::Valid;
-                if (valid) co_yield Target{s};
-            }
-        }
-        co_return;
-    }
-
-    switch (c.id.value) {
-        default: break;
-        case CardIdValue::P_SpellingReform: {
-            auto v = ValidatorFor(us);
-            for (auto [i, s] : us.word->stacks() | vws::enumerate)
-                if (validation::ValidateP_SpellingReform(v, i))
-                    co_yield Target{s};
-        } break;
-    }
+    // TODO: Handle evolutions that require an extra card.
+    std::vector<Validator> words;
+    for (auto p : all_players) words.push_back(ValidatorFor(*p));
+
+    CardId id = c.id;
+    auto moves = validation::EnumerateMoves(std::span{&id, 1}, std::span<const Validator>{words});
+    for (auto [i, p] : all_players | vws::enumerate)
+        for (auto stacks = moves.targets(0, usz(i)); stacks; stacks &= stacks - 1)
+            co_yield Target{p->word->stacks()[usz(std::countr_zero(stacks))]};
 }
 
 // =============================================================================
@@ -220,6 +211,7 @@ void GameScreen::TickSingleTarget() {
 void GameScreen::add_card(PlayerId id, u32 stack_idx, CardId card) {
     auto& player = PlayerById(id);
     player.word->stacks()[stack_idx].push(card);
+    last_seen.seq_no++;
 }
 
 void GameScreen::add_card_to_hand(CardId id) {
@@ -228,6 +220,7 @@ void GameScreen::add_card_to_hand(CardId id) {
 
 void GameScreen::enter(packets::sc::StartGame sg) {
     DeleteAllChildren();
+    last_seen = {sg.session, 0};
 
     end_turn_button = &Create<Button>("Pass", Position(-50, 50), [&] { Pass(); });
     other_players.clear();
@@ -272,9 +265,30 @@ void GameScreen::enter(packets::sc::StartGame sg) {
     client.enter_screen(*this);
 }
 
+void GameScreen::enter(packets::sc::Snapshot s) {
+    // Set up the game as it started, and then put everything that has
+    // happened since on top of that.
+    std::array<packets::sc::StartGame::PlayerInfo, constants::PlayersPerGame> player_infos;
+    for (auto [info, p] : vws::zip(player_infos, s.player_data)) {
+        info.name = p.name;
+        for (auto [c, stack] : vws::zip(info.word, p.stacks)) c = stack.cards.front();
+    }
+
+    enter(packets::sc::StartGame{player_infos, std::move(s.hand), s.player_id, s.session});
+    for (auto [i, p] : s.player_data | vws::enumerate) {
+        for (auto [stack, info] : vws::zip(PlayerById(PlayerId(i)).word->stacks(), p.stacks)) {
+            for (auto c : info.cards | vws::drop(1)) stack.push(c);
+            stack.locked = info.locked;
+        }
+    }
+
+    last_seen = {s.session, s.seq_no};
+}
+
 void GameScreen::lock_changed(PlayerId player, u32 stack_index, bool locked) {
     auto& p = PlayerById(player);
     p.word->stacks()[stack_index].locked = locked;
+    last_seen.seq_no++;
 }
 
 void GameScreen::on_refresh(Renderer& r) {
@@ -318,6 +332,16 @@ void GameScreen::tick(InputSystem& input) {
     }
 }
 
+void GameScreen::resume(packets::sc::Resume r) {
+    // Our words are still up to date, save for the updates that follow
+    // this packet, but our hand may have changed in the meantime.
+    ClearSelection();
+    our_hand->clear();
+    for (auto c : r.hand) our_hand->add_stack(c);
+    end_turn();
+    client.enter_screen(*this);
+}
+
 void GameScreen::start_turn() {
     state = State::NoSelection;
     end_turn_button->selectable = Selectable::Yes;
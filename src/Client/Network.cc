@@ -0,0 +1,231 @@
+#include <Client/Client.hh>
+
+#include <base/Base.hh>
+
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+using namespace pr;
+using namespace pr::client;
+
+namespace sc = packets::sc;
+namespace cs = packets::cs;
+
+// =============================================================================
+//  UI Thread
+// =============================================================================
+ServerConnexion::ServerConnexion() : loop(net::TCPServer::CreateDetached().value()) {
+    loop.set_callbacks(*this);
+}
+
+ServerConnexion::~ServerConnexion() {
+    thread.request_stop();
+    loop.wake();
+}
+
+void ServerConnexion::connect(net::TCPConnexion connexion) {
+    // Once the previous network thread is gone, we have both queues to
+    // ourselves, so throw away anything that is left in them.
+    Stop();
+    while (incoming.try_pop()) {}
+    while (outgoing.try_pop()) {}
+    unsent.clear();
+    overflow.clear();
+    stalled = nullptr;
+    backlogged = false;
+    closed = false;
+    close_requested = false;
+    error.clear();
+
+    encoding = connexion.encoding;
+    conn = std::move(connexion);
+    _disconnected = false;
+    thread = std::jthread{[this](std::stop_token stop) { Run(std::move(stop)); }};
+}
+
+void ServerConnexion::disconnect() {
+    if (disconnected) return;
+
+    // Hand everything we still have to the network thread, which sends
+    // it before it closes the socket; whatever doesn’t fit in the queue
+    // goes in the overflow, which it only looks at once it is closing.
+    flush();
+    if (not unsent.empty()) {
+        std::unique_lock _{overflow_lock};
+        overflow = std::move(unsent);
+    }
+
+    _disconnected = true;
+    unsent.clear();
+    close_requested.store(true, std::memory_order::release);
+    loop.wake();
+}
+
+void ServerConnexion::flush() {
+    if (disconnected or unsent.empty()) return;
+
+    // If the queue is full, keep the rest for the next frame.
+    usz n = 0;
+    while (n < unsent.size() and outgoing.try_push(std::move(unsent[n]))) n++;
+    unsent.erase(unsent.begin(), unsent.begin() + isz(n));
+    if (n) loop.wake();
+}
+
+auto ServerConnexion::receive(Client& c) -> Result<> {
+    if (disconnected) return {};
+
+    // Check this before we drain the queue: the network thread doesn’t
+    // push anything once it has set this, so if it is set, we’re about
+    // to see everything it ever received.
+    auto done = closed.load(std::memory_order::acquire);
+    while (not disconnected) {
+        auto p = incoming.try_pop();
+        if (not p) break;
+        net::Frame frame{std::to_integer<net::detail::IDType>(p->data[0]), p->data};
+        if (auto res = packets::HandleClientSideFrame(c, frame, p->encoding); not res) {
+            disconnect();
+            return res;
+        }
+    }
+
+    // Let the network thread know that there is room again.
+    if (backlogged.exchange(false, std::memory_order::acq_rel)) loop.wake();
+    if (not done or disconnected) return {};
+    _disconnected = true;
+    if (not error.empty()) return Error("{}", error);
+    return {};
+}
+
+void ServerConnexion::Stop() {
+    if (not thread.joinable()) return;
+    thread.request_stop();
+    loop.wake();
+    thread.join();
+}
+
+// =============================================================================
+//  Network Thread
+// =============================================================================
+bool ServerConnexion::accept(net::TCPConnexion&) {
+    Unreachable("The client doesn’t listen for connexions");
+}
+
+void ServerConnexion::receive(net::TCPConnexion&, net::ReceiveBuffer& buffer) {
+    Forward(buffer);
+}
+
+void ServerConnexion::Forward(net::ReceiveBuffer& buf) {
+    while (not conn.disconnected) {
+        auto res = ForwardFrame(buf);
+        if (not res) {
+            error = std::move(res.error());
+            return conn.disconnect();
+        }
+
+        if (not res.value()) return;
+    }
+}
+
+auto ServerConnexion::ForwardFrame(net::ReceiveBuffer& buf) -> Result<bool> {
+    auto frame = Try(buf.peek_frame());
+    if (not frame) return false;
+
+    // Answer heartbeats right away rather than when the UI thread gets
+    // to them; the server batches them along with everything else, so
+    // we have to look inside batches as well.
+    auto enc = buf.encoding;
+    std::vector<u32> heartbeats;
+    std::optional<u32> protocol_version;
+    auto keep = [&](const net::Frame& f) -> Result<bool> {
+        switch (sc::ID(f.id)) {
+            default: return true;
+            case sc::ID::HeartbeatRequest:
+                heartbeats.push_back(Try(net::DeserialiseFrame<sc::HeartbeatRequest>(f, enc)).seq_no);
+                return false;
+            case sc::ID::LoginAccepted:
+                protocol_version = Try(net::DeserialiseFrame<sc::LoginAccepted>(f, enc)).protocol_version;
+                return true;
+        }
+    };
+
+    Packet p{{}, enc};
+    if (sc::ID(frame->id) == sc::ID::Batch) {
+        auto data = frame->data.subspan(sizeof(net::detail::IDType));
+        p.data.push_back(frame->data[0]);
+        while (not data.empty()) {
+            auto start = data.data();
+            auto inner = Try(net::ParseFrame(data));
+            if (Try(keep(inner))) p.data.insert(p.data.end(), start, data.data());
+        }
+
+        if (p.data.size() == sizeof(net::detail::IDType)) p.data.clear();
+    } else if (Try(keep(*frame))) {
+        p.data.assign(frame->data.begin(), frame->data.end());
+    }
+
+    // If the UI thread is behind, leave this and everything after it in
+    // the buffer; once that fills up, we stop reading from the socket,
+    // and TCP makes the server wait for us.
+    if (not p.data.empty() and not incoming.try_push(std::move(p))) {
+        stalled = &buf;
+        backlogged.store(true, std::memory_order::release);
+        return false;
+    }
+
+    for (auto seq_no : heartbeats) conn.send(cs::HeartbeatResponse{seq_no});
+
+    // Everything after this packet uses the new encoding, so switch
+    // before we split off the next frame.
+    if (protocol_version) {
+        auto e = packets::EncodingFor(*protocol_version);
+        conn.set_encoding(e);
+        encoding.store(e, std::memory_order::relaxed);
+    }
+
+    buf.drop_frame();
+    return true;
+}
+
+void ServerConnexion::SendQueued() {
+    // These are already framed, so send them as-is.
+    while (auto frame = outgoing.try_pop()) conn.send(std::span<const std::byte>{*frame}, 1);
+}
+
+void ServerConnexion::Run(std::stop_token stop) {
+    loop.adopt(conn);
+    while (not stop.stop_requested() and not conn.disconnected) {
+        if (close_requested.load(std::memory_order::acquire)) break;
+
+        // Queue everything the UI thread wants to send; poll() sends
+        // it before it starts waiting.
+        SendQueued();
+
+        // Continue with frames we had to leave behind once the UI thread
+        // has made room for them. If the buffer was full, there may also
+        // be data in the socket that we won’t be told about again.
+        if (stalled and not backlogged.load(std::memory_order::acquire)) {
+            Forward(*std::exchange(stalled, nullptr));
+            if (not stalled) conn.receive([&](net::ReceiveBuffer& buf) { Forward(buf); });
+        }
+
+        loop.poll(100ms);
+    }
+
+    // Send whatever the UI thread queued before it asked us to close,
+    // in order: the overflow was only filled once the queue was full;
+    // disconnecting flushes the connexion.
+    SendQueued();
+    {
+        std::unique_lock _{overflow_lock};
+        for (auto& frame : overflow) conn.send(std::span<const std::byte>{frame}, 1);
+        overflow.clear();
+    }
+
+    conn.disconnect();
+    loop.update_connexions();
+    closed.store(true, std::memory_order::release);
+}
@@ -2,6 +2,10 @@
 
 #include <webp/decode.h>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 using namespace gl;
 using namespace pr;
 using namespace pr::client;
@@ -27,9 +31,7 @@ DrawableTexture::DrawableTexture(
     GLenum target,
     GLenum unit,
     bool tile
-) : Texture(data, width, height, format, type, target, unit, tile) {
-    vao.add_buffer(create_vertices(Size{width, height}), GL_TRIANGLE_STRIP);
-}
+) : Texture(data, width, height, format, type, target, unit, tile) {}
 
 auto DrawableTexture::LoadFromFile(fs::PathRef path) -> DrawableTexture {
     auto file = File::Read(path);
@@ -66,9 +68,165 @@ auto DrawableTexture::create_vertices_scaled(f32 scale) const -> std::array<vec4
     return MakeVerts(f32(width) * scale, f32(height) * scale, 1, 1);
 }
 
-void DrawableTexture::draw_vertices() const {
+auto ArrayImage::create_vertices(Size sz) const -> std::array<vec4, 4> {
+    return DrawableTexture::MakeVerts(
+        sz.wd,
+        sz.ht,
+        f32(std::min(sz.wd, size.wd)) / array->width,
+        f32(std::min(sz.ht, size.ht)) / array->height
+    );
+}
+
+auto ArrayImage::create_vertices_scaled(f32 scale) const -> std::array<vec4, 4> {
+    return DrawableTexture::MakeVerts(
+        f32(size.wd) * scale,
+        f32(size.ht) * scale,
+        f32(size.wd) / array->width,
+        f32(size.ht) / array->height
+    );
+}
+
+Framebuffer::Framebuffer(Size size)
+    : colour(u32(size.wd), u32(size.ht), GL_RGBA, GL_UNSIGNED_BYTE) {
+    glGenFramebuffers(1, &descriptor);
     bind();
-    vao.draw_vertices();
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colour.descriptor, 0);
+    Assert(
+        glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE,
+        "Framebuffer of size {}x{} is incomplete",
+        size.wd,
+        size.ht
+    );
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Framebuffer::bind() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, descriptor);
+}
+
+auto GLStats::Get() -> GLStats& {
+    static GLStats stats;
+    return stats;
+}
+
+TimerQuery::TimerQuery() {
+    glGenQueries(1, &descriptor);
+}
+
+void TimerQuery::begin() const { glBeginQuery(GL_TIME_ELAPSED, descriptor); }
+void TimerQuery::end() const { glEndQuery(GL_TIME_ELAPSED); }
+
+bool TimerQuery::available() const {
+    GLint available = 0;
+    glGetQueryObjectiv(descriptor, GL_QUERY_RESULT_AVAILABLE, &available);
+    return available != 0;
+}
+
+auto TimerQuery::elapsed() const -> chr::nanoseconds {
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(descriptor, GL_QUERY_RESULT, &ns);
+    return chr::nanoseconds(ns);
+}
+
+auto ImageData::Decode(std::span<const fs::Path> paths, std::stop_token stop) -> ImageData {
+    auto DecodeInto = [](Image& img, const u8* data, usz size) {
+        int wd, ht;
+        if (not WebPGetInfo(data, size, &wd, &ht)) return false;
+        img.width = u32(wd);
+        img.height = u32(ht);
+        img.pixels.resize(usz(wd) * usz(ht) * 4);
+        return WebPDecodeRGBAInto(data, size, img.pixels.data(), img.pixels.size(), wd * 4) != nullptr;
+    };
+
+    auto Load = [&](Image& img, fs::PathRef path) {
+        if (auto file = File::Read(path); not file) {
+            Log("{}", file.error());
+        } else if (DecodeInto(img, file.value().data<u8>(), file.value().size())) {
+            return;
+        } else {
+            Log("Could not decode image '{}'", path.string());
+        }
+
+        auto ok = DecodeInto(img, DefaultTextureData, sizeof DefaultTextureData);
+        Assert(ok, "Failed to decode embedded image?");
+    };
+
+    // Images are independent, so just hand them out one at a time.
+    ImageData d;
+    d.images.resize(paths.size());
+    {
+        std::atomic<usz> next = 0;
+        std::vector<std::jthread> workers;
+        auto threads = std::min<usz>(std::max(std::thread::hardware_concurrency(), 1u), paths.size());
+        for (usz i = 0; i < threads; i++) {
+            workers.emplace_back([&] {
+                for (usz j; not stop.stop_requested() and (j = next.fetch_add(1, std::memory_order::relaxed)) < paths.size();)
+                    Load(d.images[j], paths[j]);
+            });
+        }
+    }
+
+    return d;
+}
+
+TextureArray::TextureArray(const ImageData& data) : _layers{u32(data.images.size())} {
+    Assert(layers != 0, "Texture array must not be empty");
+    for (auto& img : data.images) {
+        _width = std::max(_width, img.width);
+        _height = std::max(_height, img.height);
+        sizes.emplace_back(img.width, img.height);
+    }
+
+    GLint max_layers;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+    Assert(GLint(layers) <= max_layers, "Too many images for a texture array: {}", layers);
+
+    glGenTextures(1, &descriptor);
+    bind();
+    glTexImage3D(
+        GL_TEXTURE_2D_ARRAY,
+        0,
+        GL_RGBA,
+        width,
+        height,
+        layers,
+        0,
+        GL_RGBA,
+        GL_UNSIGNED_BYTE,
+        nullptr
+    );
+
+    for (auto [layer, img] : data.images | vws::enumerate) {
+        glTexSubImage3D(
+            GL_TEXTURE_2D_ARRAY,
+            0,
+            0,
+            0,
+            GLint(layer),
+            img.width,
+            img.height,
+            1,
+            GL_RGBA,
+            GL_UNSIGNED_BYTE,
+            img.pixels.data()
+        );
+        GLStats::UploadTexture();
+    }
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+void TextureArray::bind() const {
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, descriptor);
+}
+
+auto TextureArray::image(u32 layer) const -> ArrayImage {
+    Assert(layer < layers, "Layer out of bounds: {}", layer);
+    return ArrayImage{*this, layer, sizes[layer]};
 }
 
 struct Shader : Descriptor<glDeleteShader> {
@@ -93,13 +251,6 @@ Shader::Shader(GLenum type, std::span<const char> source) {
     }
 }
 
-template <typename... T>
-void ShaderProgram::SetUniform(ZTermString name, auto callable, T... args) {
-    auto u = glGetUniformLocation(descriptor, name.c_str());
-    if (u == -1) return;
-    callable(u, args...);
-}
-
 ShaderProgram::ShaderProgram(
     std::span<const char> vertex_shader_source,
     std::span<const char> fragment_shader_source
@@ -122,24 +273,30 @@ ShaderProgram::ShaderProgram(
     }
 }
 
-void ShaderProgram::uniform(ZTermString name, vec2 v) {
-    return SetUniform(name, glUniform2f, v.x, v.y);
+void ShaderProgram::bind_block(ZTermString name, GLuint binding) {
+    auto index = glGetUniformBlockIndex(descriptor, name.c_str());
+    if (index == GL_INVALID_INDEX) return;
+    glUniformBlockBinding(descriptor, index, binding);
+}
+
+void ShaderProgram::set(Uniform<vec2> u, vec2 v) {
+    if (u.location != -1) glUniform2f(u.location, v.x, v.y);
 }
 
-void ShaderProgram::uniform(ZTermString name, vec4 v) {
-    return SetUniform(name, glUniform4f, v.x, v.y, v.z, v.w);
+void ShaderProgram::set(Uniform<vec4> u, vec4 v) {
+    if (u.location != -1) glUniform4f(u.location, v.x, v.y, v.z, v.w);
 }
 
-void ShaderProgram::uniform(ZTermString name, mat3 m) {
-    return SetUniform(name, glUniformMatrix3fv, 1, GL_FALSE, value_ptr(m));
+void ShaderProgram::set(Uniform<mat3> u, mat3 m) {
+    if (u.location != -1) glUniformMatrix3fv(u.location, 1, GL_FALSE, value_ptr(m));
 }
 
-void ShaderProgram::uniform(ZTermString name, mat4 m) {
-    return SetUniform(name, glUniformMatrix4fv, 1, GL_FALSE, value_ptr(m));
+void ShaderProgram::set(Uniform<mat4> u, mat4 m) {
+    if (u.location != -1) glUniformMatrix4fv(u.location, 1, GL_FALSE, value_ptr(m));
 }
 
-void ShaderProgram::uniform(ZTermString name, f32 f) {
-    return SetUniform(name, glUniform1f, f);
+void ShaderProgram::set(Uniform<f32> u, f32 f) {
+    if (u.location != -1) glUniform1f(u.location, f);
 }
 
 Texture::Texture(
@@ -171,6 +328,7 @@ Texture::Texture(
         data
     );
 
+    if (data) GLStats::UploadTexture();
     auto param = tile ? GL_REPEAT : GL_CLAMP_TO_EDGE;
     glTexParameteri(target, GL_TEXTURE_WRAP_S, param);
     glTexParameteri(target, GL_TEXTURE_WRAP_T, param);
@@ -190,6 +348,7 @@ void Texture::bind() const {
 }
 
 void Texture::write(u32 x, u32 y, u32 width, u32 height, const void* data) {
+    bind();
     glTexSubImage2D(
         target,
         0,
@@ -201,6 +360,7 @@ void Texture::write(u32 x, u32 y, u32 width, u32 height, const void* data) {
         type,
         data
     );
+    GLStats::UploadTexture();
 }
 
 template <typename T>
@@ -221,12 +381,14 @@ void VertexBuffer::store(std::span<const T> data) {
     Assert(data.size() == size, "Data size mismatch");
     bind();
     glBufferSubData(GL_ARRAY_BUFFER, 0, data.size_bytes(), data.data());
+    GLStats::UploadBuffer(data.size_bytes());
 }
 
 template <typename T>
 void VertexBuffer::CopyImpl(std::span<const T> data, GLenum usage) {
     bind();
     glBufferData(GL_ARRAY_BUFFER, data.size_bytes(), data.data(), usage);
+    GLStats::UploadBuffer(data.size_bytes());
     size = GLsizei(data.size());
 }
 
@@ -239,6 +401,38 @@ void VertexBuffer::copy_data(Vertices<4> data, GLenum usage) { CopyImpl(data, us
 void VertexBuffer::draw() const {
     bind();
     glDrawArrays(draw_mode, 0, size);
+    GLStats::Draw();
+}
+
+StreamBuffer::StreamBuffer() {
+    glGenBuffers(1, &descriptor);
+}
+
+void StreamBuffer::bind() const { glBindBuffer(GL_ARRAY_BUFFER, descriptor); }
+
+void StreamBuffer::upload(std::span<const std::byte> data) {
+    bind();
+
+    // Orphan the old storage instead of writing into it; this way, the
+    // driver can hand us fresh memory rather than waiting for the GPU
+    // to finish drawing whatever we uploaded last time.
+    if (data.size() > capacity) capacity = std::max(data.size(), 2 * capacity);
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(capacity), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, GLsizeiptr(data.size()), data.data());
+    GLStats::UploadBuffer(data.size());
+}
+
+UniformBuffer::UniformBuffer(usz size, GLuint binding) {
+    glGenBuffers(1, &descriptor);
+    glBindBuffer(GL_UNIFORM_BUFFER, descriptor);
+    glBufferData(GL_UNIFORM_BUFFER, GLsizeiptr(size), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, descriptor);
+}
+
+void UniformBuffer::write(usz offset, std::span<const std::byte> data) {
+    glBindBuffer(GL_UNIFORM_BUFFER, descriptor);
+    glBufferSubData(GL_UNIFORM_BUFFER, GLintptr(offset), GLsizeiptr(data.size()), data.data());
+    GLStats::UploadBuffer(data.size());
 }
 
 template <typename T>
@@ -271,6 +465,29 @@ auto VertexArrays::add_buffer(GLenum draw_mode) -> VertexBuffer& {
     return add_buffer(Vertices<2>{}, draw_mode);
 }
 
+void VertexArrays::add_stream(
+    const StreamBuffer& buffer,
+    usz stride,
+    std::initializer_list<VertexAttribute> attributes,
+    bool per_instance
+) {
+    bind();
+    buffer.bind();
+    for (auto a : attributes) {
+        glEnableVertexAttribArray(a.location);
+        glVertexAttribPointer(
+            a.location,
+            a.components,
+            GL_FLOAT,
+            GL_FALSE,
+            GLsizei(stride),
+            reinterpret_cast<const void*>(a.offset)
+        );
+
+        if (per_instance) glVertexAttribDivisor(a.location, 1);
+    }
+}
+
 void VertexArrays::bind() const { glBindVertexArray(descriptor); }
 
 void VertexArrays::draw_vertices() const {
@@ -278,6 +495,13 @@ void VertexArrays::draw_vertices() const {
     for (const auto& vbo : buffers) vbo.draw();
 }
 
+void VertexArrays::draw_vertices(usz first, usz count) const {
+    Assert(buffers.size() == 1, "Can only draw part of a vertex array with a single buffer");
+    bind();
+    glDrawArrays(buffers.front().draw_mode, GLint(first), GLsizei(count));
+    GLStats::Draw();
+}
+
 void VertexArrays::unbind() const { glBindVertexArray(0); }
 
 void VertexArrays::ApplyLayout() {
@@ -290,6 +514,8 @@ void VertexArrays::ApplyLayout() {
             glEnableVertexAttribArray(0);
             glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, nullptr);
             return;
+        case VertexLayout::Custom:
+            Unreachable("Use add_stream() to attach buffers with a custom layout");
     }
 
     Unreachable("Invalid vertex layout");
@@ -0,0 +1,257 @@
+#include <Client/Render/Profiler.hh>
+#include <Client/Render/Render.hh>
+
+#include <base/Base.hh>
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <iterator>
+
+using namespace pr;
+using namespace pr::client;
+
+namespace {
+constexpr std::array<std::string_view, Profiler::Sections> SectionNames{
+    "Networking",
+    "Refresh",
+    "Tick",
+    "Draw",
+    "Present",
+};
+
+/// Frames that take longer than this are drawn in a different colour.
+constexpr auto FrameBudget = chr::microseconds(16'667);
+
+auto Ms(auto d) -> f64 {
+    return chr::duration<f64, std::milli>(d).count();
+}
+
+auto Us(auto d) -> f64 {
+    return chr::duration<f64, std::micro>(d).count();
+}
+} // namespace
+
+void Profiler::begin_frame() {
+    GLStats::Get() = {};
+    if (not enabled) return;
+    current = {};
+    current.start = Clock::now();
+    current.screen = screen;
+
+    // Measure the GPU with a query that is not still waiting for its
+    // result; if there is none, skip this frame rather than waiting.
+    if (queries.empty()) queries.resize(QueryCount);
+    auto& q = queries[next_query];
+    if (q.frame) return;
+    q.query.begin();
+    q.frame = frames;
+    running_query = &q;
+    next_query = (next_query + 1) % QueryCount;
+}
+
+void Profiler::CollectQueries() {
+    for (auto& q : queries) {
+        if (not q.frame or not q.query.available()) continue;
+
+        // Don’t bother if the frame has already dropped out of the history.
+        auto f = *std::exchange(q.frame, std::nullopt);
+        if (frames - f <= HistorySize) history[f % HistorySize].gpu = q.query.elapsed();
+    }
+}
+
+void Profiler::draw(Renderer& r) {
+    if (not enabled) return;
+    constexpr i32 Padding = 10;
+    constexpr i32 BarWidth = 2;
+    constexpr i32 GraphHeight = 100;
+    constexpr f64 PixelsPerMs = 3;
+
+    constexpr i32 Width = i32(HistorySize) * BarWidth + 2 * Padding;
+    std::vector<Text> texts;
+    i32 text_height = 0;
+    for (auto& l : lines) {
+        auto& t = texts.emplace_back(r.text(l, FontSize::Normal));
+        text_height += t.text_size.ht + Padding / 2;
+    }
+
+    // Put everything in the top left corner.
+    auto [_, ht] = r.size();
+    auto height = GraphHeight + text_height + 3 * Padding;
+    auto top = ht - Padding;
+    r.draw_rect(xy(Padding, top - height), Size(Width, height), Colour{0, 0, 0, 192}, 4);
+
+    auto y = top - Padding;
+    for (auto& t : texts) {
+        y -= i32(t.height);
+        r.draw_text(t, xy(2 * Padding, y));
+        y -= i32(t.depth) + Padding / 2;
+    }
+
+    // One bar per frame, newest on the right, and a line for the budget.
+    auto base = top - height + Padding;
+    auto samples = Samples();
+    auto x = 2 * Padding + i32(HistorySize - samples.size()) * BarWidth;
+    for (auto s : samples) {
+        auto h = std::clamp(i32(Ms(s->total) * PixelsPerMs), 1, GraphHeight);
+        auto c = s->total <= FrameBudget     ? Colour{80, 200, 120, 255}
+               : s->total <= 2 * FrameBudget ? Colour{230, 200, 80, 255}
+                                             : Colour{230, 80, 80, 255};
+        r.draw_rect(xy(x, base), Size(BarWidth, h), c);
+        x += BarWidth;
+    }
+
+    auto budget = base + i32(Ms(FrameBudget) * PixelsPerMs);
+    r.draw_line(xy(2 * Padding, budget), xy(Width, budget), Colour::Grey);
+}
+
+auto Profiler::dump_trace(fs::PathRef path) const -> Result<> {
+    auto samples = Samples();
+    if (samples.empty()) return Error("No frames to write; press F3 to start recording");
+
+    // Sections are complete events nested in the frame they belong to;
+    // the GPU time and the counters are tracked separately since they
+    // aren’t part of the CPU timeline.
+    std::string out = "{\"traceEvents\": [";
+    auto origin = samples.front()->start;
+    for (auto [i, s] : samples | vws::enumerate) {
+        auto ts = Us(s->start - origin);
+        std::format_to(
+            std::back_inserter(out),
+            "{}\n  {{\"name\": \"Frame\", \"ph\": \"X\", \"pid\": 0, \"tid\": 0, \"ts\": {:.3f}, \"dur\": {:.3f}, "
+            "\"args\": {{\"screen\": \"{}\", \"refreshes\": {}}}}}",
+            i == 0 ? "" : ",",
+            ts,
+            Us(s->total),
+            s->screen,
+            s->refreshes
+        );
+
+        for (auto [name, offset, cpu] : vws::zip(SectionNames, s->offset, s->cpu)) {
+            if (cpu == Clock::duration::zero()) continue;
+            std::format_to(
+                std::back_inserter(out),
+                ",\n  {{\"name\": \"{}\", \"ph\": \"X\", \"pid\": 0, \"tid\": 0, \"ts\": {:.3f}, \"dur\": {:.3f}}}",
+                name,
+                ts + Us(offset),
+                Us(cpu)
+            );
+        }
+
+        std::format_to(
+            std::back_inserter(out),
+            ",\n  {{\"name\": \"GL\", \"ph\": \"C\", \"pid\": 0, \"ts\": {:.3f}, \"args\": {{"
+            "\"draw_calls\": {}, \"buffer_uploads\": {}, \"texture_uploads\": {}, \"buffer_kib\": {:.1f}}}}}",
+            ts,
+            s->gl.draw_calls,
+            s->gl.buffer_uploads,
+            s->gl.texture_uploads,
+            f64(s->gl.buffer_bytes) / 1'024
+        );
+
+        if (s->gpu) std::format_to(
+            std::back_inserter(out),
+            ",\n  {{\"name\": \"GPU\", \"ph\": \"C\", \"pid\": 0, \"ts\": {:.3f}, \"args\": {{\"ms\": {:.3f}}}}}",
+            ts,
+            Ms(*s->gpu)
+        );
+    }
+    out += "\n]}\n";
+
+    std::ofstream file{path};
+    file << out;
+    if (not file) return Error("Failed to write trace to '{}'", path.string());
+    return {};
+}
+
+void Profiler::end_frame() {
+    if (not enabled) return;
+    if (running_query) std::exchange(running_query, nullptr)->query.end();
+    current.total = Clock::now() - current.start;
+    current.gl = GLStats::Get();
+    history[frames % HistorySize] = current;
+    frames++;
+
+    CollectQueries();
+    if (current.start - last_update >= 250ms) {
+        last_update = current.start;
+        UpdateOverlay();
+    }
+}
+
+void Profiler::Record(Section s, Clock::time_point start, Clock::time_point end) {
+    auto i = +s;
+    if (current.cpu[i] == Clock::duration::zero()) current.offset[i] = start - current.start;
+    current.cpu[i] += end - start;
+}
+
+auto Profiler::Samples() const -> std::vector<const Sample*> {
+    std::vector<const Sample*> samples;
+    for (auto f = frames - std::min<u64>(frames, HistorySize); f < frames; f++)
+        samples.push_back(&history[f % HistorySize]);
+    return samples;
+}
+
+void Profiler::toggle() {
+    _enabled = not enabled;
+    frames = 0;
+    lines.clear();
+    last_update = {};
+
+    // Forget whatever the queries were measuring; we’ll just reuse them.
+    for (auto& q : queries) q.frame.reset();
+    running_query = nullptr;
+}
+
+void Profiler::UpdateOverlay() {
+    // Only look at frames of the current screen so that switching
+    // to a different screen doesn’t mix up their numbers.
+    auto all = Samples();
+    std::vector<const Sample*> samples;
+    for (auto s : all)
+        if (s->screen == screen) samples.push_back(s);
+    if (samples.empty()) return;
+
+    Clock::duration total{}, worst{};
+    std::array<Clock::duration, Sections> cpu{};
+    chr::nanoseconds gpu{};
+    usz gpu_frames = 0;
+    u32 refreshes = 0;
+    for (auto s : samples) {
+        total += s->total;
+        worst = std::max(worst, s->total);
+        for (auto [sum, d] : vws::zip(cpu, s->cpu)) sum += d;
+        if (s->gpu) {
+            gpu += *s->gpu;
+            gpu_frames++;
+        }
+        refreshes = std::max(refreshes, s->refreshes);
+    }
+
+    auto n = f64(samples.size());
+    auto& last = *samples.back();
+    lines.clear();
+    lines.push_back(std::format(
+        "{}: {:.0f} fps, {:.2f} ms per frame (worst {:.2f} ms) over {} frames",
+        screen.empty() ? "Screen" : screen,
+        n / std::max(chr::duration<f64>(total).count(), 1e-9),
+        Ms(total) / n,
+        Ms(worst),
+        samples.size()
+    ));
+
+    std::string sections;
+    for (auto [name, d] : vws::zip(SectionNames, cpu))
+        std::format_to(std::back_inserter(sections), "{}{} {:.2f}", sections.empty() ? "" : ", ", name, Ms(d) / n);
+    lines.push_back(std::format("CPU (ms): {}", sections));
+    lines.push_back(gpu_frames ? std::format("GPU: {:.2f} ms", Ms(gpu) / f64(gpu_frames)) : "GPU: waiting for results");
+    lines.push_back(std::format(
+        "Last frame: {} draw calls, {} buffer uploads ({:.1f} KiB), {} texture uploads, {} widget refreshes",
+        last.gl.draw_calls,
+        last.gl.buffer_uploads,
+        f64(last.gl.buffer_bytes) / 1'024,
+        last.gl.texture_uploads,
+        last.refreshes
+    ));
+    lines.push_back(std::format("Most widget refreshes in a frame: {}", refreshes));
+}
@@ -1,23 +1,32 @@
 #include <Client/Render/Render.hh>
 
+#include <Shared/File.hh>
+
 #include <base/FS.hh>
 #include <base/Text.hh>
 #include <SDL3/SDL.h>
 #include <webp/decode.h>
 
 #include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
 #include <cstring>
+#include <fcntl.h>
+#include <filesystem>
 #include <hb-ft.h>
 #include <hb.h>
 #include <memory>
 #include <mutex>
 #include <ranges>
 #include <stop_token>
+#include <unistd.h>
 
 // clang-format off
 // Include order matters here!
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include <freetype/ftmodapi.h>
 #include <freetype/tttables.h>
 // clang-format on
 
@@ -72,6 +81,14 @@ constexpr char ImageFragmentShaderData[]{
 #embed "Shaders/Image.frag"
 };
 
+constexpr char ImageArrayVertexShaderData[]{
+#embed "Shaders/ImageArray.vert"
+};
+
+constexpr char ImageArrayFragmentShaderData[]{
+#embed "Shaders/ImageArray.frag"
+};
+
 constexpr char ThrobberVertexShaderData[]{
 #embed "Shaders/Throbber.vert"
 };
@@ -118,11 +135,259 @@ constexpr std::span<const char> Fonts[]{
     DefaultFontBoldItalic,
 };
 
+/// Where rendered glyph atlases are cached.
+///
+/// This is the user’s cache directory if they have one; otherwise, use
+/// a directory next to the executable rather than the working directory,
+/// which may be anywhere.
+auto FontCacheDir() -> fs::Path {
+    if (auto xdg = std::getenv("XDG_CACHE_HOME"); xdg and *xdg) return fs::Path{xdg} / "prescriptivism";
+    if (auto home = std::getenv("HOME"); home and *home) return fs::Path{home} / ".cache" / "prescriptivism";
+    if (auto base = SDL_GetBasePath()) return fs::Path{base} / "cache";
+    return "cache";
+}
+
 // =============================================================================
 //  Colours
 // =============================================================================
 constexpr Colour DefaultBGColour{45, 42, 46, 255};
 
+// =============================================================================
+//  Glyph Atlas
+// =============================================================================
+/// Cached atlases start with this, followed by a version; bump it
+/// whenever the way glyphs are rendered or cached changes.
+constexpr ser::Magic<4> AtlasCacheMagic{"PRFA"};
+constexpr u32 AtlasCacheVersion = 1;
+
+void GlyphAtlas::AddGlyph(FT_UInt glyph) {
+    auto& m = glyphs[glyph];
+    m = {};
+
+    // Render the glyph at the atlas size; hinting is for a specific
+    // size, so don’t, since we draw the glyph at any size.
+    FT_Set_Pixel_Sizes(face, 0, GlyphSize);
+    if (FT_Load_Glyph(face, glyph, FT_LOAD_NO_HINTING) != 0) {
+        Log("Failed to load glyph #{}", glyph);
+        return;
+    }
+
+    // Glyphs without an outline (e.g. spaces) don’t need any space.
+    auto slot = face->glyph;
+    if (slot->format == FT_GLYPH_FORMAT_OUTLINE and slot->outline.n_contours == 0) return;
+    if (FT_Render_Glyph(slot, FT_RENDER_MODE_SDF) != 0) {
+        Log("Failed to render glyph #{}", glyph);
+        return;
+    }
+
+    // The bitmap is padded on every side by the spread.
+    auto& bitmap = slot->bitmap;
+    if (bitmap.width <= 2 * Spread or bitmap.rows <= 2 * Spread) return;
+    m.size = {bitmap.width - 2 * Spread, bitmap.rows - 2 * Spread};
+    m.bearing = {slot->bitmap_left + i32(Spread), slot->bitmap_top - i32(Spread)};
+
+    // Leave a pixel between glyphs so they don’t bleed into one
+    // another when the atlas is sampled.
+    auto wd = bitmap.width + 1;
+    auto ht = bitmap.rows + 1;
+    if (wd > PageSize or ht > PageSize) {
+        Log("Glyph #{} does not fit in the atlas", glyph);
+        m.size = {};
+        return;
+    }
+
+    auto [page_index, shelf] = FindShelf(wd, ht);
+    m.page = page_index;
+    m.x = shelf->width;
+    m.y = shelf->y;
+    shelf->width += wd;
+
+    // If we can, upload just this glyph; the rest of the page stays as is.
+    auto& page = pages[page_index];
+    if (has_context) {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, bitmap.pitch);
+        page.texture.write(m.x, m.y, bitmap.width, bitmap.rows, bitmap.buffer);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        return;
+    }
+
+    for (usz r = 0; r < bitmap.rows; r++) {
+        std::memcpy(
+            page.pixels.data() + (m.y + r) * PageSize + m.x,
+            bitmap.buffer + r * usz(bitmap.pitch),
+            bitmap.width
+        );
+    }
+}
+
+void GlyphAtlas::AddPage() {
+    auto& p = pages.emplace_back();
+    p.pixels.resize(usz(PageSize) * PageSize);
+    if (has_context) Upload(p);
+}
+
+auto GlyphAtlas::FindShelf(u32 wd, u32 ht) -> std::pair<u32, Shelf*> {
+    // Use the lowest shelf that the glyph fits on; we don’t want to put
+    // small glyphs on shelves that are much taller than them, unless the
+    // alternative is starting a new page.
+    auto Find = [&](bool any_height) -> std::pair<u32, Shelf*> {
+        std::pair<u32, Shelf*> best{0, nullptr};
+        for (auto [i, p] : pages | vws::enumerate) {
+            for (auto& s : p.shelves) {
+                if (s.height < ht or s.width + wd > PageSize) continue;
+                if (not any_height and s.height > 2 * ht) continue;
+                if (not best.second or s.height < best.second->height) best = {u32(i), &s};
+            }
+        }
+        return best;
+    };
+
+    if (auto s = Find(false); s.second) return s;
+
+    // Start a new shelf on the last page if there is room for one.
+    if (pages.empty() or pages.back().height + ht > PageSize) {
+        if (auto s = Find(true); s.second) return s;
+        AddPage();
+    }
+
+    auto& p = pages.back();
+    p.shelves.push_back({.y = p.height, .height = ht, .width = 0});
+    p.height += ht;
+    return {u32(pages.size() - 1), &p.shelves.back()};
+}
+
+auto GlyphAtlas::glyph(FT_UInt glyph) -> const Metrics& {
+    auto it = glyphs.find(glyph);
+    if (it != glyphs.end()) return it->second;
+    AddGlyph(glyph);
+    return glyphs.at(glyph);
+}
+
+auto GlyphAtlas::LoadCache(fs::PathRef path, u32 key) -> Result<> {
+    Assert(not has_context and pages.empty(), "Can only load the cache into an empty atlas");
+    auto file = Try(MappedFile::Open(path));
+    ser::Reader r{file->bytes()};
+
+    // Anything that changes what the atlas looks like makes it stale.
+    u32 version{}, cached_key{}, glyph_size{}, spread{}, page_size{};
+    r(AtlasCacheMagic, version, cached_key, glyph_size, spread, page_size);
+    Try(r.result);
+    if (
+        version != AtlasCacheVersion or
+        cached_key != key or
+        glyph_size != GlyphSize or
+        spread != Spread or
+        page_size != PageSize
+    ) return Error("Font cache '{}' is stale", path.string());
+
+    // Read everything before we touch the atlas so a damaged
+    // cache doesn’t leave it half-initialised.
+    std::unordered_map<FT_UInt, Metrics> cached_glyphs;
+    auto glyph_count = r.read_length();
+    for (usz i = 0; i < glyph_count and r; i++) {
+        FT_UInt id{};
+        Metrics m{};
+        r(id, m);
+        cached_glyphs[id] = m;
+    }
+
+    // Only the part of a page that has shelves on it is stored.
+    std::vector<Page> cached_pages;
+    auto page_count = r.read_length();
+    for (usz i = 0; i < page_count and r; i++) {
+        auto& p = cached_pages.emplace_back();
+        r(p.shelves, p.height);
+        if (not r or p.height > PageSize) break;
+        p.pixels.resize(usz(PageSize) * PageSize);
+        r >> std::span{p.pixels}.first(usz(p.height) * PageSize);
+    }
+
+    Try(r.result);
+    if (r.size() != 0 or cached_pages.size() != page_count)
+        return Error("Font cache '{}' is corrupt", path.string());
+
+    // Everything we read is used to index into the pixels, so check that
+    // every shelf and every glyph actually lies within its page. Compute
+    // bounds in 64 bits so huge values can’t wrap around.
+    auto ShelfValid = [&](const Page& p, const Shelf& s) {
+        return u64(s.y) + s.height <= p.height and s.width <= PageSize;
+    };
+
+    auto GlyphValid = [&](const Metrics& m) {
+        if (m.size == vec2()) return true;
+        if (m.page >= cached_pages.size()) return false;
+        if (not (m.size.x >= 0 and m.size.y >= 0 and m.size.x <= PageSize and m.size.y <= PageSize)) return false;
+        auto wd = u64(m.size.x) + 2 * Spread;
+        auto ht = u64(m.size.y) + 2 * Spread;
+        return u64(m.x) + wd <= PageSize and u64(m.y) + ht <= cached_pages[m.page].height;
+    };
+
+    auto corrupt = rgs::any_of(cached_pages, [&](const Page& p) {
+        return rgs::any_of(p.shelves, [&](const Shelf& s) { return not ShelfValid(p, s); });
+    }) or rgs::any_of(cached_glyphs, [&](auto& g) { return not GlyphValid(g.second); });
+
+    if (corrupt) return Error("Font cache '{}' is corrupt", path.string());
+    glyphs = std::move(cached_glyphs);
+    pages = std::move(cached_pages);
+    return {};
+}
+
+void GlyphAtlas::prerender(std::u32string_view chars) {
+    for (auto c : chars) glyph(FT_Get_Char_Index(face, FT_ULong(c)));
+}
+
+void GlyphAtlas::Upload(Page& page) {
+    page.texture = Texture(
+        page.pixels.data(),
+        PageSize,
+        PageSize,
+        GL_RED,
+        GL_UNSIGNED_BYTE
+    );
+
+    page.pixels = {};
+}
+
+auto GlyphAtlas::SaveCache(fs::PathRef path, u32 key) const -> Result<> {
+    Assert(not has_context, "Atlas has already been uploaded");
+    ser::Writer w;
+    w(AtlasCacheMagic, AtlasCacheVersion, key, GlyphSize, Spread, PageSize);
+    w.write_length(glyphs.size());
+    for (auto& [id, m] : glyphs) w(id, m);
+    w.write_length(pages.size());
+    for (auto& p : pages) {
+        w(p.shelves, p.height);
+        w.write(std::span{p.pixels}.first(usz(p.height) * PageSize));
+    }
+
+    // Write to a temporary file first so a cache that we fail to write
+    // completely never replaces a good one.
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    if (ec) return Error("Failed to create '{}': {}", path.parent_path().string(), ec.message());
+
+    auto tmp = path;
+    tmp += ".tmp";
+    auto fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) return Error("Failed to create '{}': {}", tmp.string(), std::strerror(errno));
+    defer { ::close(fd); };
+    for (ser::InputSpan data{w.data}; not data.empty();) {
+        auto n = ::write(fd, data.data(), data.size());
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return Error("Failed to write '{}': {}", tmp.string(), std::strerror(errno));
+        }
+
+        data = ser::InputSpan{data.subspan(usz(n))};
+    }
+
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) return Error("Failed to rename '{}': {}", tmp.string(), ec.message());
+    return {};
+}
+
+void GlyphAtlas::use(u32 page) const { pages[page].texture.bind(); }
+
 // =============================================================================
 //  Text and Fonts
 // =============================================================================
@@ -143,8 +408,9 @@ auto DumpHBBuffer(hb_font_t* font, hb_buffer_t* buf) {
     Log("Buffer: {}", debug);
 }
 
-Font::Font(FT_Face ft_face, FontSize size, TextStyle style)
+Font::Font(FT_Face ft_face, FontSize size, TextStyle style, GlyphAtlas& atlas)
     : face{ft_face},
+      atlas{&atlas},
       _size{size},
       _style{style} {
     // Set the font size.
@@ -157,18 +423,6 @@ Font::Font(FT_Face ft_face, FontSize size, TextStyle style)
     skip = u32(1.2f * +size);
     // skip = u32(ft_face->height / f32(ft_face->units_per_EM) * size);
 
-    // Determine the maximum width and height amongst all glyphs; we
-    // need to do this now to ensure that the dimensions of a cell
-    // don’t change when we add glyphs; otherwise, we’d be invalidating
-    // the uv coordinates of already shaped text.
-    //
-    // Note: we use the advance width for x and the bounding box for y
-    // because that seems to more closely match the data we got from
-    // iterating over every glyph in the font and computing the maximum
-    // metrics.
-    atlas_entry_width = u32(std::ceil(ft_face->max_advance_width / em * +size));
-    atlas_entry_height = u32(std::ceil(+size * (ft_face->bbox.yMax - ft_face->bbox.yMin) / em));
-
     // Create a HarfBuzz font for it.
     auto f = hb_ft_font_create(ft_face, nullptr);
     Assert(f, "Failed to create HarfBuzz font");
@@ -188,10 +442,6 @@ Font::Font(FT_Face ft_face, FontSize size, TextStyle style)
     }
 }
 
-auto Font::atlas_height() const -> i32 {
-    return i32(atlas_rows * atlas_entry_height);
-}
-
 auto Font::bold() -> Font& {
     if (style & TextStyle::Bold) return *this;
     return renderer.font(size, style | TextStyle::Bold);
@@ -201,7 +451,7 @@ auto Font::italic() -> Font& {
     if (style & TextStyle::Italic) return *this;
     return renderer.font(size, style | TextStyle::Italic);
 }
-void Font::use() const { atlas.bind(); }
+void Font::use(u32 page) const { atlas->use(page); }
 
 auto Font::strut() const -> i32 { return i32(strut_asc + strut_desc); }
 auto Font::strut_split() const -> std::pair<i32, i32> { return {strut_asc, strut_desc}; }
@@ -226,10 +476,16 @@ Text::Text(Font& font, std::u32string content, TextAlign align)
 Text::Text(Font& font, std::string_view content, TextAlign align)
     : _align{align}, _content{text::ToUTF32(content)}, _font{&font} {}
 
-void Text::draw_vertices() const { reshape().vertices->draw_vertices(); }
+void Text::draw_vertices() const {
+    reshape();
+    for (auto r : shaped->page_ranges) {
+        font.use(r.page);
+        shaped->vertices.draw_vertices(r.first, r.count);
+    }
+}
 
 auto Text::reshape() const -> const Text& {
-    if (not vertices.has_value()) font.shape(*this, nullptr);
+    if (not shaped) shaped = font.renderer.text_cache.get(*this);
     return *this;
 }
 
@@ -239,31 +495,64 @@ void Text::set_content(std::string_view new_text) {
 
 void Text::set_desired_width(i32 desired) {
     _desired_width = desired;
-    if (not vertices or desired < width or multiline) font.shape(*this, nullptr);
+    if (not shaped or desired < width or multiline) shaped = nullptr;
 }
 
 void Text::set_align(TextAlign new_value) {
     if (_align == new_value) return;
     _align = new_value;
-    vertices = std::nullopt;
+    shaped = nullptr;
 }
 
 void Text::set_content(std::u32string new_value) {
     if (new_value == _content) return;
     _content = std::move(new_value);
-    vertices = std::nullopt;
+    shaped = nullptr;
 }
 
 void Text::set_font_size(FontSize new_size) {
     if (_font->size == new_size) return;
     _font = &Renderer::current().font(new_size, _font->style);
-    vertices = std::nullopt;
+    shaped = nullptr;
 }
 
 void Text::set_style(TextStyle new_value) {
     if (_font->style == new_value) return;
     _font = &Renderer::current().font(_font->size, new_value);
-    vertices = std::nullopt;
+    shaped = nullptr;
+}
+
+// =============================================================================
+//  Shaped Text Cache
+// =============================================================================
+auto ShapedTextCache::KeyHash::operator()(const Key& k) const -> usz {
+    auto h = std::hash<std::u32string_view>{}(k.content);
+    h ^= std::hash<const Font*>{}(k.font) + 0x9e37'79b9'7f4a'7c15 + (h << 6) + (h >> 2);
+    h ^= std::hash<u64>{}(u64(u32(k.desired_width)) << 8 | u64(k.align)) + 0x9e37'79b9'7f4a'7c15 + (h << 6) + (h >> 2);
+    return h;
+}
+
+auto ShapedTextCache::get(const Text& text) -> std::shared_ptr<const ShapedText> {
+    Key key{&text.font, text.content, text.desired_width, text.align};
+    if (auto it = index.find(key); it != index.end()) {
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->shaped;
+    }
+
+    // Shape the text and remember it; the key must refer to the copy
+    // of the contents that we keep.
+    text.font.shape(text, nullptr);
+    auto& e = entries.emplace_front(text.content, text.shaped, key);
+    e.key.content = e.content;
+    index.emplace(e.key, entries.begin());
+
+    // Texts that still use an evicted entry keep it alive.
+    if (entries.size() > capacity) {
+        index.erase(entries.back().key);
+        entries.pop_back();
+    }
+
+    return e.shaped;
 }
 
 // =============================================================================
@@ -289,9 +578,8 @@ void Text::set_style(TextStyle new_value) {
 //   5. Convert the shaped physical lines into vertices and upload the vertex data.
 void Font::shape(const Text& text, std::vector<TextCluster>* clusters) {
     // Reset text properties in case we end up returning early.
-    text.vertices = VertexArrays{VertexLayout::PositionTexture4D};
-    text._width = text._height = text._depth = 0;
-    text._multiline = false;
+    auto out = std::make_shared<ShapedText>();
+    text.shaped = out;
     if (text.empty) return;
 
     // Check that this font has been fully initialised.
@@ -499,95 +787,24 @@ void Font::shape(const Text& text, std::vector<TextCluster>* clusters) {
         return rgs::max_element(lines, {}, &Line::width)->width;
     };
 
-    // Rebuild the font atlas, adding any new glyphs we need.
+    // Add any new glyphs we need to the atlas.
     //
     // We do this this way since precomputing the atlas for the
     // entire font is rather expensive in terms of memory usage
     // (over 100MB for a 96pt font), and time (it takes about 5
     // second to build the atlas...).
-    auto RebuildAtlas = [&] {
-        // Collect all glyphs that are not part of the atlas.
+    auto AddMissingGlyphs = [&] {
         for (auto& l : lines) {
             auto [infos, _] = GetInfo(l.buf, l.start, l.end);
-            for (auto& i : infos) {
-                // If the glyph is already in the atlas, we don’t need to do anything here.
-                auto g = i.codepoint;
-                if (auto it = glyphs.find(i.codepoint); it != glyphs.end()) continue;
-
-                // Load the glyph’s metrics.
-                glyphs_ordered.push_back(g);
-                if (FT_Load_Glyph(face, g, FT_LOAD_BITMAP_METRICS_ONLY) != 0) {
-                    Log("Failed to load glyph #{}", g);
-                    glyphs[g] = {};
-                    continue;
-                }
-
-                glyphs[g] = {
-                    .atlas_index = u32(glyphs_ordered.size() - 1),
-                    .size = {face->glyph->bitmap.width, face->glyph->bitmap.rows},
-                    .bearing = {face->glyph->bitmap_left, face->glyph->bitmap_top},
-                };
-            }
+            for (auto& i : infos) atlas->glyph(i.codepoint);
         }
-
-        // At this point, we know what glyphs we need.
-        if (atlas_entries == glyphs_ordered.size()) return;
-        defer { atlas_entries = u32(glyphs_ordered.size()); };
-
-        // Determine how many characters we can fit in a single row since an
-        // entire font tends to exceed OpenGL’s texture size limits in terms
-        // of width.
-        auto max_columns = Texture::MaxSize() / atlas_entry_width;
-        atlas_rows = u32(std::ceil(f64(glyphs_ordered.size()) / max_columns));
-        auto texture_height = atlas_height();
-        auto atlas_columns = atlas_width / atlas_entry_width;
-
-        // Allocate memory for the texture.
-        atlas_buffer.resize(usz(atlas_width * texture_height));
-
-        // Add new glyphs to the atlas.
-        //
-        // Old glyphs don’t need to be updated since they don’t move because we
-        // keep the atlas *width* constant.
-        for (auto [i, glyph_index] : glyphs_ordered | vws::drop(atlas_entries) | vws::enumerate) {
-            // This *should* never fail because we're loading glyphs and
-            // not codepoints, but prefer not to crash if it does fail.
-            if (FT_Load_Glyph(face, glyph_index, FT_LOAD_RENDER) != 0) {
-                Log("Failed to load glyph #{}", glyph_index);
-                continue;
-            }
-
-            // Index should start at the first new entry.
-            i += atlas_entries;
-            u32 row = u32(i) / atlas_columns;
-            u32 col = u32(i) % atlas_columns;
-
-            // Copy the glyph’s bitmap data into the atlas.
-            // TODO: Optimisation: If the bitmap is empty (i.e. every cell is 0), then
-            //       we should not create any vertices for this glyph below.
-            for (usz r = 0; r < face->glyph->bitmap.rows; r++) {
-                std::memcpy(
-                    atlas_buffer.data() + (row * atlas_entry_height + r) * u32(atlas_width) + col * atlas_entry_width,
-                    face->glyph->bitmap.buffer + r * face->glyph->bitmap.width,
-                    face->glyph->bitmap.width
-                );
-            }
-        }
-
-        // Rebuild the texture.
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        atlas = Texture(
-            atlas_buffer.data(),
-            atlas_width,
-            texture_height,
-            GL_RED,
-            GL_UNSIGNED_BYTE
-        );
     };
 
-    // Add the vertices for a line to the vertex buffer.
-    std::vector<vec4> verts;
-    auto atlas_columns = atlas_width / atlas_entry_width;
+    // Add the vertices for a line to the vertex buffer; we keep the
+    // vertices of each atlas page together so we can draw them with
+    // one draw call per page.
+    std::vector<std::vector<vec4>> verts;
+    const f32 glyph_scale = f32(+size) / GlyphAtlas::GlyphSize;
     auto AddVertices = [&](const Line& l, f32 xbase, f32 ybase) -> std::pair<f32, f32> {
         auto [infos, positions] = GetInfo(l.buf, l.start, l.end);
         f32 x = xbase;
@@ -600,51 +817,48 @@ void Font::shape(const Text& text, std::vector<TextCluster>* clusters) {
 
             // Note: 'codepoint' here is actually a glyph index in the
             // font after shaping, and not a codepoint.
-            auto& g = glyphs.at(u32(info.codepoint));
+            auto& g = atlas->glyph(u32(info.codepoint));
             f32 xoffs = pos.x_offset / f32(Scale);
             f32 xadv = pos.x_advance / f32(Scale);
             f32 yoffs = pos.y_offset / f32(Scale);
 
             // Compute the x and y position using the glyph’s metrics and
-            // the shaping data provided by HarfBuzz.
-            f32 desc = g.size.y - g.bearing.y;
-            f32 xpos = x + g.bearing.x + xoffs;
+            // the shaping data provided by HarfBuzz; the metrics are for
+            // the size of the atlas, so scale them to ours.
+            f32 desc = (g.size.y - g.bearing.y) * glyph_scale;
+            f32 xpos = x + g.bearing.x * glyph_scale + xoffs;
             f32 ypos = ybase + yoffs - desc;
-            f32 w = g.size.x;
-            f32 h = g.size.y;
-
-            // Compute the offset of the glyph in the atlas.
-            f64 tx = f64(g.atlas_index % atlas_columns) * atlas_entry_width;
-            f64 ty = f64(g.atlas_index / atlas_columns) * atlas_entry_height;
-
-            // Compute the uv coordinates of the glyph; note that the glyph
-            // is likely smaller than the width of an atlas cell, so perform
-            // this calculation in pixels.
-            //
-            // The atlas width is constant, so we can factor it into the U
-            // coordinate’s calculation here and now. On the other hand, the
-            // V coordinate may have to change since the atlas *height* may
-            // change; we deal with this by computing the actual V coordinate
-            // in the vertex shader by passing the current atlas height as
-            // a uniform, for which reason we encode absolute V coordinates
-            // here.
-            f32 u0 = f32(f64(tx) / atlas_width);
-            f32 u1 = f32(f64(tx + w) / atlas_width);
-            f32 v0 = f32(ty);
-            f32 v1 = f32(ty + h);
+            f32 w = g.size.x * glyph_scale;
+            f32 h = g.size.y * glyph_scale;
+
+            // Compute the uv coordinates of the glyph; the quad includes
+            // the padding of the distance field so the edges stay smooth.
+            constexpr f32 PageSize = GlyphAtlas::PageSize;
+            constexpr u32 Spread = GlyphAtlas::Spread;
+            f32 pad = Spread * glyph_scale;
+            f32 u0 = g.x / PageSize;
+            f32 u1 = (g.x + g.size.x + 2 * Spread) / PageSize;
+            f32 v0 = g.y / PageSize;
+            f32 v1 = (g.y + g.size.y + 2 * Spread) / PageSize;
 
             // Advance past the glyph.
             x += xadv;
             line_ht = std::max(line_ht, yoffs - desc + h);
             line_dp = std::max(line_dp, desc);
 
+            // Glyphs without a bitmap don’t need any vertices.
+            if (w == 0 or h == 0) continue;
+
             // Build vertices for the glyph’s position and texture coordinates.
-            verts.push_back({xpos, ypos + h, u0, v0});
-            verts.push_back({xpos, ypos, u0, v1});
-            verts.push_back({xpos + w, ypos, u1, v1});
-            verts.push_back({xpos, ypos + h, u0, v0});
-            verts.push_back({xpos + w, ypos, u1, v1});
-            verts.push_back({xpos + w, ypos + h, u1, v0});
+            f32 x0 = xpos - pad, x1 = xpos + w + pad;
+            f32 y0 = ypos - pad, y1 = ypos + h + pad;
+            auto& v = verts[g.page];
+            v.push_back({x0, y1, u0, v0});
+            v.push_back({x0, y0, u0, v1});
+            v.push_back({x1, y0, u1, v1});
+            v.push_back({x0, y1, u0, v0});
+            v.push_back({x1, y0, u1, v1});
+            v.push_back({x1, y1, u1, v0});
         }
 
         return {line_ht, line_dp};
@@ -654,10 +868,11 @@ void Font::shape(const Text& text, std::vector<TextCluster>* clusters) {
     auto lines_to_shape = u32stream{text.content}.lines() | vws::transform(&u32stream::text) | rgs::to<std::vector>();
     if (lines_to_shape.empty()) return;
     f32 max_x = ShapeLines(lines_to_shape);
-    text._multiline = lines.size() > 1;
+    out->multiline = lines.size() > 1;
 
-    // Rebuild the texture atlas.
-    RebuildAtlas();
+    // Update the texture atlas.
+    AddMissingGlyphs();
+    verts.resize(atlas->page_count());
 
     // Finally, add vertices for each line.
     f32 ybase = 0;
@@ -692,10 +907,17 @@ void Font::shape(const Text& text, std::vector<TextCluster>* clusters) {
     }
 
     // And upload the vertices.
-    text.vertices->add_buffer().copy_data(verts);
-    text._width = max_x;
-    text._height = ht;
-    text._depth = dp;
+    std::vector<vec4> all;
+    for (auto [page, v] : verts | vws::enumerate) {
+        if (v.empty()) continue;
+        out->page_ranges.push_back({u32(page), u32(all.size()), u32(v.size())});
+        all.insert(all.end(), v.begin(), v.end());
+    }
+
+    out->vertices.add_buffer().copy_data(all);
+    out->width = max_x;
+    out->height = ht;
+    out->depth = dp;
 }
 
 // =============================================================================
@@ -787,6 +1009,11 @@ Renderer::Renderer(int initial_wd, int initial_ht, bool set_active) {
         std::span{ImageFragmentShaderData}
     );
 
+    image_array_shader = ShaderProgram(
+        std::span{ImageArrayVertexShaderData},
+        std::span{ImageArrayFragmentShaderData}
+    );
+
     throbber_shader = ShaderProgram(
         std::span{ThrobberVertexShaderData},
         std::span{ThrobberFragmentShaderData}
@@ -797,9 +1024,17 @@ Renderer::Renderer(int initial_wd, int initial_ht, bool set_active) {
         std::span{RectangleFragmentShaderData}
     );
 
-    // Enable blending.
+    // Enable blending. Alpha is blended separately so that drawing into
+    // an empty framebuffer yields premultiplied colours; see draw_to().
     glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    // Set up the matrices shared by all shaders.
+    transforms = UniformBuffer(sizeof(Transforms), TransformsBinding);
+    LocateUniforms();
+
+    // Set up batching.
+    batch.emplace();
 
     // Make this the current renderer.
     if (set_active) SetThreadRenderer(*this);
@@ -826,23 +1061,180 @@ void Renderer::SetThreadRenderer(Renderer& r) {
 Renderer::Frame::Frame(Renderer& r) : r(r) { r.frame_start(); }
 Renderer::Frame::~Frame() { r.frame_end(); }
 
+// =============================================================================
+//  Batching
+// =============================================================================
+Renderer::Batch::Batch() {
+    vertex_vao.add_stream(
+        vertex_buffer,
+        sizeof(Vertex),
+        {
+            {0, 4, offsetof(Vertex, vertex)},
+            {1, 4, offsetof(Vertex, colour)},
+            {2, 1, offsetof(Vertex, layer)},
+        }
+    );
+
+    // Every rectangle is an instance of this square, which the vertex
+    // shader moves into place and scales to the rectangle’s size.
+    static const vec2 Corners[]{{0, 0}, {1, 0}, {0, 1}, {1, 1}};
+    unit_square.upload(std::as_bytes(std::span{Corners}));
+    rect_vao.add_stream(unit_square, sizeof(vec2), {{0, 2, 0}});
+    rect_vao.add_stream(
+        rect_buffer,
+        sizeof(Rect),
+        {
+            {1, 4, offsetof(Rect, placement)},
+            {2, 4, offsetof(Rect, region)},
+            {3, 4, offsetof(Rect, colour)},
+            {4, 2, offsetof(Rect, size)},
+        },
+        true
+    );
+}
+
+void Renderer::AddRect(xy pos, Size size, vec4 region, Colour c, i32 border_radius) {
+    BeginBatch(Batch::Kind::Rects);
+    auto& m = matrix_stack.back();
+    auto origin = m * vec4(pos.x, pos.y, 0, 1);
+    batch->rects.push_back({
+        .placement = {origin.x, origin.y, m[0][0], f32(border_radius)},
+        .region = region,
+        .colour = c.vec4(),
+        .size = size.vec(),
+    });
+}
+
+void Renderer::AddTexturedQuad(
+    Batch::Kind kind,
+    const void* texture,
+    xy pos,
+    const std::array<vec4, 4>& quad,
+    f32 layer
+) {
+    BeginBatch(kind, texture);
+
+    // The quad is a triangle strip, which we can’t join to other quads,
+    // so split it into two triangles.
+    auto& m = matrix_stack.back();
+    for (auto i : {0, 1, 2, 2, 1, 3}) {
+        auto v = quad[i];
+        auto p = m * vec4(f32(pos.x) + v.x, f32(pos.y) + v.y, 0, 1);
+        batch->vertices.push_back({{p.x, p.y, v.z, v.w}, vec4(1), layer});
+    }
+}
+
+void Renderer::BeginBatch(Batch::Kind kind, const void* texture) {
+    if (batch->kind != kind or batch->texture != texture) Flush();
+    batch->kind = kind;
+    batch->texture = texture;
+}
+
+void Renderer::Flush() {
+    auto& b = *batch;
+    defer {
+        b.kind = Batch::Kind::None;
+        b.texture = nullptr;
+        b.vertices.clear();
+        b.rects.clear();
+    };
+
+    // Everything in the batch is already in screen coordinates, so
+    // the shaders only need the projection, which is set once a frame.
+    if (b.kind != Batch::Kind::None) GLStats::Draw();
+    switch (b.kind) {
+        case Batch::Kind::None:
+            return;
+
+        case Batch::Kind::Lines:
+            primitive_shader.use_shader_program_dont_call_this_directly();
+            b.vertex_buffer.upload(std::as_bytes(std::span{b.vertices}));
+            b.vertex_vao.bind();
+            glDrawArrays(GL_LINES, 0, GLsizei(b.vertices.size()));
+            return;
+
+        case Batch::Kind::Rects:
+            rect_shader.use_shader_program_dont_call_this_directly();
+            b.rect_buffer.upload(std::as_bytes(std::span{b.rects}));
+            b.rect_vao.bind();
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(b.rects.size()));
+            return;
+
+        case Batch::Kind::Textured:
+            image_shader.use_shader_program_dont_call_this_directly();
+            static_cast<const Texture*>(b.texture)->bind();
+            b.vertex_buffer.upload(std::as_bytes(std::span{b.vertices}));
+            b.vertex_vao.bind();
+            glDrawArrays(GL_TRIANGLES, 0, GLsizei(b.vertices.size()));
+            return;
+
+        case Batch::Kind::Composite:
+            image_shader.use_shader_program_dont_call_this_directly();
+            static_cast<const Texture*>(b.texture)->bind();
+            b.vertex_buffer.upload(std::as_bytes(std::span{b.vertices}));
+            b.vertex_vao.bind();
+            glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+            glDrawArrays(GL_TRIANGLES, 0, GLsizei(b.vertices.size()));
+            glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+            return;
+
+        case Batch::Kind::TexturedArray:
+            image_array_shader.use_shader_program_dont_call_this_directly();
+            static_cast<const TextureArray*>(b.texture)->bind();
+            b.vertex_buffer.upload(std::as_bytes(std::span{b.vertices}));
+            b.vertex_vao.bind();
+            glDrawArrays(GL_TRIANGLES, 0, GLsizei(b.vertices.size()));
+            return;
+    }
+
+    Unreachable("Invalid batch kind");
+}
+
+void Renderer::LocateUniforms() {
+    for (auto s : {&primitive_shader, &text_shader, &image_shader, &image_array_shader, &throbber_shader, &rect_shader})
+        s->bind_block("Transforms", TransformsBinding);
+
+    text_uniforms.colour = text_shader.locate<vec4>("text_colour");
+    throbber_uniforms.position = throbber_shader.locate<vec2>("position");
+    throbber_uniforms.rotation = throbber_shader.locate<mat4>("rotation");
+    throbber_uniforms.r = throbber_shader.locate<f32>("r");
+}
+
 // =============================================================================
 //  Drawing
 // =============================================================================
 void Renderer::clear(Colour c) {
+    Flush();
     auto [sx, sy] = size();
     glViewport(0, 0, sx, sy);
     glClearColor(c.r, c.g, c.b, c.a);
     glClear(GL_COLOR_BUFFER_BIT);
 }
 
+void Renderer::draw_framebuffer(const Framebuffer& fb, xy pos, f32 scale) {
+    // Framebuffers aren’t flipped, unlike images, since we draw them
+    // the same way up as we read them.
+    auto sz = fb.size.vec() / scale;
+    AddTexturedQuad(
+        Batch::Kind::Composite,
+        &fb.texture(),
+        pos,
+        {
+            vec4{0, 0, 0, 0},
+            vec4{sz.x, 0, 1, 0},
+            vec4{0, sz.y, 0, 1},
+            vec4{sz.x, sz.y, 1, 1},
+        }
+    );
+}
+
 void Renderer::draw_line(xy start, xy end, Colour c) {
-    use(primitive_shader, {});
-    primitive_shader.uniform("in_colour", c.vec4());
-    VertexArrays vao{VertexLayout::Position2D};
-    vec2 verts[]{start.vec(), end.vec()};
-    vao.add_buffer(verts, GL_LINES);
-    vao.draw_vertices();
+    BeginBatch(Batch::Kind::Lines);
+    auto& m = matrix_stack.back();
+    for (auto p : {start, end}) {
+        auto v = m * vec4(p.x, p.y, 0, 1);
+        batch->vertices.push_back({{v.x, v.y, 0, 0}, c.vec4(), 0});
+    }
 }
 
 void Renderer::draw_outline_rect(
@@ -856,73 +1248,27 @@ void Renderer::draw_outline_rect(
     auto size = box.size();
     auto [wd, ht] = size;
     auto [tx, ty] = thickness;
-    use(rect_shader, pos);
-    rect_shader.uniform("in_colour", c.vec4());
-    rect_shader.uniform("size", size.vec());
-    rect_shader.uniform("radius", border_radius);
-    VertexArrays vao{VertexLayout::Position2D};
 
     // Draw four rectangles around the original rectangle.
     //
-    // These vertices actually draw a rectangle *inside* 'box', but
+    // These actually draw parts of a rectangle *inside* 'box', but
     // we grow 'box' by the thickness of the outline, so the result
     // is an outline around what the user passed in.
     //
     // We do it this way because the rectangle shader can only draw
     // the inside of a rectangle.
-    vec2 verts[]{
-        // Left, inner.
-        {0, ty},
-        {tx, ty},
-        {tx, ht - ty},
-        {tx, ht - ty},
-        {0, ty},
-        {0, ht - ty},
-
-        // Right, inner.
-        {wd - tx, 0},
-        {wd, 0},
-        {wd - tx, ht},
-        {wd - tx, ht},
-        {wd, 0},
-        {wd, ht},
-
-        // Top, outer.
-        {0, ht - ty},
-        {0, ht},
-        {wd, ht - ty},
-        {wd, ht - ty},
-        {0, ht},
-        {wd, ht},
-
-        // Bottom, outer.
-        {0, 0},
-        {0, ty},
-        {wd, ty},
-        {wd, ty},
-        {0, 0},
-        {wd, 0},
-
+    vec4 regions[]{
+        {0, ty, tx, ht - ty}, // Left, inner.
+        {wd - tx, 0, wd, ht}, // Right, inner.
+        {0, ht - ty, wd, ht}, // Top, outer.
+        {0, 0, wd, ty},       // Bottom, outer.
     };
 
-    vao.add_buffer(verts, GL_TRIANGLES);
-    vao.draw_vertices();
+    for (auto r : regions) AddRect(pos, size, r, c, border_radius);
 }
 
 void Renderer::draw_rect(xy pos, Size size, Colour c, i32 border_radius) {
-    use(rect_shader, pos);
-    rect_shader.uniform("in_colour", c.vec4());
-    rect_shader.uniform("size", size.vec());
-    rect_shader.uniform("radius", border_radius);
-    VertexArrays vao{VertexLayout::Position2D};
-    vec2 verts[]{
-        {0, 0},
-        {size.wd, 0},
-        {0, size.ht},
-        {size.wd, size.ht}
-    };
-    vao.add_buffer(verts, GL_TRIANGLE_STRIP);
-    vao.draw_vertices();
+    AddRect(pos, size, {0, 0, size.wd, size.ht}, c, border_radius);
 }
 
 void Renderer::draw_text(
@@ -934,13 +1280,9 @@ void Renderer::draw_text(
 
     // Initialise the text shader.
     use(text_shader, pos);
-    text_shader.uniform("text_colour", colour.vec4());
-    text_shader.uniform("atlas_height", text.font.atlas_height());
-
-    // Bind the font atlas.
-    text.font.use();
+    text_shader.set(text_uniforms.colour, colour.vec4());
 
-    // Dew it.
+    // Dew it; this binds the atlas pages that the text uses.
     text.draw_vertices();
 }
 
@@ -948,34 +1290,75 @@ void Renderer::draw_texture(
     const DrawableTexture& tex,
     xy pos
 ) {
-    use(image_shader, pos);
-    tex.draw_vertices();
+    AddTexturedQuad(Batch::Kind::Textured, &tex, pos, tex.create_vertices(tex.size));
+}
+
+void Renderer::draw_texture(const ArrayImage& img, xy pos) {
+    AddTexturedQuad(Batch::Kind::TexturedArray, img.array, pos, img.create_vertices(img.size), f32(img.layer));
 }
 
 void Renderer::draw_texture_scaled(const DrawableTexture& tex, xy pos, f32 scale) {
-    use(image_shader, pos);
-    tex.bind();
-    VertexArrays vao{VertexLayout::PositionTexture4D};
-    vao.add_buffer(tex.create_vertices_scaled(scale), GL_TRIANGLE_STRIP);
-    vao.draw_vertices();
+    AddTexturedQuad(Batch::Kind::Textured, &tex, pos, tex.create_vertices_scaled(scale));
+}
+
+void Renderer::draw_texture_scaled(const ArrayImage& img, xy pos, f32 scale) {
+    AddTexturedQuad(Batch::Kind::TexturedArray, img.array, pos, img.create_vertices_scaled(scale), f32(img.layer));
 }
 
 void Renderer::draw_texture_sized(const DrawableTexture& tex, AABB box) {
-    use(image_shader, box.origin());
-    tex.bind();
-    VertexArrays vao{VertexLayout::PositionTexture4D};
-    vao.add_buffer(tex.create_vertices(box.size()), GL_TRIANGLE_STRIP);
-    vao.draw_vertices();
+    AddTexturedQuad(Batch::Kind::Textured, &tex, box.origin(), tex.create_vertices(box.size()));
+}
+
+void Renderer::draw_texture_sized(const ArrayImage& img, AABB box) {
+    AddTexturedQuad(Batch::Kind::TexturedArray, img.array, box.origin(), img.create_vertices(box.size()), f32(img.layer));
+}
+
+auto Renderer::draw_to(Framebuffer& fb, f32 scale) -> TargetRAII {
+    Assert(not target, "Cannot nest framebuffers");
+    Flush();
+    target = &fb;
+    fb.bind();
+
+    auto [wd, ht] = fb.size;
+    glViewport(0, 0, wd, ht);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    transforms.write(offsetof(Transforms, projection), glm::ortho<f32>(0, f32(wd), 0, f32(ht)));
+    matrix_stack.push_back(glm::scale(mat4(1), {scale, scale, 1}));
+    return TargetRAII{*this};
+}
+
+void Renderer::EndTarget() {
+    Flush();
+    target = nullptr;
+    matrix_stack.pop_back();
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    auto [sx, sy] = size();
+    glViewport(0, 0, sx, sy);
+    transforms.write(offsetof(Transforms, projection), glm::ortho<f32>(0, sx, 0, sy));
 }
 
 void Renderer::frame_end() {
-    // Swap buffers.
-    check SDL_GL_SwapWindow(*window);
+    // Draw the overlay last so it ends up on top of everything.
+    profiler.draw(*this);
+    profiler.measure(Profiler::Section::Present, [&] {
+        Flush();
+
+        // Swap buffers.
+        check SDL_GL_SwapWindow(*window);
+    });
+    profiler.end_frame();
 }
 
 void Renderer::frame_start() {
+    profiler.begin_frame();
     clear(DefaultBGColour);
 
+    // The window may have been resized since the last frame.
+    auto [sx, sy] = size();
+    transforms.write(offsetof(Transforms, projection), glm::ortho<f32>(0, sx, 0, sy));
+
     // Disable mouse capture if the debugger is running.
     if (libassert::is_debugger_present()) {
         check SDL_SetHint(SDL_HINT_MOUSE_AUTO_CAPTURE, "0");
@@ -990,30 +1373,26 @@ void Renderer::frame_start() {
 }
 
 void Renderer::use(ShaderProgram& shader, xy position) {
-    auto [sx, sy] = size();
+    Flush();
     shader.use_shader_program_dont_call_this_directly();
 
-    auto m = matrix_stack.back();
-    m = glm::translate(m, {position.x, position.y, 0});
-    m = glm::ortho<f32>(0, sx, 0, sy) * m;
-
-    shader.uniform("transform", m);
+    auto m = glm::translate(matrix_stack.back(), {position.x, position.y, 0});
+    transforms.write(offsetof(Transforms, model), m);
 }
 
 // =============================================================================
 //  Creating Objects
 // =============================================================================
 auto Renderer::font(FontSize size, TextStyle style) -> Font& {
-    // Make sure the font exists.
-    auto it = font_data.fonts.find({+size, style});
-    Assert(
-        it != font_data.fonts.end(),
-        "Font with size {} and style {} has not been built yet. Make sure to "
-        "load this font size in the asset loader (AssetLoader::load()) if you "
-        "want to use it",
-        +size,
-        +style
-    );
+    // Fonts share the atlas of their face, so they are cheap enough
+    // to create whenever we need a size we haven’t used before.
+    auto [it, inserted] = font_data.fonts.try_emplace({+size, style});
+    if (inserted) {
+        auto& atlas = font_data.atlases[+style];
+        Assert(atlas, "Fonts have not been loaded yet; did you forget to call finalise()?");
+        it->second = Font{*font_data.ft_face[+style], size, style, *atlas};
+        it->second._renderer = this;
+    }
 
     return it->second;
 }
@@ -1036,11 +1415,14 @@ void Renderer::reload_shaders() {
         program = ShaderProgram{vert.view(), frag.view()};
     };
 
+    Flush();
     Reload(primitive_shader, "Primitive");
     Reload(text_shader, "Text");
     Reload(image_shader, "Image");
+    Reload(image_array_shader, "ImageArray");
     Reload(throbber_shader, "Throbber");
     Reload(rect_shader, "Rectangle");
+    LocateUniforms();
 }
 
 void Renderer::set_cursor(Cursor c) {
@@ -1118,6 +1500,12 @@ void AssetLoader::load(std::stop_token stop) {
     for (auto f : {Regular, Italic, Bold, BoldItalic}) {
         if (stop.stop_requested()) return;
         ftcall FT_Init_FreeType(&*font_data.ft[+f]);
+
+        // The default spread is too small to scale glyphs up much.
+        FT_Int spread = GlyphAtlas::Spread;
+        ftcall FT_Property_Set(*font_data.ft[+f], "sdf", "spread", &spread);
+        ftcall FT_Property_Set(*font_data.ft[+f], "bsdf", "spread", &spread);
+
         ftcall FT_New_Memory_Face(
             *font_data.ft[+f],
             reinterpret_cast<const FT_Byte*>(Fonts[+f].data()),
@@ -1127,22 +1515,29 @@ void AssetLoader::load(std::stop_token stop) {
         );
     }
 
-    // Load each predefined font.
-    for (
-        auto f : {
-            FontSize::Small,
-            FontSize::Normal,
-            FontSize::Intermediate,
-            FontSize::Medium,
-            FontSize::Large,
-            FontSize::Huge,
-            FontSize::Title,
-            FontSize::Gargantuan,
-        }
-    ) {
-        for (auto s : {Regular, Italic, Bold, BoldItalic})
-            font_data.fonts[{+f, s}] = Font{*font_data.ft_face[+s], f, s};
+    // Render the glyphs that almost all text needs now, so the atlases
+    // don’t have to grow during the first few frames.
+    static constexpr std::u32string_view Prerendered =
+        U" !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+        U"[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~";
+
+    // Rendering distance fields is slow, so we cache the atlases on disk
+    // and only render them again if the font has changed since.
+    for (auto f : {Regular, Italic, Bold, BoldItalic}) {
+        if (stop.stop_requested()) return;
+        auto& atlas = *(font_data.atlases[+f] = std::make_unique<GlyphAtlas>(*font_data.ft_face[+f]));
+        auto key = Checksum(ser::InputSpan{Fonts[+f]});
+        auto path = FontCacheDir() / std::format("font-{}.atlas", +f);
+        auto cached = atlas.LoadCache(path, key);
+        if (cached) continue;
+
+        Log<LogLevel::Debug>("Not using font cache: {}", cached.error());
+        atlas.prerender(Prerendered);
+        if (auto saved = atlas.SaveCache(path, key); not saved)
+            Log<LogLevel::Warning>("Failed to write font cache: {}", saved.error());
     }
+
+    // Fonts themselves are created on demand; see Renderer::font().
 }
 
 /// Finish loading assets.
@@ -1152,8 +1547,8 @@ void AssetLoader::finalise(Renderer& r) {
 
     // Build font textures.
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    for (auto& [_, f] : r.font_data.fonts) {
-        f._renderer = &r;
-        f.atlas_width = Texture::MaxSize();
+    for (auto& a : r.font_data.atlases) {
+        a->has_context = true;
+        for (auto& p : a->pages) a->Upload(p);
     }
 }
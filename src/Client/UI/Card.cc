@@ -33,8 +33,8 @@ struct PowerCardData {
     /// Path to the image.
     std::string_view image_path;
 
-    /// Cached image texture.
-    LateInit<DrawableTexture> image{};
+    /// The image, once the card art has been uploaded.
+    mutable ArrayImage image{};
 
     explicit PowerCardData(
         std::string_view image_path,
@@ -268,17 +268,28 @@ namespace pr::client {
 using power_card_database::PowerCardDatabase;
 }
 
-/// The texture used to indicate that a stack is locked.
-LateInit<DrawableTexture> LockedTexture;
+/// All card art, and the icon used to indicate that a stack is locked,
+/// which is the first image in it; keeping all of these in a single
+/// texture means the card images can be drawn without rebinding.
+LateInit<TextureArray> CardArt;
+ArrayImage LockedTexture;
+
+auto client::DecodeCardArt(std::stop_token stop) -> ImageData {
+    std::vector<fs::Path> paths{"assets/locked.webp"};
+    for (auto& p : PowerCardDatabase) paths.push_back(fs::Path{"assets/Cards"} / p.image_path);
+
+    // Most cards don’t have art yet; don’t log every one of them.
+    SilenceLog _;
+    return ImageData::Decode(paths, stop);
+}
 
 // This only takes a renderer to ensure that it is called
 // after the renderer has been initialised.
-void client::InitialiseUI(Renderer&) {
-    LockedTexture.init(DrawableTexture::LoadFromFile("assets/locked.webp"));
-    SilenceLog _;
-    for (auto& p : PowerCardDatabase) {
-        p.image.init(DrawableTexture::LoadFromFile(fs::Path{"assets/Cards"} / p.image_path));
-    }
+void client::InitialiseUI(Renderer&, const ImageData& card_art) {
+    CardArt.init(card_art);
+    LockedTexture = CardArt->image(0);
+    for (auto [i, p] : PowerCardDatabase | vws::enumerate)
+        p.image = CardArt->image(u32(i + 1));
 }
 
 // =============================================================================
@@ -301,29 +312,36 @@ Card::Card(
 
 void Card::draw(Renderer& r) {
     auto _ = PushTransform(r);
-    auto colour = variant == Variant::Regular ? outline_colour : outline_colour.darken(.2f);
     AABB rect{{0, 0}, CardSize[scale]};
-    r.draw_rect(rect, colour.lighten(.1f), BorderRadius[scale]);
-    if (selected) r.draw_outline_rect(
-        rect,
-        CardStacks::CardGaps[scale] / 2,
-        Colour{50, 50, 200, 255},
-        BorderRadius[scale]
-    );
 
-    r.draw_outline_rect(
-        rect.shrink(Border[scale].wd, Border[scale].ht),
-        Size{Border[scale]},
-        colour,
-        BorderRadius[scale]
-    );
+    // Cards are made up of a lot of draws but hardly ever change, so
+    // only draw them again if they do. The selection outline is outside
+    // the card, so it isn’t part of that.
+    auto key = u64(+overlay) | u64(+variant) << 8;
+    DrawCached(r, CardSize[scale], key, [&] {
+        auto colour = variant == Variant::Regular ? outline_colour : outline_colour.darken(.2f);
+        r.draw_rect(rect, colour.lighten(.1f), BorderRadius[scale]);
+        r.draw_outline_rect(
+            rect.shrink(Border[scale].wd, Border[scale].ht),
+            Size{Border[scale]},
+            colour,
+            BorderRadius[scale]
+        );
 
-    DrawChildren(r);
+        DrawChildren(r);
 
-    // Draw a white rectangle on top of this card if it is inactive.
-    if (overlay == Overlay::Inactive) r.draw_rect(
+        // Draw a white rectangle on top of this card if it is inactive.
+        if (overlay == Overlay::Inactive) r.draw_rect(
+            rect,
+            Colour{255, 255, 255, 200},
+            BorderRadius[scale]
+        );
+    });
+
+    if (selected) r.draw_outline_rect(
         rect,
-        Colour{255, 255, 255, 200},
+        CardStacks::CardGaps[scale] / 2,
+        Colour{50, 50, 200, 255},
         BorderRadius[scale]
     );
 
@@ -356,6 +374,8 @@ void Card::DrawChildren(Renderer& r) {
 }
 
 void Card::refresh(Renderer& r) {
+    // Labels are moved around below without going through a setter.
+    invalidate();
     SetBoundingBox(
         pos.resolve(parent.bounding_box, CardSize[scale]),
         CardSize[scale]
@@ -468,7 +488,7 @@ void Card::set_id(CardId ct) {
         description.reflow = true;
         name.reflow = true;
         name.align = TextAlign::Center;
-        image.texture = &*power.image;
+        image.texture = &power.image;
     }
 
     needs_refresh = true;
@@ -501,9 +521,9 @@ void CardStacks::Stack::draw(Renderer& r) {
         auto cs = Card::CardSize[scale];
         auto b = Card::Border[scale];
         auto p = Card::Padding[scale];
-        auto sz = LockedTexture->size * Card::IconScale[scale];
+        auto sz = LockedTexture.size * Card::IconScale[scale];
         r.draw_texture_scaled(
-            *LockedTexture,
+            LockedTexture,
             Position{b.wd + p, -cs.ht + 2 * (b.ht + p)}.resolve(rbox(), sz),
             Card::IconScale[scale]
         );
@@ -136,12 +136,34 @@ void Widget::unselect_impl(Screen& parent) {
     }
 }
 
+void Widget::invalidate() {
+    cache_valid = false;
+    if (auto w = parent.cast<Widget>()) w->invalidate();
+}
+
+bool Widget::PrepareCache(Renderer& r, Size size, u64 key) {
+    // Draw at the scale we’re displayed at so the texture isn’t blurry.
+    auto scale = r.current_scale();
+    Size px{i32(std::ceil(f32(size.wd) * scale)), i32(std::ceil(f32(size.ht) * scale))};
+    if (not draw_cache or draw_cache->size != px) {
+        draw_cache = std::make_unique<Framebuffer>(px);
+        cache_valid = false;
+    }
+
+    if (cache_valid and cache_key == key and cache_scale == scale) return false;
+    cache_valid = true;
+    cache_key = key;
+    cache_scale = scale;
+    return true;
+}
+
 void Widget::set_needs_refresh(bool new_value) {
     // Do NOT cache this since we need to propagate changes to our
     // parent, and that may not have been done yet because this may
     // have already been set before we were assigned a parent if this
     // is a new object.
     _needs_refresh = new_value;
+    if (new_value) invalidate();
 
     // Groups care about this because they need to recompute the
     // positions of their children.
@@ -188,9 +210,9 @@ void Throbber::draw(Renderer& r) {
     xfrm = rotate(xfrm, rads, vec3(0, 0, 1));
 
     r.use(r.throbber_shader, {});
-    r.throbber_shader.uniform("position", at.vec());
-    r.throbber_shader.uniform("rotation", xfrm);
-    r.throbber_shader.uniform("r", R);
+    r.throbber_shader.set(r.throbber_uniforms.position, at.vec());
+    r.throbber_shader.set(r.throbber_uniforms.rotation, xfrm);
+    r.throbber_shader.set(r.throbber_uniforms.r, R);
 
     vao.draw_vertices();
 }
@@ -212,7 +234,7 @@ void Image::UpdateDimensions() {
 }
 
 TRIVIAL_CACHING_SETTER(Image, Size, fixed_size, UpdateDimensions());
-TRIVIAL_CACHING_SETTER(Image, DrawableTexture*, texture, UpdateDimensions());
+TRIVIAL_CACHING_SETTER(Image, const ArrayImage*, texture, UpdateDimensions());
 
 // =============================================================================
 //  Group
@@ -273,6 +295,7 @@ void Group::refresh(Renderer& r) {
     // and compute the total width of all elements.
     Axis a = vertical ? Axis::Y : Axis::X;
     i32 total_extent = 0;
+    r.profiler.refreshed(ch.size());
     for (auto& c : ch) {
         c.refresh(r);
         total_extent += c.bounding_box.extent(a);
@@ -307,6 +330,7 @@ void Group::refresh(Renderer& r) {
     SetBoundingBox(pos.resolve(parent.bounding_box, sz), sz);
 
     // And refresh the children again now that we know where everything is.
+    r.profiler.refreshed(ch.size());
     for (auto& c : ch) c.refresh(r);
 }
 
@@ -365,6 +389,11 @@ void InputSystem::process_events() {
 
             case SDL_EVENT_KEY_DOWN:
                 if (event.key.key == SDLK_F12) renderer.reload_shaders();
+                if (event.key.key == SDLK_F3) renderer.profiler.toggle();
+                if (event.key.key == SDLK_F4) {
+                    if (auto res = renderer.profiler.dump_trace(Profiler::TraceFile); not res) Log("{}", res.error());
+                    else Log("Wrote frame trace to '{}'", Profiler::TraceFile);
+                }
                 kb_events.emplace_back(event.key.key, event.key.mod);
                 break;
 
@@ -406,6 +435,7 @@ void Screen::refresh(Renderer& r) {
         for (auto& e : children()) {
             if (e.needs_refresh) {
                 e.needs_refresh = false;
+                r.profiler.refreshed();
                 e.refresh(r);
             }
         }
@@ -419,6 +449,7 @@ void Screen::refresh(Renderer& r) {
     for (auto& e : children()) {
         if (e.visible or e.needs_refresh) {
             e.needs_refresh = false;
+            r.profiler.refreshed();
             e.refresh(r);
         }
     }
@@ -491,7 +522,7 @@ void InputSystem::game_loop(std::function<void()> tick) {
             );
         } else {
 #ifndef PRESCRIPTIVISM_ENABLE_SANITISERS
-            Log("Client tick took too long: {}ms", tick_duration.count());
+            Log<LogLevel::Warning>("Client tick took too long: {}ms", tick_duration.count());
 #endif
         }
     }
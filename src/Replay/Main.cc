@@ -0,0 +1,131 @@
+#include <Shared/Journal.hh>
+
+#include <base/Base.hh>
+
+#include <clopts.hh>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <print>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace pr;
+using namespace command_line_options;
+
+using options = clopts< // clang-format off
+    option<"--journals", "A journal, or a directory of journals, to replay (default: 'journals')">,
+    option<"--threads", "Number of threads to use (default: one per core)", i64>,
+    help<>
+>; // clang-format on
+
+namespace {
+struct Outcome {
+    usz actions = 0;
+    u32 turns = 0;
+    bool complete = false;
+
+    /// Why the journal doesn’t replay, if it doesn’t.
+    std::string error;
+};
+
+auto Replay(fs::PathRef path) -> Result<Outcome> {
+    auto file = Try(MappedFile::Open(path));
+    auto reader = Try(journal::Reader::Open(file->bytes()));
+
+    Outcome o;
+    journal::Replayer replay;
+    while (auto r = reader.next()) {
+        if (auto res = replay.apply(*r); not res) {
+            o.error = std::format("{} (offset {})", res.error(), reader.valid_size());
+            break;
+        }
+    }
+
+    // Games that are still running may end with a partial record; that
+    // is only a problem if the game was supposed to be over.
+    if (o.error.empty() and not reader.error().empty() and path.extension() != journal::ActiveExtension)
+        o.error = reader.error();
+    if (o.error.empty() and path.extension() == journal::FinishedExtension and not replay.complete)
+        o.error = "Journal ends before the game does";
+
+    o.actions = replay.actions;
+    o.turns = replay.state.turns;
+    o.complete = replay.complete;
+    return o;
+}
+
+auto Collect(fs::PathRef path) -> Result<std::vector<fs::Path>> {
+    std::error_code ec;
+    if (not std::filesystem::is_directory(path, ec)) return std::vector<fs::Path>{path};
+
+    std::vector<fs::Path> paths;
+    for (auto& e : std::filesystem::directory_iterator{path, ec}) {
+        auto ext = e.path().extension();
+        if (e.is_regular_file() and (ext == journal::FinishedExtension or ext == journal::ActiveExtension))
+            paths.push_back(e.path());
+    }
+
+    if (ec) return Error("Failed to list '{}': {}", path.string(), ec.message());
+    rgs::sort(paths);
+    return paths;
+}
+
+auto Run(int argc, char* argv[]) -> Result<bool> {
+    auto opts = options::parse(argc, argv);
+    i64 threads = opts.get_or<"--threads">(0);
+    if (threads < 0) return Error("--threads must not be negative");
+    if (threads == 0) threads = std::max<i64>(std::thread::hardware_concurrency(), 1);
+
+    auto paths = Try(Collect(opts.get_or<"--journals">("journals")));
+    std::vector<Result<Outcome>> outcomes(paths.size());
+
+    // Journals are independent, so just hand them out one at a time.
+    auto start = chr::steady_clock::now();
+    {
+        std::atomic<usz> next = 0;
+        std::vector<std::jthread> workers;
+        for (i64 i = 0; i < std::min<i64>(threads, i64(paths.size())); i++) {
+            workers.emplace_back([&] {
+                for (usz j; (j = next.fetch_add(1, std::memory_order::relaxed)) < paths.size();)
+                    outcomes[j] = Replay(paths[j]);
+            });
+        }
+    }
+    auto elapsed = chr::duration<f64>(chr::steady_clock::now() - start).count();
+
+    usz actions = 0, turns = 0, complete = 0, failed = 0;
+    for (auto [path, o] : vws::zip(paths, outcomes)) {
+        if (not o or not o->error.empty()) {
+            std::println(stderr, "{}: {}", path.string(), o ? o->error : o.error());
+            failed++;
+            continue;
+        }
+
+        actions += o->actions;
+        turns += o->turns;
+        if (o->complete) complete++;
+    }
+
+    std::println(
+        "Replayed {} journals ({} finished, {} failed) in {:.3f}s",
+        paths.size(),
+        complete,
+        failed,
+        elapsed
+    );
+    std::println("{} actions, {} turns ({:.0f} actions/s)", actions, turns, f64(actions) / std::max(elapsed, 1e-9));
+    return failed == 0;
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+    auto res = Run(argc, argv);
+    if (not res) {
+        std::println(stderr, "ERROR: {}", res.error());
+        return 1;
+    }
+
+    return res.value() ? 0 : 1;
+}
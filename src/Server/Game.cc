@@ -0,0 +1,571 @@
+#include <Server/Server.hh>
+
+#include <Shared/GameState.hh>
+#include <Shared/Validation.hh>
+
+#include <base/Base.hh>
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <random>
+#include <ranges>
+#include <span>
+#include <variant>
+#include <vector>
+
+using namespace pr;
+using namespace pr::server;
+namespace sc = packets::sc;
+namespace cs = packets::cs;
+
+// ============================================================================
+// Constants
+// ============================================================================
+constexpr usz PlayersNeeded = pr::constants::PlayersPerGame;
+constexpr chr::seconds HeartbeatInterval = 15s;
+
+/// Games that no player has been connected to for this long are ended.
+constexpr chr::minutes AbandonTimeout = 5min;
+
+/// The number of changes we keep for players who rejoin; anyone who
+/// missed more than that is sent the whole game state instead.
+constexpr usz MaxHistorySize = 256;
+
+/// Shared frames smaller than this are copied into a player’s batch.
+constexpr usz MinSharedFrameSize = 256;
+using enum DisconnectReason;
+
+// =============================================================================
+//  Networking
+// =============================================================================
+Game::Game(u64 id, TimerWheel& timers, journal::Sink* sink) : Game(id, timers, sink, [] {
+    std::random_device rd;
+    return (u64(rd()) << 32 | rd()) | 1;
+}(), RandomSeed()) {}
+
+Game::Game(u64 id, TimerWheel& timers, journal::Sink* sink, u64 session, u64 seed)
+    : seed(seed), sink(sink), timers(timers), id(id), session(session) {}
+
+Game::~Game() {
+    timers.cancel(heartbeat_timer);
+}
+
+auto Game::Restore(
+    u64 id,
+    TimerWheel& timers,
+    journal::Sink& sink,
+    fs::PathRef path
+) -> Result<std::unique_ptr<Game>> {
+    std::unique_ptr<Game> g;
+    journal::Replayer replay;
+    usz valid_size;
+    {
+        auto file = Try(MappedFile::Open(path));
+        auto reader = Try(journal::Reader::Open(file->bytes()));
+        while (auto r = reader.next()) {
+            Try(replay.apply(*r));
+
+            // The first record tells us who is playing; every play after
+            // it is an update that clients may have to catch up on.
+            if (auto s = std::get_if<journal::Start>(&*r)) {
+                g.reset(new Game(id, timers, &sink, s->session, s->seed));
+                for (auto& info : s->players)
+                    g->players.push_back(std::make_unique<Player>(net::TCPConnexion{}, info.name));
+            } else if (auto p = std::get_if<journal::Play>(&*r)) {
+                if (p->card.is_sound()) g->Remember(sc::AddSoundToStack{p->target, p->stack, p->card});
+                else g->Remember(sc::StackLockChanged{p->target, p->stack, true});
+            }
+        }
+
+        // Whatever follows the last good record was being written when
+        // we stopped, and is dropped below.
+        if (not reader.error().empty()) Log<LogLevel::Warning>("Journal '{}': {}", path.string(), reader.error());
+        valid_size = reader.valid_size();
+    }
+
+    // Nothing to resume if the game never got going or is already over.
+    if (not g) {
+        Log("Journal '{}' has no games in it; removing it", path.string());
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+        return nullptr;
+    }
+
+    if (replay.over) {
+        auto w = Try(sink.resume(path, valid_size));
+        w.finish();
+        return nullptr;
+    }
+
+    for (auto [i, p] : g->players | vws::enumerate) p->id = u8(i);
+    g->board = replay.state;
+    g->state = rgs::all_of(g->board.players, &PlayerState::submitted_word) ? State::Running : State::WaitingForWords;
+    g->journal_writer = Try(sink.resume(path, valid_size));
+    Log("Restored game {} after {} actions", id, replay.actions);
+    return g;
+}
+
+void Game::add_player(
+    net::TCPConnexion client,
+    std::string name,
+    packets::ResumePoint resume,
+    u32 protocol_version
+) {
+    RequestTick();
+
+    // Try to match this connexion to an existing player.
+    for (auto& p : players) {
+        if (p->name == name) {
+            // Someone is trying to connect to a player that is
+            // already connected.
+            if (p->connected) {
+                Log("{} is already connected", name);
+                return Kick(client, UsernameInUse);
+            }
+
+            Log("Player {} logging back in", name);
+            p->client_connexion = client;
+            p->heartbeat_ack = heartbeat_seq;
+            p->protocol_version = protocol_version;
+            player_map.insert(client.id, p.get());
+
+            // Get the player up to date with the current game state.
+            switch (state) {
+                case State::WaitingForPlayerRegistration: break;
+                case State::WaitingForWords:
+                    if (auto& s = StateOf(*p); not s.submitted_word) p->send(sc::WordChoice{s.word.ids()});
+                    break;
+
+                case State::Running:
+                    SendGameState(*p, resume);
+                    if (board.current_player == p->id) p->send(sc::StartTurn{});
+                    break;
+
+                case State::Ended:
+                    Kick(client, Unspecified);
+                    break;
+            }
+            return;
+        }
+    }
+
+    // The lobby should never send us more players than we can handle.
+    Assert(players.size() < PlayersNeeded, "Too many players in game {}", id);
+
+    // Create a new player. This is also the only place where we can
+    // reach the player limit for the first time, so perform game
+    // initialisation here if we have enough players.
+    players.push_back(std::make_unique<Player>(client, std::move(name)));
+    players.back()->heartbeat_ack = heartbeat_seq;
+    players.back()->protocol_version = protocol_version;
+    player_map.insert(client.id, players.back().get());
+    if (players.size() == PlayersNeeded) SetUpGame();
+}
+
+void Game::receive(net::TCPConnexion& client, net::ReceiveBuffer& buf) {
+    // Connexions that have been replaced by a newer one for the same
+    // player have no business sending us anything.
+    if (not player_map.find(client.id)) return Kick(client, UnexpectedPacket);
+    RequestTick();
+    while (not client.disconnected and not buf.empty()) {
+        auto res = packets::HandleServerSidePacket(*this, client, buf);
+
+        // If there was an error, close the connexion.
+        if (not res) {
+            Log<LogLevel::Warning>("Packet error while processing {}: {}", client.address, res.error());
+            return Kick(client, InvalidPacket);
+        }
+
+        // And stop if the packet was incomplete.
+        if (not res.value()) break;
+    }
+}
+
+void Player::flush() {
+    defer {
+        batch.clear();
+        shared_frames.clear();
+        shared_bytes = 0;
+        batched_frames = 0;
+    };
+
+    if (batched_frames == 0 or disconnected) return;
+
+    // Don’t bother wrapping a single packet.
+    std::span<const std::byte> data{batch};
+    if (batched_frames == 1) {
+        if (not shared_frames.empty()) return client_connexion.send(shared_frames.front().second);
+        return client_connexion.send(data.subspan(net::FrameHeaderSize), 1);
+    }
+
+    // Reserve() makes sure that everything fits.
+    auto size = batch.size() + shared_bytes - sizeof(net::FrameLength);
+    auto res = net::detail::PatchFrameLength(batch, 0, size);
+    Assert(res.has_value(), "{}", res.error());
+
+    // Queue the shared frames in between the data that was copied; the
+    // shared frames count themselves, so only count the others.
+    usz copied = batched_frames - shared_frames.size();
+    usz sent = 0;
+    for (auto& [offset, frame] : shared_frames) {
+        if (offset != sent) client_connexion.send(data.subspan(sent, offset - sent), std::exchange(copied, 0));
+        client_connexion.send(frame);
+        sent = offset;
+    }
+
+    if (sent != data.size()) client_connexion.send(data.subspan(sent), copied);
+}
+
+auto Player::Reserve(usz frame_size) -> Result<bool> {
+    constexpr usz MaxStandaloneFrameSize = net::MaxFrameSize + sizeof(net::FrameLength);
+    constexpr usz MaxBatchedFrameSize = net::MaxFrameSize - sizeof(net::detail::IDType);
+    if (frame_size > MaxStandaloneFrameSize) return Error("Frame too large: {}", frame_size);
+    if (not Batches()) return false;
+
+    // A frame that doesn’t fit in an empty batch can still be sent on
+    // its own, but only after everything that was sent before it.
+    if (frame_size > MaxBatchedFrameSize) {
+        flush();
+        return false;
+    }
+
+    // Start a new batch if this doesn’t fit in the current one.
+    if (batch.size() + shared_bytes + frame_size > MaxStandaloneFrameSize) flush();
+    if (batch.empty()) Try(net::AppendFrame(batch, sc::Batch{}, client_connexion.encoding));
+    return true;
+}
+
+void Player::SendFailed(const std::string& error) {
+    Log<LogLevel::Warning>("Disconnecting player {}: {}", name, error);
+    kick(Unspecified);
+}
+
+void Player::kick(DisconnectReason reason) {
+    flush();
+    Kick(client_connexion, reason);
+}
+
+void Player::send(const net::SharedFrame& frame) {
+    if (disconnected) return;
+    auto bytes = frame.bytes();
+    auto batched = Reserve(bytes.size());
+    if (not batched) return SendFailed(batched.error());
+    if (not batched.value()) return client_connexion.send(frame);
+    batched_frames++;
+
+    // Small frames are cheaper to copy than to queue separately.
+    if (bytes.size() < MinSharedFrameSize) {
+        batch.insert(batch.end(), bytes.begin(), bytes.end());
+        return;
+    }
+
+    shared_frames.emplace_back(batch.size(), frame);
+    shared_bytes += bytes.size();
+}
+
+void Game::attach(std::vector<Game*>& ticks) {
+    Assert(not tick_list, "Game {} is already attached to a worker", id);
+    tick_list = &ticks;
+    RequestTick();
+}
+
+void Game::RequestTick() {
+    if (tick_pending or not tick_list) return;
+    tick_pending = true;
+    tick_list->push_back(this);
+}
+
+void Game::tick() {
+    tick_pending = false;
+
+    // Start sending heartbeats once we’re on the worker’s thread.
+    if (not heartbeat_timer and not finished())
+        heartbeat_timer = timers.schedule(HeartbeatInterval, [this] { Heartbeat(); });
+
+    // Start the game iff all players are connected and all words have been received.
+    if (
+        state == State::WaitingForWords and
+        AllPlayersConnected() and
+        AllWordsSubmitted()
+    ) {
+        state = State::Running;
+
+        // Send each player’s word to every player and tell the first
+        // player to start their turn.
+        for (auto& p : players) SendGameState(*p, {});
+        player().send(sc::StartTurn{});
+    }
+
+    // Send everything we’ve accumulated during this tick; the journal
+    // is written in the background. If that failed, the sink has already
+    // complained about it, so just stop buffering records for it.
+    for (auto& p : players) p->flush();
+    if (journal_writer and journal_writer->failed()) {
+        Log<LogLevel::Warning>("Game {} is no longer being journalled", id);
+        journal_writer.reset();
+    }
+
+    if (journal_writer) journal_writer->flush();
+}
+
+// =============================================================================
+//  Packet Handlers
+// =============================================================================
+void Game::handle(net::TCPConnexion& client, cs::Disconnect) {
+    Log("Client {} disconnected", client.address);
+    client.disconnect();
+}
+
+void Game::handle(net::TCPConnexion& client, sc::WordChoice wc) {
+    // We didn’t ask for a word, or the player has already submitted one.
+    auto p = PlayerFor(client);
+    auto& ps = StateOf(*p);
+    if (state != State::WaitingForWords or ps.submitted_word) {
+        Kick(client, UnexpectedPacket);
+        return;
+    }
+
+    // Word is invalid.
+    constants::Word original;
+    for (auto [i, s] : ps.word.stacks | vws::enumerate) original[i] = s.top;
+    if (validation::ValidateInitialWord(wc.word, original) != validation::InitialWordValidationResult::Valid) {
+        Kick(client, InvalidPacket);
+        return;
+    }
+
+    // Word is valid. Mark it as submitted.
+    for (auto [i, c] : wc.word | vws::enumerate) ps.word.stacks[i].cards[0] = c;
+    ps.submitted_word = true;
+    Record(journal::WordChoice{p->id, wc.word});
+    Log<LogLevel::Debug>("Client gave back word");
+}
+
+void Game::handle(net::TCPConnexion& client, cs::HeartbeatResponse res) {
+    Log<LogLevel::Debug>("Received heartbeat response from client {}", res.seq_no);
+    PlayerFor(client)->heartbeat_ack = res.seq_no;
+}
+
+void Game::handle(net::TCPConnexion& client, cs::Login) {
+    // Players that have been handed to us have already logged in.
+    Kick(client, UnexpectedPacket);
+}
+
+void Game::handle(net::TCPConnexion& client, cs::Pass pass) {
+    // Check that the player is the current player.
+    auto p = PlayerFor(client);
+    if (state != State::Running or p->id != board.current_player) return Kick(client, UnexpectedPacket);
+
+    // Check that the card index is valid.
+    if (pass.card_index >= board.current().hand.size()) return Kick(client, InvalidPacket);
+
+    // Discard the card and end the player’s turn.
+    Record(journal::Pass{p->id, u32(pass.card_index), board.current().hand[pass.card_index]});
+    rules::Discard(board, pass.card_index);
+    NextPlayer();
+}
+
+void Game::handle(net::TCPConnexion& client, cs::PlaySingleTarget c) {
+    // Check that the player is the current player.
+    auto p = PlayerFor(client);
+    if (state != State::Running or p->id != board.current_player) return Kick(client, UnexpectedPacket);
+
+    // Check that all indices are valid and that the action itself is
+    // allowed; see rules::IsLegal() for why this MUST be handled in
+    // the validation namespace.
+    validation::Move m{c.card_index, c.player, c.target_stack_index};
+    if (not rules::IsLegal(board, m)) return Kick(client, InvalidPacket);
+
+    // Play the card and tell everyone what it did.
+    // TODO: Special effects when playing a sound.
+    auto card = board.current().hand[m.card];
+    Record(journal::Play{p->id, u32(m.card), card, c.player, u32(c.target_stack_index)});
+    rules::Play(board, m);
+    if (card.is_sound()) Publish(sc::AddSoundToStack{c.player, c.target_stack_index, card});
+    else Publish(sc::StackLockChanged{c.player, c.target_stack_index, true});
+    NextPlayer();
+}
+
+// =============================================================================
+//  General Game Logic
+// =============================================================================
+void Game::Heartbeat() {
+    if (finished()) return;
+    RequestTick();
+
+    // If everyone has left, end the game eventually; otherwise, it would
+    // stay around for ever, and be restored after every restart.
+    if (rgs::none_of(players, [](const auto& p) { return p->connected; })) {
+        auto now = TimerWheel::Clock::now();
+        if (not abandoned_since) abandoned_since = now;
+        else if (now - *abandoned_since >= AbandonTimeout) {
+            Log("All players have left game {}; ending it", id);
+            return Finish();
+        }
+    } else {
+        abandoned_since.reset();
+    }
+
+    for (auto& p : players) {
+        if (p->disconnected) continue;
+        if (p->heartbeat_ack != heartbeat_seq) {
+            Log("Player {} stopped responding to heartbeats", p->name);
+            p->kick(Unspecified);
+            continue;
+        }
+
+        p->send(sc::HeartbeatRequest{heartbeat_seq + 1});
+    }
+
+    heartbeat_seq++;
+    heartbeat_timer = timers.schedule(HeartbeatInterval, [this] { Heartbeat(); });
+}
+
+void Game::NextPlayer() {
+    // Tell the players about everything that happens between turns.
+    struct Observer {
+        Game& g;
+        void draw(PlayerId p, std::span<const CardId> cards) {
+            auto& player = *g.players[p];
+            if (player.protocol_version < packets::BatchProtocolVersion) {
+                for (auto c : cards) player.send(sc::LegacyDraw{c});
+                return;
+            }
+
+            player.send(sc::Draw{std::vector<CardId>{cards.begin(), cards.end()}});
+        }
+
+        void end_turn(PlayerId p) { g.players[p]->send(sc::EndTurn{}); }
+        void start_turn(PlayerId p) { g.players[p]->send(sc::StartTurn{}); }
+    } o{*this};
+
+    if (rules::EndTurn(board, o)) return;
+    Log("No more plays can be made. Game {} is a draw.", id);
+    Finish();
+}
+
+void Game::Finish() {
+    Record(journal::End{board.turns});
+    if (journal_writer) journal_writer->finish();
+    for (auto& p : players) p->kick(Unspecified);
+    state = State::Ended;
+}
+
+void Game::Remember(Update update) {
+    history.push_back(std::move(update));
+    if (history.size() > MaxHistorySize) history.pop_front();
+    seq_no++;
+}
+
+void Game::SendGameState(Player& p, packets::ResumePoint resume) {
+    auto& cards = StateOf(p).hand;
+    std::vector<CardId> hand{cards.begin(), cards.end()};
+    auto first = seq_no - u32(history.size());
+    auto SendHistory = [&](u32 from) {
+        for (auto& update : history | vws::drop(from - first))
+            std::visit([&](const auto& u) { p.send(u); }, update);
+    };
+
+    // If the player still knows what the game looked like when they
+    // left, and we still know what happened since, only send them
+    // what they missed.
+    if (
+        p.resumable and
+        p.protocol_version >= packets::ResumeProtocolVersion and
+        resume.session == session and
+        resume.seq_no >= first and
+        resume.seq_no <= seq_no
+    ) {
+        p.send(sc::Resume{std::move(hand)});
+        return SendHistory(resume.seq_no);
+    }
+
+    // These are sent so rarely (once at the start of the game and once
+    // every time someone rejoins without a valid resume point), that we
+    // just build them from scratch every time. Clients that know about
+    // snapshots get the current state of every word.
+    p.resumable = true;
+    if (seq_no != 0 and p.protocol_version >= packets::SnapshotProtocolVersion) {
+        std::array<sc::Snapshot::PlayerInfo, constants::PlayersPerGame> player_infos;
+        for (auto [info, other] : vws::zip(player_infos, players)) {
+            info.name = other->name;
+            for (auto [s, stack] : vws::zip(info.stacks, StateOf(*other).word.stacks)) {
+                s.cards.assign(stack.cards.begin(), stack.cards.end());
+                s.locked = stack.locked;
+            }
+        }
+
+        p.send(sc::Snapshot{std::move(player_infos), std::move(hand), u8(p.id), session, seq_no});
+        return;
+    }
+
+    // Everyone else gets what the game started with, i.e. the bottom
+    // card of every stack, and the changes since.
+    std::array<sc::StartGame::PlayerInfo, constants::PlayersPerGame> player_infos;
+    for (auto [info, other] : vws::zip(player_infos, players)) {
+        info.name = other->name;
+        for (auto [c, stack] : vws::zip(info.word, StateOf(*other).word.stacks)) c = stack[0];
+    }
+
+    auto resumable_session = p.protocol_version >= packets::ResumeProtocolVersion ? session : 0;
+    p.send(sc::StartGame{player_infos, std::move(hand), u8(p.id), resumable_session});
+    if (first == 0) return SendHistory(0);
+
+    // If we’ve forgotten some of those, make up changes that lead to the
+    // same state; the client’s sequence numbers won’t match ours after
+    // that, so it has to start over if it rejoins again.
+    p.resumable = false;
+    for (auto [id, other] : players | vws::enumerate) {
+        for (auto [i, stack] : StateOf(*other).word.stacks | vws::enumerate) {
+            for (auto c : stack.cards | vws::drop(1)) p.send(sc::AddSoundToStack{PlayerId(id), u32(i), c});
+            if (stack.locked) p.send(sc::StackLockChanged{PlayerId(id), u32(i), true});
+        }
+    }
+}
+
+void Game::SetUpGame() {
+    Assert(state == State::WaitingForPlayerRegistration);
+    state = State::WaitingForWords;
+    Log<LogLevel::Debug>("Setting up game {} with seed {}", id, seed);
+
+    // Decide the turn order first, since a player’s id is also where
+    // their cards and word are stored.
+    rgs::shuffle(players, rng);
+
+    // FIXME: FOR TESTING ONLY. COMMENT THIS OUT IN PRODUCTION.
+    auto it = rgs::find_if(players, [](auto& p) { return p->name == "debugger" or p->name == "console"; });
+    if (it != players.end()) {
+        Log("Debugger or console found.");
+        std::iter_swap(it, players.begin());
+    }
+
+    // Initialise player IDs.
+    for (auto [i, p] : players | vws::enumerate) p->id = u8(i);
+
+    // Deal the cards, and send each player their word; don’t send the
+    // hands until the game starts.
+    rules::SetUp(board, rng);
+    for (auto& p : players) p->send(sc::WordChoice{StateOf(*p).word.ids()});
+
+    // Record the game as it was dealt; everything else follows from
+    // that and the players’ actions.
+    if (not sink) return;
+    auto w = sink->create(session);
+    if (not w) {
+        Log<LogLevel::Warning>("Not journalling game {}: {}", id, w.error());
+        return;
+    }
+
+    journal::Start start{session, seed, {}, {board.deck.begin(), board.deck.end()}};
+    for (auto [i, p] : players | vws::enumerate) {
+        auto& s = StateOf(*p);
+        auto& info = start.players[usz(i)];
+        info.name = p->name;
+        for (auto [j, c] : s.word.ids() | vws::enumerate) info.word[usz(j)] = c;
+        info.hand.assign(s.hand.begin(), s.hand.end());
+    }
+
+    journal_writer.emplace(std::move(*w));
+    Record(start);
+}
@@ -2,6 +2,7 @@
 
 #include <clopts.hh>
 #include <print>
+#include <thread>
 
 using namespace pr;
 using namespace command_line_options;
@@ -9,6 +10,9 @@ using namespace command_line_options;
 using options = clopts< // clang-format off
     option<"--port", "The port to listen on", i64>,
     option<"--pwd", "Password to the game">,
+    option<"--workers", "Number of worker threads that run games (default: one per core)", i64>,
+    option<"--metrics-port", "Port to serve Prometheus metrics on (default: disabled)", i64>,
+    option<"--journal-dir", "Directory to write game journals to and resume games from (default: disabled)">,
     help<>
 >; // clang-format on
 
@@ -21,5 +25,20 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    server::Server(u16(port), opts.get_or<"--pwd">("")).Run();
+    i64 workers = opts.get_or<"--workers">(i64(std::thread::hardware_concurrency()));
+    if (workers <= 0) workers = 1;
+
+    i64 metrics_port = opts.get_or<"--metrics-port">(0);
+    if (metrics_port < 0 or metrics_port > std::numeric_limits<u16>::max()) {
+        std::println(stderr, "ERROR: invalid metrics port {}", metrics_port);
+        return 1;
+    }
+
+    server::Server(
+        u16(port),
+        opts.get_or<"--pwd">(""),
+        usz(workers),
+        u16(metrics_port),
+        opts.get_or<"--journal-dir">("")
+    ).Run();
 }
@@ -1,13 +1,12 @@
 #include <Server/Server.hh>
 
-#include <Shared/Validation.hh>
-
 #include <base/Base.hh>
 
 #include <algorithm>
 #include <chrono>
-#include <map>
+#include <filesystem>
 #include <memory>
+#include <mutex>
 #include <ranges>
 #include <thread>
 #include <vector>
@@ -21,100 +20,145 @@ namespace cs = packets::cs;
 // Constants
 // ============================================================================
 constexpr usz PlayersNeeded = pr::constants::PlayersPerGame;
-constexpr usz HandSize = 7;
+constexpr chr::seconds LoginTimeout = 30s;
+constexpr u32 ListenBacklog = 1'024;
+constexpr usz MaxPendingConnexions = 10'000;
+constexpr chr::milliseconds SlowTickThreshold = 33ms;
 using enum DisconnectReason;
 
-// ============================================================================
-// Helpers
-// ============================================================================
-struct Server::Validator {
-    const Player& p;
-    PlayerId acting_player;
-
-    auto operator[](usz i) const -> CardId { return p.word.stacks[i].top; }
-    bool is_own_word() const { return acting_player == p.id; }
-    auto size() const -> usz { return p.word.stacks.size(); }
-    bool stack_is_locked(usz i) const { return p.word.stacks[i].locked; }
-    bool stack_is_full(usz i) const { return p.word.stacks[i].full; }
-};
-
-auto BuildWordArray(const Word& w) {
-    return w.stacks | vws::transform(&Stack::get_top);
-}
+// =============================================================================
+//  Metrics
+// =============================================================================
+auto server::HandlerTime(cs::ID id) -> metrics::Histogram& {
+    switch (id) {
+#define X(name)                                               \
+    case cs::ID::name: {                                      \
+        static metrics::Histogram h{                          \
+            "prescriptivism_handler_duration_seconds",        \
+            "Time spent deserialising and handling a packet", \
+            "packet=\"" #name "\"",                           \
+            1e-9,                                             \
+        };                                                    \
+        return h;                                             \
+    }
+        COMMON_PACKETS(X)
+        CS_PACKETS(X)
+#undef X
+    }
 
-auto Server::ValidatorFor(Player& p) -> Validator {
-    return Validator{p, current_player};
+    Unreachable("Invalid packet id {}", +id);
 }
 
 // =============================================================================
 //  Networking
 // =============================================================================
-void Server::Kick(net::TCPConnexion& client, DisconnectReason reason) {
+void server::Kick(net::TCPConnexion& client, DisconnectReason reason) {
     client.send(packets::sc::Disconnect{reason});
     client.disconnect();
 }
 
-void Server::Tick() {
-    // Receive incoming data.
-    server.receive();
-
-    // For any pending connexions, disconnect any that haven’t sent
-    // a login packet within the timeout.
-    auto now = chr::steady_clock::now();
-    for (auto& [conn, established] : pending_connexions) {
-        if (now - established > 30s) {
-            // Don’t even bother sending a packet here; if they didn’t
-            // respond within the time frame, they’re likely not actually
-            // a game client, but rather some random other connexion.
-            Log("Client {} took too long to send a login packet", conn.address);
-            conn.disconnect();
+void Server::HandOffLogins() {
+    if (logged_in.empty()) return;
+    std::unique_lock _{tables_lock};
+    for (auto& [conn, name, resume, version] : logged_in) {
+        // The connexion may have gone away in the meantime.
+        if (conn.disconnected) continue;
+
+        // Stop listening for data on this connexion; it belongs to
+        // a worker from now on.
+        server.release(conn);
+
+        // If this player is already in a game, send them there; the
+        // game will figure out whether they are allowed to rejoin.
+        if (auto it = player_tables.find(name); it != player_tables.end()) {
+            tables.at(it->second).worker->hand_off(it->second, false, std::move(conn), std::move(name), resume, version);
+            continue;
+        }
+
+        // Otherwise, create a new game if there is no game that isn’t
+        // full yet; put it on the worker that has the fewest games.
+        bool new_game = not open_table.has_value();
+        if (new_game) {
+            auto w = rgs::min_element(workers, {}, [](auto& w) { return w->load.load(); });
+            open_table = next_table_id++;
+            tables[*open_table].worker = w->get();
+            (*w)->load++;
         }
+
+        // Add the player to the game.
+        auto id = *open_table;
+        auto& table = tables.at(id);
+        table.players.push_back(name);
+        player_tables[name] = id;
+        if (table.players.size() == PlayersNeeded) open_table.reset();
+        table.worker->hand_off(id, new_game, std::move(conn), std::move(name), resume, version);
     }
 
-    // Clear out pending connexions that may have gone away.
-    std::erase_if(pending_connexions, [](const auto& c) { return c.conn.disconnected; });
+    logged_in.clear();
+}
 
-    // Clear out player connexions of players that are disconnected.
-    std::erase_if(player_map, [](const auto& x) { return x.first.disconnected; });
+void Server::Tick() {
+    // Send everyone who has logged in to their game.
+    HandOffLogins();
 
-    // As the last step, accept new connexions and close stale ones.
+    // As the last step, close stale connexions.
     server.update_connexions();
-
-    // Start the game if we have enough connected players.
-    // Start the game iff all players are connected and all words have been received.
-    if (
-        state == State::WaitingForWords and
-        AllPlayersConnected() and
-        AllWordsSubmitted()
-    ) {
-        state = State::Running;
-
-        // Send each player’s word to every player and tell the first
-        // player to start their turn.
-        for (auto& p : players) SendGameState(*p);
-        player().send(sc::StartTurn{});
-    }
 }
 
 bool Server::accept(net::TCPConnexion& connexion) {
     // Make sure we’re not full yet.
-    auto connected_players = rgs::distance(players | vws::filter([](auto& p) { return p->connected; }));
-    if (connected_players + pending_connexions.size() == PlayersNeeded) {
+    if (pending_connexions.size() == MaxPendingConnexions) {
         connexion.send(packets::sc::Disconnect{ServerFull});
         return false;
     }
 
-    pending_connexions.emplace_back(connexion, chr::steady_clock::now());
+    // Disconnect anyone who doesn’t send a login packet in time. Don’t
+    // even bother sending a packet here; if they didn’t respond within
+    // the time frame, they’re likely not actually a game client, but
+    // rather some random other connexion. Connexions that go away before
+    // that are removed by closed(), which also cancels this.
+    auto timeout = server.timers().schedule(LoginTimeout, [this, id = connexion.id] {
+        auto pending = pending_connexions.find(id);
+        if (not pending) return;
+        Log("Client {} took too long to send a login packet", pending->conn.address);
+        pending->conn.disconnect();
+        pending_connexions.erase(id);
+    });
+
+    pending_connexions.insert(connexion.id, {connexion, timeout});
     return true;
 }
 
+void Server::closed(net::ConnexionId id) {
+    // Forget about clients that hung up before logging in, so they
+    // don’t count towards the limit of pending connexions.
+    auto pending = pending_connexions.find(id);
+    if (not pending) return;
+    server.timers().cancel(pending->timeout);
+    pending_connexions.erase(id);
+}
+
+void Server::game_finished(u64 game) {
+    std::unique_lock _{tables_lock};
+    auto it = tables.find(game);
+    Assert(it != tables.end(), "Unknown game {}", game);
+    for (auto& name : it->second.players) player_tables.erase(name);
+    if (open_table == game) open_table.reset();
+    it->second.worker->load--;
+    tables.erase(it);
+}
+
 void Server::receive(net::TCPConnexion& client, net::ReceiveBuffer& buf) {
-    while (not client.disconnected and not buf.empty()) {
+    // Only process packets until the client has logged in; anything
+    // after that is for the game, which will process it once it has
+    // taken over the connexion.
+    auto Pending = [&] { return pending_connexions.find(client.id) != nullptr; };
+    while (not client.disconnected and not buf.empty() and Pending()) {
         auto res = packets::HandleServerSidePacket(*this, client, buf);
 
         // If there was an error, close the connexion.
         if (not res) {
-            Log("Packet error while processing {}: {}", client.address, res.error());
+            Log<LogLevel::Warning>("Packet error while processing {}: {}", client.address, res.error());
             return Kick(client, InvalidPacket);
         }
 
@@ -131,326 +175,245 @@ void Server::handle(net::TCPConnexion& client, cs::Disconnect) {
     client.disconnect();
 }
 
-void Server::handle(net::TCPConnexion& client, sc::WordChoice wc) {
-    // Player has already submitted a word.
-    if (not player_map.contains(client) or player_map[client]->submitted_word) {
-        Kick(client, UnexpectedPacket);
-        return;
-    }
-
-    // Word is invalid.
-    constants::Word original;
-    auto& p = player_map[client];
-    for (auto [i, s] : p->word.stacks | vws::enumerate) original[i] = s.top;
-    if (validation::ValidateInitialWord(wc.word, original) != validation::InitialWordValidationResult::Valid) {
-        Kick(client, InvalidPacket);
-        return;
-    }
-
-    // Word is valid. Mark it as submitted.
-    for (auto [i, c] : wc.word | vws::enumerate) p->word.stacks[i].cards[0].id = c;
-    p->submitted_word = true;
-    Log("Client gave back word");
-}
-
-void Server::handle(net::TCPConnexion& client, cs::HeartbeatResponse res) {
-    Log("Received heartbeat response from client {}", res.seq_no);
-}
-
 void Server::handle(net::TCPConnexion& client, cs::Login login) {
     Log("Login: name = {}, password = {}", login.name, login.password);
 
-    // Mark this as no longer pending and also check whether it was
-    // pending in the first place. Clients that are already connected
-    // to a player are not supposed to send a login packet.
-    auto erased = std::erase_if(pending_connexions, [&](auto& x) {
-        return client == x.conn;
-    });
-    if (erased != 1) return Kick(client, InvalidPacket);
+    // Mark this as no longer pending; receive() only dispatches packets
+    // for pending connexions, so this must have been one.
+    auto pending = pending_connexions.find(client.id);
+    Assert(pending);
+    server.timers().cancel(pending->timeout);
+    pending_connexions.erase(client.id);
 
     // Check that the password matches.
     if (login.password != password) return Kick(client, WrongPassword);
 
-    // Try to match this connexion to an existing player.
-    for (auto& p : players) {
-        if (p->name == login.name) {
-            // Someone is trying to connect to a player that is
-            // already connected.
-            if (p->connected) {
-                Log("{} is already connected", login.name);
-                return Kick(client, UsernameInUse);
-            }
-
-            Log("Player {} logging back in", login.name);
-            p->client_connexion = client;
-            player_map[client] = p.get();
-
-            // Get the player up to date with the current game state.
-            switch (state) {
-                case State::WaitingForPlayerRegistration: break;
-                case State::WaitingForWords:
-                    if (not p->submitted_word) p->send(sc::WordChoice{p->word.ids()});
-                    break;
-
-                case State::Running:
-                    SendGameState(*p);
-                    if (current_player == p->id) p->send(sc::StartTurn{});
-                    break;
-            }
-            return;
-        }
+    // The name ends up in packets and journal records that are
+    // limited in size, so don’t let it get arbitrarily large.
+    if (login.name.size() > constants::MaxPlayerNameSize) return Kick(client, UsernameTooLong);
+
+    // Agree on a protocol version. Clients that don’t send one don’t
+    // know about LoginAccepted either, so just keep using the old
+    // encoding for them.
+    auto version = std::min(login.protocol_version, packets::ProtocolVersion);
+    if (version != packets::LegacyProtocolVersion) {
+        client.send(sc::LoginAccepted{version});
+        client.set_encoding(packets::EncodingFor(version));
     }
 
-    // Create a new player. This is also the only place where we can
-    // reach the player limit for the first time, so perform game
-    // initialisation here if we have enough players.
-    players.push_back(std::make_unique<Player>(client, std::move(login.name)));
-    player_map[client] = players.back().get();
-    if (players.size() == PlayersNeeded) SetUpGame();
+    // We can’t hand this off to a worker while the connexion is still
+    // being processed, so do that later.
+    logged_in.emplace_back(client, std::move(login.name), login.resume, version);
 }
 
-void Server::handle(net::TCPConnexion& client, cs::Pass pass) {
-    // Check that the player is the current player.
-    auto& p = player_map[client];
-    if (p->id != current_player) return Kick(client, UnexpectedPacket);
-
-    // Check that the card index is valid.
-    if (pass.card_index >= p->hand.size()) return Kick(client, InvalidPacket);
-
-    // Discard the card and end the player’s turn.
-    RemoveCard(*p, p->hand[pass.card_index]);
-    NextPlayer();
+// =============================================================================
+//  Worker
+// =============================================================================
+Worker::Worker(Server& lobby, usz index, journal::Sink* sink)
+    : lobby(lobby),
+      loop(net::TCPServer::CreateDetached().value()),
+      sink(sink),
+      tick_monitor(std::format("worker{}", index), SlowTickThreshold) {
+    loop.set_callbacks(*this);
+
+    // Only start the thread once everything else is set up.
+    thread = std::jthread{[this](std::stop_token stop) { Run(std::move(stop)); }};
 }
 
-void Server::handle(net::TCPConnexion& client, cs::PlaySingleTarget c) {
-    // Check that the player is the current player.
-    auto& p = player_map[client];
-    if (p->id != current_player) return Kick(client, UnexpectedPacket);
-
-    /// Check that the player index is valid.
-    if (c.player >= players.size()) return Kick(client, InvalidPacket);
-
-    // Check that the card indices are valid.
-    auto& target_player = players[c.player];
-    if (
-        c.card_index >= p->hand.size() or
-        c.target_stack_index >= target_player->word.stacks.size()
-    ) return Kick(client, InvalidPacket);
-
-    // Now that we have checked that all indices are valid and that it’s
-    // this player’s turn, validate the action itself. Any code below this
-    // MUST be handled in the validation namespace to make sure the client
-    // can perform the exact same checks as the server so we don’t allow a
-    // player to take an invalid action.
-    //
-    // The card is a sound card.
-    auto& card = p->hand[c.card_index];
-    if (card.id.is_sound()) return HandlePlaySoundCard(
-        client,
-        card,
-        *target_player,
-        c.target_stack_index
-    );
-
-    // The card is a power card.
-    switch (card.id.value) {
-        default: Kick(client, InvalidPacket); break;
-        case CardIdValue::P_SpellingReform: {
-            if (not validation::ValidateP_SpellingReform(ValidatorFor(*p), c.target_stack_index))
-                return Kick(client, InvalidPacket);
-
-            // Lock the stack.
-            target_player->word.stacks[c.target_stack_index].locked = true;
-            Broadcast(sc::StackLockChanged{target_player->id, c.target_stack_index, true});
-            RemoveCard(*p, card);
-            NextPlayer();
-        } break;
-    }
+Worker::~Worker() {
+    thread.request_stop();
+    loop.wake();
 }
 
-// =============================================================================
-//  Playing Cards
-// =============================================================================
-void Server::HandlePlaySoundCard(
-    net::TCPConnexion& client,
-    Card& card,
-    Player& target_player,
-    u32 target_index
+void Worker::hand_off(
+    u64 game,
+    bool new_game,
+    net::TCPConnexion conn,
+    std::string name,
+    packets::ResumePoint resume,
+    u32 protocol_version
 ) {
-    auto& p = player_map[client];
-
-    // Perform validation.
-    if (
-        validation::ValidatePlaySoundCard(card.id, ValidatorFor(target_player), target_index) !=
-        validation::PlaySoundCardValidationResult::Valid
-    ) return Kick(client, InvalidPacket);
-
-    // Add the sound to the player’s word.
-    // TODO: Special effects when playing a sound.
-    // TODO: Check for locks.
-    // TODO: The cursed i+2*j -> j change.
-    target_player.word.stacks[target_index].push(Card{card.id});
-    Broadcast(sc::AddSoundToStack{target_player.id, target_index, card.id});
-
-    // Remove the card from the player’s hand and end their turn.
-    RemoveCard(*p, card);
-    NextPlayer();
-}
+    {
+        std::unique_lock _{handoff_lock};
+        handoffs.emplace_back(game, new_game, std::move(conn), std::move(name), resume, protocol_version);
+    }
 
-// =============================================================================
-//  General Game Logic
-// =============================================================================
-void Server::Draw(Player& p, usz count) {
-    for (usz i = 0; i < count; ++i) {
-        if (deck.empty()) {
-            // TODO: Shuffle discard pile back into deck.
-            return;
-        }
+    loop.wake();
+}
 
-        p.hand.push_back(std::move(deck.back()));
-        deck.pop_back();
-        p.send(sc::Draw{p.hand.back().id});
+void Worker::adopt_game(u64 id, std::unique_ptr<Game> game) {
+    {
+        std::unique_lock _{handoff_lock};
+        adopted.emplace_back(id, std::move(game));
     }
-}
 
-void Server::NextPlayer() {
-    // TODO: Can a player somehow have more than 7 cards in hand?
-    if (player().hand.size() < HandSize) Draw(player(), HandSize - player().hand.size());
-    player().send(sc::EndTurn{});
-    current_player = (current_player + 1) % players.size();
-    player().send(sc::StartTurn{});
-
-    // If this player’s hand is empty, move on to the next player. Do this
-    // *after* drawing so this code only fires if the deck is empty.
-    if (player().hand.empty()) {
-        // If *all* players’ hands are empty, we need to end the game. This
-        // *shouldn’t* happen, but you never know...
-        if (rgs::all_of(players, [](auto& p) { return p->hand.empty(); })) {
-            Broadcast(sc::Disconnect{Unspecified});
-            Log("No more plays can be made. The game is a draw.");
-            std::exit(27);
-        }
+    loop.wake();
+}
 
-        NextPlayer();
+void Worker::Run(std::stop_token stop) {
+    while (not stop.stop_requested()) {
+        loop.poll();
+        tick_monitor.begin();
+        TakeHandoffs();
+        Tick();
+        tick_monitor.end();
     }
 }
 
-void Server::SendGameState(Player& p) {
-    // Yes, we recompute this every time this packet is sent, but
-    // it’s sent so rarely (once at the start of the game and once
-    // every time someone rejoins), that it’s not really worth moving
-    // this into a separate function.
-    std::array<sc::StartGame::PlayerInfo, constants::PlayersPerGame> player_infos;
-    for (auto [i, p] : players | vws::enumerate) {
-        player_infos[i].name = p->name;
-        for (auto [j, c] : p->word.stacks | vws::enumerate)
-            player_infos[i].word[j] = c.top;
+void Worker::TakeHandoffs() {
+    std::vector<Handoff> new_connexions;
+    std::vector<std::pair<u64, std::unique_ptr<Game>>> new_games;
+    {
+        std::unique_lock _{handoff_lock};
+        std::swap(new_connexions, handoffs);
+        std::swap(new_games, adopted);
     }
 
-    // Send each player their hand and id.
-    p.send(sc::StartGame{
-        player_infos,
-        p.hand | vws::transform(&Card::id) | rgs::to<std::vector>(),
-        u8(p.id),
-    });
-}
-
-void Server::SetUpGame() {
-    Assert(state == State::WaitingForPlayerRegistration);
-    state = State::WaitingForWords;
+    // Restored games are adopted before anyone can try to rejoin them.
+    for (auto& [id, game] : new_games) {
+        game->attach(pending_ticks);
+        games[id] = std::move(game);
+    }
 
-    // Consonants.
-    auto AddCards = [&](std::span<const CardData> s) {
-        for (auto& c : s) {
-            for (u8 i = 0; i < c.count_in_deck; ++i) {
-                deck.emplace_back(c.id);
-            }
+    for (auto& h : new_connexions) {
+        // Create the game if need be.
+        if (h.new_game) {
+            auto& g = games[h.game] = std::make_unique<Game>(h.game, loop.timers(), sink);
+            g->attach(pending_ticks);
         }
-    };
-
-    AddCards(CardDatabaseConsonants);
-    auto num_consonants = deck.size();
-
-    // Vowels.
-    AddCards(CardDatabaseVowels);
-
-    // Draw the cards for reach player’s word. Alternate vowels
-    // and consonants so the player always gets a valid word to
-    // begin with.
-    rgs::shuffle(deck.begin(), deck.begin() + num_consonants, rng);
-    rgs::shuffle(deck.begin() + num_consonants, deck.end(), rng);
-    for (auto& p : players) {
-        for (u8 i = 0; i < 3; ++i) {
-            // Add consonant.
-            p->word.add_stack(std::move(deck.front()));
-            deck.erase(deck.begin());
-
-            // Add vowel.
-            p->word.add_stack(std::move(deck.back()));
-            deck.pop_back();
+
+        // The game may have ended before the player got here.
+        auto it = games.find(h.game);
+        if (it == games.end()) {
+            Kick(h.conn, Unspecified);
+            continue;
         }
 
-        // Send the player their word.
-        p->send(sc::WordChoice{BuildWordArray(p->word)});
+        // Adopting the connexion gives it the id we index it by; any data
+        // that is already waiting is only dispatched on the next poll, by
+        // which point the game knows about the player.
+        auto& game = *it->second;
+        loop.adopt(h.conn);
+        game_map.insert(h.conn.id, &game);
+        game.add_player(std::move(h.conn), std::move(h.name), h.resume, h.protocol_version);
     }
+}
 
-    // Special cards.
-    AddCards(CardDatabasePowers);
-
-    // Draw each player’s hand, but don’t send the cards yet.
-    rgs::shuffle(deck, rng);
-    for (auto& p : players) {
-        Assert(deck.size() > HandSize, "Somehow out of cards?");
-        p->hand.insert(
-            p->hand.end(),
-            std::make_move_iterator(deck.end() - HandSize),
-            std::make_move_iterator(deck.end())
-        );
-        deck.erase(deck.end() - HandSize, deck.end());
-
-        // FIXME: TESTING ONLY. REMOVE THIS LATER: Hallucinate a Spelling
-        // Reform into the player’s hand.
-        p->hand.emplace_back(CardId::P_SpellingReform);
+void Worker::Tick() {
+    // Only tick games that received data or ran a timer since the last
+    // tick; anything that can end a game does one of those, so this is
+    // also where we find out about games that have ended.
+    std::vector<u64> ended;
+    for (auto g : pending_ticks) {
+        g->tick();
+        if (g->finished()) ended.push_back(g->id);
     }
-    rgs::shuffle(players, rng);
-
-    // FIXME: FOR TESTING ONLY. COMMENT THIS OUT IN PRODUCTION.
-    auto it = rgs::find_if(players, [](auto& p) { return p->name == "debugger" or p->name == "console"; });
-    if (it != players.end()) {
-        Log("Debugger or console found.");
-        std::iter_swap(it, players.begin());
+    pending_ticks.clear();
+
+    // Delete games that have ended.
+    if (not ended.empty()) {
+        game_map.erase_if([](Game* g) { return g->finished(); });
+        for (auto id : ended) {
+            lobby.game_finished(id);
+            games.erase(id);
+        }
     }
 
-    // Initialise player IDs.
-    for (auto [i, p] : players | vws::enumerate) p->id = u8(i);
+    // Close stale connexions.
+    loop.update_connexions();
+}
+
+bool Worker::accept(net::TCPConnexion&) {
+    Unreachable("Workers don’t listen for connexions");
+}
+
+void Worker::receive(net::TCPConnexion& client, net::ReceiveBuffer& buffer) {
+    auto g = game_map.find(client.id);
+    if (not g) return Kick(client, UnexpectedPacket);
+    (*g)->receive(client, buffer);
 }
 
 // =============================================================================
 //  API
 // =============================================================================
-Server::Server(u16 port, std::string password)
-    : server(net::TCPServer::Create(port, 200).value()),
-      password(std::move(password)) {
+Server::Server(
+    u16 port,
+    std::string password,
+    usz worker_count,
+    u16 metrics_port,
+    fs::Path journal_dir
+) : server(net::TCPServer::Create(port, ListenBacklog).value()),
+    password(std::move(password)),
+    tick_monitor("lobby", SlowTickThreshold) {
     server.set_callbacks(*this);
+    if (not journal_dir.empty()) {
+        sink = journal::Sink::Create(std::move(journal_dir)).value();
+        Log("Writing game journals to '{}'", sink->directory().string());
+    }
+
+    for (usz i = 0; i < std::max<usz>(worker_count, 1); i++)
+        workers.push_back(std::make_unique<Worker>(*this, i, sink.get()));
+
+    if (metrics_port != 0) {
+        exporter = metrics::Exporter::Create(metrics_port).value();
+        Log("Serving metrics on port {}", metrics_port);
+    }
+
+    if (sink) RestoreGames();
 }
 
-void Server::Run() {
-    constexpr chr::milliseconds ServerTickDuration = 33ms;
-    Log("Server listening on port {}", server.port());
-    for (;;) {
-        const auto start_of_tick = chr::system_clock::now();
+void Server::RestoreGames() {
+    std::error_code ec;
+    std::vector<fs::Path> paths;
+    for (auto& e : std::filesystem::directory_iterator{sink->directory(), ec})
+        if (e.is_regular_file() and e.path().extension() == journal::ActiveExtension)
+            paths.push_back(e.path());
 
-        Tick();
+    if (ec) {
+        Log<LogLevel::Warning>("Failed to list journals in '{}': {}", sink->directory().string(), ec.message());
+        return;
+    }
 
-        // Sleep for a bit.
-        const auto end_of_tick = chr::system_clock::now();
-        const auto tick_duration = chr::duration_cast<chr::milliseconds>(end_of_tick - start_of_tick);
-        if (tick_duration < ServerTickDuration) {
-            std::this_thread::sleep_for(ServerTickDuration - tick_duration);
-        } else {
-#ifndef PRESCRIPTIVISM_ENABLE_SANITISERS
-            Log("Server tick took too long: {}ms", tick_duration.count());
-#endif
+    // Players who rejoin are sent to their old game, just like after
+    // a disconnect; they can’t tell that the server went away.
+    std::unique_lock _{tables_lock};
+    for (auto& path : paths) {
+        auto id = next_table_id;
+        auto w = rgs::min_element(workers, {}, [](auto& w) { return w->load.load(); });
+        auto res = Game::Restore(id, (*w)->timers(), *sink, path);
+        if (not res) {
+            Log<LogLevel::Warning>("Failed to restore '{}': {}", path.string(), res.error());
+            continue;
         }
+
+        auto game = std::move(res.value());
+        if (not game) continue;
+
+        next_table_id++;
+        auto& table = tables[id];
+        table.worker = w->get();
+        for (auto& name : game->player_names()) {
+            table.players.push_back(name);
+            player_tables[name] = id;
+        }
+
+        (*w)->load++;
+        (*w)->adopt_game(id, std::move(game));
+    }
+}
+
+void Server::Run() {
+    Log("Server listening on port {} with {} workers", server.port(), workers.size());
+    for (;;) {
+        // Sleep until there is network activity or until the next timer
+        // expires; this also dispatches any incoming packets and runs
+        // the timers.
+        server.poll();
+
+        // Then, update everything else; the monitor complains if this
+        // takes an unreasonable amount of time.
+        tick_monitor.begin();
+        Tick();
+        tick_monitor.end();
     }
 }
@@ -0,0 +1,55 @@
+#include <Shared/File.hh>
+
+#include <base/Base.hh>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace pr;
+
+namespace {
+constexpr auto CRCTable = [] {
+    std::array<u32, 256> table{};
+    for (u32 i = 0; i < 256; i++) {
+        u32 c = i;
+        for (int k = 0; k < 8; k++) c = c & 1 ? 0xEDB8'8320 ^ (c >> 1) : c >> 1;
+        table[i] = c;
+    }
+    return table;
+}();
+} // namespace
+
+auto pr::Checksum(ser::InputSpan data) -> u32 {
+    u32 c = ~0u;
+    for (auto b : data) c = CRCTable[(c ^ u8(b)) & 0xff] ^ (c >> 8);
+    return ~c;
+}
+
+MappedFile::~MappedFile() {
+    if (ptr) ::munmap(const_cast<std::byte*>(ptr), size);
+}
+
+auto MappedFile::Open(fs::PathRef path) -> Result<std::unique_ptr<MappedFile>> {
+    auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return Error("Failed to open '{}': {}", path.string(), std::strerror(errno));
+    defer { ::close(fd); };
+
+    struct stat st {};
+    if (::fstat(fd, &st) == -1) return Error("Failed to stat '{}': {}", path.string(), std::strerror(errno));
+
+    // Mapping an empty file is an error, so don’t.
+    std::unique_ptr<MappedFile> f{new MappedFile};
+    if (st.st_size == 0) return f;
+
+    auto p = ::mmap(nullptr, usz(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) return Error("Failed to map '{}': {}", path.string(), std::strerror(errno));
+    ::madvise(p, usz(st.st_size), MADV_SEQUENTIAL);
+    f->ptr = static_cast<const std::byte*>(p);
+    f->size = usz(st.st_size);
+    return f;
+}
@@ -0,0 +1,153 @@
+#include <Shared/GameState.hh>
+
+#include <base/Base.hh>
+
+#include <algorithm>
+#include <ranges>
+
+using namespace pr;
+using namespace pr::rules;
+
+bool rules::AllHandsEmpty(const GameState& g) {
+    return rgs::all_of(g.players, [](auto& p) { return p.hand.empty(); });
+}
+
+void rules::Apply(GameState& g, Action a) {
+    switch (a.kind) {
+        case Action::Kind::Play: return Play(g, a.move);
+        case Action::Kind::Discard: return Discard(g, a.move.card);
+    }
+
+    Unreachable();
+}
+
+void rules::Discard(GameState& g, usz card) {
+    auto& hand = g.current().hand;
+    Assert(card < hand.size(), "Card not in hand");
+    g.discard.push_back(hand[card]);
+    hand.erase(hand.begin() + card);
+}
+
+auto rules::Draw(GameState& g, PlayerId p, usz count) -> usz {
+    auto& hand = g.players[p].hand;
+    usz drawn = 0;
+    for (; drawn < count and not hand.full(); drawn++) {
+        if (g.deck.empty()) {
+            // TODO: Shuffle discard pile back into deck.
+            break;
+        }
+
+        hand.push_back(g.deck.back());
+        g.deck.pop_back();
+    }
+
+    return drawn;
+}
+
+bool rules::IsLegal(const GameState& g, validation::Move m) {
+    auto& hand = g.current().hand;
+    if (
+        m.card >= hand.size() or
+        m.word >= g.players.size() or
+        m.stack >= g.players[m.word].word.stacks.size()
+    ) return false;
+
+    // Any code below this MUST be handled in the validation namespace to
+    // make sure the client can perform the exact same checks so we don’t
+    // allow a player to take an invalid action.
+    auto card = hand[m.card];
+    auto on = ViewOf(g, PlayerId(m.word));
+    if (card.is_sound()) return validation::ValidatePlaySoundCard(card, on, m.stack) == validation::PlaySoundCardValidationResult::Valid;
+    switch (card.value) {
+        default: return false;
+        case CardIdValue::P_SpellingReform: return validation::ValidateP_SpellingReform(on, m.stack);
+    }
+}
+
+auto rules::LegalMoves(const GameState& g) -> validation::MoveSet {
+    std::array<WordView, constants::PlayersPerGame> words{
+        ViewOf(g, 0),
+        ViewOf(g, 1),
+    };
+
+    static_assert(constants::PlayersPerGame == 2, "Update the list of words above");
+    auto& hand = g.current().hand;
+    return validation::EnumerateMoves(std::span<const CardId>{hand}, std::span<const WordView>{words});
+}
+
+void rules::Play(GameState& g, validation::Move m) {
+    Assert(IsLegal(g, m), "Illegal move");
+    auto card = g.current().hand[m.card];
+    auto& stack = g.players[m.word].word.stacks[m.stack];
+
+    // TODO: Special effects when playing a sound.
+    // TODO: The cursed i+2*j -> j change.
+    if (card.is_sound()) stack.push(card);
+    else if (card == CardId::P_SpellingReform) stack.locked = true;
+    else Unreachable("Unsupported power card");
+
+    // The card goes to the discard pile either way.
+    Discard(g, m.card);
+}
+
+void rules::SetUp(GameState& g, Rng& rng, const DeckCounts& counts) {
+    auto& deck = g.deck;
+    auto AddCards = [&](std::span<const CardData> s) {
+        for (auto& c : s) {
+            for (u8 i = 0; i < counts[+c.id]; ++i) {
+                deck.push_back(c.id);
+            }
+        }
+    };
+
+    // Consonants.
+    AddCards(CardDatabaseConsonants);
+    auto num_consonants = deck.size();
+
+    // Vowels.
+    AddCards(CardDatabaseVowels);
+
+    // Draw the cards for reach player’s word. Alternate vowels
+    // and consonants so the player always gets a valid word to
+    // begin with.
+    rgs::shuffle(deck.begin(), deck.begin() + num_consonants, rng);
+    rgs::shuffle(deck.begin() + num_consonants, deck.end(), rng);
+    for (auto& p : g.players) {
+        Assert(
+            num_consonants >= 3 and deck.size() - num_consonants >= 3,
+            "Not enough sounds in the deck to deal every player a word"
+        );
+
+        for (u8 i = 0; i < 3; ++i) {
+            // Add consonant. Take the last one so only the vowels
+            // have to be moved.
+            p.word.add_stack(deck[--num_consonants]);
+            deck.erase(deck.begin() + num_consonants);
+
+            // Add vowel.
+            p.word.add_stack(deck.back());
+            deck.pop_back();
+        }
+    }
+
+    // Special cards.
+    AddCards(CardDatabasePowers);
+
+    // Draw each player’s hand.
+    rgs::shuffle(deck, rng);
+    for (auto& p : g.players) {
+        Assert(deck.size() > HandSize, "Somehow out of cards?");
+        for (usz i = 0; i < HandSize; ++i) {
+            p.hand.push_back(deck.back());
+            deck.pop_back();
+        }
+
+        // FIXME: TESTING ONLY. REMOVE THIS LATER: Hallucinate a Spelling
+        // Reform into the player’s hand.
+        p.hand.push_back(CardId::P_SpellingReform);
+    }
+}
+
+auto rules::ViewOf(const GameState& g, PlayerId owner) -> WordView {
+    return WordView{g.players[owner], owner, g.current_player};
+}
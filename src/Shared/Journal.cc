@@ -0,0 +1,324 @@
+#include <Shared/Journal.hh>
+#include <Shared/Validation.hh>
+
+#include <base/Base.hh>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <unistd.h>
+
+using namespace pr;
+using namespace pr::journal;
+
+// =============================================================================
+//  Format
+// =============================================================================
+namespace {
+auto Header() -> std::vector<std::byte> {
+    std::vector<std::byte> header;
+    ser::Writer{header} << Magic << Version;
+    return header;
+}
+
+auto ReadRecord(ser::Reader& r) -> std::optional<Record> {
+    auto type = r.read<u8>();
+    if (not r) return std::nullopt;
+    switch (RecordType(type)) {
+#define X(name)                \
+    case RecordType::name: {   \
+        name rec;              \
+        r >> rec;              \
+        return Record{std::move(rec)}; \
+    }
+        JOURNAL_RECORDS(X)
+#undef X
+    }
+
+    r.fail(std::format("Unknown record type {}", type));
+    return std::nullopt;
+}
+} // namespace
+
+void journal::AppendRecord(std::vector<std::byte>& buffer, const Record& r) {
+    // Leave room for the frame header; we only know what goes in there
+    // once the record has been written.
+    auto start = buffer.size();
+    buffer.resize(start + FrameHeaderSize);
+    {
+        ser::Writer w{buffer, ser::Encoding::Compact};
+        w << u8(r.index());
+        std::visit([&](const auto& rec) { w << rec; }, r);
+    }
+
+    auto payload = std::span{buffer}.subspan(start + FrameHeaderSize);
+    std::vector<std::byte> header;
+    ser::Writer{header} << u32(payload.size()) << Checksum(payload);
+    rgs::copy(header, buffer.begin() + isz(start));
+}
+
+// =============================================================================
+//  Reading
+// =============================================================================
+auto Reader::Open(ser::InputSpan data) -> Result<Reader> {
+    if (data.size() < HeaderSize) return Error("Not a journal: file is only {} bytes", data.size());
+
+    ser::Reader r{data.subspan(0, HeaderSize)};
+    auto magic = r.read<u32>();
+    auto version = r.read<u32>();
+    if (magic != Magic) return Error("Not a journal: bad magic number {:#010x}", magic);
+    if (version != Version) return Error("Unsupported journal version {} (expected {})", version, Version);
+    return Reader{data};
+}
+
+auto Reader::next() -> std::optional<Record> {
+    if (not err.empty() or offset == data.size()) return std::nullopt;
+    auto Fail = [&](std::string_view msg) -> std::optional<Record> {
+        err = std::format("{} at offset {}", msg, offset);
+        return std::nullopt;
+    };
+
+    // Everything past the end of the last complete frame is what was
+    // being written when we stopped.
+    auto rest = data.subspan(offset);
+    if (rest.size() < FrameHeaderSize) return Fail("Truncated frame header");
+
+    ser::Reader h{rest.subspan(0, FrameHeaderSize)};
+    auto length = h.read<u32>();
+    auto checksum = h.read<u32>();
+    if (length > MaxRecordSize) return Fail(std::format("Record of {} bytes is too large", length));
+    if (rest.size() - FrameHeaderSize < length) return Fail("Truncated record");
+
+    auto payload = rest.subspan(FrameHeaderSize, length);
+    if (Checksum(payload) != checksum) return Fail("Checksum mismatch");
+
+    // The checksum matched, so anything wrong with the contents is a
+    // bug in whatever wrote them.
+    ser::Reader r{payload, ser::Encoding::Compact};
+    auto rec = ReadRecord(r);
+    if (not r) return Fail(std::format("Invalid record: {}", r.result.error()));
+    if (r.size() != 0) return Fail(std::format("{} bytes of trailing data in record", r.size()));
+
+    offset += FrameHeaderSize + length;
+    return rec;
+}
+
+// =============================================================================
+//  Replaying
+// =============================================================================
+auto Replayer::apply(const Record& r) -> Result<> {
+    if (complete) return Error("Record after the end of the game");
+    if (not start and not std::holds_alternative<Start>(r)) return Error("Journal does not begin with a start record");
+    if (over and not std::holds_alternative<End>(r)) return Error("Action after the game was over");
+    return std::visit([&](const auto& rec) { return Apply(rec); }, r);
+}
+
+auto Replayer::Apply(const Start& s) -> Result<> {
+    if (start) return Error("Duplicate start record");
+    for (auto [i, info] : s.players | vws::enumerate) {
+        if (info.hand.size() > MaxHandSize) return Error("Player {} has {} cards", i, info.hand.size());
+        auto& p = state.players[usz(i)];
+        for (auto c : info.word) p.word.add_stack(c);
+        for (auto c : info.hand) p.hand.push_back(c);
+    }
+
+    if (s.deck.size() > MaxPileSize) return Error("Deck has {} cards", s.deck.size());
+    for (auto c : s.deck) state.deck.push_back(c);
+    start = s;
+    return {};
+}
+
+auto Replayer::Apply(const WordChoice& w) -> Result<> {
+    if (w.player >= state.players.size()) return Error("Invalid player {}", w.player);
+    auto& p = state.players[w.player];
+    if (p.submitted_word) return Error("Player {} submitted their word twice", w.player);
+
+    constants::Word original;
+    for (auto [i, s] : p.word.stacks | vws::enumerate) original[usz(i)] = s.top;
+    if (validation::ValidateInitialWord(w.word, original) != validation::InitialWordValidationResult::Valid)
+        return Error("Invalid word for player {}", w.player);
+
+    for (auto [i, c] : w.word | vws::enumerate) p.word.stacks[usz(i)].cards[0] = c;
+    p.submitted_word = true;
+    actions++;
+    return {};
+}
+
+auto Replayer::Apply(const Play& p) -> Result<> {
+    Try(CheckTurn(p.player, p.card_index, p.card));
+    validation::Move m{p.card_index, p.target, p.stack};
+    if (not rules::IsLegal(state, m)) return Error("Illegal play in turn {}", state.turns);
+    rules::Play(state, m);
+    EndTurn();
+    return {};
+}
+
+auto Replayer::Apply(const Pass& p) -> Result<> {
+    Try(CheckTurn(p.player, p.card_index, p.card));
+    rules::Discard(state, p.card_index);
+    EndTurn();
+    return {};
+}
+
+auto Replayer::Apply(const End& e) -> Result<> {
+    if (e.turns != state.turns) return Error("Game ended after {} turns, but we counted {}", e.turns, state.turns);
+    over = complete = true;
+    return {};
+}
+
+auto Replayer::CheckTurn(PlayerId player, u32 card_index, CardId card) -> Result<> {
+    if (not rgs::all_of(state.players, &PlayerState::submitted_word)) return Error("Action before all words were submitted");
+    if (player != state.current_player) return Error("Player {} acted during the turn of player {}", player, state.current_player);
+
+    auto& hand = state.current().hand;
+    if (card_index >= hand.size()) return Error("Card index {} out of bounds in turn {}", card_index, state.turns);
+    if (hand[card_index] != card) return Error("Expected card {} in turn {}, but hand has {}", +card, state.turns, +hand[card_index]);
+    return {};
+}
+
+void Replayer::EndTurn() {
+    rules::IgnoreTurns o;
+    actions++;
+    if (not rules::EndTurn(state, o)) over = true;
+}
+
+// =============================================================================
+//  Writing
+// =============================================================================
+struct Sink::File {
+    LIBBASE_IMMOVABLE(File);
+
+    int fd;
+    fs::Path path;
+
+    /// Set once a write failed; this is read by the game’s thread.
+    std::atomic_bool failed = false;
+
+    File(int fd, fs::Path path) : fd(fd), path(std::move(path)) {}
+    ~File() { ::close(fd); }
+
+    /// Stop writing to the journal after an error. A record may only
+    /// have been written in part, and anything we appended after it
+    /// would be unreadable, so rename the journal so it isn’t resumed
+    /// from whatever came before that either.
+    void fail(std::string_view why) {
+        Log<LogLevel::Error>("Failed to write '{}': {}; no longer writing to it", path.string(), why);
+        failed.store(true, std::memory_order::release);
+        auto to = path;
+        to.replace_extension(FailedExtension);
+        std::error_code ec;
+        std::filesystem::rename(path, to, ec);
+        if (ec) Log<LogLevel::Warning>("Failed to rename '{}': {}", path.string(), ec.message());
+    }
+
+    /// Make sure everything reaches the disk, and rename the journal so
+    /// it isn’t resumed.
+    void finish() {
+        if (failed.load(std::memory_order::relaxed)) return;
+        if (::fdatasync(fd) == -1) Log<LogLevel::Warning>("Failed to sync '{}': {}", path.string(), std::strerror(errno));
+        auto to = path;
+        to.replace_extension(FinishedExtension);
+        std::error_code ec;
+        std::filesystem::rename(path, to, ec);
+        if (ec) Log<LogLevel::Warning>("Failed to rename '{}': {}", path.string(), ec.message());
+    }
+
+    /// Write all of 'data'; we’re on the sink thread, so blocking is fine.
+    void write(ser::InputSpan data) {
+        if (failed.load(std::memory_order::relaxed)) return;
+        while (not data.empty()) {
+            auto n = ::write(fd, data.data(), data.size());
+            if (n == -1) {
+                if (errno == EINTR) continue;
+                return fail(std::strerror(errno));
+            }
+
+            data = ser::InputSpan{data.subspan(usz(n))};
+        }
+    }
+};
+
+Sink::Sink(fs::Path dir) : dir(std::move(dir)) {
+    thread = std::jthread{[this](std::stop_token stop) { Run(std::move(stop)); }};
+}
+
+Sink::~Sink() = default;
+
+auto Sink::Create(fs::Path dir) -> Result<std::unique_ptr<Sink>> {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) return Error("Failed to create journal directory '{}': {}", dir.string(), ec.message());
+    return std::unique_ptr<Sink>{new Sink(std::move(dir))};
+}
+
+auto Sink::create(u64 session) -> Result<Writer> {
+    auto path = dir / std::format("{:016x}{}", session, ActiveExtension);
+    auto fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644);
+    if (fd == -1) return Error("Failed to create '{}': {}", path.string(), std::strerror(errno));
+
+    // The header is written along with the first records.
+    Writer w{*this, std::make_shared<File>(fd, std::move(path))};
+    w.buffer = Header();
+    return w;
+}
+
+auto Sink::resume(fs::PathRef path, usz valid_size) -> Result<Writer> {
+    auto fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (fd == -1) return Error("Failed to open '{}': {}", path.string(), std::strerror(errno));
+
+    // Drop whatever was being written when we crashed; appending after
+    // a damaged frame would make everything after it unreadable.
+    auto file = std::make_shared<File>(fd, path);
+    if (::ftruncate(fd, off_t(valid_size)) == -1)
+        return Error("Failed to truncate '{}': {}", path.string(), std::strerror(errno));
+    return Writer{*this, std::move(file)};
+}
+
+void Sink::Run(std::stop_token stop) {
+    std::vector<Job> batch;
+    for (;;) {
+        {
+            // Once we’re asked to stop, finish whatever is still queued.
+            std::unique_lock lock{mutex};
+            cv.wait(lock, stop, [&] { return not jobs.empty(); });
+            if (jobs.empty()) return;
+            std::swap(batch, jobs);
+        }
+
+        for (auto& j : batch) {
+            j.file->write(j.data);
+            if (j.finish) j.file->finish();
+        }
+
+        batch.clear();
+    }
+}
+
+void Sink::Submit(Job job) {
+    {
+        std::unique_lock _{mutex};
+        jobs.push_back(std::move(job));
+    }
+
+    cv.notify_one();
+}
+
+bool Writer::failed() const {
+    return file and file->failed.load(std::memory_order::acquire);
+}
+
+void Writer::flush() {
+    if (not file or buffer.empty()) return;
+    sink->Submit({file, std::move(buffer), false});
+    buffer = {};
+}
+
+void Writer::finish() {
+    if (not file) return;
+    sink->Submit({std::move(file), std::move(buffer), true});
+    file = nullptr;
+    buffer = {};
+}
@@ -0,0 +1,159 @@
+#include <Shared/Log.hh>
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <print>
+#include <string>
+#include <thread>
+
+using namespace pr;
+using namespace pr::detail;
+
+// =============================================================================
+//  Ring Buffer
+// =============================================================================
+//
+// This is a bounded multi-producer, single-consumer queue: a producer
+// claims a record by bumping 'EnqueuePos' and hands it to the logging
+// thread by bumping the record’s sequence number; the logging thread
+// then bumps that number again once it’s done with the record.
+//
+// A record at index 'i' is free for the enqueue position 'pos' if its
+// sequence number is 'pos', and ready for the logging thread if it is
+// 'pos + 1'. We store all sequence numbers minus their index so that
+// the initial state is all zeroes and the buffer can be constinit.
+constexpr usz LogCapacity = 2'048;
+constexpr u64 LogMask = LogCapacity - 1;
+static_assert(std::has_single_bit(LogCapacity));
+
+namespace {
+constinit LogRecord Records[LogCapacity]{};
+constinit std::atomic<u64> EnqueuePos = 0;
+constinit std::atomic<u64> Dropped = 0;
+constinit std::atomic_bool Wakeup = false;
+constinit std::atomic<LogOverflowPolicy> OverflowPolicy = LogOverflowPolicy::Drop;
+u64 DequeuePos = 0;
+} // namespace
+
+constinit std::atomic<LogLevel> pr::detail::CurrentLogLevel = LogLevel::Debug;
+constinit std::atomic_bool pr::detail::LogEnabled = true;
+
+auto pr::detail::AcquireLogRecord() -> LogRecord* {
+    auto pos = EnqueuePos.load(std::memory_order::relaxed);
+    for (;;) {
+        auto& r = Records[pos & LogMask];
+        auto seq = r.sequence.load(std::memory_order::acquire) + (pos & LogMask);
+        auto diff = i64(seq - pos);
+
+        // The record is free; try to claim it.
+        if (diff == 0) {
+            if (EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order::relaxed)) return &r;
+            continue;
+        }
+
+        // The buffer is full.
+        if (diff < 0) {
+            if (OverflowPolicy.load(std::memory_order::relaxed) == LogOverflowPolicy::Drop) {
+                Dropped.fetch_add(1, std::memory_order::relaxed);
+                return nullptr;
+            }
+
+            std::this_thread::yield();
+        }
+
+        // Someone else claimed this record before us.
+        pos = EnqueuePos.load(std::memory_order::relaxed);
+    }
+}
+
+void pr::detail::CommitLogRecord(LogRecord* r) {
+    // We own this record, so no-one else can touch its sequence number.
+    r->sequence.store(r->sequence.load(std::memory_order::relaxed) + 1, std::memory_order::release);
+
+    // Only wake the logging thread if it might be asleep.
+    if (not Wakeup.exchange(true, std::memory_order::acq_rel)) Wakeup.notify_one();
+}
+
+// =============================================================================
+//  Logging Thread
+// =============================================================================
+namespace {
+void Print(const LogRecord& r, std::string& msg) {
+    static constexpr std::string_view Colours[]{"90", "33", "35", "31"};
+
+    msg.clear();
+    r.format(r, msg);
+    if (not msg.ends_with('\n')) msg += '\n';
+
+    std::tm now_tm;
+    std::time_t now_c = chr::system_clock::to_time_t(r.time);
+    ::localtime_r(&now_c, &now_tm);
+    std::print(
+        stderr,
+        "\033[{}m[{:02}:{:02}:{:02}]\033[m {}",
+        Colours[+r.level],
+        now_tm.tm_hour,
+        now_tm.tm_min,
+        now_tm.tm_sec,
+        msg
+    );
+}
+
+/// Print every message that is ready.
+void Drain(std::string& msg) {
+    for (;;) {
+        auto& r = Records[DequeuePos & LogMask];
+        auto seq = r.sequence.load(std::memory_order::acquire) + (DequeuePos & LogMask);
+        if (seq != DequeuePos + 1) break;
+        Print(r, msg);
+
+        // Hand the record back to the producers, one lap later.
+        r.sequence.store(r.sequence.load(std::memory_order::relaxed) + LogCapacity - 1, std::memory_order::release);
+        DequeuePos++;
+    }
+
+    if (auto n = Dropped.exchange(0, std::memory_order::relaxed))
+        std::print(stderr, "\033[31m[Log]\033[m Dropped {} messages\n", n);
+}
+} // namespace
+
+// Run the logger on a separate thread since printing to the console
+// might be slow depending on what console we’re printing to (it can
+// take ~100ms in my IDE).
+std::jthread LoggerThread([](std::stop_token tok) {
+    std::atexit([] {
+        LoggerThread.request_stop();
+        Wakeup.store(true, std::memory_order::release);
+        Wakeup.notify_one();
+    });
+
+    std::string msg;
+    for (;;) {
+        Wakeup.wait(false, std::memory_order::acquire);
+        Wakeup.exchange(false, std::memory_order::acq_rel);
+        Drain(msg);
+        if (tok.stop_requested()) return;
+    }
+});
+
+// =============================================================================
+//  API
+// =============================================================================
+void pr::SetLogLevel(LogLevel level) {
+    CurrentLogLevel.store(level, std::memory_order::relaxed);
+}
+
+void pr::SetLogOverflowPolicy(LogOverflowPolicy policy) {
+    OverflowPolicy.store(policy, std::memory_order::relaxed);
+}
+
+SilenceLog::SilenceLog() {
+    LogEnabled = false;
+}
+
+SilenceLog::~SilenceLog() {
+    LogEnabled = true;
+}
@@ -0,0 +1,346 @@
+#include <Shared/Metrics.hh>
+#include <Shared/Utils.hh>
+
+#include <base/Base.hh>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <format>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// =============================================================================
+//  Linux
+// =============================================================================
+#ifdef __linux__
+#    include <netinet/in.h>
+#    include <sys/socket.h>
+
+#    include <poll.h>
+#    include <unistd.h>
+
+// =============================================================================
+//  Windows
+// =============================================================================
+#else
+#    error TODO: Non-linux support
+#endif
+
+using namespace pr;
+using namespace pr::metrics;
+
+// =============================================================================
+//  Registry
+// =============================================================================
+namespace {
+struct Registry {
+    std::mutex lock;
+    std::vector<Metric*> metrics;
+
+    static auto Get() -> Registry& {
+        static Registry r;
+        return r;
+    }
+};
+
+void AppendSample(
+    std::string& out,
+    std::string_view name,
+    std::string_view suffix,
+    std::string_view labels,
+    std::string_view extra_label,
+    auto value
+) {
+    std::format_to(std::back_inserter(out), "{}{}", name, suffix);
+    if (not labels.empty() or not extra_label.empty()) {
+        auto sep = not labels.empty() and not extra_label.empty() ? "," : "";
+        std::format_to(std::back_inserter(out), "{{{}{}{}}}", labels, sep, extra_label);
+    }
+    std::format_to(std::back_inserter(out), " {}\n", value);
+}
+} // namespace
+
+Metric::Metric(std::string name, std::string help, std::string labels)
+    : _name(std::move(name)),
+      _help(std::move(help)),
+      _labels(std::move(labels)) {
+    auto& r = Registry::Get();
+    std::unique_lock _{r.lock};
+    r.metrics.push_back(this);
+}
+
+Metric::~Metric() {
+    auto& r = Registry::Get();
+    std::unique_lock _{r.lock};
+    std::erase(r.metrics, this);
+}
+
+auto metrics::Render() -> std::string {
+    auto& r = Registry::Get();
+    std::unique_lock _{r.lock};
+
+    // Group metrics by family; the exposition format requires all
+    // samples of a family to be contiguous.
+    auto sorted = r.metrics;
+    rgs::stable_sort(sorted, {}, [](Metric* m) -> std::string_view { return m->name; });
+
+    std::string out;
+    std::string_view family;
+    for (auto m : sorted) {
+        if (m->name != family) {
+            family = m->name;
+            std::format_to(std::back_inserter(out), "# HELP {} {}\n", m->name, m->help);
+            std::format_to(std::back_inserter(out), "# TYPE {} {}\n", m->name, m->TypeName());
+        }
+
+        m->RenderSamples(out);
+    }
+
+    return out;
+}
+
+// =============================================================================
+//  Metrics
+// =============================================================================
+void Counter::RenderSamples(std::string& out) const {
+    AppendSample(out, name, "", labels, "", get());
+}
+
+void Gauge::RenderSamples(std::string& out) const {
+    AppendSample(out, name, "", labels, "", get());
+}
+
+auto Histogram::quantile(f64 q) const -> u64 {
+    auto n = count();
+    if (n == 0) return 0;
+
+    auto target = std::max<u64>(u64(std::ceil(q * f64(n))), 1);
+    u64 seen = 0;
+    for (usz i = 0; i < BucketCount; i++) {
+        seen += buckets[i].load(std::memory_order::relaxed);
+        if (seen >= target) return UpperBound(i);
+    }
+
+    // Buckets may have been updated while we were reading them.
+    return ~u64(0);
+}
+
+void Histogram::RenderSamples(std::string& out) const {
+    std::array<u64, BucketCount> snapshot;
+    usz last = 0;
+    for (usz i = 0; i < BucketCount; i++) {
+        snapshot[i] = buckets[i].load(std::memory_order::relaxed);
+        if (snapshot[i]) last = i;
+    }
+
+    // Export one bucket per power of two; exporting every sub-bucket
+    // would be far too much data for not much benefit.
+    u64 cumulative = 0;
+    for (usz i = 0; i < BucketCount; i++) {
+        cumulative += snapshot[i];
+        if ((i + 1) % SubBuckets != 0 or i + 1 == BucketCount) continue;
+        auto le = std::format("le=\"{}\"", f64(UpperBound(i)) * scale);
+        AppendSample(out, name, "_bucket", labels, le, cumulative);
+        if (i >= last) break;
+    }
+
+    AppendSample(out, name, "_bucket", labels, "le=\"+Inf\"", cumulative);
+    AppendSample(out, name, "_sum", labels, "", f64(sum.load(std::memory_order::relaxed)) * scale);
+    AppendSample(out, name, "_count", labels, "", cumulative);
+}
+
+// =============================================================================
+//  Tick Monitor
+// =============================================================================
+namespace {
+constexpr chr::milliseconds WatchdogInterval = 5ms;
+
+struct Watchdog {
+    std::mutex lock;
+    std::condition_variable_any cv;
+    std::vector<TickMonitor*> monitors;
+    std::jthread thread{[this](std::stop_token stop) { Run(stop); }};
+
+    static auto Get() -> Watchdog& {
+        static Watchdog w;
+        return w;
+    }
+
+    void Run(std::stop_token stop) {
+        std::unique_lock l{lock};
+        while (not stop.stop_requested()) {
+            cv.wait_for(l, stop, WatchdogInterval, [] { return false; });
+            auto now = chr::steady_clock::now();
+            for (auto m : monitors) m->check(now);
+        }
+    }
+};
+
+auto Nanoseconds(chr::steady_clock::time_point t) -> i64 {
+    return chr::duration_cast<chr::nanoseconds>(t.time_since_epoch()).count();
+}
+} // namespace
+
+TickMonitor::TickMonitor(std::string loop, chr::nanoseconds threshold)
+    : _loop(std::move(loop)),
+      duration(
+          "prescriptivism_tick_duration_seconds",
+          "Time spent processing a single tick of an event loop",
+          std::format("loop=\"{}\"", _loop),
+          1e-9
+      ),
+      slow_ticks(
+          "prescriptivism_slow_ticks_total",
+          "Number of ticks that took longer than the tick budget",
+          std::format("loop=\"{}\"", _loop)
+      ),
+      threshold(threshold) {
+    auto& w = Watchdog::Get();
+    std::unique_lock _{w.lock};
+    w.monitors.push_back(this);
+}
+
+TickMonitor::~TickMonitor() {
+    auto& w = Watchdog::Get();
+    std::unique_lock _{w.lock};
+    std::erase(w.monitors, this);
+}
+
+void TickMonitor::begin() {
+    reported.store(false, std::memory_order::relaxed);
+    started.store(Nanoseconds(chr::steady_clock::now()), std::memory_order::release);
+}
+
+void TickMonitor::end() {
+    auto start = started.exchange(0, std::memory_order::acq_rel);
+    if (start == 0) return;
+
+    chr::nanoseconds elapsed{Nanoseconds(chr::steady_clock::now()) - start};
+    duration.record(elapsed);
+    if (elapsed < threshold) return;
+    slow_ticks.add();
+
+    // Mention it again if the watchdog has already reported this one,
+    // since we now know how long it actually took.
+#ifndef PRESCRIPTIVISM_ENABLE_SANITISERS
+    auto ms = chr::duration_cast<chr::milliseconds>(elapsed).count();
+    if (reported.load(std::memory_order::relaxed)) Log<LogLevel::Warning>("{} tick finished after {}ms", loop, ms);
+    else Log<LogLevel::Warning>("{} tick took too long: {}ms", loop, ms);
+#endif
+}
+
+void TickMonitor::check(chr::steady_clock::time_point now) {
+    auto start = started.load(std::memory_order::acquire);
+    if (start == 0) return;
+
+    chr::nanoseconds elapsed{Nanoseconds(now) - start};
+    if (elapsed < threshold or reported.exchange(true, std::memory_order::relaxed)) return;
+#ifndef PRESCRIPTIVISM_ENABLE_SANITISERS
+    auto ms = chr::duration_cast<chr::milliseconds>(elapsed).count();
+    Log<LogLevel::Warning>("{} tick has been running for {}ms", loop, ms);
+#endif
+}
+
+// =============================================================================
+//  Exporter
+// =============================================================================
+struct Exporter::Impl {
+    int listener;
+    std::jthread thread;
+
+    explicit Impl(int listener) : listener(listener) {
+        thread = std::jthread{[this](std::stop_token stop) { Run(stop); }};
+    }
+
+    ~Impl() {
+        thread.request_stop();
+        thread.join();
+        ::close(listener);
+    }
+
+    void Run(std::stop_token stop);
+    void Serve(int client);
+};
+
+void Exporter::Impl::Run(std::stop_token stop) {
+    // Poll with a timeout so we notice when we’re asked to stop.
+    while (not stop.stop_requested()) {
+        pollfd pfd{listener, POLLIN, 0};
+        auto n = ::poll(&pfd, 1, 250);
+        if (n <= 0) continue;
+
+        auto client = ::accept(listener, nullptr, nullptr);
+        if (client == -1) continue;
+        Serve(client);
+        ::close(client);
+    }
+}
+
+void Exporter::Impl::Serve(int client) {
+    // Don’t let a client that never sends anything block us.
+    timeval tv{1, 0};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+
+    // Read the request line; we don’t care about the headers.
+    std::string request;
+    char buf[1'024];
+    while (not request.contains("\r\n") and request.size() < 8'192) {
+        auto sz = ::recv(client, buf, sizeof buf, 0);
+        if (sz <= 0) return;
+        request.append(buf, usz(sz));
+    }
+
+    std::string_view status = "200 OK";
+    std::string body;
+    if (request.starts_with("GET /metrics ") or request.starts_with("GET / ")) body = Render();
+    else status = "404 Not Found";
+
+    auto response = std::format(
+        "HTTP/1.1 {}\r\n"
+        "Content-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: {}\r\n"
+        "Connection: close\r\n"
+        "\r\n"
+        "{}",
+        status,
+        body.size(),
+        body
+    );
+
+    for (std::string_view data = response; not data.empty();) {
+        auto sz = ::send(client, data.data(), data.size(), MSG_NOSIGNAL);
+        if (sz == -1 and errno == EINTR) continue;
+        if (sz <= 0) return;
+        data.remove_prefix(usz(sz));
+    }
+}
+
+Exporter::Exporter(std::unique_ptr<Impl> impl) : impl(std::move(impl)) {}
+Exporter::~Exporter() = default;
+
+auto Exporter::Create(u16 port) -> Result<std::unique_ptr<Exporter>> {
+    auto sock = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock == -1) return Error("Failed to create metrics socket: {}", std::strerror(errno));
+
+    auto Fail = [&](std::string_view what) -> Result<std::unique_ptr<Exporter>> {
+        std::string reason = std::strerror(errno);
+        ::close(sock);
+        return Error("Failed to {} metrics socket: {}", what, reason);
+    };
+
+    int opt = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof opt) == -1) return Fail("configure");
+
+    sockaddr_in sa{};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    sa.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(sock, reinterpret_cast<sockaddr*>(&sa), sizeof sa) == -1) return Fail("bind");
+    if (listen(sock, 16) == -1) return Fail("listen on");
+
+    return std::unique_ptr<Exporter>(new Exporter(std::make_unique<Impl>(sock)));
+}
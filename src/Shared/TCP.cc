@@ -1,13 +1,18 @@
+#include <Shared/Metrics.hh>
 #include <Shared/TCP.hh>
 
 #include <base/Base.hh>
 
+#include <array>
 #include <cerrno>
 #include <cstring>
+#include <deque>
 #include <functional>
+#include <limits>
 #include <memory>
 #include <print>
 #include <span>
+#include <utility>
 #include <vector>
 
 // =============================================================================
@@ -16,8 +21,11 @@
 #ifdef __linux__
 #    include <arpa/inet.h>
 #    include <netinet/in.h>
+#    include <sys/epoll.h>
+#    include <sys/eventfd.h>
 #    include <sys/socket.h>
 #    include <sys/types.h>
+#    include <sys/uio.h>
 
 #    include <fcntl.h>
 #    include <netdb.h>
@@ -33,6 +41,18 @@
 using namespace pr;
 using namespace pr::net;
 
+namespace {
+metrics::Counter BytesReceived{"prescriptivism_net_received_bytes_total", "Bytes received on all connexions"};
+metrics::Counter BytesSent{"prescriptivism_net_sent_bytes_total", "Bytes sent on all connexions"};
+metrics::Counter FramesReceived{"prescriptivism_net_received_frames_total", "Frames received on all connexions"};
+metrics::Counter FramesSent{"prescriptivism_net_sent_frames_total", "Frames queued for sending on all connexions"};
+metrics::Gauge Connexions{"prescriptivism_net_connexions", "Connexions managed by a server"};
+metrics::Gauge SendBacklog{"prescriptivism_net_send_backlog_bytes", "Bytes left in send queues after the last flush"};
+
+/// How long to wait before accepting again after accept() failed.
+constexpr auto AcceptRetryInterval = 100ms;
+} // namespace
+
 namespace pr::net::impl {
 // =============================================================================
 //  Impl - Linux Decls
@@ -53,6 +73,9 @@ constexpr Socket InvalidSocket = -1;
 // =============================================================================
 namespace pr::net::impl {
 /// RAII wrapper for a socket.
+///
+/// This is also used for other handles that are closed the same way
+/// as sockets (e.g. the epoll instance on Linux).
 class SocketHolder {
     Socket socket = InvalidSocket;
 
@@ -81,9 +104,48 @@ struct AcceptedConnexion {
     std::string ip_address;
 };
 
-auto AcceptConnexion(Socket sock, bool& done) -> std::optional<AcceptedConnexion>;
+/// Outgoing data is queued in chunks that are recycled per thread.
+using Chunk = std::vector<std::byte>;
+constexpr usz ChunkSize = 16'384;
+
+/// Don’t bother appending raw data to a chunk that has less free space than this.
+constexpr usz MinFreeSpace = 256;
+
+auto AllocateChunk() -> Chunk;
+void FreeChunk(Chunk chunk);
+
+/// An entry in the send queue: either a chunk that we own and can
+/// append to, or a frame that is shared with other connexions.
+struct QueuedData {
+    Chunk chunk;
+    std::shared_ptr<const std::vector<std::byte>> shared;
+
+    auto bytes() const -> std::span<const std::byte> {
+        if (shared) return *shared;
+        return chunk;
+    }
+};
+
+/// 'reserve' is a spare descriptor that is sacrificed to turn away
+/// connexions if we run out; an error means that the caller should
+/// stop and try again later.
+auto AcceptConnexion(Socket sock, SocketHolder& reserve, bool& done) -> Result<std::optional<AcceptedConnexion>>;
 auto ConnectToServer(const std::string& remote_address, u16 port) -> Result<SocketHolder>;
 auto CreateServerSocket(u16 port, u32 max_connexions) -> Result<SocketHolder>;
+
+/// Readiness notification.
+///
+/// 'data' is the pointer passed to Watch() when the socket was added.
+auto CreateEventQueue() -> Result<SocketHolder>;
+auto Unwatch(Socket queue, Socket sock) -> Result<>;
+auto Watch(Socket queue, Socket sock, void* data) -> Result<>;
+auto WaitForEvents(Socket queue, std::span<void*> ready, chr::milliseconds timeout) -> Result<usz>;
+
+/// Wakeup handle that can be signalled from any thread to interrupt
+/// a wait on an event queue that it has been added to.
+auto CreateWakeupHandle() -> Result<SocketHolder>;
+void ClearWakeup(Socket wakeup);
+void SignalWakeup(Socket wakeup);
 } // namespace pr::net::impl
 
 // =============================================================================
@@ -132,20 +194,38 @@ auto CreateNonBlockingSocket() -> Result<impl::SocketHolder> {
     return std::move(sock);
 }
 
-auto impl::AcceptConnexion(Socket sock, bool& done) -> std::optional<AcceptedConnexion> {
+auto impl::AcceptConnexion(
+    Socket sock,
+    SocketHolder& reserve,
+    bool& done
+) -> Result<std::optional<AcceptedConnexion>> {
     Assert(sock != InvalidSocket, "Server socket invalid");
 
     sockaddr_in sa{};
     socklen_t sa_len = sizeof sa;
     SocketHolder new_sock{accept(sock, reinterpret_cast<sockaddr*>(&sa), &sa_len)};
     if (new_sock.handle() == InvalidSocket) {
-        if (errno == EWOULDBLOCK or errno == EAGAIN or errno == ECONNABORTED) {
+        // There may be more connexions behind one that was aborted.
+        if (errno == ECONNABORTED or errno == EINTR) return std::nullopt;
+        if (errno == EWOULDBLOCK or errno == EAGAIN) {
             done = true;
             return std::nullopt;
         }
 
-        Log("Failed to accept connexion: {}", std::strerror(errno));
-        return std::nullopt;
+        // If we’re out of descriptors, the connexion stays in the queue,
+        // and we won’t be told about it again; give up our spare one so
+        // we can accept and close it, which at least tells the client.
+        if ((errno == EMFILE or errno == ENFILE) and reserve.handle() != InvalidSocket) {
+            reserve = SocketHolder{InvalidSocket};
+            SocketHolder{accept(sock, nullptr, nullptr)};
+            reserve = SocketHolder{open("/dev/null", O_RDONLY | O_CLOEXEC)};
+            Log("Out of file descriptors; rejected a connexion");
+            return std::nullopt;
+        }
+
+        // Anything else won’t go away if we try again right away.
+        done = true;
+        return Error("Failed to accept connexion: {}", std::strerror(errno));
     }
 
     // Make the connexion non-blocking.
@@ -250,6 +330,85 @@ auto impl::CreateServerSocket(u16 port, u32 max_connexions) -> Result<SocketHold
     // Take care to clear 'fd' so we don't close the socket.
     return std::move(sock);
 }
+
+auto impl::CreateEventQueue() -> Result<SocketHolder> {
+    SocketHolder queue{epoll_create1(EPOLL_CLOEXEC)};
+    if (queue.handle() == InvalidSocket) return Error(
+        "Failed to create epoll instance: {}",
+        std::strerror(errno)
+    );
+
+    return std::move(queue);
+}
+
+auto impl::CreateWakeupHandle() -> Result<SocketHolder> {
+    SocketHolder ev{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)};
+    if (ev.handle() == InvalidSocket) return Error(
+        "Failed to create eventfd: {}",
+        std::strerror(errno)
+    );
+
+    return std::move(ev);
+}
+
+void impl::ClearWakeup(Socket wakeup) {
+    // Reading an eventfd resets its counter; we don’t care about the value.
+    eventfd_t value;
+    while (eventfd_read(wakeup, &value) == -1 and errno == EINTR);
+}
+
+void impl::SignalWakeup(Socket wakeup) {
+    while (eventfd_write(wakeup, 1) == -1 and errno == EINTR);
+}
+
+auto impl::Unwatch(Socket queue, Socket sock) -> Result<> {
+    if (epoll_ctl(queue, EPOLL_CTL_DEL, sock, nullptr) == -1) return Error(
+        "Failed to remove socket from epoll instance: {}",
+        std::strerror(errno)
+    );
+
+    return {};
+}
+
+auto impl::Watch(Socket queue, Socket sock, void* data) -> Result<> {
+    // Everything is edge-triggered: we only get woken up when new data
+    // arrives, so users of this must drain the socket every time. We
+    // also want to know when a socket that was full becomes writable
+    // again so we can flush whatever is still queued.
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = data;
+    if (epoll_ctl(queue, EPOLL_CTL_ADD, sock, &ev) == -1) return Error(
+        "Failed to add socket to epoll instance: {}",
+        std::strerror(errno)
+    );
+
+    return {};
+}
+
+auto impl::WaitForEvents(
+    Socket queue,
+    std::span<void*> ready,
+    chr::milliseconds timeout
+) -> Result<usz> {
+    constexpr usz MaxEvents = 256;
+    std::array<epoll_event, MaxEvents> events;
+
+    // A timeout that doesn’t fit in an int means ‘wait forever’.
+    int ms = timeout.count() >= std::numeric_limits<int>::max()
+               ? -1
+               : int(std::max<chr::milliseconds::rep>(timeout.count(), 0));
+
+    auto max = int(std::min(ready.size(), MaxEvents));
+    auto n = epoll_wait(queue, events.data(), max, ms);
+    if (n == -1) {
+        if (errno == EINTR) return 0;
+        return Error("Failed to wait for events: {}", std::strerror(errno));
+    }
+
+    for (int i = 0; i < n; ++i) ready[usz(i)] = events[usz(i)].data.ptr;
+    return usz(n);
+}
 #endif
 
 // =============================================================================
@@ -261,129 +420,382 @@ auto impl::CreateServerSocket(u16 port, u32 max_connexions) -> Result<SocketHold
 // =============================================================================
 //  Impl
 // =============================================================================
-struct TCPConnexion::Impl : impl::SocketHolder {
+struct TCPConnexion::Impl : impl::SocketHolder
+    , std::enable_shared_from_this<TCPConnexion::Impl> {
     std::string ip_address;
-    std::vector<std::byte> receive_buffer;
-    std::vector<std::byte> send_buffer;
+    ReceiveBuffer receive_buffer;
+
+    /// Data that has yet to be sent; 'send_offset' is how much of
+    /// the first chunk has already been sent.
+    std::deque<impl::QueuedData> send_queue;
+    usz send_offset = 0;
 
     // We need this because multiple copies of a connexion need
     // to be able to communicate to each other the fact that a
     // connexion has gone away.
     bool disconnected = false;
 
+    /// Our id in the server that manages us, and where to tell it
+    /// once we’ve been closed.
+    ConnexionId id;
+    std::vector<ConnexionId>* closed_list = nullptr;
+
+    /// Where to tell the server that we have data to send; 'dirty' is
+    /// set while we’re in that list.
+    std::vector<ConnexionId>* dirty_list = nullptr;
+    bool dirty = false;
+
+    /// Traffic statistics; 'frames_received' lives in the receive buffer.
+    ConnexionStats stats;
+
     explicit Impl(SocketHolder socket, std::string ip_address)
         : SocketHolder(std::move(socket)),
           ip_address(std::move(ip_address)) {}
 
     void Disconnect();
+    void Flush();
+    void MarkDirty();
     void Receive(std::function<void(ReceiveBuffer&)> callback);
     void Send(std::span<const std::byte> data);
+    void Send(std::shared_ptr<const std::vector<std::byte>> frame);
+    auto Tail(usz needed = impl::MinFreeSpace) -> impl::Chunk&;
 
 private:
-    usz SendImpl(std::span<const std::byte> data);
+    void Abort();
+    void UpdateBacklog();
 };
 
 struct TCPServer::Impl : impl::SocketHolder {
+    /// Slab of connexion ids; each slot stores the index of its
+    /// connexion in 'all_connexions'.
+    struct Slot {
+        u32 generation = 0;
+        u32 connexion_index = 0;
+    };
+
     std::vector<TCPConnexion> all_connexions;
+    std::vector<Slot> slots;
+    std::vector<u32> free_slots;
+
+    /// Connexions that have been closed since the last call to
+    /// UpdateConnexions(); the connexions add themselves here.
+    std::vector<ConnexionId> closed;
+
+    /// Adopted connexions with data that hasn’t been processed yet.
+    std::vector<TCPConnexion> adopted;
+
+    /// Connexions that have queued data since the last flush; the
+    /// connexions add themselves here. 'flushing' is just the other
+    /// half of a double buffer.
+    std::vector<ConnexionId> dirty;
+    std::vector<ConnexionId> flushing;
+
+    impl::SocketHolder event_queue;
+    impl::SocketHolder wakeup;
+
+    /// Spare descriptor for turning away connexions once we run out.
+    impl::SocketHolder reserve{impl::InvalidSocket};
+    bool accept_retry_scheduled = false;
+
     const u16 port;
     TCPServerCallbacks* tcp_callbacks = nullptr;
+    TimerWheel timers;
 
-    explicit Impl(SocketHolder socket, u16 port)
+    /// The listening socket may be invalid if this is a detached server.
+    explicit Impl(SocketHolder socket, SocketHolder event_queue, SocketHolder wakeup, u16 port)
         : SocketHolder(std::move(socket)),
+          event_queue(std::move(event_queue)),
+          wakeup(std::move(wakeup)),
           port(port) {}
 
+    ~Impl();
+
+    void AcceptAll();
+    void Adopt(TCPConnexion conn);
+    void Allocate(TCPConnexion& conn);
     void CloseConnexionAfterError(TCPConnexion& conn);
+    auto Find(ConnexionId id) -> TCPConnexion*;
+    void Free(ConnexionId id);
+    void Poll(chr::milliseconds timeout);
+    void Release(const TCPConnexion& conn);
     void UpdateConnexions();
-    void ReceiveAll();
     void SetCallbacks(TCPServerCallbacks& callbacks);
+
+    static auto Make(SocketHolder listener, u16 port) -> Result<std::unique_ptr<Impl>>;
 };
 
+// =============================================================================
+//  Chunk Pool
+// =============================================================================
+namespace {
+// Chunks are usually freed on the thread that allocated them, so
+// keeping a pool per thread avoids any synchronisation.
+thread_local std::vector<impl::Chunk> FreeChunks;
+constexpr usz MaxFreeChunks = 256;
+} // namespace
+
+auto impl::AllocateChunk() -> Chunk {
+    if (FreeChunks.empty()) {
+        Chunk c;
+        c.reserve(ChunkSize);
+        return c;
+    }
+
+    auto c = std::move(FreeChunks.back());
+    FreeChunks.pop_back();
+    return c;
+}
+
+void impl::FreeChunk(Chunk chunk) {
+    if (FreeChunks.size() == MaxFreeChunks) return;
+    chunk.clear();
+    FreeChunks.push_back(std::move(chunk));
+}
+
+// =============================================================================
+//  Receive Buffer
+// =============================================================================
+ReceiveBuffer::ReceiveBuffer()
+    : storage(std::make_unique_for_overwrite<std::byte[]>(ReceiveBufferSize)),
+      _encoding(ser::Encoding::Fixed) {}
+
+auto ReceiveBuffer::append(ser::InputSpan data) -> usz {
+    usz n = 0;
+    for (auto region : WritableRegions()) {
+        auto sz = std::min(region.size(), data.size() - n);
+        std::memcpy(region.data(), data.data() + n, sz);
+        n += sz;
+    }
+
+    Commit(n);
+    return n;
+}
+
+void ReceiveBuffer::CopyOut(void* into, u64 pos, usz n) const {
+    auto start = usz(pos & Mask);
+    auto first = std::min(n, ReceiveBufferSize - start);
+    std::memcpy(into, storage.get() + start, first);
+    std::memcpy(static_cast<std::byte*>(into) + first, storage.get(), n - first);
+}
+
+void ReceiveBuffer::drop_frame() {
+    Assert(current.has_value(), "No frame to drop");
+    read_pos += sizeof(FrameLength) + current->data.size();
+    current.reset();
+    frames_read++;
+    FramesReceived.add();
+}
+
+auto ReceiveBuffer::peek_frame() -> Result<std::optional<Frame>> {
+    if (current) return current;
+
+    // Read the length, if we have it yet.
+    if (size() < sizeof(FrameLength)) return std::nullopt;
+    FrameLength len;
+    CopyOut(&len, read_pos, sizeof(FrameLength));
+    if constexpr (std::endian::native != std::endian::little) len = std::byteswap(len);
+    if (len < sizeof(detail::IDType) or len > MaxFrameSize)
+        return Error("Invalid frame length {}", len);
+
+    // Check that the frame is complete.
+    if (size() < sizeof(FrameLength) + len) return std::nullopt;
+
+    // If it’s contiguous, we can just hand out a pointer into the
+    // buffer; otherwise, we have to copy it.
+    auto start = usz((read_pos + sizeof(FrameLength)) & Mask);
+    std::span<const std::byte> data;
+    if (start + len <= ReceiveBufferSize) {
+        data = {storage.get() + start, len};
+    } else {
+        if (not wrapped_frame) wrapped_frame = std::make_unique_for_overwrite<std::byte[]>(MaxFrameSize);
+        CopyOut(wrapped_frame.get(), read_pos + sizeof(FrameLength), len);
+        data = {wrapped_frame.get(), len};
+    }
+
+    current = Frame{std::to_integer<detail::IDType>(data[0]), data};
+    return current;
+}
+
+auto ReceiveBuffer::WritableRegions() -> std::array<std::span<std::byte>, 2> {
+    auto free = ReceiveBufferSize - size();
+    auto start = usz(write_pos & Mask);
+    auto first = std::min(free, ReceiveBufferSize - start);
+    return {
+        std::span{storage.get() + start, first},
+        std::span{storage.get(), free - first},
+    };
+}
+
+auto net::ParseFrame(ser::InputSpan& data) -> Result<Frame> {
+    FrameLength len;
+    if (data.size() < sizeof(FrameLength)) return Error("Truncated frame header");
+    std::memcpy(&len, data.data(), sizeof(FrameLength));
+    if constexpr (std::endian::native != std::endian::little) len = std::byteswap(len);
+    if (len < sizeof(detail::IDType) or len > MaxFrameSize)
+        return Error("Invalid frame length {}", len);
+    if (data.size() - sizeof(FrameLength) < len) return Error("Truncated frame");
+
+    auto frame = data.subspan(sizeof(FrameLength), len);
+    data = data.subspan(sizeof(FrameLength) + len);
+    return Frame{std::to_integer<detail::IDType>(frame[0]), frame};
+}
+
 // =============================================================================
 //  Impl - Connexion
 // =============================================================================
-void TCPConnexion::Impl::Disconnect() {
+void TCPConnexion::Impl::Abort() {
     disconnected = true;
+    for (auto& q : send_queue)
+        if (not q.shared) impl::FreeChunk(std::move(q.chunk));
+    send_queue.clear();
+    send_offset = 0;
+    UpdateBacklog();
+    Close();
+    if (closed_list) closed_list->push_back(id);
+}
 
-    // Try to flush the send buffer before closing the connexion so
+void TCPConnexion::Impl::Disconnect() {
+    // Try to flush the send queue before closing the connexion so
     // the client hopefully gets any disconnect packets that might
     // have been queued up.
-    if (not send_buffer.empty()) Send(send_buffer);
+    Flush();
+    Abort();
+}
 
-    // Actually close the socket.
-    Close();
+void TCPConnexion::Impl::Flush() {
+    constexpr usz MaxIOVecs = 64;
+    defer { UpdateBacklog(); };
+    while (not disconnected and not send_queue.empty()) {
+        // Send as many chunks as we can at once.
+        std::array<iovec, MaxIOVecs> iov;
+        usz count = 0;
+        for (auto& q : send_queue) {
+            if (count == MaxIOVecs) break;
+            auto data = q.bytes().subspan(count == 0 ? send_offset : 0);
+            iov[count++] = iovec{const_cast<std::byte*>(data.data()), data.size()};
+        }
+
+        msghdr msg{};
+        msg.msg_iov = iov.data();
+        msg.msg_iovlen = count;
+        auto sz = sendmsg(handle(), &msg, MSG_NOSIGNAL);
+
+        // Sending failed.
+        if (sz == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EWOULDBLOCK or errno == EAGAIN) return;
+            if (errno != ECONNRESET and errno != EPIPE) Log(
+                "Unexpected error while sending data to {}: {}",
+                ip_address,
+                std::strerror(errno)
+            );
+            return Abort();
+        }
+
+        stats.bytes_sent += usz(sz);
+        BytesSent.add(usz(sz));
+
+        // Drop everything we’ve sent; if a chunk was only partially
+        // sent, just remember how far we got.
+        for (auto sent = usz(sz); sent != 0;) {
+            auto left = send_queue.front().bytes().size() - send_offset;
+            if (sent < left) {
+                send_offset += sent;
+                break;
+            }
+
+            sent -= left;
+            send_offset = 0;
+            if (not send_queue.front().shared) impl::FreeChunk(std::move(send_queue.front().chunk));
+            send_queue.pop_front();
+        }
+    }
 }
 
 void TCPConnexion::Impl::Send(std::span<const std::byte> data) {
-    // Clear out the buffer first before sending new data.
-    if (not send_buffer.empty()) {
-        auto sent = SendImpl(send_buffer);
-        if (sent != send_buffer.size()) {
-            send_buffer.erase(send_buffer.begin(), send_buffer.begin() + sent);
-            send_buffer.insert(send_buffer.end(), data.begin(), data.end());
-            return;
-        }
+    while (not data.empty()) {
+        auto& c = Tail(std::min(data.size(), impl::MinFreeSpace));
+        auto n = std::min(data.size(), c.capacity() - c.size());
+        c.insert(c.end(), data.begin(), data.begin() + isz(n));
+        data = data.subspan(n);
     }
+}
 
-    // Then, send the new data.
-    auto sent = SendImpl(data);
-    if (sent != data.size()) send_buffer.insert(
-        send_buffer.end(),
-        data.begin() + sent,
-        data.end()
-    );
+void TCPConnexion::Impl::Send(std::shared_ptr<const std::vector<std::byte>> frame) {
+    send_queue.emplace_back(impl::Chunk{}, std::move(frame));
+    MarkDirty();
+    stats.frames_sent++;
+    FramesSent.add();
 }
 
-void TCPConnexion::Impl::Receive(std::function<void(ReceiveBuffer&)> callback) {
-    // Unlike the send buffer, we don’t want to pass the receive buffer
-    // to the caller immediately even if it is not empty, since data left
-    // in the receive buffer indicates an incomplete packet.
-    constexpr usz ReceivePerTick = 65'536;
-
-    // Allocate more space in the buffer.
-    auto old_sz = receive_buffer.size();
-    receive_buffer.resize(old_sz + ReceivePerTick);
-
-    // Receive data.
-    auto sz = recv(handle(), receive_buffer.data() + old_sz, ReceivePerTick, 0);
-    if (sz == -1) {
-        receive_buffer.resize(old_sz);
-        if (errno == EWOULDBLOCK or errno == EAGAIN) return;
-        return Disconnect();
-    }
+void TCPConnexion::Impl::UpdateBacklog() {
+    usz backlog = 0;
+    for (auto& q : send_queue) backlog += q.bytes().size();
+    backlog -= send_offset;
+    SendBacklog.add(i64(backlog) - i64(stats.send_backlog));
+    stats.send_backlog = backlog;
+}
 
-    // If we receive 0, the connexion was closed.
-    if (sz == 0) {
-        Log("Connexion {} closed by peer", ip_address);
-        return Disconnect();
+auto TCPConnexion::Impl::Tail(usz needed) -> impl::Chunk& {
+    MarkDirty();
+
+    // Start a new chunk if the last entry is a shared frame or if the last
+    // chunk doesn’t have enough space left; we’d rather waste a bit of space
+    // at the end of a chunk than grow it.
+    if (
+        send_queue.empty() or
+        send_queue.back().shared or
+        send_queue.back().chunk.capacity() - send_queue.back().chunk.size() < needed
+    ) {
+        send_queue.emplace_back(impl::AllocateChunk(), nullptr);
+        send_queue.back().chunk.reserve(needed);
     }
 
-    // Truncate the buffer to match what we received.
-    receive_buffer.resize(old_sz + usz(sz));
-
-    // Dispatch the data to the callback and truncate the buffer
-    // to remove everything that was processed by it.
-    ReceiveBuffer buffer{receive_buffer};
-    callback(buffer);
-    auto processed = receive_buffer.size() - buffer.size();
-    receive_buffer.erase(
-        receive_buffer.begin(),
-        receive_buffer.begin() + isz(processed)
-    );
+    return send_queue.back().chunk;
 }
 
-usz TCPConnexion::Impl::SendImpl(std::span<const std::byte> data) {
-    auto sz = ::send(handle(), data.data(), data.size(), MSG_NOSIGNAL);
+void TCPConnexion::Impl::MarkDirty() {
+    if (dirty or not dirty_list) return;
+    dirty = true;
+    dirty_list->push_back(id);
+}
 
-    // Sending failed.
-    if (sz == -1) {
-        if (errno == EINTR) return SendImpl(data);
-        if (errno == EWOULDBLOCK or errno == EAGAIN) return 0;
-        if (errno == ECONNRESET or errno == EPIPE) return Disconnect(), 0;
-        Log("Unexpected error while sending data to {}: {}", ip_address, std::strerror(errno));
-        return Disconnect(), 0;
-    }
+void TCPConnexion::Impl::Receive(std::function<void(ReceiveBuffer&)> callback) {
+    // Connexions that belong to a server are edge-triggered, i.e. we
+    // won’t be told about data that we leave in the socket, so keep
+    // reading until there is nothing left.
+    while (not disconnected) {
+        // Read into whatever space is left in the buffer. If there
+        // is none, then the callback isn’t processing the data we
+        // give it, so pretend we’re done; whoever is meant to handle
+        // it will have to call us again.
+        auto regions = receive_buffer.WritableRegions();
+        if (regions[0].empty()) return;
+        std::array<iovec, 2> iov{
+            iovec{regions[0].data(), regions[0].size()},
+            iovec{regions[1].data(), regions[1].size()},
+        };
+
+        auto sz = readv(handle(), iov.data(), regions[1].empty() ? 1 : 2);
+        if (sz == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EWOULDBLOCK or errno == EAGAIN) return;
+            return Disconnect();
+        }
 
-    return usz(sz);
+        // If we receive 0, the connexion was closed.
+        if (sz == 0) {
+            Log("Connexion {} closed by peer", ip_address);
+            return Disconnect();
+        }
+
+        // Dispatch the data to the callback; it removes whatever it
+        // processed from the buffer.
+        stats.bytes_received += usz(sz);
+        BytesReceived.add(usz(sz));
+        receive_buffer.Commit(usz(sz));
+        callback(receive_buffer);
+    }
 }
 
 // =============================================================================
@@ -395,27 +807,27 @@ void TCPServer::Impl::CloseConnexionAfterError(TCPConnexion& conn) {
     conn.disconnect();
 }
 
-void TCPServer::Impl::ReceiveAll() {
-    Assert(tcp_callbacks, "Callbacks not set");
-    for (auto& conn : all_connexions) conn.receive([&](ReceiveBuffer& buf) {
-        tcp_callbacks->receive(conn, buf);
-    });
-}
-
-void TCPServer::Impl::SetCallbacks(TCPServerCallbacks& callbacks) {
-    Assert(not tcp_callbacks, "Callbacks already set");
-    tcp_callbacks = &callbacks;
-}
-
-void TCPServer::Impl::UpdateConnexions() {
-    // Delete stale connexions.
-    std::erase_if(all_connexions, [](const TCPConnexion& conn) {
-        return conn.disconnected;
-    });
-
-    // Accept incoming ones.
+void TCPServer::Impl::AcceptAll() {
+    // The listening socket is edge-triggered as well, so accept
+    // everything that is queued up.
     for (bool done = false; not done;) {
-        auto conn = impl::AcceptConnexion(handle(), done);
+        auto accepted = impl::AcceptConnexion(handle(), reserve, done);
+
+        // Nothing will tell us about the connexions that are still
+        // queued, so look at them again in a bit.
+        if (not accepted) {
+            Log("{}", accepted.error());
+            if (not accept_retry_scheduled) {
+                accept_retry_scheduled = true;
+                timers.schedule(AcceptRetryInterval, [this] {
+                    accept_retry_scheduled = false;
+                    AcceptAll();
+                });
+            }
+            continue;
+        }
+
+        auto& conn = accepted.value();
         if (not conn) continue;
 
         // Create the connexion.
@@ -425,11 +837,204 @@ void TCPServer::Impl::UpdateConnexions() {
             std::move(conn->ip_address)
         );
 
-        // Try to accept it.
-        if (tcp_callbacks->accept(c)) {
-            Log("Added connexion from {}", c.address);
-            all_connexions.push_back(std::move(c));
+        // Try to accept it; give it an id first so the callbacks can
+        // use it.
+        Allocate(c);
+        if (not tcp_callbacks->accept(c)) {
+            Free(c.id);
+            continue;
+        }
+
+        // Start listening for data on it. If data has already arrived by
+        // now, epoll will report it immediately on the next wait.
+        if (auto res = impl::Watch(event_queue.handle(), c.impl->handle(), c.impl.get()); not res) {
+            Log("Dropping connexion {}: {}", c.address, res.error());
+            c.disconnect();
+            continue;
+        }
+
+        Log<LogLevel::Debug>("Added connexion from {}", c.address);
+    }
+}
+
+void TCPServer::Impl::Adopt(TCPConnexion conn) {
+    Assert(tcp_callbacks, "Callbacks not set");
+    if (conn.disconnected) return;
+    if (auto res = impl::Watch(event_queue.handle(), conn.impl->handle(), conn.impl.get()); not res) {
+        Log("Dropping connexion {}: {}", conn.address, res.error());
+        conn.disconnect();
+        return;
+    }
+
+    // The previous owner may have read data that it didn’t process; we
+    // won’t be notified about that, so hand it to the callbacks in the
+    // next call to Poll(), once the caller has had a chance to register
+    // the new id.
+    Allocate(conn);
+    if (not conn.impl->receive_buffer.empty()) adopted.push_back(std::move(conn));
+}
+
+void TCPServer::Impl::Allocate(TCPConnexion& conn) {
+    Assert(not conn.impl->closed_list, "Connexion is managed by another server");
+
+    u32 index;
+    if (free_slots.empty()) {
+        index = u32(slots.size());
+        slots.emplace_back();
+    } else {
+        index = free_slots.back();
+        free_slots.pop_back();
+    }
+
+    auto& s = slots[index];
+    s.connexion_index = u32(all_connexions.size());
+    conn.impl->id = {index, s.generation};
+    conn.impl->closed_list = &closed;
+    conn.impl->dirty_list = &dirty;
+    all_connexions.push_back(conn);
+    Connexions.add(1);
+
+    // An adopted connexion may have data that its previous owner
+    // didn’t get around to sending.
+    if (not conn.impl->send_queue.empty()) conn.impl->MarkDirty();
+}
+
+auto TCPServer::Impl::Find(ConnexionId id) -> TCPConnexion* {
+    if (id.index >= slots.size() or slots[id.index].generation != id.generation) return nullptr;
+    return &all_connexions[slots[id.index].connexion_index];
+}
+
+void TCPServer::Impl::Free(ConnexionId id) {
+    auto c = Find(id);
+    if (not c) return;
+    auto& s = slots[id.index];
+    auto& conn = *c;
+    conn.impl->id = {};
+    conn.impl->closed_list = nullptr;
+    conn.impl->dirty_list = nullptr;
+    conn.impl->dirty = false;
+
+    // Move the last connexion into the hole we’re leaving behind.
+    if (s.connexion_index != all_connexions.size() - 1) {
+        conn = std::move(all_connexions.back());
+        slots[conn.impl->id.index].connexion_index = s.connexion_index;
+    }
+
+    all_connexions.pop_back();
+    Connexions.add(-1);
+    s.generation++;
+    free_slots.push_back(id.index);
+}
+
+TCPServer::Impl::~Impl() {
+    Connexions.add(-i64(all_connexions.size()));
+    for (auto& c : all_connexions) {
+        c.impl->id = {};
+        c.impl->closed_list = nullptr;
+        c.impl->dirty_list = nullptr;
+        c.impl->dirty = false;
+    }
+}
+
+auto TCPServer::Impl::Make(SocketHolder listener, u16 port) -> Result<std::unique_ptr<Impl>> {
+    auto queue = Try(impl::CreateEventQueue());
+    auto wakeup = Try(impl::CreateWakeupHandle());
+
+    // Register the listening socket, if there is one; we use a null
+    // pointer to tell it apart from connexions.
+    auto listening = listener.handle() != impl::InvalidSocket;
+    if (listening) Try(impl::Watch(queue.handle(), listener.handle(), nullptr));
+
+    auto i = std::make_unique<Impl>(std::move(listener), std::move(queue), std::move(wakeup), port);
+    if (listening) i->reserve = impl::SocketHolder{open("/dev/null", O_RDONLY | O_CLOEXEC)};
+
+    // The wakeup handle is identified by its own address.
+    Try(impl::Watch(i->event_queue.handle(), i->wakeup.handle(), &i->wakeup));
+    return i;
+}
+
+void TCPServer::Impl::Poll(chr::milliseconds timeout) {
+    Assert(tcp_callbacks, "Callbacks not set");
+
+    // Process data that arrived before we got these connexions.
+    for (auto& c : std::exchange(adopted, {}))
+        if (not c.disconnected) tcp_callbacks->receive(c, c.impl->receive_buffer);
+
+    // Send everything that was queued since the last call. Connexions
+    // that couldn’t send all of it stay in the list so we try again
+    // once the socket has room, which also wakes us up.
+    std::swap(dirty, flushing);
+    for (auto id : flushing) {
+        auto c = Find(id);
+        if (not c) continue;
+        c->impl->dirty = false;
+        c->flush();
+        if (not c->disconnected and not c->impl->send_queue.empty()) c->impl->MarkDirty();
+    }
+    flushing.clear();
+
+    // Don’t sleep past the next timer; run everything that is due once
+    // we’re done with the network.
+    defer { timers.advance(); };
+    std::array<void*, 256> ready;
+    auto count = impl::WaitForEvents(event_queue.handle(), ready, std::min(timeout, timers.next_timeout()));
+    if (not count) {
+        Log("{}", count.error());
+        return;
+    }
+
+    for (auto data : std::span{ready}.first(count.value())) {
+        // The listening socket is registered without any data.
+        if (not data) {
+            AcceptAll();
+            continue;
+        }
+
+        // Someone woke us up; there is nothing to do here as the
+        // caller will handle whatever it got woken up for.
+        if (data == &wakeup) {
+            impl::ClearWakeup(wakeup.handle());
+            continue;
         }
+
+        // A connexion may have been closed while handling an earlier
+        // event in this batch; it stays alive until the next call to
+        // UpdateConnexions(), so checking the flag is enough.
+        auto conn_impl = static_cast<TCPConnexion::Impl*>(data);
+        if (conn_impl->disconnected) continue;
+
+        TCPConnexion conn;
+        conn.impl = conn_impl->shared_from_this();
+        conn.receive([&](ReceiveBuffer& buf) {
+            tcp_callbacks->receive(conn, buf);
+        });
+    }
+}
+
+void TCPServer::Impl::Release(const TCPConnexion& conn) {
+    if (conn.impl->closed_list != &closed) return;
+    if (not conn.disconnected) {
+        auto res = impl::Unwatch(event_queue.handle(), conn.impl->handle());
+        if (not res) Log("{}", res.error());
+    }
+
+    Free(conn.id);
+}
+
+void TCPServer::Impl::SetCallbacks(TCPServerCallbacks& callbacks) {
+    Assert(not tcp_callbacks, "Callbacks already set");
+    tcp_callbacks = &callbacks;
+}
+
+void TCPServer::Impl::UpdateConnexions() {
+    // Delete connexions that have been closed. Closing the socket also
+    // removes it from the event queue. Connexions that were released
+    // in the meantime have already been freed, and Free() ignores them.
+    // Anything the callbacks close is handled by the next call.
+    for (auto id : std::exchange(closed, {})) {
+        if (not Find(id)) continue;
+        if (tcp_callbacks) tcp_callbacks->closed(id);
+        Free(id);
     }
 }
 
@@ -445,14 +1050,20 @@ auto TCPConnexion::Connect(
 ) -> Result<TCPConnexion> {
     TCPConnexion conn;
     auto sock = Try(impl::ConnectToServer(remote_ip, port));
-    conn.impl = std::make_unique<Impl>(std::move(sock), std::move(remote_ip));
+    conn.impl = std::make_shared<Impl>(std::move(sock), std::move(remote_ip));
     return conn;
 }
 
 auto TCPServer::Create(u16 port, u32 max_connexions) -> Result<TCPServer> {
     TCPServer server;
     auto sock = Try(impl::CreateServerSocket(port, max_connexions));
-    server.impl = std::make_unique<Impl>(std::move(sock), port);
+    server.impl = Try(Impl::Make(std::move(sock), port));
+    return server;
+}
+
+auto TCPServer::CreateDetached() -> Result<TCPServer> {
+    TCPServer server;
+    server.impl = Try(Impl::Make(impl::SocketHolder{impl::InvalidSocket}, 0));
     return server;
 }
 
@@ -460,11 +1071,38 @@ void TCPConnexion::disconnect() {
     if (not disconnected) impl->Disconnect();
 }
 
+void TCPConnexion::flush() {
+    if (not disconnected) impl->Flush();
+}
+
+auto TCPConnexion::QueueBuffer(usz size) -> std::vector<std::byte>& {
+    impl->stats.frames_sent++;
+    FramesSent.add();
+    return impl->Tail(size);
+}
+
 auto TCPConnexion::get_address() const -> std::string_view {
     if (disconnected) return "";
     return impl->ip_address;
 }
 
+auto TCPConnexion::get_encoding() const -> ser::Encoding {
+    if (not impl) return ser::Encoding::Fixed;
+    return impl->receive_buffer.encoding;
+}
+
+auto TCPConnexion::get_id() const -> ConnexionId {
+    if (not impl) return {};
+    return impl->id;
+}
+
+auto TCPConnexion::get_stats() const -> ConnexionStats {
+    if (not impl) return {};
+    auto s = impl->stats;
+    s.frames_received = impl->receive_buffer.frames_read;
+    return s;
+}
+
 bool TCPConnexion::get_disconnected() const {
     return not impl or impl->disconnected;
 }
@@ -473,12 +1111,28 @@ void TCPConnexion::receive(std::function<void(ReceiveBuffer&)> callback) {
     if (not disconnected) return impl->Receive(callback);
 }
 
-void TCPConnexion::send(std::span<const std::byte> data) {
-    if (not disconnected) return impl->Send(data);
+void TCPConnexion::send(std::span<const std::byte> data, usz frames) {
+    if (disconnected) return;
+    impl->stats.frames_sent += frames;
+    FramesSent.add(frames);
+    impl->Send(data);
+}
+
+void TCPConnexion::send(const SharedFrame& frame) {
+    Assert(frame.encoding == encoding, "Frame encoding does not match connexion encoding");
+    if (not disconnected) return impl->Send(frame.data);
+}
+
+void TCPConnexion::set_encoding(ser::Encoding encoding) {
+    if (impl) impl->receive_buffer._encoding = encoding;
 }
 
+void TCPServer::adopt(TCPConnexion conn) { impl->Adopt(std::move(conn)); }
 auto TCPServer::connexions() -> std::span<TCPConnexion> { return impl->all_connexions; }
+void TCPServer::poll(chr::milliseconds timeout) { impl->Poll(timeout); }
 auto TCPServer::port() const -> u16 { return impl->port; }
-void TCPServer::receive() { impl->ReceiveAll(); }
+void TCPServer::release(const TCPConnexion& conn) { impl->Release(conn); }
 void TCPServer::set_callbacks(TCPServerCallbacks& callbacks) { impl->SetCallbacks(callbacks); }
+auto TCPServer::timers() -> TimerWheel& { return impl->timers; }
 void TCPServer::update_connexions() { impl->UpdateConnexions(); }
+void TCPServer::wake() { impl::SignalWakeup(impl->wakeup.handle()); }
@@ -0,0 +1,158 @@
+#include <Shared/Timers.hh>
+
+#include <base/Base.hh>
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+using namespace pr;
+
+TimerWheel::TimerWheel(Clock::time_point start) : epoch(start) {
+    heads.fill(None);
+}
+
+void TimerWheel::advance(Clock::time_point t) {
+    auto target = t <= epoch ? 0 : u64(chr::floor<chr::milliseconds>(t - epoch).count());
+    for (;;) {
+        // Run everything in the current slot. Timers are moved to a
+        // separate list first so that timers which are scheduled by
+        // the callbacks for right now wait for the next call.
+        auto& slot = heads[now & (Slots - 1)];
+        while (slot != None) {
+            auto i = slot;
+            Unlink(i);
+            Link(i, Firing);
+        }
+
+        while (heads[Firing] != None) {
+            auto i = heads[Firing];
+            auto cb = std::move(timers[i].callback);
+            Unlink(i);
+            Free(i);
+            cb();
+        }
+
+        // Skip ahead to the next slot that has anything in it; if the
+        // callbacks scheduled more timers for right now, we have to run
+        // those before we can move on.
+        if (now >= target or heads[now & (Slots - 1)] != None) return;
+        auto next = NextEvent(false);
+        if (next > target) {
+            now = target;
+            return;
+        }
+
+        // Move timers down from every level whose slot we just entered,
+        // starting at the top since timers may move down several levels.
+        now = next;
+        for (usz l = Levels - 1; l > 0; l--)
+            if ((now & ((u64(1) << (l * SlotBits)) - 1)) == 0)
+                Cascade(l);
+    }
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    if (id.index >= timers.size()) return false;
+    auto& t = timers[id.index];
+    if (t.generation != id.generation or t.list == None) return false;
+    Unlink(id.index);
+    Free(id.index);
+    return true;
+}
+
+void TimerWheel::Cascade(usz level) {
+    auto& list = heads[level * Slots + ((now >> (level * SlotBits)) & (Slots - 1))];
+    while (list != None) {
+        auto i = list;
+        Unlink(i);
+        Insert(i);
+    }
+}
+
+void TimerWheel::Free(u32 index) {
+    auto& t = timers[index];
+    t.callback = {};
+    if (++t.generation == 0) t.generation = 1;
+    t.next = free_list;
+    free_list = index;
+    active--;
+}
+
+void TimerWheel::Insert(u32 index) {
+    // Timers that are already due go into the current slot.
+    auto& t = timers[index];
+    if (t.deadline <= now) return Link(index, u32(now & (Slots - 1)));
+
+    // Otherwise, find the lowest level that reaches far enough; timers
+    // beyond the top level are put at its end and moved again later.
+    auto delta = t.deadline - now;
+    auto level = std::min<usz>((usz(std::bit_width(delta)) - 1) / SlotBits, Levels - 1);
+    auto deadline = std::min(t.deadline, now + (u64(1) << (Levels * SlotBits)) - 1);
+    auto slot = (deadline >> (level * SlotBits)) & (Slots - 1);
+    Link(index, u32(level * Slots + slot));
+}
+
+void TimerWheel::Link(u32 index, u32 list) {
+    auto& t = timers[index];
+    t.list = list;
+    t.prev = None;
+    t.next = heads[list];
+    if (t.next != None) timers[t.next].prev = index;
+    heads[list] = index;
+    if (list != Firing) occupied[list / Slots] |= u64(1) << (list % Slots);
+}
+
+auto TimerWheel::NextEvent(bool include_current) const -> u64 {
+    auto next = std::numeric_limits<u64>::max();
+
+    // On the first level, timers are due at the start of their slot.
+    auto r = std::rotr(occupied[0], int(now & (Slots - 1)));
+    if (not include_current) r &= ~u64(1);
+    if (r) next = now + u64(std::countr_zero(r));
+
+    // On every other level, the start of a slot is when its timers move
+    // down. The current slot has already been moved, so anything in it
+    // is a full rotation away.
+    for (usz l = 1; l < Levels; l++) {
+        auto period = now >> (l * SlotBits);
+        auto bits = std::rotr(occupied[l], int((period + 1) & (Slots - 1)));
+        if (bits) next = std::min(next, (period + 1 + u64(std::countr_zero(bits))) << (l * SlotBits));
+    }
+
+    return next;
+}
+
+auto TimerWheel::next_timeout(Clock::time_point t) const -> chr::milliseconds {
+    if (active == 0) return chr::milliseconds::max();
+    auto next = epoch + chr::milliseconds(NextEvent(true));
+    return std::max(chr::ceil<chr::milliseconds>(next - t), 0ms);
+}
+
+auto TimerWheel::schedule_at(Clock::time_point deadline, Callback cb) -> TimerId {
+    u32 index;
+    if (free_list != None) {
+        index = free_list;
+        free_list = timers[index].next;
+    } else {
+        index = u32(timers.size());
+        timers.emplace_back();
+    }
+
+    // Round up so timers never go off early.
+    auto& t = timers[index];
+    t.callback = std::move(cb);
+    t.deadline = deadline <= epoch ? 0 : u64(chr::ceil<chr::milliseconds>(deadline - epoch).count());
+    active++;
+    Insert(index);
+    return {index, t.generation};
+}
+
+void TimerWheel::Unlink(u32 index) {
+    auto& t = timers[index];
+    if (t.prev != None) timers[t.prev].next = t.next;
+    else heads[t.list] = t.next;
+    if (t.next != None) timers[t.next].prev = t.prev;
+    if (heads[t.list] == None and t.list != Firing) occupied[t.list / Slots] &= ~(u64(1) << (t.list % Slots));
+    t.list = None;
+}
@@ -0,0 +1,150 @@
+#include <Sim/Sim.hh>
+
+#include <Shared/Cards.hh>
+
+#include <clopts.hh>
+#include <algorithm>
+#include <charconv>
+#include <numeric>
+#include <print>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+
+using namespace pr;
+using namespace command_line_options;
+
+using options = clopts< // clang-format off
+    option<"--games", "Number of games to play (default: 10000)", i64>,
+    option<"--seed", "Seed for the first game (default: random)", i64>,
+    option<"--threads", "Number of threads to use (default: one per core)", i64>,
+    option<"--ai", "Comma-separated list of seats played by the Monte-Carlo AI, e.g. '0' or '0,1'">,
+    option<"--playouts", "Playouts per candidate move for the AI (default: 64)", i64>,
+    option<"--counts", "Comma-separated list of 'card=count' overrides for the deck, e.g. 'Spelling Reform=4'">,
+    flag<"--cheat", "Let the AI see the deck and the other players’ hands">,
+    help<>
+>; // clang-format on
+
+namespace {
+/// Get a card’s name on a single line.
+auto CardName(const CardData& c) -> std::string {
+    std::string name{c.name};
+    rgs::replace(name, '\n', ' ');
+    return name;
+}
+
+auto ParseSeats(std::string_view list, sim::GameOptions& opts) -> Result<> {
+    for (auto part : list | vws::split(',')) {
+        std::string_view s{part.begin(), part.end()};
+        usz seat{};
+        auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), seat);
+        if (ec != std::errc{} or ptr != s.data() + s.size() or seat >= opts.seats.size())
+            return Error("Invalid seat '{}'", s);
+        opts.seats[seat] = sim::Policy::MonteCarlo;
+    }
+    return {};
+}
+
+auto ParseCounts(std::string_view list, DeckCounts& counts) -> Result<> {
+    for (auto part : list | vws::split(',')) {
+        std::string_view s{part.begin(), part.end()};
+        auto eq = s.rfind('=');
+        if (eq == s.npos) return Error("Expected 'card=count', got '{}'", s);
+
+        auto name = s.substr(0, eq);
+        auto card = rgs::find_if(CardDatabase, [&](auto& c) { return CardName(c) == name; });
+        if (card == CardDatabase.end()) return Error("Unknown card '{}'", name);
+
+        u8 count{};
+        auto value = s.substr(eq + 1);
+        auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), count);
+        if (ec != std::errc{} or ptr != value.data() + value.size()) return Error("Invalid count '{}'", value);
+        counts[+card->id] = count;
+    }
+
+    auto Count = [&](std::span<const CardData> cards) {
+        usz n = 0;
+        for (auto& c : cards) n += counts[+c.id];
+        return n;
+    };
+
+    // rules::SetUp() asserts that it can deal every player a word and a
+    // hand, so reject decks that are too small to do that here.
+    constexpr usz Players = constants::PlayersPerGame;
+    constexpr usz PerWord = constants::StartingWordSize / 2;
+    auto consonants = Count(CardDatabaseConsonants);
+    auto vowels = Count(CardDatabaseVowels);
+    auto total = consonants + vowels + Count(CardDatabasePowers);
+    if (total > MaxDeckSize) return Error("Deck has {} cards, but at most {} are supported", total, MaxDeckSize);
+    if (consonants < Players * PerWord or vowels < Players * PerWord) return Error(
+        "Deck needs at least {} consonants and {} vowels to deal every player a word, but has {} and {}",
+        Players * PerWord,
+        Players * PerWord,
+        consonants,
+        vowels
+    );
+
+    auto rest = total - Players * constants::StartingWordSize;
+    if (rest <= Players * HandSize) return Error(
+        "Deck needs more than {} cards besides the players’ words to deal every player a hand, but has {}",
+        Players * HandSize,
+        rest
+    );
+
+    return {};
+}
+
+auto Run(int argc, char* argv[]) -> Result<> {
+    auto opts = options::parse(argc, argv);
+
+    i64 games = opts.get_or<"--games">(10'000);
+    i64 threads = opts.get_or<"--threads">(0);
+    i64 playouts = opts.get_or<"--playouts">(64);
+    if (games <= 0 or threads < 0 or playouts <= 0)
+        return Error("--games and --playouts must be positive, and --threads must not be negative");
+
+    sim::GameOptions game_opts;
+    game_opts.search.playouts = usz(playouts);
+    game_opts.search.cheat = opts.get<"--cheat">();
+    if (auto ai = opts.get<"--ai">()) Try(ParseSeats(*ai, game_opts));
+    if (auto counts = opts.get<"--counts">()) Try(ParseCounts(*counts, game_opts.counts));
+
+    // Print the seed so a run can be reproduced.
+    u64 seed = opts.get<"--seed">() ? u64(*opts.get<"--seed">()) : RandomSeed();
+    sim::Pool pool{usz(threads)};
+    std::println("Playing {} games on {} threads with seed {}", games, pool.threads(), seed);
+
+    auto start = chr::steady_clock::now();
+    auto res = sim::RunBatch(game_opts, usz(games), seed, pool);
+    auto elapsed = chr::duration<f64>(chr::steady_clock::now() - start).count();
+
+    auto Percent = [&](usz n) { return 100. * f64(n) / f64(games); };
+    auto Turns = [&](f64 q) { return res.turns[std::min(usz(q * f64(res.turns.size())), res.turns.size() - 1)]; };
+    std::println("Done in {:.2f}s ({:.1f} games/s)\n", elapsed, f64(games) / elapsed);
+    for (auto [i, wins] : res.wins | vws::enumerate) {
+        auto ai = game_opts.seats[usz(i)] == sim::Policy::MonteCarlo;
+        std::println("Seat {} ({}): {} wins ({:.1f}%)", i, ai ? "ai" : "random", wins, Percent(wins));
+    }
+
+    std::println("Draws: {} ({:.1f}%)", res.draws, Percent(res.draws));
+    std::println(
+        "Turns: min={} p50={} p90={} p99={} max={} mean={:.1f}",
+        res.turns.front(),
+        Turns(.5),
+        Turns(.9),
+        Turns(.99),
+        res.turns.back(),
+        f64(std::accumulate(res.turns.begin(), res.turns.end(), u64(0))) / f64(res.turns.size())
+    );
+
+    return {};
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (auto res = Run(argc, argv); not res) {
+        std::println(stderr, "ERROR: {}", res.error());
+        return 1;
+    }
+}
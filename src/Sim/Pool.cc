@@ -0,0 +1,103 @@
+#include <Sim/Sim.hh>
+
+#include <algorithm>
+
+using namespace pr;
+using namespace pr::sim;
+
+namespace {
+/// The pool and queue of the current thread, if it is a worker.
+thread_local const Pool* CurrentPool = nullptr;
+thread_local usz CurrentQueue = 0;
+} // namespace
+
+Pool::Pool(usz threads) {
+    if (threads == 0) threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    // The last queue is for threads that aren’t workers.
+    for (usz i = 0; i <= threads; i++) queues.push_back(std::make_unique<Queue>());
+    for (usz i = 0; i < threads; i++) workers.emplace_back([this, i](std::stop_token stop) { Run(stop, i); });
+}
+
+void Pool::parallel_for(usz n, const std::function<void(usz)>& body) {
+    if (n == 0) return;
+
+    // Split the work into a few chunks per thread so threads that are
+    // done early have something to steal.
+    auto chunks = std::min(n, 4 * (threads() + 1));
+    std::atomic<usz> remaining = chunks;
+    for (usz c = 0; c < chunks; c++) {
+        auto begin = n * c / chunks;
+        auto end = n * (c + 1) / chunks;
+        Push([&, begin, end] {
+            for (auto i = begin; i < end; i++) body(i);
+            if (remaining.fetch_sub(1, std::memory_order::acq_rel) == 1) {
+                std::unique_lock _{mutex};
+                changed.notify_all();
+            }
+        });
+    }
+
+    // Run tasks until all of ours are done; they may be stolen by, and
+    // finish on, other threads while we’re busy.
+    while (remaining.load(std::memory_order::acquire) != 0) {
+        if (auto t = Pop()) {
+            (*t)();
+            continue;
+        }
+
+        std::unique_lock lock{mutex};
+        changed.wait(lock, [&] {
+            return remaining.load(std::memory_order::acquire) == 0 or
+                   queued.load(std::memory_order::acquire) != 0;
+        });
+    }
+}
+
+auto Pool::Pop() -> std::optional<Task> {
+    auto TryPop = [&](Queue& q, bool newest) -> std::optional<Task> {
+        std::unique_lock _{q.mutex};
+        if (q.tasks.empty()) return std::nullopt;
+        auto t = std::move(newest ? q.tasks.back() : q.tasks.front());
+        if (newest) q.tasks.pop_back();
+        else q.tasks.pop_front();
+        queued.fetch_sub(1, std::memory_order::acq_rel);
+        return t;
+    };
+
+    // Take the newest task from our own queue first, then steal the
+    // oldest one from everyone else, starting with our neighbour so
+    // not every thread goes for the same queue.
+    auto self = CurrentPool == this ? CurrentQueue : queues.size() - 1;
+    if (auto t = TryPop(*queues[self], true)) return t;
+    for (usz i = 1; i < queues.size(); i++)
+        if (auto t = TryPop(*queues[(self + i) % queues.size()], false)) return t;
+    return std::nullopt;
+}
+
+void Pool::Push(Task t) {
+    auto index = CurrentPool == this ? CurrentQueue : queues.size() - 1;
+    auto& q = *queues[index];
+    {
+        std::unique_lock _{q.mutex};
+        q.tasks.push_back(std::move(t));
+    }
+
+    std::unique_lock _{mutex};
+    queued.fetch_add(1, std::memory_order::acq_rel);
+    changed.notify_all();
+}
+
+void Pool::Run(std::stop_token stop, usz index) {
+    CurrentPool = this;
+    CurrentQueue = index;
+    while (not stop.stop_requested()) {
+        if (auto t = Pop()) {
+            (*t)();
+            continue;
+        }
+
+        std::unique_lock lock{mutex};
+        changed.wait(lock, stop, [&] { return queued.load(std::memory_order::acquire) != 0; });
+    }
+}
@@ -0,0 +1,152 @@
+#include <Sim/Sim.hh>
+
+#include <Shared/Validation.hh>
+
+#include <algorithm>
+#include <numeric>
+#include <ranges>
+
+using namespace pr;
+using namespace pr::sim;
+
+// =============================================================================
+//  Scoring
+// =============================================================================
+namespace {
+/// How good the outcome of a game is for a player.
+auto Value(const GameResult& res, PlayerId p) -> f64 {
+    if (not res.winner) return .5;
+    return *res.winner == p ? 1 : 0;
+}
+} // namespace
+
+auto sim::Finish(const GameState& g) -> GameResult {
+    GameResult res;
+    res.turns = g.turns;
+    for (auto [i, s] : res.scores | vws::enumerate) s = Score(g, PlayerId(i));
+
+    // There is only a winner if no one else has the same score.
+    auto best = rgs::max_element(res.scores);
+    if (rgs::count(res.scores, *best) == 1) res.winner = PlayerId(best - res.scores.begin());
+    return res;
+}
+
+auto sim::Score(const GameState& g, PlayerId p) -> u32 {
+    return u32(rgs::count_if(g.players[p].word.stacks, [](const Stack& s) { return s.cards.size() == 1; }));
+}
+
+// =============================================================================
+//  Playing
+// =============================================================================
+auto sim::Determinise(const GameState& g, PlayerId viewer, Rng& rng) -> GameState {
+    auto d = g;
+
+    // Collect every card we can’t see...
+    Pile unknown = d.deck;
+    for (auto [i, p] : d.players | vws::enumerate)
+        if (PlayerId(i) != viewer)
+            for (auto c : p.hand) unknown.push_back(c);
+
+    // ...and deal them back out in the same amounts.
+    rgs::shuffle(unknown, rng);
+    auto next = unknown.begin();
+    for (auto& c : d.deck) c = *next++;
+    for (auto [i, p] : d.players | vws::enumerate)
+        if (PlayerId(i) != viewer)
+            for (auto& c : p.hand) c = *next++;
+    return d;
+}
+
+auto sim::PlayGame(const GameOptions& opts, u64 seed, Pool& pool) -> GameResult {
+    Rng rng{seed};
+    GameState g;
+    rules::SetUp(g, rng, opts.counts);
+
+    rules::IgnoreTurns o;
+    do {
+        auto a = opts.seats[g.current_player] == Policy::MonteCarlo
+                   ? ChooseAction(g, opts.search, pool, rng())
+                   : RandomAction(g, rng);
+        rules::Apply(g, a);
+    } while (rules::EndTurn(g, o));
+    return Finish(g);
+}
+
+auto sim::Playout(GameState g, Rng& rng) -> GameResult {
+    // Every turn removes a card from the game, so this always ends.
+    rules::IgnoreTurns o;
+    do rules::Apply(g, RandomAction(g, rng));
+    while (rules::EndTurn(g, o));
+    return Finish(g);
+}
+
+auto sim::RandomAction(const GameState& g, Rng& rng) -> rules::Action {
+    // Passing when there is a legal move is rarely a good idea, so only
+    // do that if we have to.
+    auto moves = rules::LegalMoves(g);
+    if (auto n = moves.size()) return rules::Action::Play(moves.nth(rng.below(n)));
+    return rules::Action::Discard(rng.below(g.current().hand.size()));
+}
+
+// =============================================================================
+//  Search
+// =============================================================================
+auto sim::ChooseAction(const GameState& g, const SearchOptions& opts, Pool& pool, u64 seed) -> rules::Action {
+    // Consider every legal play, and discarding each kind of card.
+    std::vector<rules::Action> candidates;
+    rules::LegalMoves(g).for_each([&](validation::Move m) { candidates.push_back(rules::Action::Play(m)); });
+    auto& hand = g.current().hand;
+    for (usz i = 0; i < hand.size(); i++)
+        if (std::find(hand.begin(), hand.begin() + i, hand[i]) == hand.begin() + i)
+            candidates.push_back(rules::Action::Discard(i));
+
+    Assert(not candidates.empty(), "Current player has no cards");
+    if (candidates.size() == 1 or opts.playouts == 0) return candidates.front();
+
+    // Playout 'j' of every candidate uses the same seed, and thus the
+    // same guess at the hidden cards, so the candidates are compared
+    // on equal terms.
+    auto me = g.current_player;
+    auto n = opts.playouts;
+    std::vector<f64> values(candidates.size() * n);
+    pool.parallel_for(values.size(), [&](usz i) {
+        Rng rng{MixSeed(seed, i % n)};
+        auto s = opts.cheat ? g : Determinise(g, me, rng);
+        rules::Apply(s, candidates[i / n]);
+
+        rules::IgnoreTurns o;
+        values[i] = Value(rules::EndTurn(s, o) ? Playout(s, rng) : Finish(s), me);
+    });
+
+    // Pick the candidate with the best total; ties go to the first one,
+    // which keeps this deterministic.
+    usz best = 0;
+    f64 best_value = -1;
+    for (usz c = 0; c < candidates.size(); c++) {
+        auto v = std::accumulate(values.begin() + c * n, values.begin() + (c + 1) * n, 0.);
+        if (v > best_value) {
+            best = c;
+            best_value = v;
+        }
+    }
+
+    return candidates[best];
+}
+
+// =============================================================================
+//  Batches
+// =============================================================================
+auto sim::RunBatch(const GameOptions& opts, usz games, u64 seed, Pool& pool) -> BatchResult {
+    std::vector<GameResult> results(games);
+    pool.parallel_for(games, [&](usz i) { results[i] = PlayGame(opts, MixSeed(seed, i), pool); });
+
+    BatchResult b;
+    for (auto& r : results) {
+        if (r.winner) b.wins[*r.winner]++;
+        else b.draws++;
+        b.turns.push_back(r.turns);
+    }
+
+    rgs::sort(b.turns);
+    return b;
+}